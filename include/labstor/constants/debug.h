@@ -27,9 +27,24 @@
 #ifndef LABSTOR_DEBUG_H
 #define LABSTOR_DEBUG_H
 
-#if defined(LABSTOR_DEBUG) && defined(__cplusplus)
-#define AUTO_TRACE(...) labstor::AutoTrace auto_tracer(false, __PRETTY_FUNCTION__, __VA_ARGS__);
-#define TRACEPOINT(...) labstor::AutoTrace(true, __PRETTY_FUNCTION__, __VA_ARGS__);
+/*
+ * AUTO_TRACE records the begin and end of the enclosing scope and TRACEPOINT
+ * records an instant, along with the integer arguments given. Both cost a
+ * branch while their category is switched off. See labstor::Tracer.
+ * */
+#if defined(__cplusplus) && !defined(KERNEL_BUILD)
+#include "labstor/userspace/util/trace.h"
+#define AUTO_TRACE(...) \
+    labstor::AutoTrace auto_tracer; \
+    { \
+        static const labstor::TraceSite &labstor_trace_site = labstor::Tracer::Register(__PRETTY_FUNCTION__, __FILE__, __LINE__, #__VA_ARGS__); \
+        if(labstor::Tracer::IsEnabled(labstor_trace_site.category_)) { auto_tracer.Begin(labstor_trace_site.id_, ##__VA_ARGS__); } \
+    }
+#define TRACEPOINT(...) \
+    { \
+        static const labstor::TraceSite &labstor_trace_site = labstor::Tracer::Register(__PRETTY_FUNCTION__, __FILE__, __LINE__, #__VA_ARGS__); \
+        if(labstor::Tracer::IsEnabled(labstor_trace_site.category_)) { labstor::Tracer::Emit(labstor_trace_site.id_, labstor::TracePhase::kInstant, ##__VA_ARGS__); } \
+    }
 #elif defined(KERNEL_BUILD) && defined(DEBUG)
 #define AUTO_TRACE(...) pr_info(__VA_ARGS__);
 #define TRACEPOINT(...) pr_info(__VA_ARGS__);
@@ -38,51 +53,4 @@
 #define TRACEPOINT(...)
 #endif
 
-#ifdef __cplusplus
-
-#include "stdio.h"
-#include "labstor/userspace/util/timer.h"
-#include "labstor/userspace/util/serializeable.h"
-#include <sched.h>
-#include <unistd.h>
-
-namespace labstor {
-
-class AutoTrace {
-private:
-    std::string base_text_;
-    bool tracepoint_;
-    labstor::HighResCpuTimer t_cpu_;
-    labstor::HighResMonotonicTimer t_total_;
-public:
-    template<typename ...Args>
-    AutoTrace(bool tracepoint, Args ...args) : tracepoint_(tracepoint) {
-        labstor::ArgPacker params(args...);
-        char *buffer = (char *) calloc(8192, 1);
-        size_t off = 0;
-        for (auto &param : params) {
-            off += param.serialize(buffer + off);
-            buffer[off++] = ';';
-        }
-        base_text_ = std::string(buffer, off) + ";";
-        t_cpu_.Resume();
-        t_total_.Resume();
-        if(!tracepoint) { printf("%s\n", (base_text_ + "start").c_str()); }
-        else { printf("%d;%s\n", gettid(),(base_text_).c_str()); }
-    }
-
-    ~AutoTrace() {
-        if(!tracepoint_) {
-            t_cpu_.Pause();
-            t_total_.Pause();
-            base_text_ += "cpu-time-us;" + std::to_string(t_cpu_.GetUsec()) + ";total-time-us;" + std::to_string(t_total_.GetUsec()) + ";";
-            printf("%s\n", (base_text_ + "end").c_str());
-        }
-    }
-};
-
-}
-
-#endif
-
-#endif //LABSTOR_DEBUG_H
\ No newline at end of file
+#endif //LABSTOR_DEBUG_H
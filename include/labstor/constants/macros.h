@@ -54,6 +54,9 @@ static inline labstor::off_t LABSTOR_REGION_SUB(void *ptr, void *region) {
 #define LABSTOR_REGION_ADD(off, region) (void*)((char*)region + off)
 #define LABSTOR_PTR_DIFF(region1,region2) (region1 >= region2 ? (size_t)region1 - (size_t)region2 : (int64_t)((size_t)region1 - (size_t)region2))
 
+/*CACHE LINE*/
+#define LABSTOR_CACHELINE_SIZE 64
+
 /*YIELD*/
 #ifdef KERNEL_BUILD
 #include <linux/sched.h>
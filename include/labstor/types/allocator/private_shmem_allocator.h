@@ -36,6 +36,8 @@
 #include <labstor/constants/debug.h>
 #include "labstor/types/data_structures/c/shmem_request_ring_buffer.h"
 
+#define LABSTOR_ALLOC_MAX_BULK 32
+
 struct labstor_private_shmem_allocator_entry {
     uint32_t stamp_;
 };
@@ -115,6 +117,31 @@ static inline void* labstor_private_shmem_allocator_Alloc(struct labstor_private
 static inline bool labstor_private_shmem_allocator_Free(struct labstor_private_shmem_allocator *alloc, void *data) {
     return labstor_request_ring_buffer_Enqueue_simple(&alloc->objs_, LABSTOR_REGION_SUB(data, alloc->base_region_));
 }
+/*
+ * Allocate or free up to count objects (at most LABSTOR_ALLOC_MAX_BULK) at once.
+ * Returns the number of objects moved.
+ * */
+static inline uint32_t labstor_private_shmem_allocator_AllocBulk(struct labstor_private_shmem_allocator *alloc, void **objs, uint32_t count) {
+    labstor_off_t offs[LABSTOR_ALLOC_MAX_BULK];
+    uint32_t i;
+    if(count > LABSTOR_ALLOC_MAX_BULK) { count = LABSTOR_ALLOC_MAX_BULK; }
+    count = labstor_request_ring_buffer_DequeueBulk(&alloc->objs_, offs, count);
+    for(i = 0; i < count; ++i) {
+        objs[i] = LABSTOR_REGION_ADD(offs[i], alloc->base_region_);
+    }
+    return count;
+}
+
+static inline uint32_t labstor_private_shmem_allocator_FreeBulk(struct labstor_private_shmem_allocator *alloc, void **objs, uint32_t count) {
+    labstor_off_t offs[LABSTOR_ALLOC_MAX_BULK];
+    uint32_t i;
+    if(count > LABSTOR_ALLOC_MAX_BULK) { count = LABSTOR_ALLOC_MAX_BULK; }
+    for(i = 0; i < count; ++i) {
+        offs[i] = LABSTOR_REGION_SUB(objs[i], alloc->base_region_);
+    }
+    return labstor_request_ring_buffer_EnqueueBulk(&alloc->objs_, offs, count);
+}
+
 
 #ifdef __cplusplus
 namespace labstor::ipc {
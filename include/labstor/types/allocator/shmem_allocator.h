@@ -292,6 +292,51 @@ static inline void labstor_shmem_allocator_Free(struct labstor_shmem_allocator *
 #endif
 }
 
+/*
+ * Take up to count pages (at most LABSTOR_ALLOC_MAX_BULK) from the per-core
+ * rings, starting at core. Returns the number of pages taken.
+ * */
+static inline uint32_t labstor_shmem_allocator_AllocBulk(struct labstor_shmem_allocator *alloc, uint32_t core, void **objs, uint32_t count) {
+    struct labstor_shmem_allocator_entry *page;
+    uint32_t save, n = 0, i, taken;
+    if(count > LABSTOR_ALLOC_MAX_BULK) { count = LABSTOR_ALLOC_MAX_BULK; }
+    core = core % alloc->concurrency_;
+    save = core;
+    do {
+        taken = labstor_private_shmem_allocator_AllocBulk(&alloc->per_core_allocs_[core], objs + n, count - n);
+        for(i = n; i < n + taken; ++i) {
+            page = (struct labstor_shmem_allocator_entry *)objs[i];
+            page->core_ = core;
+            objs[i] = (void*)(page + 1);
+        }
+        n += taken;
+        core = (core + 1)%alloc->concurrency_;
+    } while(n < count && core != save);
+    return n;
+}
+
+/*
+ * Return pages to the rings of the cores they were allocated from. Consecutive
+ * pages of the same core are pushed with one ring update.
+ * */
+static inline void labstor_shmem_allocator_FreeBulk(struct labstor_shmem_allocator *alloc, void **objs, uint32_t count) {
+    void *pages[LABSTOR_ALLOC_MAX_BULK];
+    uint32_t i = 0, n, done;
+    int core;
+    while(i < count) {
+        core = (((struct labstor_shmem_allocator_entry*)objs[i]) - 1)->core_;
+        for(n = 0; i < count && n < LABSTOR_ALLOC_MAX_BULK; ++i, ++n) {
+            struct labstor_shmem_allocator_entry *page = ((struct labstor_shmem_allocator_entry*)objs[i]) - 1;
+            if(page->core_ != core) { break; }
+            pages[n] = page;
+        }
+        done = labstor_private_shmem_allocator_FreeBulk(&alloc->per_core_allocs_[core], pages, n);
+        for(; done < n; ++done) {
+            labstor_shmem_allocator_Free(alloc, (struct labstor_shmem_allocator_entry*)pages[done] + 1);
+        }
+    }
+}
+
 static inline void labstor_shmem_allocator_Release(struct labstor_shmem_allocator *alloc) {
     if(alloc->per_core_allocs_) {
         labstor_shmem_allocator_FreePerCore(alloc);
@@ -299,6 +344,81 @@ static inline void labstor_shmem_allocator_Release(struct labstor_shmem_allocato
 }
 
 
+/*
+ * Per-thread magazines in front of the per-core rings (userspace only).
+ *
+ * A thread keeps a bounded stack of free pages for each allocator it uses.
+ * Alloc and Free touch only the thread's stack; the rings are touched in bulk
+ * when the stack runs empty or full. A page freed by another thread (e.g., a
+ * server worker completing a client's request) stays in that thread's magazine
+ * until it is returned in a batch, so the ring's cache line moves once per
+ * batch instead of once per request.
+ * */
+#if defined(__cplusplus) && !defined(KERNEL_BUILD) && !defined(LABSTOR_MEM_DEBUG)
+#define LABSTOR_SHMEM_ALLOC_MAGAZINES
+#endif
+#define LABSTOR_SHMEM_MAGAZINE_SIZE 64
+#define LABSTOR_SHMEM_MAGAZINE_BATCH 32
+#define LABSTOR_SHMEM_MAGAZINE_SLOTS 4
+
+#ifdef LABSTOR_SHMEM_ALLOC_MAGAZINES
+namespace labstor::ipc {
+
+struct shmem_magazine {
+    labstor_shmem_allocator *alloc_;
+    uint32_t count_;
+    void *objs_[LABSTOR_SHMEM_MAGAZINE_SIZE];
+};
+
+class shmem_magazine_cache {
+private:
+    shmem_magazine mags_[LABSTOR_SHMEM_MAGAZINE_SLOTS];
+public:
+    shmem_magazine_cache() {
+        for(auto &mag : mags_) {
+            mag.alloc_ = nullptr;
+            mag.count_ = 0;
+        }
+    }
+    ~shmem_magazine_cache() {
+        for(auto &mag : mags_) {
+            if(mag.alloc_ && mag.count_) {
+                labstor_shmem_allocator_FreeBulk(mag.alloc_, mag.objs_, mag.count_);
+            }
+        }
+    }
+
+    /*The calling thread's magazine for alloc, or nullptr if all slots are taken*/
+    static inline shmem_magazine* Get(labstor_shmem_allocator *alloc) {
+        shmem_magazine *empty = nullptr;
+        for(auto &mag : GetThreadCache().mags_) {
+            if(mag.alloc_ == alloc) { return &mag; }
+            if(mag.alloc_ == nullptr && empty == nullptr) { empty = &mag; }
+        }
+        if(empty) { empty->alloc_ = alloc; }
+        return empty;
+    }
+
+    /*Return the calling thread's cached pages of alloc and release its slot*/
+    static inline void Flush(labstor_shmem_allocator *alloc) {
+        for(auto &mag : GetThreadCache().mags_) {
+            if(mag.alloc_ != alloc) { continue; }
+            labstor_shmem_allocator_FreeBulk(alloc, mag.objs_, mag.count_);
+            mag.alloc_ = nullptr;
+            mag.count_ = 0;
+        }
+    }
+
+private:
+    static inline shmem_magazine_cache& GetThreadCache() {
+        thread_local shmem_magazine_cache cache;
+        return cache;
+    }
+};
+
+}
+#endif
+
 #ifdef __cplusplus
 namespace labstor::ipc {
     typedef labstor_shmem_allocator shmem_allocator;
@@ -319,10 +439,31 @@ void labstor_shmem_allocator::Attach(void *base_region, void *region) {
     labstor_shmem_allocator_Attach(this, base_region, region);
 }
 void *labstor_shmem_allocator::Alloc(uint32_t size, uint32_t core) {
+#ifdef LABSTOR_SHMEM_ALLOC_MAGAZINES
+    labstor::ipc::shmem_magazine *mag = labstor::ipc::shmem_magazine_cache::Get(this);
+    if(mag) {
+        if(mag->count_ == 0) {
+            mag->count_ = labstor_shmem_allocator_AllocBulk(this, core, mag->objs_, LABSTOR_SHMEM_MAGAZINE_BATCH);
+            if(mag->count_ == 0) { return nullptr; }
+        }
+        return mag->objs_[--mag->count_];
+    }
+#endif
     return labstor_shmem_allocator_Alloc(this, size, core);
 }
 void labstor_shmem_allocator::Free(void *data) {
-    return labstor_shmem_allocator_Free(this, data);
+#ifdef LABSTOR_SHMEM_ALLOC_MAGAZINES
+    labstor::ipc::shmem_magazine *mag = labstor::ipc::shmem_magazine_cache::Get(this);
+    if(mag) {
+        if(mag->count_ == LABSTOR_SHMEM_MAGAZINE_SIZE) {
+            mag->count_ -= LABSTOR_SHMEM_MAGAZINE_BATCH;
+            labstor_shmem_allocator_FreeBulk(this, mag->objs_ + mag->count_, LABSTOR_SHMEM_MAGAZINE_BATCH);
+        }
+        mag->objs_[mag->count_++] = data;
+        return;
+    }
+#endif
+    labstor_shmem_allocator_Free(this, data);
 }
 #endif
 
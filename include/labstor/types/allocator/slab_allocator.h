@@ -0,0 +1,606 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_SLAB_ALLOCATOR_H
+#define LABSTOR_SLAB_ALLOCATOR_H
+
+#include <labstor/constants/macros.h>
+#include <labstor/types/basics.h>
+#ifdef __cplusplus
+#include <sys/sysinfo.h>
+#include "allocator.h"
+#endif
+
+/*
+ * A size-class slab allocator for a shared-memory request region.
+ *
+ * The region is cut into fixed-size slabs. A slab is formatted for one size
+ * class (a power of two starting at the region's minimum unit) when it is first
+ * needed, so small requests are packed densely while large ones (e.g., requests
+ * carrying a path) still fit. Each core keeps a current slab per size class in
+ * the region itself; an exhausted slab is detached and re-queued on its class's
+ * partial list once an object in it is freed.
+ *
+ * All links are slab or object indexes relative to the region, so any process
+ * which maps the region can free any object. The lists are Treiber stacks whose
+ * heads carry a tag in the upper 32 bits to avoid ABA.
+ *
+ * The region can be grown with segments placed at fixed strides (the segment
+ * span) after the header. The segment table lives in the header, and a slab
+ * index holds its segment in the upper 16 bits, so finding the slab of an
+ * object is a division rather than a search.
+ *
+ * Slab data is aligned to the minimum unit (up to a page), so a region used as
+ * a data buffer pool hands out page-aligned buffers.
+ * */
+
+#define LABSTOR_SLAB_SIZE (16*1024)
+#define LABSTOR_SLAB_MIN_SLAB_SIZE 1024
+#define LABSTOR_SLAB_MIN_SLABS 16
+#define LABSTOR_SLAB_MIN_UNIT 64
+#define LABSTOR_SLAB_MAX_ALIGN 4096
+#define LABSTOR_SLAB_MAX_CLASSES 8
+#define LABSTOR_SLAB_MAX_RETRIES 8
+#define LABSTOR_SLAB_NIL 0xFFFFFFFFu
+#define LABSTOR_SLAB_MAX_SEGMENTS 64
+#define LABSTOR_SLAB_SEGMENT_SHIFT 16
+#define LABSTOR_SLAB_MAX_SEGMENT_SLABS ((1u << LABSTOR_SLAB_SEGMENT_SHIFT) - 1)
+#define LABSTOR_SLAB_INDEX(seg, local) (((uint32_t)(seg) << LABSTOR_SLAB_SEGMENT_SHIFT) | (local))
+
+enum labstor_slab_state {
+    LABSTOR_SLAB_EMPTY,
+    LABSTOR_SLAB_ACTIVE,
+    LABSTOR_SLAB_PARTIAL,
+    LABSTOR_SLAB_FULL
+};
+
+struct labstor_slab {
+    uint64_t free_;
+    uint32_t next_;
+    int32_t num_free_;
+    uint32_t num_objs_;
+    uint16_t class_;
+    uint16_t state_;
+    char pad_[LABSTOR_CACHELINE_SIZE - sizeof(uint64_t) - 4*sizeof(uint32_t)];
+};
+
+struct labstor_slab_core {
+    uint32_t cur_[LABSTOR_SLAB_MAX_CLASSES];
+    char pad_[LABSTOR_CACHELINE_SIZE - LABSTOR_SLAB_MAX_CLASSES*sizeof(uint32_t)];
+};
+
+/*
+ * Offsets are relative to the allocator header.
+ * */
+struct labstor_slab_segment {
+    uint32_t size_;
+    uint32_t num_slabs_;
+    uint32_t slabs_off_;
+    uint32_t data_off_;
+};
+
+struct labstor_slab_allocator_header {
+    uint32_t region_size_;
+    uint32_t slab_size_;
+    uint32_t num_slabs_;
+    uint32_t num_classes_;
+    uint32_t min_unit_;
+    uint32_t concurrency_;
+    uint32_t segment_span_;
+    uint32_t num_segments_;
+    uint32_t data_align_;
+    char config_pad_[LABSTOR_CACHELINE_SIZE - 9*sizeof(uint32_t)];
+    uint64_t free_slabs_;
+    uint64_t partial_[LABSTOR_SLAB_MAX_CLASSES];
+    char list_pad_[LABSTOR_CACHELINE_SIZE - sizeof(uint64_t)];
+    struct labstor_slab_segment segments_[LABSTOR_SLAB_MAX_SEGMENTS];
+};
+
+#ifdef __cplusplus
+struct labstor_slab_allocator : public labstor::GenericAllocator {
+#else
+struct labstor_slab_allocator {
+#endif
+    void *base_region_;
+    struct labstor_slab_allocator_header *header_;
+    struct labstor_slab_core *cores_;
+
+#ifdef __cplusplus
+    inline void* GetRegion();
+    inline void* GetBaseRegion();
+    inline uint32_t GetSize();
+    inline void Init(void *base_region, void *region, uint32_t region_size, uint32_t min_unit, int concurrency = 0, uint32_t segment_span = 0);
+    inline void InitSlabs(void *base_region, void *region, uint32_t region_size, uint32_t min_unit, uint32_t slab_size,
+                          int concurrency = 0, uint32_t segment_span = 0);
+    inline void Attach(void *base_region, void *region);
+    inline void AddSegment(void *segment, uint32_t size);
+    inline uint32_t GetNumSegments();
+    inline int GetClass(uint32_t size);
+    inline uint32_t GetClassSize(int cls);
+    inline uint32_t GetMaxSize();
+    inline void *Alloc(uint32_t size, uint32_t core) override;
+    inline void Free(void *data) override;
+#endif
+};
+
+static inline uint64_t labstor_slab_MakeHead(uint64_t old, uint32_t idx) {
+    return (((old >> 32) + 1) << 32) | idx;
+}
+
+static inline void* labstor_slab_allocator_GetRegion(struct labstor_slab_allocator *alloc) {
+    return alloc->header_;
+}
+
+static inline void* labstor_slab_allocator_GetBaseRegion(struct labstor_slab_allocator *alloc) {
+    return alloc->base_region_;
+}
+
+static inline uint32_t labstor_slab_allocator_GetSize(struct labstor_slab_allocator *alloc) {
+    return alloc->header_->region_size_;
+}
+
+static inline uint32_t labstor_slab_allocator_GetClassSize(struct labstor_slab_allocator *alloc, int cls) {
+    return alloc->header_->min_unit_ << cls;
+}
+
+static inline uint32_t labstor_slab_allocator_GetMaxSize(struct labstor_slab_allocator *alloc) {
+    return labstor_slab_allocator_GetClassSize(alloc, alloc->header_->num_classes_ - 1);
+}
+
+/*
+ * The smallest size class which fits size, or -1 if none does.
+ * */
+static inline int labstor_slab_allocator_GetClass(struct labstor_slab_allocator *alloc, uint32_t size) {
+    uint32_t class_size = alloc->header_->min_unit_;
+    int cls;
+    for(cls = 0; cls < (int)alloc->header_->num_classes_; ++cls) {
+        if(size <= class_size) { return cls; }
+        class_size <<= 1;
+    }
+    return -1;
+}
+
+static inline uint32_t labstor_slab_allocator_GetNumSegments(struct labstor_slab_allocator *alloc) {
+    return __atomic_load_n(&alloc->header_->num_segments_, __ATOMIC_ACQUIRE);
+}
+
+static inline struct labstor_slab* labstor_slab_allocator_GetSlab(struct labstor_slab_allocator *alloc, uint32_t idx) {
+    struct labstor_slab_segment *segment = &alloc->header_->segments_[idx >> LABSTOR_SLAB_SEGMENT_SHIFT];
+    return (struct labstor_slab*)((char*)alloc->header_ + segment->slabs_off_) + (idx & LABSTOR_SLAB_MAX_SEGMENT_SLABS);
+}
+
+static inline char* labstor_slab_allocator_GetSlabData(struct labstor_slab_allocator *alloc, uint32_t idx) {
+    struct labstor_slab_segment *segment = &alloc->header_->segments_[idx >> LABSTOR_SLAB_SEGMENT_SHIFT];
+    return (char*)alloc->header_ + segment->data_off_ + (size_t)(idx & LABSTOR_SLAB_MAX_SEGMENT_SLABS)*alloc->header_->slab_size_;
+}
+
+static inline void labstor_slab_allocator_Push(struct labstor_slab_allocator *alloc, uint64_t *head, uint32_t idx) {
+    struct labstor_slab *slab = labstor_slab_allocator_GetSlab(alloc, idx);
+    uint64_t old = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+    do {
+        __atomic_store_n(&slab->next_, (uint32_t)old, __ATOMIC_RELAXED);
+    } while(!__atomic_compare_exchange_n(head, &old, labstor_slab_MakeHead(old, idx), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+}
+
+static inline uint32_t labstor_slab_allocator_Pop(struct labstor_slab_allocator *alloc, uint64_t *head) {
+    uint64_t old = __atomic_load_n(head, __ATOMIC_ACQUIRE);
+    uint32_t idx, next;
+    do {
+        idx = (uint32_t)old;
+        if(idx == LABSTOR_SLAB_NIL) { return LABSTOR_SLAB_NIL; }
+        next = __atomic_load_n(&labstor_slab_allocator_GetSlab(alloc, idx)->next_, __ATOMIC_RELAXED);
+    } while(!__atomic_compare_exchange_n(head, &old, labstor_slab_MakeHead(old, next), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    return idx;
+}
+
+/*
+ * Object free lists store the index of the next free object in the object itself.
+ *
+ * num_free_ counts the objects which may be taken. A thread reserves an object
+ * by decrementing it before popping the list, and Free pushes an object before
+ * incrementing it, so a reservation always finds an object on the list. A slab
+ * can only be reformatted by claiming every object at once.
+ * */
+static inline bool labstor_slab_allocator_Reserve(struct labstor_slab *slab) {
+    int32_t num_free = __atomic_load_n(&slab->num_free_, __ATOMIC_ACQUIRE);
+    do {
+        if(num_free <= 0) { return false; }
+    } while(!__atomic_compare_exchange_n(&slab->num_free_, &num_free, num_free - 1, false, __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE));
+    return true;
+}
+
+static inline void labstor_slab_allocator_Requeue(struct labstor_slab_allocator *alloc, uint32_t idx, uint16_t state);
+
+/*
+ * Give back a reservation which was not used. Like Free, re-queue the slab if
+ * it was retired in the meantime.
+ * */
+static inline void labstor_slab_allocator_Unreserve(struct labstor_slab_allocator *alloc, uint32_t idx) {
+    struct labstor_slab *slab = labstor_slab_allocator_GetSlab(alloc, idx);
+    __atomic_fetch_add(&slab->num_free_, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&slab->state_, __ATOMIC_SEQ_CST) == LABSTOR_SLAB_FULL) {
+        labstor_slab_allocator_Requeue(alloc, idx, LABSTOR_SLAB_FULL);
+    }
+}
+
+/*
+ * Take an object of class cls from a slab a core pointed at. Between reading the
+ * core's pointer and reserving, the slab may have been retired, stolen by another
+ * class and reformatted. Format stores the class before num_free_, so a
+ * reservation which sees the wrong class is given back.
+ * */
+static inline void* labstor_slab_allocator_PopObject(struct labstor_slab_allocator *alloc, uint32_t idx, int cls) {
+    struct labstor_slab *slab = labstor_slab_allocator_GetSlab(alloc, idx);
+    char *data = labstor_slab_allocator_GetSlabData(alloc, idx);
+    uint32_t class_size, obj, next;
+    uint64_t old;
+    if(!labstor_slab_allocator_Reserve(slab)) { return NULL; }
+    if(__atomic_load_n(&slab->class_, __ATOMIC_SEQ_CST) != cls) {
+        labstor_slab_allocator_Unreserve(alloc, idx);
+        return NULL;
+    }
+    class_size = labstor_slab_allocator_GetClassSize(alloc, cls);
+    old = __atomic_load_n(&slab->free_, __ATOMIC_ACQUIRE);
+    do {
+        obj = (uint32_t)old;
+        next = __atomic_load_n((uint32_t*)(data + (size_t)obj*class_size), __ATOMIC_RELAXED);
+    } while(!__atomic_compare_exchange_n(&slab->free_, &old, labstor_slab_MakeHead(old, next), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    return data + (size_t)obj*class_size;
+}
+
+static inline void labstor_slab_allocator_PushObject(struct labstor_slab_allocator *alloc, uint32_t idx, uint32_t obj) {
+    struct labstor_slab *slab = labstor_slab_allocator_GetSlab(alloc, idx);
+    char *data = labstor_slab_allocator_GetSlabData(alloc, idx);
+    uint32_t *link = (uint32_t*)(data + (size_t)obj*labstor_slab_allocator_GetClassSize(alloc, slab->class_));
+    uint64_t old = __atomic_load_n(&slab->free_, __ATOMIC_ACQUIRE);
+    do {
+        __atomic_store_n(link, (uint32_t)old, __ATOMIC_RELAXED);
+    } while(!__atomic_compare_exchange_n(&slab->free_, &old, labstor_slab_MakeHead(old, obj), false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+    __atomic_fetch_add(&slab->num_free_, 1, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Carve an unowned slab into objects of a size class.
+ * */
+static inline void labstor_slab_allocator_Format(struct labstor_slab_allocator *alloc, uint32_t idx, int cls) {
+    struct labstor_slab *slab = labstor_slab_allocator_GetSlab(alloc, idx);
+    char *data = labstor_slab_allocator_GetSlabData(alloc, idx);
+    uint32_t class_size = labstor_slab_allocator_GetClassSize(alloc, cls);
+    uint32_t i;
+    __atomic_store_n(&slab->class_, cls, __ATOMIC_SEQ_CST);
+    slab->num_objs_ = alloc->header_->slab_size_ / class_size;
+    for(i = 0; i < slab->num_objs_; ++i) {
+        *(uint32_t*)(data + (size_t)i*class_size) = (i + 1 < slab->num_objs_) ? i + 1 : LABSTOR_SLAB_NIL;
+    }
+    __atomic_store_n(&slab->free_, labstor_slab_MakeHead(slab->free_, 0), __ATOMIC_RELEASE);
+    __atomic_store_n(&slab->state_, LABSTOR_SLAB_ACTIVE, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&slab->num_free_, (int32_t)slab->num_objs_, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Put a slab with free objects back on the partial list of its class.
+ * */
+static inline void labstor_slab_allocator_Requeue(struct labstor_slab_allocator *alloc, uint32_t idx, uint16_t state) {
+    struct labstor_slab *slab = labstor_slab_allocator_GetSlab(alloc, idx);
+    if(__atomic_compare_exchange_n(&slab->state_, &state, LABSTOR_SLAB_PARTIAL, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        labstor_slab_allocator_Push(alloc, &alloc->header_->partial_[slab->class_], idx);
+    }
+}
+
+/*
+ * Detach an exhausted slab from a core. Whichever of this and a concurrent Free
+ * observes the other re-queues the slab, so a slab with free objects is never lost.
+ * */
+static inline void labstor_slab_allocator_Retire(struct labstor_slab_allocator *alloc, uint32_t idx) {
+    struct labstor_slab *slab = labstor_slab_allocator_GetSlab(alloc, idx);
+    __atomic_store_n(&slab->state_, LABSTOR_SLAB_FULL, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&slab->num_free_, __ATOMIC_SEQ_CST) > 0) {
+        labstor_slab_allocator_Requeue(alloc, idx, LABSTOR_SLAB_FULL);
+    }
+}
+
+/*
+ * Find a slab for a size class: a partial one, then an empty one, and finally a
+ * completely free slab from the partial list of another class.
+ * */
+static inline uint32_t labstor_slab_allocator_Refill(struct labstor_slab_allocator *alloc, int cls) {
+    struct labstor_slab *slab;
+    int32_t num_objs;
+    uint32_t idx;
+    int i;
+
+    idx = labstor_slab_allocator_Pop(alloc, &alloc->header_->partial_[cls]);
+    if(idx != LABSTOR_SLAB_NIL) {
+        __atomic_store_n(&labstor_slab_allocator_GetSlab(alloc, idx)->state_, LABSTOR_SLAB_ACTIVE, __ATOMIC_SEQ_CST);
+        return idx;
+    }
+    idx = labstor_slab_allocator_Pop(alloc, &alloc->header_->free_slabs_);
+    if(idx != LABSTOR_SLAB_NIL) {
+        labstor_slab_allocator_Format(alloc, idx, cls);
+        return idx;
+    }
+    for(i = 0; i < (int)alloc->header_->num_classes_; ++i) {
+        uint32_t busy = LABSTOR_SLAB_NIL, found = LABSTOR_SLAB_NIL;
+        if(i == cls) { continue; }
+        while(found == LABSTOR_SLAB_NIL && (idx = labstor_slab_allocator_Pop(alloc, &alloc->header_->partial_[i])) != LABSTOR_SLAB_NIL) {
+            slab = labstor_slab_allocator_GetSlab(alloc, idx);
+            num_objs = slab->num_objs_;
+            if(__atomic_compare_exchange_n(&slab->num_free_, &num_objs, 0, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+                found = idx;
+            } else {
+                slab->next_ = busy;
+                busy = idx;
+            }
+        }
+        while(busy != LABSTOR_SLAB_NIL) {
+            idx = busy;
+            busy = labstor_slab_allocator_GetSlab(alloc, idx)->next_;
+            labstor_slab_allocator_Push(alloc, &alloc->header_->partial_[i], idx);
+        }
+        if(found != LABSTOR_SLAB_NIL) {
+            labstor_slab_allocator_Format(alloc, found, cls);
+            return found;
+        }
+    }
+    return LABSTOR_SLAB_NIL;
+}
+
+static inline void labstor_slab_allocator_Layout(struct labstor_slab_allocator *alloc, void *base_region, void *region) {
+    alloc->base_region_ = base_region;
+    alloc->header_ = (struct labstor_slab_allocator_header*)region;
+    alloc->cores_ = (struct labstor_slab_core*)(alloc->header_ + 1);
+}
+
+static inline uint32_t labstor_slab_allocator_GetDataAlign(uint32_t unit) {
+    return unit < LABSTOR_SLAB_MAX_ALIGN ? unit : LABSTOR_SLAB_MAX_ALIGN;
+}
+
+static inline uint32_t labstor_slab_allocator_GetNumSlabs(uint32_t region_size, uint32_t slab_size, uint32_t concurrency, uint32_t align) {
+    uint32_t meta_size = sizeof(struct labstor_slab_allocator_header) + concurrency*sizeof(struct labstor_slab_core) + align - 1;
+    uint32_t num_slabs;
+    if(region_size <= meta_size) { return 0; }
+    num_slabs = (region_size - meta_size) / (slab_size + sizeof(struct labstor_slab));
+    return num_slabs < LABSTOR_SLAB_MAX_SEGMENT_SLABS ? num_slabs : LABSTOR_SLAB_MAX_SEGMENT_SLABS;
+}
+
+/*
+ * Format the slab descriptors of a segment and hand its slabs to the free list.
+ * The segment entry is written before any of its slabs can be popped.
+ * */
+static inline void labstor_slab_allocator_FormatSegment(struct labstor_slab_allocator *alloc, uint32_t seg,
+        uint32_t size, uint32_t num_slabs, uint32_t slabs_off) {
+    struct labstor_slab_segment *segment = &alloc->header_->segments_[seg];
+    uint32_t i;
+    segment->size_ = size;
+    segment->num_slabs_ = num_slabs;
+    segment->slabs_off_ = slabs_off;
+    segment->data_off_ = slabs_off + num_slabs*sizeof(struct labstor_slab);
+    segment->data_off_ = (segment->data_off_ + alloc->header_->data_align_ - 1) & ~(alloc->header_->data_align_ - 1);
+    for(i = num_slabs; i > 0; --i) {
+        struct labstor_slab *slab = labstor_slab_allocator_GetSlab(alloc, LABSTOR_SLAB_INDEX(seg, i - 1));
+        slab->free_ = LABSTOR_SLAB_NIL;
+        slab->num_free_ = 0;
+        slab->num_objs_ = 0;
+        slab->class_ = 0;
+        slab->state_ = LABSTOR_SLAB_EMPTY;
+    }
+    __atomic_fetch_add(&alloc->header_->num_slabs_, num_slabs, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&alloc->header_->num_segments_, 1, __ATOMIC_RELEASE);
+    for(i = num_slabs; i > 0; --i) {
+        labstor_slab_allocator_Push(alloc, &alloc->header_->free_slabs_, LABSTOR_SLAB_INDEX(seg, i - 1));
+    }
+}
+
+static inline bool labstor_slab_allocator_InitSlabs(
+        struct labstor_slab_allocator *alloc, void *base_region, void *region, uint32_t region_size, uint32_t min_unit, uint32_t slab_size,
+        int concurrency, uint32_t segment_span) {
+    struct labstor_slab_allocator_header *header = (struct labstor_slab_allocator_header*)region;
+    uint32_t unit = LABSTOR_SLAB_MIN_UNIT, align, num_slabs, num_classes, max_concurrency, i, j;
+
+    if(concurrency <= 0) {
+#ifdef KERNEL_BUILD
+        concurrency = NR_CPUS;
+#elif __cplusplus
+        concurrency = get_nprocs_conf();
+#else
+        concurrency = 1;
+#endif
+    }
+    while(unit < min_unit) { unit <<= 1; }
+    align = labstor_slab_allocator_GetDataAlign(unit);
+
+    //Shrink slabs for small regions, then cap the number of cores so that each
+    //core can hold a current slab of every class without draining the region
+    num_slabs = labstor_slab_allocator_GetNumSlabs(region_size, slab_size, concurrency, align);
+    while(num_slabs < LABSTOR_SLAB_MIN_SLABS && slab_size > LABSTOR_SLAB_MIN_SLAB_SIZE && slab_size > 4*unit) {
+        slab_size >>= 1;
+        num_slabs = labstor_slab_allocator_GetNumSlabs(region_size, slab_size, concurrency, align);
+    }
+    for(num_classes = 1; num_classes < LABSTOR_SLAB_MAX_CLASSES && (unit << num_classes) <= slab_size / 4; ++num_classes);
+    max_concurrency = num_slabs / (2*num_classes);
+    if(max_concurrency == 0) { max_concurrency = 1; }
+    if((uint32_t)concurrency > max_concurrency) {
+        concurrency = max_concurrency;
+        num_slabs = labstor_slab_allocator_GetNumSlabs(region_size, slab_size, concurrency, align);
+    }
+    if(num_slabs == 0 || slab_size < unit || (segment_span && region_size > segment_span)) {
+#ifdef __cplusplus
+        throw labstor::INVALID_RING_BUFFER_SIZE.format(region_size, min_unit);
+#else
+        return false;
+#endif
+    }
+
+    header->region_size_ = region_size;
+    header->slab_size_ = slab_size;
+    header->num_slabs_ = 0;
+    header->num_classes_ = num_classes;
+    header->min_unit_ = unit;
+    header->concurrency_ = concurrency;
+    header->segment_span_ = segment_span;
+    header->num_segments_ = 0;
+    header->data_align_ = align;
+    header->free_slabs_ = LABSTOR_SLAB_NIL;
+    for(i = 0; i < LABSTOR_SLAB_MAX_CLASSES; ++i) {
+        header->partial_[i] = LABSTOR_SLAB_NIL;
+    }
+    for(i = 0; i < LABSTOR_SLAB_MAX_SEGMENTS; ++i) {
+        header->segments_[i].size_ = 0;
+        header->segments_[i].num_slabs_ = 0;
+    }
+    labstor_slab_allocator_Layout(alloc, base_region, region);
+    for(i = 0; i < (uint32_t)concurrency; ++i) {
+        for(j = 0; j < LABSTOR_SLAB_MAX_CLASSES; ++j) {
+            alloc->cores_[i].cur_[j] = LABSTOR_SLAB_NIL;
+        }
+    }
+    labstor_slab_allocator_FormatSegment(alloc, 0, region_size, num_slabs,
+            sizeof(struct labstor_slab_allocator_header) + concurrency*sizeof(struct labstor_slab_core));
+    return true;
+}
+
+static inline bool labstor_slab_allocator_Init(
+        struct labstor_slab_allocator *alloc, void *base_region, void *region, uint32_t region_size, uint32_t min_unit, int concurrency,
+        uint32_t segment_span) {
+    return labstor_slab_allocator_InitSlabs(alloc, base_region, region, region_size, min_unit, LABSTOR_SLAB_SIZE, concurrency, segment_span);
+}
+
+/*
+ * Add the slabs of a segment mapped at a multiple of the segment span from the
+ * header. Any process which maps the segment at the same place can use them.
+ * */
+static inline bool labstor_slab_allocator_AddSegment(struct labstor_slab_allocator *alloc, void *segment, uint32_t size) {
+    struct labstor_slab_allocator_header *header = alloc->header_;
+    size_t off = (size_t)((char*)segment - (char*)header);
+    uint32_t seg = header->segment_span_ ? off / header->segment_span_ : 0;
+    uint32_t num_slabs = size > header->data_align_ ? (size - header->data_align_ + 1) / (header->slab_size_ + sizeof(struct labstor_slab)) : 0;
+    if(num_slabs > LABSTOR_SLAB_MAX_SEGMENT_SLABS) { num_slabs = LABSTOR_SLAB_MAX_SEGMENT_SLABS; }
+    if(seg == 0 || seg >= LABSTOR_SLAB_MAX_SEGMENTS || off % header->segment_span_ ||
+            size > header->segment_span_ || num_slabs == 0 || header->segments_[seg].num_slabs_) {
+#ifdef __cplusplus
+        throw labstor::INVALID_SLAB_SEGMENT.format(size, off);
+#else
+        return false;
+#endif
+    }
+    labstor_slab_allocator_FormatSegment(alloc, seg, size, num_slabs, off);
+    return true;
+}
+
+static inline void labstor_slab_allocator_Attach(struct labstor_slab_allocator *alloc, void *base_region, void *region) {
+    labstor_slab_allocator_Layout(alloc, base_region, region);
+}
+
+static inline void *labstor_slab_allocator_Alloc(struct labstor_slab_allocator *alloc, uint32_t size, uint32_t core) {
+    int cls = labstor_slab_allocator_GetClass(alloc, size);
+    uint32_t *cur, idx, nil, retry;
+    void *obj;
+    if(cls < 0) { return NULL; }
+    cur = &alloc->cores_[core % alloc->header_->concurrency_].cur_[cls];
+
+    for(retry = 0; retry < LABSTOR_SLAB_MAX_RETRIES; ++retry) {
+        idx = __atomic_load_n(cur, __ATOMIC_ACQUIRE);
+        if(idx != LABSTOR_SLAB_NIL) {
+            obj = labstor_slab_allocator_PopObject(alloc, idx, cls);
+            if(obj) { return obj; }
+            if(__atomic_compare_exchange_n(cur, &idx, LABSTOR_SLAB_NIL, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                labstor_slab_allocator_Retire(alloc, idx);
+            }
+            continue;
+        }
+        idx = labstor_slab_allocator_Refill(alloc, cls);
+        if(idx == LABSTOR_SLAB_NIL) { return NULL; }
+        nil = LABSTOR_SLAB_NIL;
+        if(!__atomic_compare_exchange_n(cur, &nil, idx, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            //Another thread on this core installed a slab first
+            labstor_slab_allocator_Requeue(alloc, idx, LABSTOR_SLAB_ACTIVE);
+        }
+    }
+    return NULL;
+}
+
+static inline void labstor_slab_allocator_Free(struct labstor_slab_allocator *alloc, void *data) {
+    size_t off = (size_t)((char*)data - (char*)alloc->header_);
+    uint32_t seg = alloc->header_->segment_span_ ? off / alloc->header_->segment_span_ : 0;
+    uint32_t idx, obj;
+    struct labstor_slab *slab;
+    off -= alloc->header_->segments_[seg].data_off_;
+    idx = LABSTOR_SLAB_INDEX(seg, off / alloc->header_->slab_size_);
+    slab = labstor_slab_allocator_GetSlab(alloc, idx);
+    obj = (off % alloc->header_->slab_size_) / labstor_slab_allocator_GetClassSize(alloc, slab->class_);
+    labstor_slab_allocator_PushObject(alloc, idx, obj);
+    if(__atomic_load_n(&slab->state_, __ATOMIC_SEQ_CST) == LABSTOR_SLAB_FULL) {
+        labstor_slab_allocator_Requeue(alloc, idx, LABSTOR_SLAB_FULL);
+    }
+}
+
+#ifdef __cplusplus
+namespace labstor::ipc {
+    typedef labstor_slab_allocator slab_allocator;
+}
+void* labstor_slab_allocator::GetRegion() {
+    return labstor_slab_allocator_GetRegion(this);
+}
+void* labstor_slab_allocator::GetBaseRegion() {
+    return labstor_slab_allocator_GetBaseRegion(this);
+}
+uint32_t labstor_slab_allocator::GetSize() {
+    return labstor_slab_allocator_GetSize(this);
+}
+void labstor_slab_allocator::Init(void *base_region, void *region, uint32_t region_size, uint32_t min_unit, int concurrency, uint32_t segment_span) {
+    labstor_slab_allocator_Init(this, base_region, region, region_size, min_unit, concurrency, segment_span);
+}
+void labstor_slab_allocator::InitSlabs(void *base_region, void *region, uint32_t region_size, uint32_t min_unit, uint32_t slab_size,
+                                       int concurrency, uint32_t segment_span) {
+    labstor_slab_allocator_InitSlabs(this, base_region, region, region_size, min_unit, slab_size, concurrency, segment_span);
+}
+void labstor_slab_allocator::Attach(void *base_region, void *region) {
+    labstor_slab_allocator_Attach(this, base_region, region);
+}
+void labstor_slab_allocator::AddSegment(void *segment, uint32_t size) {
+    labstor_slab_allocator_AddSegment(this, segment, size);
+}
+uint32_t labstor_slab_allocator::GetNumSegments() {
+    return labstor_slab_allocator_GetNumSegments(this);
+}
+int labstor_slab_allocator::GetClass(uint32_t size) {
+    return labstor_slab_allocator_GetClass(this, size);
+}
+uint32_t labstor_slab_allocator::GetClassSize(int cls) {
+    return labstor_slab_allocator_GetClassSize(this, cls);
+}
+uint32_t labstor_slab_allocator::GetMaxSize() {
+    return labstor_slab_allocator_GetMaxSize(this);
+}
+void *labstor_slab_allocator::Alloc(uint32_t size, uint32_t core) {
+    return labstor_slab_allocator_Alloc(this, size, core);
+}
+void labstor_slab_allocator::Free(void *data) {
+    labstor_slab_allocator_Free(this, data);
+}
+#endif
+
+#endif //LABSTOR_SLAB_ALLOCATOR_H
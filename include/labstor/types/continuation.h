@@ -0,0 +1,269 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_CONTINUATION_H
+#define LABSTOR_CONTINUATION_H
+
+#include <coroutine>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+
+/*Coroutine frames are pooled in multiples of this size*/
+#define LABSTOR_CONTINUATION_FRAME_UNIT 64
+/*Frames larger than this come straight from the heap*/
+#define LABSTOR_CONTINUATION_MAX_POOLED_FRAME 4096
+/*Number of free frames of each size a thread keeps*/
+#define LABSTOR_CONTINUATION_MAX_FREE 256
+
+namespace labstor {
+
+/*
+ * Recycles coroutine frames. Each thread (i.e., each worker) has its own free
+ * lists, one per multiple of LABSTOR_CONTINUATION_FRAME_UNIT, so allocating a
+ * frame takes no lock. A frame freed on another thread than the one which
+ * allocated it, e.g., after its request migrated, joins that thread's lists.
+ * */
+class ContinuationFramePool {
+private:
+    static const uint32_t kNumClasses = LABSTOR_CONTINUATION_MAX_POOLED_FRAME / LABSTOR_CONTINUATION_FRAME_UNIT + 1;
+    struct alignas(std::max_align_t) FrameHeader {
+        uint32_t size_class_;
+    };
+    struct FreeFrame {
+        FreeFrame *next_;
+    };
+    FreeFrame *free_[kNumClasses];
+    uint32_t num_free_[kNumClasses];
+public:
+    ContinuationFramePool() {
+        for(uint32_t i = 0; i < kNumClasses; ++i) {
+            free_[i] = nullptr;
+            num_free_[i] = 0;
+        }
+    }
+    ~ContinuationFramePool() {
+        for(uint32_t i = 0; i < kNumClasses; ++i) {
+            while(free_[i]) {
+                FreeFrame *frame = free_[i];
+                free_[i] = frame->next_;
+                free(frame);
+            }
+        }
+    }
+
+    static inline ContinuationFramePool& Get() {
+        thread_local ContinuationFramePool pool;
+        return pool;
+    }
+
+    inline void* Alloc(size_t size) {
+        size_t total = size + sizeof(FrameHeader);
+        uint32_t size_class = (total + LABSTOR_CONTINUATION_FRAME_UNIT - 1) / LABSTOR_CONTINUATION_FRAME_UNIT;
+        FrameHeader *header;
+        if(size_class >= kNumClasses) {
+            size_class = 0;
+        } else if(free_[size_class]) {
+            FreeFrame *frame = free_[size_class];
+            free_[size_class] = frame->next_;
+            --num_free_[size_class];
+            header = reinterpret_cast<FrameHeader*>(frame);
+            header->size_class_ = size_class;
+            return header + 1;
+        } else {
+            total = size_class*LABSTOR_CONTINUATION_FRAME_UNIT;
+        }
+        header = reinterpret_cast<FrameHeader*>(malloc(total));
+        if(header == nullptr) {
+            throw std::bad_alloc();
+        }
+        header->size_class_ = size_class;
+        return header + 1;
+    }
+
+    inline void Free(void *ptr) {
+        FrameHeader *header = reinterpret_cast<FrameHeader*>(ptr) - 1;
+        uint32_t size_class = header->size_class_;
+        if(size_class == 0 || num_free_[size_class] >= LABSTOR_CONTINUATION_MAX_FREE) {
+            free(header);
+            return;
+        }
+        FreeFrame *frame = reinterpret_cast<FreeFrame*>(header);
+        frame->next_ = free_[size_class];
+        free_[size_class] = frame;
+        ++num_free_[size_class];
+    }
+};
+
+/*
+ * A request handler written as a coroutine.
+ *
+ * A handler returns a Continuation and awaits operations which complete later,
+ * e.g., co_await kern_qp->Submit(kern_rq). The handler runs until its first
+ * such operation is pending. ProcessRequest then hands it to the worker with
+ * RunContinuation and returns false. The worker holds onto it, checks whether
+ * the awaited operation completed, and resumes the handler where it left off
+ * instead of calling ProcessRequest again.
+ * */
+class Continuation {
+public:
+    struct promise_type {
+        bool (*ready_)(void*);
+        void *awaiter_;
+        std::exception_ptr exception_;
+
+        promise_type() : ready_(nullptr), awaiter_(nullptr) {}
+        Continuation get_return_object() {
+            return Continuation(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { exception_ = std::current_exception(); }
+
+        /*Called by awaiters when they suspend the handler*/
+        void Await(void *awaiter, bool (*ready)(void*)) {
+            awaiter_ = awaiter;
+            ready_ = ready;
+        }
+
+        static void* operator new(size_t size) {
+            return ContinuationFramePool::Get().Alloc(size);
+        }
+        static void operator delete(void *ptr) {
+            ContinuationFramePool::Get().Free(ptr);
+        }
+    };
+    typedef std::coroutine_handle<promise_type> handle_type;
+
+private:
+    handle_type handle_;
+    static inline thread_local handle_type parked_ = nullptr;
+
+public:
+    Continuation() : handle_(nullptr) {}
+    explicit Continuation(handle_type handle) : handle_(handle) {}
+    Continuation(const Continuation&) = delete;
+    Continuation& operator=(const Continuation&) = delete;
+    Continuation(Continuation &&other) noexcept : handle_(other.handle_) {
+        other.handle_ = nullptr;
+    }
+    Continuation& operator=(Continuation &&other) noexcept {
+        if(this != &other) {
+            Reset();
+            handle_ = other.handle_;
+            other.handle_ = nullptr;
+        }
+        return *this;
+    }
+    ~Continuation() {
+        Reset();
+    }
+
+    inline explicit operator bool() const { return handle_ != nullptr; }
+    inline bool IsDone() { return !handle_ || handle_.done(); }
+
+    /*Whether the operation the handler awaits has completed*/
+    inline bool IsReady() {
+        promise_type &promise = handle_.promise();
+        return promise.ready_ == nullptr || promise.ready_(promise.awaiter_);
+    }
+
+    /*Run the handler until it awaits again or returns. Returns true if it returned.*/
+    inline bool Resume() {
+        handle_.promise().ready_ = nullptr;
+        handle_.resume();
+        return Finish();
+    }
+
+    inline void Reset() {
+        if(handle_) {
+            handle_.destroy();
+            handle_ = nullptr;
+        }
+    }
+
+    /*Hand a pending handler to the worker which called ProcessRequest*/
+    static inline void Park(Continuation &&cont) {
+        if(parked_) { parked_.destroy(); }
+        parked_ = cont.handle_;
+        cont.handle_ = nullptr;
+    }
+
+    /*Called by the worker after ProcessRequest returns false*/
+    static inline Continuation TakeParked() {
+        Continuation cont(parked_);
+        parked_ = nullptr;
+        return cont;
+    }
+
+private:
+    inline bool Finish() {
+        if(!handle_.done()) { return false; }
+        std::exception_ptr exception = handle_.promise().exception_;
+        Reset();
+        if(exception) { std::rethrow_exception(exception); }
+        return true;
+    }
+
+    friend bool RunContinuation(Continuation &&cont);
+};
+
+/*
+ * Return this from ProcessRequest: true if the handler already finished,
+ * otherwise false, and the worker resumes the handler from now on.
+ * */
+inline bool RunContinuation(Continuation &&cont) {
+    if(!cont.handle_ || cont.Finish()) { return true; }
+    Continuation::Park(std::move(cont));
+    return false;
+}
+
+/*Suspend a handler until the predicate holds, e.g., until a device sets a completion flag*/
+template<typename F>
+struct PollAwaiter {
+    F pred_;
+    explicit PollAwaiter(F pred) : pred_(pred) {}
+    bool await_ready() { return pred_(); }
+    void await_suspend(Continuation::handle_type handle) {
+        handle.promise().Await(this, &Ready);
+    }
+    void await_resume() {}
+    static bool Ready(void *awaiter) {
+        return reinterpret_cast<PollAwaiter*>(awaiter)->pred_();
+    }
+};
+
+template<typename F>
+inline PollAwaiter<F> WaitUntil(F pred) {
+    return PollAwaiter<F>(pred);
+}
+
+}
+
+#endif //LABSTOR_CONTINUATION_H
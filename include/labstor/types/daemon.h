@@ -30,6 +30,7 @@
 #include <labstor/userspace/util/errors.h>
 #include <sys/sysinfo.h>
 #include <sched.h>
+#include <unistd.h>
 #include <thread>
 #include <future>
 
@@ -38,6 +39,10 @@ namespace labstor {
 class DaemonWorker {
 public:
     virtual void DoWork() = 0;
+    /*Whether the last call to DoWork found anything to do. Workers which don't say are never idle.*/
+    virtual bool DidWork() { return true; }
+    /*Block until new work may have arrived, for at most max_us*/
+    virtual void WaitForWork(uint32_t max_us) { usleep(max_us); }
 };
 
 class Daemon {
@@ -0,0 +1,285 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_SHMEM_ACTIVE_QUEUES_H
+#define LABSTOR_SHMEM_ACTIVE_QUEUES_H
+
+#include "labstor/constants/macros.h"
+#include "labstor/types/basics.h"
+#include "shmem_doorbell.h"
+#ifdef __cplusplus
+#include "labstor/types/shmem_type.h"
+#include "labstor/userspace/util/errors.h"
+#endif
+
+/*
+ * The set of queue pairs of a worker which may have pending requests.
+ *
+ * Each queue pair owned by a worker is given a slot. Producers set the slot's
+ * bit when they submit to a queue pair the worker has marked idle, so the
+ * worker only visits queue pairs with work instead of every queue pair it owns.
+ *
+ * The bitmap has two levels: bit i of summary_ is set when words_[i] is non-zero.
+ * A producer sets its bit in words_ and, if the word was zero, the summary bit.
+ * The worker takes the summary and then each word it points to, so a bit set
+ * concurrently is either taken now or leaves a summary bit for the next pass.
+ *
+ * The header carries a doorbell the worker can sleep on while no queue is active.
+ * */
+
+#define LABSTOR_ACTIVE_QUEUES_BITS 64
+#define LABSTOR_ACTIVE_QUEUES_MAX_SLOTS (LABSTOR_ACTIVE_QUEUES_BITS*LABSTOR_ACTIVE_QUEUES_BITS)
+
+/*
+ * The doorbell word stored in each request queue: the worker and slot which own
+ * the queue, and whether the worker wants to be told about the next submission.
+ * */
+#define LABSTOR_QP_DOORBELL_ARMED 0x80000000u
+#define LABSTOR_QP_DOORBELL(worker_id, slot) ((((uint32_t)(worker_id) & 0x7FFF) << 16) | ((uint32_t)(slot) & 0xFFFF))
+#define LABSTOR_QP_DOORBELL_WORKER(db) (((db) >> 16) & 0x7FFF)
+#define LABSTOR_QP_DOORBELL_SLOT(db) ((db) & 0xFFFF)
+
+struct labstor_active_queues_header {
+    struct labstor_doorbell doorbell_;
+    uint32_t max_slots_;
+    uint32_t num_words_;
+    char config_pad_[LABSTOR_CACHELINE_SIZE - 2*sizeof(uint32_t)];
+    uint64_t summary_;
+    char summary_pad_[LABSTOR_CACHELINE_SIZE - sizeof(uint64_t)];
+};
+
+#ifdef __cplusplus
+struct labstor_active_queues : public labstor::shmem_type {
+#else
+struct labstor_active_queues {
+#endif
+    struct labstor_active_queues_header *header_;
+    uint64_t *words_;
+#ifdef __cplusplus
+    static inline uint32_t GetSize(uint32_t max_slots);
+    inline uint32_t GetSize();
+    inline void* GetRegion();
+    inline void Init(void *region, uint32_t region_size, uint32_t max_slots);
+    inline void Attach(void *region);
+    inline uint32_t GetMaxSlots();
+    inline labstor::ipc::doorbell* GetDoorbell();
+    inline void Set(uint32_t slot);
+    inline void SetAll(uint32_t num_slots);
+    inline bool IsEmpty();
+    inline uint64_t TakeSummary();
+    inline uint64_t TakeWord(uint32_t word);
+#endif
+};
+
+static inline uint32_t labstor_active_queues_GetNumWords(uint32_t max_slots) {
+    return (max_slots + LABSTOR_ACTIVE_QUEUES_BITS - 1) / LABSTOR_ACTIVE_QUEUES_BITS;
+}
+
+static inline uint32_t labstor_active_queues_GetSize_global(uint32_t max_slots) {
+    return sizeof(struct labstor_active_queues_header) + labstor_active_queues_GetNumWords(max_slots)*sizeof(uint64_t);
+}
+
+static inline uint32_t labstor_active_queues_GetSize(struct labstor_active_queues *aq) {
+    return labstor_active_queues_GetSize_global(aq->header_->max_slots_);
+}
+
+static inline void* labstor_active_queues_GetRegion(struct labstor_active_queues *aq) {
+    return aq->header_;
+}
+
+static inline uint32_t labstor_active_queues_GetMaxSlots(struct labstor_active_queues *aq) {
+    return aq->header_->max_slots_;
+}
+
+static inline struct labstor_doorbell* labstor_active_queues_GetDoorbell(struct labstor_active_queues *aq) {
+    return &aq->header_->doorbell_;
+}
+
+static inline bool labstor_active_queues_Init(struct labstor_active_queues *aq, void *region, uint32_t region_size, uint32_t max_slots) {
+    uint32_t i;
+    aq->header_ = (struct labstor_active_queues_header*)region;
+    aq->words_ = (uint64_t*)(aq->header_ + 1);
+    if(max_slots > LABSTOR_ACTIVE_QUEUES_MAX_SLOTS || region_size < labstor_active_queues_GetSize_global(max_slots)) {
+#ifdef __cplusplus
+        throw labstor::INVALID_RING_BUFFER_SIZE.format(region_size, max_slots);
+#else
+        return false;
+#endif
+    }
+    labstor_doorbell_Init(&aq->header_->doorbell_, LABSTOR_WAIT_ADAPTIVE);
+    aq->header_->max_slots_ = max_slots;
+    aq->header_->num_words_ = labstor_active_queues_GetNumWords(max_slots);
+    aq->header_->summary_ = 0;
+    for(i = 0; i < aq->header_->num_words_; ++i) {
+        aq->words_[i] = 0;
+    }
+    return true;
+}
+
+static inline void labstor_active_queues_Attach(struct labstor_active_queues *aq, void *region) {
+    aq->header_ = (struct labstor_active_queues_header*)region;
+    aq->words_ = (uint64_t*)(aq->header_ + 1);
+}
+
+/*
+ * Mark a slot as having pending work and wake the worker if it sleeps.
+ * */
+static inline void labstor_active_queues_Set(struct labstor_active_queues *aq, uint32_t slot) {
+    uint32_t word = slot / LABSTOR_ACTIVE_QUEUES_BITS;
+    uint64_t bit = 1ull << (slot % LABSTOR_ACTIVE_QUEUES_BITS);
+    uint64_t old;
+    if(slot >= aq->header_->max_slots_) { return; }
+    old = __atomic_fetch_or(&aq->words_[word], bit, __ATOMIC_ACQ_REL);
+    if(old == 0) {
+        __atomic_fetch_or(&aq->header_->summary_, 1ull << word, __ATOMIC_ACQ_REL);
+    }
+    labstor_doorbell_Ring(&aq->header_->doorbell_);
+}
+
+static inline void labstor_active_queues_SetAll(struct labstor_active_queues *aq, uint32_t num_slots) {
+    uint32_t slot;
+    for(slot = 0; slot < num_slots; slot += LABSTOR_ACTIVE_QUEUES_BITS) {
+        uint32_t count = num_slots - slot;
+        uint64_t bits = count >= LABSTOR_ACTIVE_QUEUES_BITS ? ~0ull : (1ull << count) - 1;
+        uint32_t word = slot / LABSTOR_ACTIVE_QUEUES_BITS;
+        if(word >= aq->header_->num_words_) { break; }
+        __atomic_fetch_or(&aq->words_[word], bits, __ATOMIC_ACQ_REL);
+        __atomic_fetch_or(&aq->header_->summary_, 1ull << word, __ATOMIC_ACQ_REL);
+    }
+}
+
+static inline bool labstor_active_queues_IsEmpty(struct labstor_active_queues *aq) {
+    return __atomic_load_n(&aq->header_->summary_, __ATOMIC_ACQUIRE) == 0;
+}
+
+static inline uint64_t labstor_active_queues_TakeSummary(struct labstor_active_queues *aq) {
+    if(labstor_active_queues_IsEmpty(aq)) { return 0; }
+    return __atomic_exchange_n(&aq->header_->summary_, 0, __ATOMIC_ACQ_REL);
+}
+
+static inline uint64_t labstor_active_queues_TakeWord(struct labstor_active_queues *aq, uint32_t word) {
+    return __atomic_exchange_n(&aq->words_[word], 0, __ATOMIC_ACQ_REL);
+}
+
+/*
+ * A region holding the active queue sets of every worker, mapped by producers
+ * so they can resolve the worker and slot stored in a queue's doorbell word.
+ * */
+
+struct labstor_active_queues_table {
+    uint32_t num_workers_;
+    uint32_t stride_;
+    char pad_[LABSTOR_CACHELINE_SIZE - 2*sizeof(uint32_t)];
+};
+
+static inline uint32_t labstor_active_queues_table_GetStride(uint32_t max_slots) {
+    uint32_t size = labstor_active_queues_GetSize_global(max_slots);
+    return (size + LABSTOR_CACHELINE_SIZE - 1) / LABSTOR_CACHELINE_SIZE * LABSTOR_CACHELINE_SIZE;
+}
+
+static inline uint32_t labstor_active_queues_table_GetSize_global(uint32_t num_workers, uint32_t max_slots) {
+    return sizeof(struct labstor_active_queues_table) + num_workers*labstor_active_queues_table_GetStride(max_slots);
+}
+
+static inline void labstor_active_queues_table_Get(struct labstor_active_queues_table *table, uint32_t worker_id, struct labstor_active_queues *aq) {
+    labstor_active_queues_Attach(aq, (char*)(table + 1) + worker_id*table->stride_);
+}
+
+static inline bool labstor_active_queues_table_Init(struct labstor_active_queues_table *table, uint32_t region_size, uint32_t num_workers, uint32_t max_slots) {
+    struct labstor_active_queues aq;
+    uint32_t i;
+    if(region_size < labstor_active_queues_table_GetSize_global(num_workers, max_slots)) {
+#ifdef __cplusplus
+        throw labstor::INVALID_RING_BUFFER_SIZE.format(region_size, num_workers);
+#else
+        return false;
+#endif
+    }
+    table->num_workers_ = num_workers;
+    table->stride_ = labstor_active_queues_table_GetStride(max_slots);
+    for(i = 0; i < num_workers; ++i) {
+        if(!labstor_active_queues_Init(&aq, (char*)(table + 1) + i*table->stride_, table->stride_, max_slots)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Called by producers: mark the queue owning this doorbell word as active.
+ * */
+static inline void labstor_active_queues_table_Ring(struct labstor_active_queues_table *table, uint32_t doorbell) {
+    struct labstor_active_queues aq;
+    uint32_t worker_id = LABSTOR_QP_DOORBELL_WORKER(doorbell);
+    if(worker_id >= table->num_workers_) { return; }
+    labstor_active_queues_table_Get(table, worker_id, &aq);
+    labstor_active_queues_Set(&aq, LABSTOR_QP_DOORBELL_SLOT(doorbell));
+}
+
+#ifdef __cplusplus
+namespace labstor::ipc {
+    typedef labstor_active_queues active_queues;
+    typedef labstor_active_queues_table active_queues_table;
+}
+uint32_t labstor_active_queues::GetSize(uint32_t max_slots) {
+    return labstor_active_queues_GetSize_global(max_slots);
+}
+uint32_t labstor_active_queues::GetSize() {
+    return labstor_active_queues_GetSize(this);
+}
+void* labstor_active_queues::GetRegion() {
+    return labstor_active_queues_GetRegion(this);
+}
+void labstor_active_queues::Init(void *region, uint32_t region_size, uint32_t max_slots) {
+    labstor_active_queues_Init(this, region, region_size, max_slots);
+}
+void labstor_active_queues::Attach(void *region) {
+    labstor_active_queues_Attach(this, region);
+}
+uint32_t labstor_active_queues::GetMaxSlots() {
+    return labstor_active_queues_GetMaxSlots(this);
+}
+labstor::ipc::doorbell* labstor_active_queues::GetDoorbell() {
+    return labstor_active_queues_GetDoorbell(this);
+}
+void labstor_active_queues::Set(uint32_t slot) {
+    labstor_active_queues_Set(this, slot);
+}
+void labstor_active_queues::SetAll(uint32_t num_slots) {
+    labstor_active_queues_SetAll(this, num_slots);
+}
+bool labstor_active_queues::IsEmpty() {
+    return labstor_active_queues_IsEmpty(this);
+}
+uint64_t labstor_active_queues::TakeSummary() {
+    return labstor_active_queues_TakeSummary(this);
+}
+uint64_t labstor_active_queues::TakeWord(uint32_t word) {
+    return labstor_active_queues_TakeWord(this, word);
+}
+#endif
+
+#endif //LABSTOR_SHMEM_ACTIVE_QUEUES_H
@@ -0,0 +1,395 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_COMPLETION_RING_H
+#define LABSTOR_COMPLETION_RING_H
+
+#include "labstor/constants/macros.h"
+#include "labstor/types/basics.h"
+#include "labstor/types/data_structures/shmem_qtok.h"
+#include "labstor/types/data_structures/shmem_request.h"
+#include "shmem_spsc_request_ring.h"
+#include "shmem_doorbell.h"
+#ifdef __cplusplus
+#include "labstor/types/shmem_type.h"
+#include "labstor/userspace/util/errors.h"
+#endif
+
+/*
+ * An ordered ring of completion entries (req_id, code, request offset).
+ *
+ * Any number of threads may complete requests. A completer reserves a range of
+ * entries by advancing enqueued_, fills them, and publishes each entry by
+ * storing its sequence number with release semantics. Entry at position pos is
+ * free when seq_ == pos and ready when seq_ == pos + 1.
+ *
+ * Any number of threads may reap completions, either in order (RemoveAll) or out
+ * of order (FindAndRemove). A reaper claims a ready entry by swapping its
+ * sequence number from pos + 1 to LABSTOR_COMPLETION_REAPED_SEQ(pos), so an entry
+ * is reaped exactly once and a claim can never land on a later use of the same
+ * slot. After every reap, the reaper retires the reaped prefix of the ring: each
+ * reaped entry at the head is released by swapping its sequence number to
+ * pos + max_depth_, and only the thread which wins that swap advances the head.
+ * Completers therefore never see a hole, and an entry reaped behind the head is
+ * retired by whichever reaper next reaches it.
+ *
+ * The header carries a doorbell so the reaper can sleep until a completion arrives.
+ * Completers which lose the race for a range of entries, or find the ring full,
+ * count a collision, which is only touched on that slow path.
+ * */
+
+#define LABSTOR_COMPLETION_REAPED_SEQ(pos) ((uint32_t)(pos) + 1 + 0x80000000u)
+
+struct labstor_completion_entry {
+    uint32_t seq_;
+    uint32_t req_id_;
+    uint32_t code_;
+    labstor_off_t rq_off_;
+};
+
+struct labstor_completion_ring_header {
+    uint32_t max_depth_;
+    uint32_t mask_;
+    char ro_pad_[LABSTOR_CACHELINE_SIZE - 2*sizeof(uint32_t)];
+
+    uint32_t enqueued_;
+    uint32_t collisions_;
+    char producer_pad_[LABSTOR_CACHELINE_SIZE - 2*sizeof(uint32_t)];
+
+    uint32_t dequeued_;
+    char consumer_pad_[LABSTOR_CACHELINE_SIZE - sizeof(uint32_t)];
+
+    struct labstor_doorbell doorbell_;
+};
+
+#ifdef __cplusplus
+struct labstor_completion_ring : public labstor::shmem_type {
+#else
+struct labstor_completion_ring {
+#endif
+    struct labstor_completion_ring_header *header_;
+    struct labstor_completion_entry *entries_;
+    void *base_region_;
+
+#ifdef __cplusplus
+    static inline uint32_t GetSize(uint32_t max_depth);
+    inline uint32_t GetSize();
+    inline void* GetRegion();
+    inline void* GetBaseRegion();
+    inline uint32_t GetDepth();
+    inline uint32_t GetMaxDepth();
+    inline uint32_t GetNumCollisions();
+    inline labstor::ipc::doorbell* GetDoorbell();
+    inline void Init(void *base_region, void *region, uint32_t region_size, uint32_t max_depth);
+    inline void Init(void *base_region, void *region, uint32_t region_size);
+    inline void Attach(void *base_region, void *region);
+    inline int Set(struct labstor_request *rq);
+    inline int FindAndRemove(uint32_t key, struct labstor_request* &value);
+    inline uint32_t SetBatch(struct labstor_request **rqs, uint32_t count);
+    inline uint32_t RemoveCompleted(struct labstor_qtok_t *qtoks, uint32_t count, struct labstor_request **rqs);
+    inline uint32_t RemoveAll(struct labstor_request **rqs, uint32_t max_count);
+#endif
+};
+
+static inline uint32_t labstor_completion_ring_GetSize_global(uint32_t max_depth) {
+    return sizeof(struct labstor_completion_ring_header) +
+            sizeof(struct labstor_completion_entry)*labstor_spsc_request_ring_RoundDepthUp(max_depth);
+}
+
+static inline uint32_t labstor_completion_ring_GetSize(struct labstor_completion_ring *ring) {
+    return labstor_completion_ring_GetSize_global(ring->header_->max_depth_);
+}
+
+static inline void* labstor_completion_ring_GetRegion(struct labstor_completion_ring *ring) {
+    return (void*)ring->header_;
+}
+
+static inline void* labstor_completion_ring_GetBaseRegion(struct labstor_completion_ring *ring) {
+    return ring->base_region_;
+}
+
+static inline uint32_t labstor_completion_ring_GetDepth(struct labstor_completion_ring *ring) {
+    uint32_t dequeued = __atomic_load_n(&ring->header_->dequeued_, __ATOMIC_ACQUIRE);
+    uint32_t enqueued = __atomic_load_n(&ring->header_->enqueued_, __ATOMIC_ACQUIRE);
+    return enqueued - dequeued;
+}
+
+static inline uint32_t labstor_completion_ring_GetMaxDepth(struct labstor_completion_ring *ring) {
+    return ring->header_->max_depth_;
+}
+
+static inline uint32_t labstor_completion_ring_GetNumCollisions(struct labstor_completion_ring *ring) {
+    return __atomic_load_n(&ring->header_->collisions_, __ATOMIC_RELAXED);
+}
+
+static inline struct labstor_doorbell* labstor_completion_ring_GetDoorbell(struct labstor_completion_ring *ring) {
+    return &ring->header_->doorbell_;
+}
+
+static inline bool labstor_completion_ring_Init(
+        struct labstor_completion_ring *ring,
+        void *base_region, void *region, uint32_t region_size, uint32_t max_depth) {
+    uint32_t i;
+    ring->base_region_ = base_region;
+    ring->header_ = (struct labstor_completion_ring_header*)region;
+    if(region_size < labstor_completion_ring_GetSize_global(max_depth)) {
+#ifdef __cplusplus
+        throw labstor::INVALID_RING_BUFFER_SIZE.format(region_size, max_depth);
+#else
+        return false;
+#endif
+    }
+    if(max_depth == 0) {
+        max_depth = region_size - sizeof(struct labstor_completion_ring_header);
+        max_depth /= sizeof(struct labstor_completion_entry);
+        max_depth = labstor_spsc_request_ring_RoundDepthDown(max_depth);
+    } else {
+        max_depth = labstor_spsc_request_ring_RoundDepthUp(max_depth);
+    }
+    if(max_depth == 0) {
+#ifdef __cplusplus
+        throw labstor::INVALID_RING_BUFFER_SIZE.format(region_size, max_depth);
+#else
+        return false;
+#endif
+    }
+    ring->header_->max_depth_ = max_depth;
+    ring->header_->mask_ = max_depth - 1;
+    ring->header_->enqueued_ = 0;
+    ring->header_->collisions_ = 0;
+    ring->header_->dequeued_ = 0;
+    labstor_doorbell_Init(&ring->header_->doorbell_, LABSTOR_WAIT_ADAPTIVE);
+    ring->entries_ = (struct labstor_completion_entry*)(ring->header_ + 1);
+    for(i = 0; i < max_depth; ++i) {
+        ring->entries_[i].seq_ = i;
+    }
+    return true;
+}
+
+static inline void labstor_completion_ring_Attach(
+        struct labstor_completion_ring *ring, void *base_region, void *region) {
+    ring->base_region_ = base_region;
+    ring->header_ = (struct labstor_completion_ring_header*)region;
+    ring->entries_ = (struct labstor_completion_entry*)(ring->header_ + 1);
+}
+
+static inline void labstor_completion_ring_RemoteAttach(
+        struct labstor_completion_ring *ring, void *kern_base_region, void *kern_region) {
+    ring->base_region_ = kern_base_region;
+    ring->header_ = (struct labstor_completion_ring_header*)kern_region;
+    ring->entries_ = (struct labstor_completion_entry*)(ring->header_ + 1);
+}
+
+/*
+ * Reserve and publish up to count completions.
+ * Returns the number of leading requests that were completed; the rest found the ring full.
+ * */
+static inline uint32_t labstor_completion_ring_SetBatch(struct labstor_completion_ring *ring, struct labstor_request **rqs, uint32_t count) {
+    struct labstor_completion_entry *entry;
+    uint32_t pos, dequeued, num_free, i;
+    pos = __atomic_load_n(&ring->header_->enqueued_, __ATOMIC_RELAXED);
+    for(;;) {
+        dequeued = __atomic_load_n(&ring->header_->dequeued_, __ATOMIC_ACQUIRE);
+        num_free = ring->header_->max_depth_ - (pos - dequeued);
+        if(num_free == 0) {
+            __atomic_fetch_add(&ring->header_->collisions_, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+        if(count > num_free) {
+            count = num_free;
+        }
+        if(__atomic_compare_exchange_n(&ring->header_->enqueued_, &pos, pos + count, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+        }
+        __atomic_fetch_add(&ring->header_->collisions_, 1, __ATOMIC_RELAXED);
+    }
+
+    for(i = 0; i < count; ++i, ++pos) {
+        entry = &ring->entries_[pos & ring->header_->mask_];
+        entry->req_id_ = rqs[i]->req_id_;
+        entry->code_ = rqs[i]->code_;
+        entry->rq_off_ = LABSTOR_REGION_SUB(rqs[i], ring->base_region_);
+        __atomic_store_n(&entry->seq_, pos + 1, __ATOMIC_RELEASE);
+    }
+    labstor_doorbell_Ring(&ring->header_->doorbell_);
+    return count;
+}
+
+static inline bool labstor_completion_ring_Set(struct labstor_completion_ring *ring, struct labstor_request *rq) {
+    return labstor_completion_ring_SetBatch(ring, &rq, 1) == 1;
+}
+
+/*
+ * Release the prefix of reaped entries back to the completers.
+ * Safe to call from any number of reapers at once.
+ * */
+static inline void labstor_completion_ring_Retire(struct labstor_completion_ring *ring) {
+    struct labstor_completion_entry *entry;
+    uint32_t pos, seq;
+    for(;;) {
+        pos = __atomic_load_n(&ring->header_->dequeued_, __ATOMIC_SEQ_CST);
+        entry = &ring->entries_[pos & ring->header_->mask_];
+        seq = LABSTOR_COMPLETION_REAPED_SEQ(pos);
+        if(!__atomic_compare_exchange_n(&entry->seq_, &seq, pos + ring->header_->max_depth_, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            break;
+        }
+        __atomic_store_n(&ring->header_->dequeued_, pos + 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+/*
+ * Claim the entry at position pos for this reaper.
+ * Returns 0 if the entry is not completed yet, 1 if it was claimed,
+ * and -1 if it was claimed by another reaper or does not match key.
+ * A NULL key matches every entry.
+ * */
+static inline int labstor_completion_ring_Claim(struct labstor_completion_ring *ring, uint32_t pos, const uint32_t *key, struct labstor_request **value) {
+    struct labstor_completion_entry *entry = &ring->entries_[pos & ring->header_->mask_];
+    uint32_t seq = __atomic_load_n(&entry->seq_, __ATOMIC_ACQUIRE);
+    labstor_off_t rq_off;
+    if(seq == pos) {
+        return 0;
+    }
+    if(seq != pos + 1 || (key && entry->req_id_ != *key)) {
+        return -1;
+    }
+    rq_off = entry->rq_off_;
+    if(!__atomic_compare_exchange_n(&entry->seq_, &seq, LABSTOR_COMPLETION_REAPED_SEQ(pos), false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return -1;
+    }
+    *value = (struct labstor_request*)LABSTOR_REGION_ADD(rq_off, ring->base_region_);
+    return 1;
+}
+
+static inline int labstor_completion_ring_FindAndRemove(struct labstor_completion_ring *ring, uint32_t key, struct labstor_request **value) {
+    uint32_t head = __atomic_load_n(&ring->header_->dequeued_, __ATOMIC_ACQUIRE), pos;
+    int ret;
+    for(pos = head; pos - head < ring->header_->max_depth_; ++pos) {
+        ret = labstor_completion_ring_Claim(ring, pos, &key, value);
+        if(ret == 0) {
+            return false;
+        }
+        if(ret > 0) {
+            labstor_completion_ring_Retire(ring);
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Reap every completed request among qtoks[0..count).
+ * Completed requests are stored in rqs and the qtoks which are still pending
+ * are compacted to the front of qtoks. Returns the number of requests reaped.
+ * */
+static inline uint32_t labstor_completion_ring_RemoveCompleted(struct labstor_completion_ring *ring, struct labstor_qtok_t *qtoks, uint32_t count, struct labstor_request **rqs) {
+    uint32_t i, num_reaped = 0, num_pending = 0;
+    for(i = 0; i < count; ++i) {
+        if(labstor_completion_ring_FindAndRemove(ring, qtoks[i].req_id_, &rqs[num_reaped])) {
+            ++num_reaped;
+        } else {
+            qtoks[num_pending++] = qtoks[i];
+        }
+    }
+    return num_reaped;
+}
+
+/*
+ * Reap up to max_count completed requests in completion order, regardless of which request they belong to.
+ * */
+static inline uint32_t labstor_completion_ring_RemoveAll(struct labstor_completion_ring *ring, struct labstor_request **rqs, uint32_t max_count) {
+    uint32_t head = __atomic_load_n(&ring->header_->dequeued_, __ATOMIC_ACQUIRE), pos, num_reaped = 0;
+    int ret;
+    for(pos = head; pos - head < ring->header_->max_depth_ && num_reaped < max_count; ++pos) {
+        ret = labstor_completion_ring_Claim(ring, pos, NULL, &rqs[num_reaped]);
+        if(ret == 0) {
+            break;
+        }
+        if(ret > 0) {
+            ++num_reaped;
+        }
+    }
+    if(num_reaped) {
+        labstor_completion_ring_Retire(ring);
+    }
+    return num_reaped;
+}
+
+#ifdef __cplusplus
+namespace labstor::ipc {
+    typedef labstor_completion_ring completion_ring;
+}
+uint32_t labstor_completion_ring::GetSize(uint32_t max_depth) {
+    return labstor_completion_ring_GetSize_global(max_depth);
+}
+uint32_t labstor_completion_ring::GetSize() {
+    return labstor_completion_ring_GetSize(this);
+}
+void* labstor_completion_ring::GetRegion() {
+    return labstor_completion_ring_GetRegion(this);
+}
+void* labstor_completion_ring::GetBaseRegion() {
+    return labstor_completion_ring_GetBaseRegion(this);
+}
+uint32_t labstor_completion_ring::GetDepth() {
+    return labstor_completion_ring_GetDepth(this);
+}
+uint32_t labstor_completion_ring::GetMaxDepth() {
+    return labstor_completion_ring_GetMaxDepth(this);
+}
+uint32_t labstor_completion_ring::GetNumCollisions() {
+    return labstor_completion_ring_GetNumCollisions(this);
+}
+labstor::ipc::doorbell* labstor_completion_ring::GetDoorbell() {
+    return labstor_completion_ring_GetDoorbell(this);
+}
+void labstor_completion_ring::Init(void *base_region, void *region, uint32_t region_size, uint32_t max_depth) {
+    labstor_completion_ring_Init(this, base_region, region, region_size, max_depth);
+}
+void labstor_completion_ring::Init(void *base_region, void *region, uint32_t region_size) {
+    labstor_completion_ring_Init(this, base_region, region, region_size, 0);
+}
+void labstor_completion_ring::Attach(void *base_region, void *region) {
+    labstor_completion_ring_Attach(this, base_region, region);
+}
+int labstor_completion_ring::Set(struct labstor_request *rq) {
+    return labstor_completion_ring_Set(this, rq);
+}
+int labstor_completion_ring::FindAndRemove(uint32_t key, struct labstor_request* &value) {
+    return labstor_completion_ring_FindAndRemove(this, key, &value);
+}
+uint32_t labstor_completion_ring::SetBatch(struct labstor_request **rqs, uint32_t count) {
+    return labstor_completion_ring_SetBatch(this, rqs, count);
+}
+uint32_t labstor_completion_ring::RemoveCompleted(struct labstor_qtok_t *qtoks, uint32_t count, struct labstor_request **rqs) {
+    return labstor_completion_ring_RemoveCompleted(this, qtoks, count, rqs);
+}
+uint32_t labstor_completion_ring::RemoveAll(struct labstor_request **rqs, uint32_t max_count) {
+    return labstor_completion_ring_RemoveAll(this, rqs, max_count);
+}
+#endif
+
+#endif //LABSTOR_COMPLETION_RING_H
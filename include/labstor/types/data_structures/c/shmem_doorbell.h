@@ -0,0 +1,191 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_SHMEM_DOORBELL_H
+#define LABSTOR_SHMEM_DOORBELL_H
+
+#include "labstor/constants/macros.h"
+#include "labstor/types/basics.h"
+#ifndef KERNEL_BUILD
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#include <limits.h>
+#endif
+#ifdef __cplusplus
+#include <labstor/userspace/util/timer.h>
+#endif
+
+/*
+ * A futex word in shared memory which lets the owner of a queue pair sleep
+ * until a completion arrives.
+ *
+ * A waiter spins for spin_us_, then yields for yield_us_, then registers itself
+ * in waiters_ and sleeps on seq_. Completers only touch seq_ and issue a wakeup
+ * when waiters_ is non-zero, so the completion path costs a fence and a load
+ * when nobody sleeps. Sleeps are bounded by sleep_us_, so a completer which
+ * can't issue wakeups (e.g., the kernel) only delays a sleeper.
+ * */
+
+#define LABSTOR_WAIT_POLL 0
+#define LABSTOR_WAIT_ADAPTIVE 1
+
+/*Until the server measures wakeups (or ipc_manager.<type>.wait_spin_us is set)*/
+#define LABSTOR_WAIT_DEFAULT_SPIN_US 50
+#define LABSTOR_WAIT_DEFAULT_YIELD_US 200
+#define LABSTOR_WAIT_DEFAULT_SLEEP_US 1000
+#define LABSTOR_WAIT_POLLS_PER_CLOCK 64
+
+struct labstor_doorbell {
+    uint32_t policy_;
+    uint32_t spin_us_;
+    uint32_t yield_us_;
+    uint32_t sleep_us_;
+    char config_pad_[LABSTOR_CACHELINE_SIZE - 4*sizeof(uint32_t)];
+
+    uint32_t waiters_;
+    uint32_t seq_;
+    char wait_pad_[LABSTOR_CACHELINE_SIZE - 2*sizeof(uint32_t)];
+
+#ifdef __cplusplus
+    inline void Init(uint32_t policy);
+    inline void SetPolicy(uint32_t policy, uint32_t spin_us, uint32_t yield_us);
+    inline bool IsPolling();
+    inline void Ring();
+    template<typename F>
+    inline void Wait(F &&is_ready);
+#endif
+};
+
+static inline void labstor_doorbell_Init(struct labstor_doorbell *db, uint32_t policy) {
+    db->policy_ = policy;
+    db->spin_us_ = LABSTOR_WAIT_DEFAULT_SPIN_US;
+    db->yield_us_ = LABSTOR_WAIT_DEFAULT_YIELD_US;
+    db->sleep_us_ = LABSTOR_WAIT_DEFAULT_SLEEP_US;
+    db->waiters_ = 0;
+    db->seq_ = 0;
+}
+
+static inline void labstor_doorbell_SetPolicy(struct labstor_doorbell *db, uint32_t policy, uint32_t spin_us, uint32_t yield_us) {
+    db->spin_us_ = spin_us;
+    db->yield_us_ = yield_us;
+    __atomic_store_n(&db->policy_, policy, __ATOMIC_RELEASE);
+}
+
+static inline bool labstor_doorbell_IsPolling(struct labstor_doorbell *db) {
+    return __atomic_load_n(&db->policy_, __ATOMIC_RELAXED) == LABSTOR_WAIT_POLL;
+}
+
+/*
+ * Called by completers after the completion has been published.
+ * */
+static inline void labstor_doorbell_Ring(struct labstor_doorbell *db) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&db->waiters_, __ATOMIC_RELAXED) == 0) {
+        return;
+    }
+    __atomic_fetch_add(&db->seq_, 1, __ATOMIC_RELEASE);
+#ifndef KERNEL_BUILD
+    syscall(SYS_futex, &db->seq_, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+#ifndef KERNEL_BUILD
+/*
+ * Register as a sleeper. The caller must re-check its condition after this
+ * returns and before calling labstor_doorbell_Sleep.
+ * */
+static inline uint32_t labstor_doorbell_PrepareSleep(struct labstor_doorbell *db) {
+    uint32_t seq = __atomic_load_n(&db->seq_, __ATOMIC_ACQUIRE);
+    __atomic_fetch_add(&db->waiters_, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return seq;
+}
+
+static inline void labstor_doorbell_CancelSleep(struct labstor_doorbell *db) {
+    __atomic_fetch_sub(&db->waiters_, 1, __ATOMIC_RELAXED);
+}
+
+static inline void labstor_doorbell_SleepUs(struct labstor_doorbell *db, uint32_t seq, uint32_t sleep_us) {
+    struct timespec timeout;
+    timeout.tv_sec = sleep_us / 1000000;
+    timeout.tv_nsec = (sleep_us % 1000000) * 1000;
+    syscall(SYS_futex, &db->seq_, FUTEX_WAIT, seq, &timeout, NULL, 0);
+    labstor_doorbell_CancelSleep(db);
+}
+
+static inline void labstor_doorbell_Sleep(struct labstor_doorbell *db, uint32_t seq) {
+    labstor_doorbell_SleepUs(db, seq, db->sleep_us_);
+}
+#endif
+
+#ifdef __cplusplus
+namespace labstor::ipc {
+    typedef labstor_doorbell doorbell;
+}
+void labstor_doorbell::Init(uint32_t policy) {
+    labstor_doorbell_Init(this, policy);
+}
+void labstor_doorbell::SetPolicy(uint32_t policy, uint32_t spin_us, uint32_t yield_us) {
+    labstor_doorbell_SetPolicy(this, policy, spin_us, yield_us);
+}
+bool labstor_doorbell::IsPolling() {
+    return labstor_doorbell_IsPolling(this);
+}
+void labstor_doorbell::Ring() {
+    labstor_doorbell_Ring(this);
+}
+template<typename F>
+void labstor_doorbell::Wait(F &&is_ready) {
+    labstor::HighResMonotonicTimer t;
+    uint32_t i, seq;
+    double spin_ns = spin_us_*1000.0, yield_ns = (spin_us_ + yield_us_)*1000.0;
+
+    //Spin, then yield, for a bounded amount of time
+    t.Resume();
+    for(i = 1;; ++i) {
+        if(is_ready()) { return; }
+        if(i % LABSTOR_WAIT_POLLS_PER_CLOCK) { continue; }
+        double elapsed = t.GetNsecFromStart();
+        if(elapsed >= yield_ns) { break; }
+        if(elapsed >= spin_ns) { LABSTOR_YIELD(); }
+    }
+
+    //Sleep until a completer rings the doorbell
+    while(true) {
+        seq = labstor_doorbell_PrepareSleep(this);
+        if(is_ready()) {
+            labstor_doorbell_CancelSleep(this);
+            return;
+        }
+        labstor_doorbell_Sleep(this, seq);
+        if(is_ready()) { return; }
+    }
+}
+#endif
+
+#endif //LABSTOR_SHMEM_DOORBELL_H
@@ -30,7 +30,7 @@
 #include "labstor/types/basics.h"
 #include "labstor/types/data_structures/shmem_qtok.h"
 #include "shmem_request_queue.h"
-#include "shmem_request_map.h"
+#include "shmem_completion_ring.h"
 #include "labstor/constants/debug.h"
 #include "labstor/userspace/util/errors.h"
 #include "labstor/types/data_structures/queue_pair.h"
@@ -97,13 +97,14 @@ namespace labstor::ipc {
 //Define the labstor::queue_pair type
 struct labstor_queue_pair {
     struct labstor_request_queue sq_;
-    struct labstor_request_map cq_;
+    struct labstor_completion_ring cq_;
 
 #ifdef __cplusplus
     inline labstor::ipc::qid_t& GetQID();
     inline static uint32_t GetSize(uint32_t queue_depth);
     inline void GetPointer(labstor::ipc::queue_pair_ptr &ptr, void *base_region);
     inline uint32_t GetDepth();
+    inline uint32_t GetNumArrivals();
     inline void Init(labstor::ipc::qid_t qid, void *base_region, uint32_t depth, void *sq_region, uint32_t sq_size, void *cq_region, uint32_t cq_size);
     inline void Init(labstor::ipc::qid_t qid, void *base_region, void *sq_region, uint32_t sq_size, void *cq_region, uint32_t cq_size);
     inline void Attach(labstor::ipc::queue_pair_ptr &ptr, void *base_region);
@@ -120,7 +121,7 @@ static inline void labstor_queue_pair_ptr_Init(struct labstor_queue_pair_ptr *pt
 static inline uint32_t labstor_queue_pair_GetSize_global(uint32_t queue_depth) {
     return sizeof(struct labstor_queue_pair) +
         labstor_request_queue_GetSize_global(queue_depth) +
-        labstor_request_map_GetSize_global(queue_depth);
+        labstor_completion_ring_GetSize_global(queue_depth);
 }
 
 static inline void labstor_queue_pair_GetPointer(struct labstor_queue_pair *qp, struct labstor_queue_pair_ptr *ptr, void *base_region) {
@@ -128,24 +129,24 @@ static inline void labstor_queue_pair_GetPointer(struct labstor_queue_pair *qp,
             ptr,
             *labstor_request_queue_GetQID(&qp->sq_),
             labstor_request_queue_GetRegion(&qp->sq_),
-            labstor_request_map_GetRegion(&qp->cq_),
+            labstor_completion_ring_GetRegion(&qp->cq_),
             base_region);
 }
 
 static inline void labstor_queue_pair_Init(
         struct labstor_queue_pair *qp, labstor_qid_t qid, void *base_region, uint32_t depth, void *sq_region, uint32_t sq_size, void *cq_region, uint32_t cq_size) {
     labstor_request_queue_Init(&qp->sq_, base_region, sq_region, sq_size, depth, qid);
-    labstor_request_map_Init(&qp->cq_, base_region, cq_region, cq_size, depth);
+    labstor_completion_ring_Init(&qp->cq_, base_region, cq_region, cq_size, depth);
 }
 
 static inline void labstor_queue_pair_Attach(struct labstor_queue_pair *qp, struct labstor_queue_pair_ptr *ptr, void *base_region) {
     labstor_request_queue_Attach(&qp->sq_, base_region, LABSTOR_REGION_ADD(ptr->sq_off_, base_region));
-    labstor_request_map_Attach(&qp->cq_, base_region, LABSTOR_REGION_ADD(ptr->cq_off_, base_region));
+    labstor_completion_ring_Attach(&qp->cq_, base_region, LABSTOR_REGION_ADD(ptr->cq_off_, base_region));
 }
 
 static inline void labstor_queue_pair_RemoteAttach(struct labstor_queue_pair *qp, struct labstor_queue_pair_ptr *ptr, void *kern_base_region) {
     labstor_request_queue_RemoteAttach(&qp->sq_, kern_base_region, LABSTOR_REGION_ADD(ptr->sq_off_, kern_base_region));
-    labstor_request_map_RemoteAttach(&qp->cq_, kern_base_region, LABSTOR_REGION_ADD(ptr->cq_off_, kern_base_region));
+    labstor_completion_ring_RemoteAttach(&qp->cq_, kern_base_region, LABSTOR_REGION_ADD(ptr->cq_off_, kern_base_region));
 }
 
 static inline bool labstor_queue_pair_Enqueue(struct labstor_queue_pair *qp, struct labstor_request *rq, struct labstor_qtok_t *qtok) {
@@ -166,7 +167,7 @@ static inline bool labstor_queue_pair_CompleteTimed(struct labstor_queue_pair *q
     LABSTOR_TIMED_SPINWAIT_PREAMBLE()
     rq->req_id_ = req_id;
     LABSTOR_TIMED_SPINWAIT_START(50)
-    if(labstor_request_map_Set(&qp->cq_, rq)) {
+    if(labstor_completion_ring_Set(&qp->cq_, rq)) {
         return true;
     }
     LABSTOR_TIMED_SPINWAIT_END(50)
@@ -176,7 +177,7 @@ static inline bool labstor_queue_pair_CompleteTimed(struct labstor_queue_pair *q
 static inline bool labstor_queue_pair_CompleteInf(struct labstor_queue_pair *qp, struct labstor_request *rq) {
     LABSTOR_INF_SPINWAIT_PREAMBLE()
     LABSTOR_INF_SPINWAIT_START()
-    if(labstor_request_map_Set(&qp->cq_, rq)) {
+    if(labstor_completion_ring_Set(&qp->cq_, rq)) {
         return true;
     }
     LABSTOR_INF_SPINWAIT_END()
@@ -199,7 +200,7 @@ static inline bool labstor_queue_pair_Complete(struct labstor_queue_pair *qp,  s
 }
 
 static inline bool labstor_queue_pair_IsComplete(struct labstor_queue_pair *qp, uint32_t req_id, struct labstor_request **rq) {
-    return labstor_request_map_FindAndRemove(&qp->cq_, req_id, rq);
+    return labstor_completion_ring_FindAndRemove(&qp->cq_, req_id, rq);
 }
 
 static inline struct labstor_request* labstor_queue_pair_Wait(struct labstor_queue_pair *qp, uint32_t req_id) {
@@ -223,10 +224,52 @@ static inline struct labstor_request* labstor_queue_pair_TimedWait(struct labsto
     return NULL;
 }
 
+/*Batching*/
+
+static inline uint32_t labstor_queue_pair_EnqueueBatch(struct labstor_queue_pair *qp, struct labstor_request **rqs, uint32_t count, struct labstor_qtok_t *qtoks) {
+    return labstor_request_queue_EnqueueBatch(&qp->sq_, rqs, count, qtoks);
+}
+
+static inline uint32_t labstor_queue_pair_PeekBatch(struct labstor_queue_pair *qp, struct labstor_request **rqs, uint32_t max_count) {
+    return labstor_request_queue_PeekBatch(&qp->sq_, rqs, max_count);
+}
+
+static inline void labstor_queue_pair_Consume(struct labstor_queue_pair *qp, uint32_t count) {
+    labstor_request_queue_Consume(&qp->sq_, count);
+}
+
+static inline uint32_t labstor_queue_pair_DequeueBatch(struct labstor_queue_pair *qp, struct labstor_request **rqs, uint32_t max_count) {
+    return labstor_request_queue_DequeueBatch(&qp->sq_, rqs, max_count);
+}
+
+static inline bool labstor_queue_pair_CompleteBatchInf(struct labstor_queue_pair *qp, struct labstor_request **rqs, uint32_t count) {
+    uint32_t completed = 0;
+    LABSTOR_INF_SPINWAIT_PREAMBLE()
+    LABSTOR_INF_SPINWAIT_START()
+    completed += labstor_completion_ring_SetBatch(&qp->cq_, rqs + completed, count - completed);
+    if(completed == count) {
+        return true;
+    }
+    LABSTOR_INF_SPINWAIT_END()
+    return false;
+}
+
+static inline uint32_t labstor_queue_pair_ReapCompleted(struct labstor_queue_pair *qp, struct labstor_qtok_t *qtoks, uint32_t count, struct labstor_request **rqs) {
+    return labstor_completion_ring_RemoveCompleted(&qp->cq_, qtoks, count, rqs);
+}
+
+static inline uint32_t labstor_queue_pair_ReapAll(struct labstor_queue_pair *qp, struct labstor_request **rqs, uint32_t max_count) {
+    return labstor_completion_ring_RemoveAll(&qp->cq_, rqs, max_count);
+}
+
 static inline uint32_t labstor_queue_pair_GetDepth(struct labstor_queue_pair *qp) {
     return labstor_request_queue_GetDepth(&qp->sq_);
 }
 
+static inline uint32_t labstor_queue_pair_GetNumArrivals(struct labstor_queue_pair *qp) {
+    return labstor_request_queue_GetNumEnqueued(&qp->sq_);
+}
+
 static inline labstor_qid_t* labstor_queue_pair_GetQID(struct labstor_queue_pair *qp) {
     return labstor_request_queue_GetQID(&qp->sq_);
 }
@@ -257,6 +300,9 @@ void labstor_queue_pair::GetPointer(labstor::ipc::queue_pair_ptr &ptr, void *bas
 uint32_t labstor_queue_pair::GetDepth() {
     return labstor_queue_pair_GetDepth(this);
 }
+uint32_t labstor_queue_pair::GetNumArrivals() {
+    return labstor_queue_pair_GetNumArrivals(this);
+}
 void labstor_queue_pair::Init(labstor::ipc::qid_t qid, void *base_region, uint32_t depth, void *sq_region, uint32_t sq_size, void *cq_region, uint32_t cq_size) {
     labstor_queue_pair_Init(this, qid, base_region, depth, sq_region, sq_size, cq_region, cq_size);
 }
@@ -299,6 +345,35 @@ struct shmem_queue_pair : public labstor::queue_pair, public labstor_queue_pair
     inline virtual bool _IsComplete(labstor_req_id_t req_id, labstor::ipc::request **rq) {
         return labstor_queue_pair_IsComplete(this, req_id, rq);
     }
+    inline labstor::ipc::doorbell* _GetDoorbell() {
+        return cq_.GetDoorbell();
+    }
+    inline uint32_t _EnqueueBatch(labstor::ipc::request **rqs, uint32_t count, labstor::ipc::qtok_t *qtoks) {
+        if(labstor_queue_pair_EnqueueBatch(this, rqs, count, qtoks) != count) {
+            throw labstor::FAILED_TO_ENQUEUE.format();
+        }
+        return count;
+    }
+    inline uint32_t _PeekBatch(labstor::ipc::request **rqs, uint32_t max_count) {
+        return labstor_queue_pair_PeekBatch(this, rqs, max_count);
+    }
+    inline void _Consume(uint32_t count) {
+        labstor_queue_pair_Consume(this, count);
+    }
+    inline uint32_t _DequeueBatch(labstor::ipc::request **rqs, uint32_t max_count) {
+        return labstor_queue_pair_DequeueBatch(this, rqs, max_count);
+    }
+    inline void _CompleteBatch(labstor::ipc::request **rqs, uint32_t count) {
+        if(!labstor_queue_pair_CompleteBatchInf(this, rqs, count)) {
+            throw labstor::FAILED_TO_COMPLETE.format();
+        }
+    }
+    inline uint32_t _ReapCompleted(labstor::ipc::qtok_t *qtoks, uint32_t count, labstor::ipc::request **rqs) {
+        return labstor_queue_pair_ReapCompleted(this, qtoks, count, rqs);
+    }
+    inline uint32_t _ReapAll(labstor::ipc::request **rqs, uint32_t max_count) {
+        return labstor_queue_pair_ReapAll(this, rqs, max_count);
+    }
 };
 }
 
@@ -63,6 +63,9 @@ struct labstor_request_map {
     inline void Attach(void *base_region, void *region);
     inline int Set(struct labstor_request *rq);
     inline int FindAndRemove(uint32_t key, struct labstor_request* &value);
+    inline uint32_t SetBatch(struct labstor_request **rqs, uint32_t count);
+    inline uint32_t RemoveCompleted(struct labstor_qtok_t *qtoks, uint32_t count, struct labstor_request **rqs);
+    inline uint32_t RemoveAll(struct labstor_request **rqs, uint32_t max_count);
 #endif
 };
 
@@ -132,23 +135,76 @@ static inline void labstor_request_map_RemoteAttach(
 
 static inline bool labstor_request_map_Set(struct labstor_request_map *map, struct labstor_request *rq) {
     uint32_t b = rq->req_id_ % map->header_->num_buckets_;
-    if(map->buckets_[b] != -1) {
+    if(__atomic_load_n(&map->buckets_[b], __ATOMIC_RELAXED) != -1) {
         return false;
     }
-    map->buckets_[b] = LABSTOR_REGION_SUB(rq, map->base_region_);
+    __atomic_store_n(&map->buckets_[b], LABSTOR_REGION_SUB(rq, map->base_region_), __ATOMIC_RELEASE);
     return true;
 }
 
 static inline int labstor_request_map_FindAndRemove(struct labstor_request_map *map, uint32_t key, struct labstor_request **value) {
     uint32_t b = key % map->header_->num_buckets_;
-    if(__atomic_load_n(&map->buckets_[b], __ATOMIC_RELAXED) == -1) {
+    labstor_off_t off = __atomic_load_n(&map->buckets_[b], __ATOMIC_ACQUIRE);
+    if(off == -1) {
         return false;
     }
-    *value = (struct labstor_request*)LABSTOR_REGION_ADD(map->buckets_[b], map->base_region_);
-    map->buckets_[b] = -1;
+    *value = (struct labstor_request*)LABSTOR_REGION_ADD(off, map->base_region_);
+    __atomic_store_n(&map->buckets_[b], -1, __ATOMIC_RELAXED);
     return true;
 }
 
+/*
+ * Batching: a single release fence publishes the contents of every request in
+ * the batch, and the buckets are then set with relaxed stores.
+ * Returns the number of leading requests that were set; the rest collided.
+ * */
+static inline uint32_t labstor_request_map_SetBatch(struct labstor_request_map *map, struct labstor_request **rqs, uint32_t count) {
+    uint32_t i, b;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for(i = 0; i < count; ++i) {
+        b = rqs[i]->req_id_ % map->header_->num_buckets_;
+        if(__atomic_load_n(&map->buckets_[b], __ATOMIC_RELAXED) != -1) {
+            break;
+        }
+        __atomic_store_n(&map->buckets_[b], LABSTOR_REGION_SUB(rqs[i], map->base_region_), __ATOMIC_RELAXED);
+    }
+    return i;
+}
+
+/*
+ * Reap every completed request among qtoks[0..count).
+ * Completed requests are stored in rqs and the qtoks which are still pending
+ * are compacted to the front of qtoks. Returns the number of requests reaped.
+ * */
+static inline uint32_t labstor_request_map_RemoveCompleted(struct labstor_request_map *map, struct labstor_qtok_t *qtoks, uint32_t count, struct labstor_request **rqs) {
+    uint32_t i, num_reaped = 0, num_pending = 0;
+    for(i = 0; i < count; ++i) {
+        if(labstor_request_map_FindAndRemove(map, qtoks[i].req_id_, &rqs[num_reaped])) {
+            ++num_reaped;
+        } else {
+            qtoks[num_pending++] = qtoks[i];
+        }
+    }
+    return num_reaped;
+}
+
+/*
+ * Reap up to max_count completed requests, regardless of which request they belong to.
+ * */
+static inline uint32_t labstor_request_map_RemoveAll(struct labstor_request_map *map, struct labstor_request **rqs, uint32_t max_count) {
+    uint32_t b, num_reaped = 0;
+    labstor_off_t off;
+    for(b = 0; b < map->header_->num_buckets_ && num_reaped < max_count; ++b) {
+        off = __atomic_load_n(&map->buckets_[b], __ATOMIC_ACQUIRE);
+        if(off == -1) {
+            continue;
+        }
+        rqs[num_reaped++] = (struct labstor_request*)LABSTOR_REGION_ADD(off, map->base_region_);
+        __atomic_store_n(&map->buckets_[b], -1, __ATOMIC_RELAXED);
+    }
+    return num_reaped;
+}
+
 #ifdef __cplusplus
 namespace labstor::ipc {
     typedef labstor_request_map request_map;
@@ -183,6 +239,15 @@ int labstor_request_map::Set(struct labstor_request *rq) {
 int labstor_request_map::FindAndRemove(uint32_t key, struct labstor_request* &value) {
     return labstor_request_map_FindAndRemove(this, key, &value);
 }
+uint32_t labstor_request_map::SetBatch(struct labstor_request **rqs, uint32_t count) {
+    return labstor_request_map_SetBatch(this, rqs, count);
+}
+uint32_t labstor_request_map::RemoveCompleted(struct labstor_qtok_t *qtoks, uint32_t count, struct labstor_request **rqs) {
+    return labstor_request_map_RemoveCompleted(this, qtoks, count, rqs);
+}
+uint32_t labstor_request_map::RemoveAll(struct labstor_request **rqs, uint32_t max_count) {
+    return labstor_request_map_RemoveAll(this, rqs, max_count);
+}
 #endif
 
 #endif //LABSTOR_LABSTOR_REQUEST_MAP_H
\ No newline at end of file
@@ -28,13 +28,16 @@
 #define LABSTOR_REQUEST_QUEUE_H
 
 #include "labstor/constants/macros.h"
-#include "shmem_request_ring_buffer.h"
+#include "labstor/constants/busy_wait.h"
+#include "shmem_spsc_request_ring.h"
+#include "shmem_active_queues.h"
 #include "labstor/types/data_structures/shmem_qtok.h"
 #include "labstor/types/data_structures/shmem_request.h"
 
 struct labstor_request_queue_header {
     labstor_qid_t qid_;
     uint16_t update_[2];
+    uint32_t doorbell_;
 };
 
 #ifdef __cplusplus
@@ -44,7 +47,8 @@ struct labstor_request_queue {
 #endif
     void *base_region_;
     struct labstor_request_queue_header *header_;
-    struct labstor_request_ring_buffer queue_;
+    struct labstor_spsc_request_ring queue_;
+    struct labstor_active_queues_table *active_table_;
 
 #ifdef __cplusplus
     static inline uint32_t GetSize(uint32_t max_depth);
@@ -56,9 +60,17 @@ struct labstor_request_queue {
     inline labstor::ipc::qid_t& GetQID();
     inline bool Enqueue(labstor::ipc::request *rq, labstor::ipc::qtok_t &qtok);
     inline bool Dequeue(labstor::ipc::request *&rq);
+    inline uint32_t EnqueueBatch(labstor::ipc::request **rqs, uint32_t count, labstor::ipc::qtok_t *qtoks);
+    inline uint32_t PeekBatch(labstor::ipc::request **rqs, uint32_t max_count);
+    inline void Consume(uint32_t count);
+    inline uint32_t DequeueBatch(labstor::ipc::request **rqs, uint32_t max_count);
     inline uint32_t GetDepth();
     inline uint32_t GetMaxDepth();
+    inline uint32_t GetNumEnqueued();
     inline uint32_t GetFlags();
+    inline void SetActiveTable(labstor::ipc::active_queues_table *table);
+    inline void SetDoorbell(uint32_t doorbell);
+    inline bool ArmDoorbell(uint32_t doorbell);
     inline void MarkPaused();
     inline bool IsPaused();
     inline void UnPause();
@@ -66,11 +78,11 @@ struct labstor_request_queue {
 };
 
 static inline uint32_t labstor_request_queue_GetSize_global(uint32_t max_depth) {
-    return sizeof(struct labstor_request_queue_header) + labstor_request_ring_buffer_GetSize_global(max_depth);
+    return sizeof(struct labstor_request_queue_header) + labstor_spsc_request_ring_GetSize_global(max_depth);
 }
 
 static inline uint32_t labstor_request_queue_GetSize(struct labstor_request_queue *lrq) {
-    return labstor_request_queue_GetSize_global(labstor_request_ring_buffer_GetMaxDepth(&lrq->queue_));
+    return labstor_request_queue_GetSize_global(labstor_spsc_request_ring_GetMaxDepth(&lrq->queue_));
 }
 
 static inline void* labstor_request_queue_GetRegion(struct labstor_request_queue *lrq) {
@@ -78,11 +90,15 @@ static inline void* labstor_request_queue_GetRegion(struct labstor_request_queue
 }
 
 static inline uint32_t labstor_request_queue_GetDepth(struct labstor_request_queue *lrq) {
-    return labstor_request_ring_buffer_GetDepth(&lrq->queue_);
+    return labstor_spsc_request_ring_GetDepth(&lrq->queue_);
 }
 
 static inline uint32_t labstor_request_queue_GetMaxDepth(struct labstor_request_queue *lrq) {
-    return labstor_request_ring_buffer_GetMaxDepth(&lrq->queue_);
+    return labstor_spsc_request_ring_GetMaxDepth(&lrq->queue_);
+}
+
+static inline uint32_t labstor_request_queue_GetNumEnqueued(struct labstor_request_queue *lrq) {
+    return labstor_spsc_request_ring_GetNumEnqueued(&lrq->queue_);
 }
 
 static inline uint32_t labstor_request_queue_GetFlags(struct labstor_request_queue *lrq) {
@@ -97,31 +113,77 @@ static inline void labstor_request_queue_Init(
     lrq->header_->qid_ = qid;
     lrq->header_->update_[0] = 0;
     lrq->header_->update_[1] = 0;
-    labstor_request_ring_buffer_Init(&lrq->queue_, lrq->header_+1, region_size - sizeof(struct labstor_request_queue_header), depth);
+    lrq->header_->doorbell_ = 0;
+    lrq->active_table_ = NULL;
+    labstor_spsc_request_ring_Init(&lrq->queue_, lrq->header_+1, region_size - sizeof(struct labstor_request_queue_header), depth);
 }
 
 static inline void labstor_request_queue_Attach(struct labstor_request_queue *lrq, void *base_region, void *region) {
     lrq->base_region_ = base_region;
     lrq->header_ = (struct labstor_request_queue_header*)region;
-    labstor_request_ring_buffer_Attach(&lrq->queue_, lrq->header_ + 1);
+    lrq->active_table_ = NULL;
+    labstor_spsc_request_ring_Attach(&lrq->queue_, lrq->header_ + 1);
 }
 
 static inline void labstor_request_queue_RemoteAttach(struct labstor_request_queue *lrq, void *kern_lrq_region, void *kern_base_region) {
     lrq->base_region_ = kern_base_region;
     lrq->header_ = (struct labstor_request_queue_header*)kern_lrq_region;
-    labstor_request_ring_buffer_RemoteAttach(&lrq->queue_, lrq->header_ + 1);
+    lrq->active_table_ = NULL;
+    labstor_spsc_request_ring_RemoteAttach(&lrq->queue_, lrq->header_ + 1);
 }
 
 static inline labstor_qid_t* labstor_request_queue_GetQID(struct labstor_request_queue *lrq) {
     return &lrq->header_->qid_;
 }
 
+/*
+ * Worker doorbells: a worker arms a queue's doorbell once it has drained it.
+ * The next submission disarms it and marks the queue active in the worker's
+ * active queue set, which producers find through the table they have mapped.
+ * Producers without a table never notify, so workers must still sweep.
+ * */
+
+static inline void labstor_request_queue_SetActiveTable(struct labstor_request_queue *lrq, struct labstor_active_queues_table *table) {
+    lrq->active_table_ = table;
+}
+
+static inline void labstor_request_queue_SetDoorbell(struct labstor_request_queue *lrq, uint32_t doorbell) {
+    __atomic_store_n(&lrq->header_->doorbell_, doorbell, __ATOMIC_RELEASE);
+}
+
+/*
+ * Called by the consumer. Returns false if requests were submitted before the
+ * doorbell was armed, in which case the consumer must visit the queue again.
+ * */
+static inline bool labstor_request_queue_ArmDoorbell(struct labstor_request_queue *lrq, uint32_t doorbell) {
+    __atomic_store_n(&lrq->header_->doorbell_, doorbell | LABSTOR_QP_DOORBELL_ARMED, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return labstor_spsc_request_ring_GetDepth(&lrq->queue_) == 0;
+}
+
+/*
+ * Called by the producer after a submission has been published.
+ * */
+static inline void labstor_request_queue_RingDoorbell(struct labstor_request_queue *lrq) {
+    uint32_t doorbell;
+    if(!lrq->active_table_) { return; }
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    doorbell = __atomic_load_n(&lrq->header_->doorbell_, __ATOMIC_RELAXED);
+    if(!(doorbell & LABSTOR_QP_DOORBELL_ARMED)) { return; }
+    if(!__atomic_compare_exchange_n(&lrq->header_->doorbell_, &doorbell, doorbell & ~LABSTOR_QP_DOORBELL_ARMED,
+                                    false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        return;
+    }
+    labstor_active_queues_table_Ring(lrq->active_table_, doorbell);
+}
+
 static inline bool labstor_request_queue_Enqueue(struct labstor_request_queue *lrq, struct labstor_request *rq, struct labstor_qtok_t *qtok) {
     LABSTOR_INF_SPINWAIT_PREAMBLE()
     LABSTOR_INF_SPINWAIT_START()
-    if(labstor_request_ring_buffer_Enqueue(&lrq->queue_, LABSTOR_REGION_SUB(rq, lrq->base_region_), &rq->req_id_)) {
+    if(labstor_spsc_request_ring_Enqueue(&lrq->queue_, LABSTOR_REGION_SUB(rq, lrq->base_region_), &rq->req_id_)) {
         qtok->qid_ = lrq->header_->qid_;
         qtok->req_id_ = rq->req_id_;
+        labstor_request_queue_RingDoorbell(lrq);
         return true;
     }
     LABSTOR_INF_SPINWAIT_END()
@@ -131,7 +193,8 @@ static inline bool labstor_request_queue_Enqueue(struct labstor_request_queue *l
 static inline bool labstor_request_queue_EnqueueSimple(struct labstor_request_queue *lrq, struct labstor_request *rq) {
     LABSTOR_INF_SPINWAIT_PREAMBLE()
     LABSTOR_INF_SPINWAIT_START()
-    if(labstor_request_ring_buffer_Enqueue(&lrq->queue_, LABSTOR_REGION_SUB(rq, lrq->base_region_), &rq->req_id_)) {
+    if(labstor_spsc_request_ring_Enqueue(&lrq->queue_, LABSTOR_REGION_SUB(rq, lrq->base_region_), &rq->req_id_)) {
+        labstor_request_queue_RingDoorbell(lrq);
         return true;
     }
     LABSTOR_INF_SPINWAIT_END()
@@ -140,19 +203,68 @@ static inline bool labstor_request_queue_EnqueueSimple(struct labstor_request_qu
 
 static inline bool labstor_request_queue_Peek(struct labstor_request_queue *lrq, struct labstor_request **rq, int i) {
     labstor_off_t off;
-    if(!labstor_request_ring_buffer_Peek(&lrq->queue_, &off, i)) { return false; }
+    if(!labstor_spsc_request_ring_Peek(&lrq->queue_, &off, i)) { return false; }
     *rq = (struct labstor_request*)(LABSTOR_REGION_ADD(off, lrq->base_region_));
     return true;
 }
 
 static inline bool labstor_request_queue_Dequeue(struct labstor_request_queue *lrq, struct labstor_request **rq) {
     labstor_off_t off;
-    if(!labstor_request_ring_buffer_Dequeue(&lrq->queue_, &off)) { return false; }
+    if(!labstor_spsc_request_ring_Dequeue(&lrq->queue_, &off)) { return false; }
     *rq = (struct labstor_request*)(LABSTOR_REGION_ADD(off, lrq->base_region_));
     return true;
 }
 
 
+/*Batching: the SQ index is published once per batch*/
+
+static inline uint32_t labstor_request_queue_EnqueueBatch(struct labstor_request_queue *lrq, struct labstor_request **rqs, uint32_t count, struct labstor_qtok_t *qtoks) {
+    uint32_t start, i, n, submitted = 0;
+    LABSTOR_INF_SPINWAIT_PREAMBLE()
+    LABSTOR_INF_SPINWAIT_START()
+    n = labstor_spsc_request_ring_ReserveEnqueue(&lrq->queue_, count - submitted, &start);
+    for(i = 0; i < n; ++i) {
+        struct labstor_request *rq = rqs[submitted + i];
+        rq->req_id_ = start + i;
+        if(qtoks) {
+            qtoks[submitted + i].qid_ = lrq->header_->qid_;
+            qtoks[submitted + i].req_id_ = rq->req_id_;
+        }
+        labstor_spsc_request_ring_SetSlot(&lrq->queue_, start + i, LABSTOR_REGION_SUB(rq, lrq->base_region_));
+    }
+    if(n) {
+        labstor_spsc_request_ring_CommitEnqueue(&lrq->queue_, n);
+        labstor_request_queue_RingDoorbell(lrq);
+        submitted += n;
+    }
+    if(submitted == count) {
+        return submitted;
+    }
+    LABSTOR_INF_SPINWAIT_END()
+    return submitted;
+}
+
+static inline uint32_t labstor_request_queue_PeekBatch(struct labstor_request_queue *lrq, struct labstor_request **rqs, uint32_t max_count) {
+    uint32_t start, i, count;
+    count = labstor_spsc_request_ring_ReserveDequeue(&lrq->queue_, max_count, &start);
+    for(i = 0; i < count; ++i) {
+        rqs[i] = (struct labstor_request*)LABSTOR_REGION_ADD(labstor_spsc_request_ring_GetSlot(&lrq->queue_, start + i), lrq->base_region_);
+    }
+    return count;
+}
+
+static inline void labstor_request_queue_Consume(struct labstor_request_queue *lrq, uint32_t count) {
+    if(count) {
+        labstor_spsc_request_ring_CommitDequeue(&lrq->queue_, count);
+    }
+}
+
+static inline uint32_t labstor_request_queue_DequeueBatch(struct labstor_request_queue *lrq, struct labstor_request **rqs, uint32_t max_count) {
+    uint32_t count = labstor_request_queue_PeekBatch(lrq, rqs, max_count);
+    labstor_request_queue_Consume(lrq, count);
+    return count;
+}
+
 /*Queue Plugging*/
 
 static inline void labstor_request_queue_MarkPaused(struct labstor_request_queue *lrq) {
@@ -206,12 +318,36 @@ bool labstor_request_queue::Enqueue(labstor::ipc::request *rq, labstor::ipc::qto
 bool labstor_request_queue::Dequeue(labstor::ipc::request *&rq) {
     return labstor_request_queue_Dequeue(this, reinterpret_cast<struct labstor_request **>(&rq));
 }
+uint32_t labstor_request_queue::EnqueueBatch(labstor::ipc::request **rqs, uint32_t count, labstor::ipc::qtok_t *qtoks) {
+    return labstor_request_queue_EnqueueBatch(this, rqs, count, qtoks);
+}
+uint32_t labstor_request_queue::PeekBatch(labstor::ipc::request **rqs, uint32_t max_count) {
+    return labstor_request_queue_PeekBatch(this, rqs, max_count);
+}
+void labstor_request_queue::Consume(uint32_t count) {
+    labstor_request_queue_Consume(this, count);
+}
+uint32_t labstor_request_queue::DequeueBatch(labstor::ipc::request **rqs, uint32_t max_count) {
+    return labstor_request_queue_DequeueBatch(this, rqs, max_count);
+}
 uint32_t labstor_request_queue::GetDepth() {
     return labstor_request_queue_GetDepth(this);
 }
 uint32_t labstor_request_queue::GetMaxDepth() {
     return labstor_request_queue_GetMaxDepth(this);
 }
+uint32_t labstor_request_queue::GetNumEnqueued() {
+    return labstor_request_queue_GetNumEnqueued(this);
+}
+void labstor_request_queue::SetActiveTable(labstor::ipc::active_queues_table *table) {
+    labstor_request_queue_SetActiveTable(this, table);
+}
+void labstor_request_queue::SetDoorbell(uint32_t doorbell) {
+    labstor_request_queue_SetDoorbell(this, doorbell);
+}
+bool labstor_request_queue::ArmDoorbell(uint32_t doorbell) {
+    return labstor_request_queue_ArmDoorbell(this, doorbell);
+}
 uint32_t labstor_request_queue::GetFlags() {
     return labstor_request_queue_GetFlags(this);
 }
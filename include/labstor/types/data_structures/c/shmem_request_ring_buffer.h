@@ -200,6 +200,32 @@ static inline bool labstor_request_ring_buffer_Dequeue(struct labstor_request_ri
 #endif
 }
 
+/*
+ * Move up to count entries in or out of the ring with a single update of the
+ * ring indexes. Returns the number of entries moved.
+ * */
+static inline uint32_t labstor_request_ring_buffer_EnqueueBulk(struct labstor_request_ring_buffer *rbuf, labstor_off_t *data, uint32_t count) {
+    uint32_t free_slots, i;
+    free_slots = rbuf->header_->max_depth_ - (rbuf->header_->enqueued_ - rbuf->header_->dequeued_);
+    if(count > free_slots) { count = free_slots; }
+    for(i = 0; i < count; ++i) {
+        rbuf->queue_[(rbuf->header_->enqueued_ + i) % rbuf->header_->max_depth_] = data[i];
+    }
+    rbuf->header_->enqueued_ += count;
+    return count;
+}
+
+static inline uint32_t labstor_request_ring_buffer_DequeueBulk(struct labstor_request_ring_buffer *rbuf, labstor_off_t *data, uint32_t count) {
+    uint32_t depth, i;
+    depth = rbuf->header_->enqueued_ - rbuf->header_->dequeued_;
+    if(count > depth) { count = depth; }
+    for(i = 0; i < count; ++i) {
+        data[i] = rbuf->queue_[(rbuf->header_->dequeued_ + i) % rbuf->header_->max_depth_];
+    }
+    rbuf->header_->dequeued_ += count;
+    return count;
+}
+
 
 #ifdef __cplusplus
 namespace labstor::ipc {
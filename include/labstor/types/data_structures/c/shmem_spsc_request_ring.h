@@ -0,0 +1,345 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_SPSC_REQUEST_RING_H
+#define LABSTOR_SPSC_REQUEST_RING_H
+
+#include "labstor/constants/macros.h"
+#include "labstor/types/basics.h"
+#ifdef __cplusplus
+#include "labstor/types/shmem_type.h"
+#include "labstor/userspace/util/errors.h"
+#endif
+
+/*
+ * A single-producer, single-consumer ring of request offsets.
+ *
+ * The header is split into three cache lines:
+ *  1. Read-only after Init (max_depth_, mask_)
+ *  2. Producer-owned (enqueued_, cached_dequeued_)
+ *  3. Consumer-owned (dequeued_, cached_enqueued_)
+ * Each side only writes to its own cache line. The remote index is only re-read
+ * when the cached copy says the ring is full (producer) or empty (consumer).
+ * Slots are published with release stores and observed with acquire loads.
+ * The depth is always a power of two so indexing is a mask.
+ * */
+
+struct labstor_spsc_request_ring_header {
+    uint32_t max_depth_;
+    uint32_t mask_;
+    char ro_pad_[LABSTOR_CACHELINE_SIZE - 2*sizeof(uint32_t)];
+
+    uint32_t enqueued_;
+    uint32_t cached_dequeued_;
+    char producer_pad_[LABSTOR_CACHELINE_SIZE - 2*sizeof(uint32_t)];
+
+    uint32_t dequeued_;
+    uint32_t cached_enqueued_;
+    char consumer_pad_[LABSTOR_CACHELINE_SIZE - 2*sizeof(uint32_t)];
+};
+
+#ifdef __cplusplus
+struct labstor_spsc_request_ring : public labstor::shmem_type {
+#else
+struct labstor_spsc_request_ring {
+#endif
+    struct labstor_spsc_request_ring_header *header_;
+    labstor_off_t *queue_;
+#ifdef __cplusplus
+    static inline uint32_t GetSize(uint32_t max_depth);
+    inline uint32_t GetSize();
+    inline void* GetRegion();
+    inline void Init(void *region, uint32_t region_size, uint32_t max_depth = 0);
+    inline void Attach(void *region);
+    inline bool Enqueue(labstor_off_t data);
+    inline bool Enqueue(labstor_off_t data, uint32_t &req_id);
+    inline bool Peek(labstor_off_t &data, int i);
+    inline bool Dequeue(labstor_off_t &data);
+    inline uint32_t EnqueueBatch(labstor_off_t *data, uint32_t count, uint32_t &first_req_id);
+    inline uint32_t DequeueBatch(labstor_off_t *data, uint32_t max_count);
+    inline uint32_t GetDepth();
+    inline uint32_t GetMaxDepth();
+    inline uint32_t GetNumEnqueued();
+#endif
+};
+
+static inline uint32_t labstor_spsc_request_ring_RoundDepthUp(uint32_t max_depth) {
+    uint32_t depth = 1;
+    while(depth < max_depth) { depth <<= 1; }
+    return depth;
+}
+
+static inline uint32_t labstor_spsc_request_ring_RoundDepthDown(uint32_t max_depth) {
+    uint32_t depth = 1;
+    if(max_depth == 0) { return 0; }
+    while((depth << 1) <= max_depth && (depth << 1) != 0) { depth <<= 1; }
+    return depth;
+}
+
+static inline uint32_t labstor_spsc_request_ring_GetSize_global(uint32_t max_depth) {
+    return sizeof(struct labstor_spsc_request_ring_header) +
+            sizeof(labstor_off_t)*labstor_spsc_request_ring_RoundDepthUp(max_depth);
+}
+
+static inline uint32_t labstor_spsc_request_ring_GetSize(struct labstor_spsc_request_ring *rbuf) {
+    return labstor_spsc_request_ring_GetSize_global(rbuf->header_->max_depth_);
+}
+
+static inline void* labstor_spsc_request_ring_GetRegion(struct labstor_spsc_request_ring *rbuf) {
+    return rbuf->header_;
+}
+
+static inline void* labstor_spsc_request_ring_GetNextSection(struct labstor_spsc_request_ring *rbuf) {
+    return (char*)rbuf->header_ + labstor_spsc_request_ring_GetSize(rbuf);
+}
+
+static inline uint32_t labstor_spsc_request_ring_GetDepth(struct labstor_spsc_request_ring *rbuf) {
+    uint32_t dequeued = __atomic_load_n(&rbuf->header_->dequeued_, __ATOMIC_ACQUIRE);
+    uint32_t enqueued = __atomic_load_n(&rbuf->header_->enqueued_, __ATOMIC_ACQUIRE);
+    return enqueued - dequeued;
+}
+
+static inline uint32_t labstor_spsc_request_ring_GetMaxDepth(struct labstor_spsc_request_ring *rbuf) {
+    return rbuf->header_->max_depth_;
+}
+
+/*The total number of entries ever enqueued (wraps). Safe to sample from any thread.*/
+static inline uint32_t labstor_spsc_request_ring_GetNumEnqueued(struct labstor_spsc_request_ring *rbuf) {
+    return __atomic_load_n(&rbuf->header_->enqueued_, __ATOMIC_RELAXED);
+}
+
+static inline bool labstor_spsc_request_ring_Init(struct labstor_spsc_request_ring *rbuf, void *region, uint32_t region_size, uint32_t max_depth) {
+    rbuf->header_ = (struct labstor_spsc_request_ring_header*)region;
+    if(region_size < labstor_spsc_request_ring_GetSize_global(max_depth)) {
+#ifdef __cplusplus
+        throw labstor::INVALID_RING_BUFFER_SIZE.format(region_size, max_depth);
+#else
+        return false;
+#endif
+    }
+    if(max_depth == 0) {
+        max_depth = region_size - sizeof(struct labstor_spsc_request_ring_header);
+        max_depth /= sizeof(labstor_off_t);
+        max_depth = labstor_spsc_request_ring_RoundDepthDown(max_depth);
+    } else {
+        max_depth = labstor_spsc_request_ring_RoundDepthUp(max_depth);
+    }
+    if(max_depth == 0) {
+#ifdef __cplusplus
+        throw labstor::INVALID_RING_BUFFER_SIZE.format(region_size, max_depth);
+#else
+        return false;
+#endif
+    }
+    rbuf->header_->max_depth_ = max_depth;
+    rbuf->header_->mask_ = max_depth - 1;
+    rbuf->header_->enqueued_ = 0;
+    rbuf->header_->cached_dequeued_ = 0;
+    rbuf->header_->dequeued_ = 0;
+    rbuf->header_->cached_enqueued_ = 0;
+    rbuf->queue_ = (labstor_off_t*)(rbuf->header_ + 1);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return true;
+}
+
+static inline void labstor_spsc_request_ring_Attach(struct labstor_spsc_request_ring *rbuf, void *region) {
+    rbuf->header_ = (struct labstor_spsc_request_ring_header*)region;
+    rbuf->queue_ = (labstor_off_t*)(rbuf->header_ + 1);
+}
+
+static inline void labstor_spsc_request_ring_RemoteAttach(struct labstor_spsc_request_ring *rbuf, void *kern_region) {
+    rbuf->header_ = (struct labstor_spsc_request_ring_header*)kern_region;
+    rbuf->queue_ = (labstor_off_t*)(rbuf->header_ + 1);
+}
+
+static inline bool labstor_spsc_request_ring_Enqueue(struct labstor_spsc_request_ring *rbuf, labstor_off_t data, uint32_t *req_id) {
+    struct labstor_spsc_request_ring_header *header = rbuf->header_;
+    uint32_t enqueued = header->enqueued_;
+    if(enqueued - header->cached_dequeued_ >= header->max_depth_) {
+        header->cached_dequeued_ = __atomic_load_n(&header->dequeued_, __ATOMIC_ACQUIRE);
+        if(enqueued - header->cached_dequeued_ >= header->max_depth_) {
+            return false;
+        }
+    }
+    rbuf->queue_[enqueued & header->mask_] = data;
+    *req_id = enqueued;
+    __atomic_store_n(&header->enqueued_, enqueued + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static inline bool labstor_spsc_request_ring_Enqueue_simple(struct labstor_spsc_request_ring *rbuf, labstor_off_t data) {
+    uint32_t req_id;
+    return labstor_spsc_request_ring_Enqueue(rbuf, data, &req_id);
+}
+
+static inline bool labstor_spsc_request_ring_Peek(struct labstor_spsc_request_ring *rbuf, labstor_off_t *data, int i) {
+    struct labstor_spsc_request_ring_header *header = rbuf->header_;
+    uint32_t dequeued = header->dequeued_;
+    if(header->cached_enqueued_ - dequeued <= (uint32_t)i) {
+        header->cached_enqueued_ = __atomic_load_n(&header->enqueued_, __ATOMIC_ACQUIRE);
+        if(header->cached_enqueued_ - dequeued <= (uint32_t)i) {
+            return false;
+        }
+    }
+    *data = rbuf->queue_[(dequeued + i) & header->mask_];
+    return true;
+}
+
+static inline bool labstor_spsc_request_ring_Dequeue(struct labstor_spsc_request_ring *rbuf, labstor_off_t *data) {
+    struct labstor_spsc_request_ring_header *header = rbuf->header_;
+    uint32_t dequeued = header->dequeued_;
+    if(header->cached_enqueued_ == dequeued) {
+        header->cached_enqueued_ = __atomic_load_n(&header->enqueued_, __ATOMIC_ACQUIRE);
+        if(header->cached_enqueued_ == dequeued) {
+            return false;
+        }
+    }
+    *data = rbuf->queue_[dequeued & header->mask_];
+    __atomic_store_n(&header->dequeued_, dequeued + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/*
+ * Batching: reserve up to count slots, fill them, and then commit them with a
+ * single index publication.
+ * */
+
+static inline uint32_t labstor_spsc_request_ring_ReserveEnqueue(struct labstor_spsc_request_ring *rbuf, uint32_t count, uint32_t *start) {
+    struct labstor_spsc_request_ring_header *header = rbuf->header_;
+    uint32_t enqueued = header->enqueued_;
+    uint32_t free_slots = header->max_depth_ - (enqueued - header->cached_dequeued_);
+    if(free_slots < count) {
+        header->cached_dequeued_ = __atomic_load_n(&header->dequeued_, __ATOMIC_ACQUIRE);
+        free_slots = header->max_depth_ - (enqueued - header->cached_dequeued_);
+    }
+    *start = enqueued;
+    return free_slots < count ? free_slots : count;
+}
+
+static inline void labstor_spsc_request_ring_SetSlot(struct labstor_spsc_request_ring *rbuf, uint32_t pos, labstor_off_t data) {
+    rbuf->queue_[pos & rbuf->header_->mask_] = data;
+}
+
+static inline void labstor_spsc_request_ring_CommitEnqueue(struct labstor_spsc_request_ring *rbuf, uint32_t count) {
+    __atomic_store_n(&rbuf->header_->enqueued_, rbuf->header_->enqueued_ + count, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t labstor_spsc_request_ring_ReserveDequeue(struct labstor_spsc_request_ring *rbuf, uint32_t count, uint32_t *start) {
+    struct labstor_spsc_request_ring_header *header = rbuf->header_;
+    uint32_t dequeued = header->dequeued_;
+    uint32_t ready = header->cached_enqueued_ - dequeued;
+    if(ready < count) {
+        header->cached_enqueued_ = __atomic_load_n(&header->enqueued_, __ATOMIC_ACQUIRE);
+        ready = header->cached_enqueued_ - dequeued;
+    }
+    *start = dequeued;
+    return ready < count ? ready : count;
+}
+
+static inline labstor_off_t labstor_spsc_request_ring_GetSlot(struct labstor_spsc_request_ring *rbuf, uint32_t pos) {
+    return rbuf->queue_[pos & rbuf->header_->mask_];
+}
+
+static inline void labstor_spsc_request_ring_CommitDequeue(struct labstor_spsc_request_ring *rbuf, uint32_t count) {
+    __atomic_store_n(&rbuf->header_->dequeued_, rbuf->header_->dequeued_ + count, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t labstor_spsc_request_ring_EnqueueBatch(struct labstor_spsc_request_ring *rbuf, labstor_off_t *data, uint32_t count, uint32_t *first_req_id) {
+    uint32_t start, i;
+    count = labstor_spsc_request_ring_ReserveEnqueue(rbuf, count, &start);
+    for(i = 0; i < count; ++i) {
+        labstor_spsc_request_ring_SetSlot(rbuf, start + i, data[i]);
+    }
+    *first_req_id = start;
+    if(count) {
+        labstor_spsc_request_ring_CommitEnqueue(rbuf, count);
+    }
+    return count;
+}
+
+static inline uint32_t labstor_spsc_request_ring_DequeueBatch(struct labstor_spsc_request_ring *rbuf, labstor_off_t *data, uint32_t max_count) {
+    uint32_t start, i, count;
+    count = labstor_spsc_request_ring_ReserveDequeue(rbuf, max_count, &start);
+    for(i = 0; i < count; ++i) {
+        data[i] = labstor_spsc_request_ring_GetSlot(rbuf, start + i);
+    }
+    if(count) {
+        labstor_spsc_request_ring_CommitDequeue(rbuf, count);
+    }
+    return count;
+}
+
+#ifdef __cplusplus
+namespace labstor::ipc {
+    typedef labstor_spsc_request_ring spsc_request_ring;
+}
+
+uint32_t labstor_spsc_request_ring::GetSize(uint32_t max_depth) {
+    return labstor_spsc_request_ring_GetSize_global(max_depth);
+}
+uint32_t labstor_spsc_request_ring::GetSize() {
+    return labstor_spsc_request_ring_GetSize(this);
+}
+void* labstor_spsc_request_ring::GetRegion() {
+    return labstor_spsc_request_ring_GetRegion(this);
+}
+void labstor_spsc_request_ring::Init(void *region, uint32_t region_size, uint32_t max_depth) {
+    labstor_spsc_request_ring_Init(this, region, region_size, max_depth);
+}
+void labstor_spsc_request_ring::Attach(void *region) {
+    labstor_spsc_request_ring_Attach(this, region);
+}
+bool labstor_spsc_request_ring::Enqueue(labstor_off_t data) {
+    return labstor_spsc_request_ring_Enqueue_simple(this, data);
+}
+bool labstor_spsc_request_ring::Enqueue(labstor_off_t data, uint32_t &req_id) {
+    return labstor_spsc_request_ring_Enqueue(this, data, &req_id);
+}
+bool labstor_spsc_request_ring::Peek(labstor_off_t &data, int i) {
+    return labstor_spsc_request_ring_Peek(this, &data, i);
+}
+bool labstor_spsc_request_ring::Dequeue(labstor_off_t &data) {
+    return labstor_spsc_request_ring_Dequeue(this, &data);
+}
+uint32_t labstor_spsc_request_ring::EnqueueBatch(labstor_off_t *data, uint32_t count, uint32_t &first_req_id) {
+    return labstor_spsc_request_ring_EnqueueBatch(this, data, count, &first_req_id);
+}
+uint32_t labstor_spsc_request_ring::DequeueBatch(labstor_off_t *data, uint32_t max_count) {
+    return labstor_spsc_request_ring_DequeueBatch(this, data, max_count);
+}
+uint32_t labstor_spsc_request_ring::GetDepth() {
+    return labstor_spsc_request_ring_GetDepth(this);
+}
+uint32_t labstor_spsc_request_ring::GetMaxDepth() {
+    return labstor_spsc_request_ring_GetMaxDepth(this);
+}
+uint32_t labstor_spsc_request_ring::GetNumEnqueued() {
+    return labstor_spsc_request_ring_GetNumEnqueued(this);
+}
+
+#endif
+
+#endif //LABSTOR_SPSC_REQUEST_RING_H
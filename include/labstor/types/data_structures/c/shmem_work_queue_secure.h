@@ -62,6 +62,7 @@ struct labstor_work_queue_secure {
     inline void Attach(void *region);
     inline bool Enqueue(struct labstor_queue_pair *qp, struct labstor_credentials *creds);
     inline bool Peek(struct labstor_queue_pair *&qp, struct labstor_credentials *&creds, int i);
+    inline bool Remove(int i);
     inline uint32_t GetDepth();
     inline uint32_t GetMaxDepth();
 #endif
@@ -142,6 +143,16 @@ static inline bool labstor_work_queue_secure_Peek(
     return true;
 }
 
+/*
+ * Remove entry i by moving the last entry into its place.
+ * */
+static inline bool labstor_work_queue_secure_Remove(struct labstor_work_queue_secure *rbuf, int i) {
+    if(i >= rbuf->header_->enqueued_) { return false; }
+    rbuf->queue_[i] = rbuf->queue_[rbuf->header_->enqueued_ - 1];
+    --rbuf->header_->enqueued_;
+    return true;
+}
+
 #ifdef __cplusplus
 namespace labstor::ipc {
     typedef labstor_work_queue_secure work_queue_secure;
@@ -168,6 +179,9 @@ bool labstor_work_queue_secure::Enqueue(struct labstor_queue_pair *qp, struct la
 bool labstor_work_queue_secure::Peek(struct labstor_queue_pair *&qp, struct labstor_credentials *&creds, int i) {
     return labstor_work_queue_secure_Peek(this, &qp, &creds, i);
 }
+bool labstor_work_queue_secure::Remove(int i) {
+    return labstor_work_queue_secure_Remove(this, i);
+}
 uint32_t labstor_work_queue_secure::GetDepth() {
     return labstor_work_queue_secure_GetDepth(this);
 }
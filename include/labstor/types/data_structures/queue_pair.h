@@ -30,10 +30,19 @@
 #include "shmem_qtok.h"
 #include "shmem_request.h"
 #include "labstor/constants/busy_wait.h"
+#include "c/shmem_doorbell.h"
 
 #ifdef __cplusplus
+#ifdef __cpp_impl_coroutine
+#include "labstor/types/continuation.h"
+#endif
 
 namespace labstor {
+#ifdef __cpp_impl_coroutine
+template<typename T>
+struct SubmitAwaiter;
+#endif
+
 class queue_pair {
 public:
     int GetPID() {
@@ -75,6 +84,55 @@ public:
     inline bool IsComplete(labstor::ipc::qtok_t &qtok, T *&rq) {
         return _IsComplete(qtok.req_id_, reinterpret_cast<labstor::ipc::request**>(&rq));
     }
+
+    /*Batching: submit and drain many requests per shared index publication*/
+    template<typename T>
+    inline uint32_t EnqueueBatch(T **rqs, uint32_t count, labstor::ipc::qtok_t *qtoks) {
+        return _EnqueueBatch(reinterpret_cast<labstor::ipc::request**>(rqs), count, qtoks);
+    }
+    template<typename T>
+    inline uint32_t PeekBatch(T **rqs, uint32_t max_count) {
+        return _PeekBatch(reinterpret_cast<labstor::ipc::request**>(rqs), max_count);
+    }
+    inline void Consume(uint32_t count) {
+        _Consume(count);
+    }
+    template<typename T>
+    inline uint32_t DequeueBatch(T **rqs, uint32_t max_count) {
+        return _DequeueBatch(reinterpret_cast<labstor::ipc::request**>(rqs), max_count);
+    }
+    template<typename T>
+    inline void CompleteBatch(T **rqs, uint32_t count) {
+        _CompleteBatch(reinterpret_cast<labstor::ipc::request**>(rqs), count);
+    }
+    template<typename T>
+    inline uint32_t ReapCompleted(labstor::ipc::qtok_t *qtoks, uint32_t count, T **rqs) {
+        return _ReapCompleted(qtoks, count, reinterpret_cast<labstor::ipc::request**>(rqs));
+    }
+    template<typename T>
+    inline uint32_t ReapAll(T **rqs, uint32_t max_count) {
+        return _ReapAll(reinterpret_cast<labstor::ipc::request**>(rqs), max_count);
+    }
+
+#ifdef __cpp_impl_coroutine
+    /*Enqueue a request; awaiting the result suspends a handler until the request completes*/
+    template<typename T>
+    inline SubmitAwaiter<T> Submit(T *rq);
+#endif
+
+    /*Select how the owner of this queue pair waits for completions*/
+    inline void SetWaitPolicy(uint32_t policy,
+                              uint32_t spin_us = LABSTOR_WAIT_DEFAULT_SPIN_US,
+                              uint32_t yield_us = LABSTOR_WAIT_DEFAULT_YIELD_US) {
+        labstor::ipc::doorbell *db = _GetDoorbell();
+        if(db) { db->SetPolicy(policy, spin_us, yield_us); }
+    }
+
+    template<typename T>
+    inline uint32_t WaitAny(T **rqs, uint32_t max_count) {
+        return _WaitAny(reinterpret_cast<labstor::ipc::request**>(rqs), max_count);
+    }
+
     template<typename T>
     inline T* Wait(uint32_t req_id) {
         return reinterpret_cast<T*>(_Wait(req_id));
@@ -122,6 +180,57 @@ private:
     inline virtual void _Complete(labstor_req_id_t req_id, labstor::ipc::request *rq) = 0;
     inline virtual bool _IsComplete(labstor_req_id_t req_id, labstor::ipc::request **rq) = 0;
 
+    /*Batching defaults: queue pairs which can't batch fall back to single operations*/
+    inline virtual uint32_t _EnqueueBatch(labstor::ipc::request **rqs, uint32_t count, labstor::ipc::qtok_t *qtoks) {
+        labstor::ipc::qtok_t qtok;
+        for(uint32_t i = 0; i < count; ++i) {
+            _Enqueue(rqs[i], qtoks ? qtoks[i] : qtok);
+        }
+        return count;
+    }
+    inline virtual uint32_t _PeekBatch(labstor::ipc::request **rqs, uint32_t max_count) {
+        uint32_t i;
+        for(i = 0; i < max_count; ++i) {
+            if(!_Peek(&rqs[i], i)) { break; }
+        }
+        return i;
+    }
+    inline virtual void _Consume(uint32_t count) {
+        labstor::ipc::request *rq;
+        for(uint32_t i = 0; i < count; ++i) {
+            _Dequeue(&rq);
+        }
+    }
+    inline virtual uint32_t _DequeueBatch(labstor::ipc::request **rqs, uint32_t max_count) {
+        uint32_t i;
+        for(i = 0; i < max_count; ++i) {
+            if(!_Dequeue(&rqs[i])) { break; }
+        }
+        return i;
+    }
+    inline virtual void _CompleteBatch(labstor::ipc::request **rqs, uint32_t count) {
+        for(uint32_t i = 0; i < count; ++i) {
+            _Complete(rqs[i]->req_id_, rqs[i]);
+        }
+    }
+    inline virtual uint32_t _ReapCompleted(labstor::ipc::qtok_t *qtoks, uint32_t count, labstor::ipc::request **rqs) {
+        uint32_t num_reaped = 0, num_pending = 0;
+        for(uint32_t i = 0; i < count; ++i) {
+            if(_IsComplete(qtoks[i].req_id_, &rqs[num_reaped])) {
+                ++num_reaped;
+            } else {
+                qtoks[num_pending++] = qtoks[i];
+            }
+        }
+        return num_reaped;
+    }
+    inline virtual uint32_t _ReapAll(labstor::ipc::request **, uint32_t) {
+        return 0;
+    }
+    inline virtual labstor::ipc::doorbell* _GetDoorbell() {
+        return nullptr;
+    }
+
     inline void _Complete(labstor::ipc::request *old_rq, labstor::ipc::request *new_rq) {
         _Complete(old_rq->req_id_, new_rq);
     }
@@ -132,8 +241,13 @@ private:
         _Complete(qtok.req_id_, rq);
     }
     inline labstor::ipc::request* _Wait(uint32_t req_id) {
-        LABSTOR_INF_SPINWAIT_PREAMBLE()
         labstor::ipc::request *ret = NULL;
+        labstor::ipc::doorbell *db = _GetDoorbell();
+        if(db && !db->IsPolling()) {
+            db->Wait([&]() { return _IsComplete(req_id, &ret); });
+            return ret;
+        }
+        LABSTOR_INF_SPINWAIT_PREAMBLE()
         LABSTOR_INF_SPINWAIT_START()
             if(_IsComplete(req_id, &ret)) {
                 return ret;
@@ -150,6 +264,21 @@ private:
         LABSTOR_TIMED_SPINWAIT_END(max_ms)
         return NULL;
     }
+    inline uint32_t _WaitAny(labstor::ipc::request **rqs, uint32_t max_count) {
+        uint32_t num_reaped;
+        labstor::ipc::doorbell *db = _GetDoorbell();
+        if(db && !db->IsPolling()) {
+            db->Wait([&]() { return (num_reaped = _ReapAll(rqs, max_count)) > 0; });
+            return num_reaped;
+        }
+        LABSTOR_INF_SPINWAIT_PREAMBLE()
+        LABSTOR_INF_SPINWAIT_START()
+            num_reaped = _ReapAll(rqs, max_count);
+            if(num_reaped) {
+                return num_reaped;
+            }
+        LABSTOR_INF_SPINWAIT_END()
+    }
     inline labstor::ipc::request* _Wait(labstor::ipc::qtok_t &qtok) {
         return _Wait(qtok.req_id_);
     }
@@ -158,6 +287,32 @@ private:
     }
 };
 
+#ifdef __cpp_impl_coroutine
+template<typename T>
+struct SubmitAwaiter {
+    queue_pair *qp_;
+    labstor::ipc::qtok_t qtok_;
+    T *rq_;
+    SubmitAwaiter(queue_pair *qp, T *rq) : qp_(qp), rq_(rq) {
+        qp_->Enqueue<T>(rq, qtok_);
+    }
+    bool await_ready() { return qp_->IsComplete<T>(qtok_, rq_); }
+    void await_suspend(Continuation::handle_type handle) {
+        handle.promise().Await(this, &Ready);
+    }
+    T* await_resume() { return rq_; }
+    static bool Ready(void *awaiter) {
+        SubmitAwaiter *self = reinterpret_cast<SubmitAwaiter*>(awaiter);
+        return self->qp_->template IsComplete<T>(self->qtok_, self->rq_);
+    }
+};
+
+template<typename T>
+inline SubmitAwaiter<T> queue_pair::Submit(T *rq) {
+    return SubmitAwaiter<T>(this, rq);
+}
+#endif
+
 class user_queue_pair : public queue_pair {
 private:
     labstor::ipc::qid_t qid_;
@@ -0,0 +1,90 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_SHMEM_BUFFER_H
+#define LABSTOR_SHMEM_BUFFER_H
+
+#include <labstor/types/basics.h>
+
+/*
+ * A reference to the payload of an I/O request.
+ *
+ * Payloads allocated from a data buffer pool are named by the pool's shared
+ * memory region and an offset into it, so every process which maps the pool,
+ * and the kernel, reads and writes the same bytes in place. Any other payload
+ * is passed as a raw pointer in the address space of the submitter.
+ * */
+
+#define LABSTOR_BUF_RAW (-1)
+
+/*Data buffer pools hand out page-aligned buffers from 1MB slabs*/
+#define LABSTOR_DATA_POOL_UNIT 4096
+#define LABSTOR_DATA_POOL_SLAB_SIZE (1024*1024)
+
+struct labstor_buf_ref {
+    int32_t region_id_;
+    uint32_t pad_;
+    uint64_t off_;
+#ifdef __cplusplus
+    static inline labstor_buf_ref Raw(void *ptr) {
+        labstor_buf_ref ref;
+        ref.region_id_ = LABSTOR_BUF_RAW;
+        ref.pad_ = 0;
+        ref.off_ = (uint64_t)ptr;
+        return ref;
+    }
+    static inline labstor_buf_ref Shmem(int region_id, uint64_t off) {
+        labstor_buf_ref ref;
+        ref.region_id_ = region_id;
+        ref.pad_ = 0;
+        ref.off_ = off;
+        return ref;
+    }
+    inline bool IsRaw() const {
+        return region_id_ == LABSTOR_BUF_RAW;
+    }
+    inline void* GetRaw() const {
+        return (void*)off_;
+    }
+    inline labstor_buf_ref Add(uint64_t off) const {
+        labstor_buf_ref ref = *this;
+        ref.off_ += off;
+        return ref;
+    }
+#endif
+};
+
+static inline bool labstor_buf_ref_IsRaw(struct labstor_buf_ref *ref) {
+    return ref->region_id_ == LABSTOR_BUF_RAW;
+}
+
+#ifdef __cplusplus
+namespace labstor::ipc {
+    typedef labstor_buf_ref buf_ref;
+}
+#endif
+
+#endif //LABSTOR_SHMEM_BUFFER_H
@@ -0,0 +1,184 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_LOCKLESS_RING_BUFFER_MPMC_H
+#define LABSTOR_LOCKLESS_RING_BUFFER_MPMC_H
+
+#include "labstor/constants/macros.h"
+#include "labstor/types/basics.h"
+#include "labstor/types/shmem_type.h"
+#include "labstor/userspace/util/errors.h"
+
+/*
+ * A bounded MPMC ring buffer where every slot carries a sequence number (Vyukov).
+ * A slot at position pos is free for the producer which claims pos when seq_ == pos,
+ * and is full for the consumer which claims pos when seq_ == pos + 1.
+ * Producers and consumers only contend on their own index, which are kept on
+ * separate cache lines. Enqueue only fails when the ring is full and Dequeue
+ * only fails when the ring is empty.
+ * */
+
+namespace labstor::ipc::mpmc {
+
+struct lockless_ring_buffer_header {
+    uint64_t enqueued_;
+    char enqueued_pad_[LABSTOR_CACHELINE_SIZE - sizeof(uint64_t)];
+    uint64_t dequeued_;
+    char dequeued_pad_[LABSTOR_CACHELINE_SIZE - sizeof(uint64_t)];
+    uint32_t max_depth_;
+};
+
+template<typename T>
+struct lockless_ring_buffer_slot {
+    uint64_t seq_;
+    T data_;
+};
+
+template<typename T>
+struct lockless_ring_buffer : public labstor::shmem_type {
+    lockless_ring_buffer_header *header_;
+    lockless_ring_buffer_slot<T> *queue_;
+
+    lockless_ring_buffer() = default;
+    lockless_ring_buffer(void *region, uint32_t region_size, uint32_t max_depth=0) {
+        Init(region, region_size, max_depth);
+    }
+    lockless_ring_buffer(void *region) {
+        Attach(region);
+    }
+
+    static inline uint32_t GetSize(uint32_t max_depth) {
+        return sizeof(lockless_ring_buffer_header) +
+               sizeof(lockless_ring_buffer_slot<T>)*max_depth;
+    }
+
+    inline uint32_t GetSize() {
+        return GetSize(header_->max_depth_);
+    }
+
+    inline void* GetRegion() {
+        return header_;
+    }
+
+    inline void* GetNextSection() {
+        return (char*)header_ + GetSize();
+    }
+
+    inline uint32_t GetDepth() {
+        uint64_t enqueued = __atomic_load_n(&header_->enqueued_, __ATOMIC_RELAXED);
+        uint64_t dequeued = __atomic_load_n(&header_->dequeued_, __ATOMIC_RELAXED);
+        if(enqueued < dequeued) { return 0; }
+        return (uint32_t)(enqueued - dequeued);
+    }
+
+    inline uint32_t GetMaxDepth() {
+        return (uint32_t)(header_->max_depth_);
+    }
+
+    inline bool Init(void *region, uint32_t region_size, uint32_t max_depth=0) {
+        header_ = (lockless_ring_buffer_header*)region;
+        header_->enqueued_ = 0;
+        header_->dequeued_ = 0;
+        if(region_size < GetSize(max_depth)) {
+            throw labstor::INVALID_RING_BUFFER_SIZE.format(region_size, max_depth);
+        }
+        if(max_depth == 0) {
+            max_depth = (region_size - sizeof(lockless_ring_buffer_header))/sizeof(lockless_ring_buffer_slot<T>);
+        }
+        if(max_depth == 0) {
+            throw labstor::INVALID_RING_BUFFER_SIZE.format(region_size, max_depth);
+        }
+        header_->max_depth_ = max_depth;
+        queue_ = reinterpret_cast<lockless_ring_buffer_slot<T>*>(header_ + 1);
+        for(uint32_t i = 0; i < max_depth; ++i) {
+            queue_[i].seq_ = i;
+        }
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        return true;
+    }
+
+    inline void Attach(void *region) {
+        header_ = (lockless_ring_buffer_header*)region;
+        queue_ = reinterpret_cast<lockless_ring_buffer_slot<T>*>(header_ + 1);
+    }
+
+    inline bool Enqueue(T data, uint32_t &req_id) {
+        lockless_ring_buffer_slot<T> *slot;
+        uint64_t pos = __atomic_load_n(&header_->enqueued_, __ATOMIC_RELAXED);
+        while(1) {
+            slot = &queue_[pos % header_->max_depth_];
+            uint64_t seq = __atomic_load_n(&slot->seq_, __ATOMIC_ACQUIRE);
+            int64_t diff = (int64_t)seq - (int64_t)pos;
+            if(diff == 0) {
+                //On failure, pos is reloaded with the current enqueue index
+                if(__atomic_compare_exchange_n(&header_->enqueued_, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                    break;
+                }
+            } else if(diff < 0) {
+                //The slot from the previous lap has not been consumed: full
+                return false;
+            } else {
+                pos = __atomic_load_n(&header_->enqueued_, __ATOMIC_RELAXED);
+            }
+        }
+        slot->data_ = data;
+        req_id = (uint32_t)pos;
+        __atomic_store_n(&slot->seq_, pos + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    inline bool Enqueue(T data) {
+        uint32_t req_id;
+        return Enqueue(data, req_id);
+    }
+
+    inline bool Dequeue(T &data) {
+        lockless_ring_buffer_slot<T> *slot;
+        uint64_t pos = __atomic_load_n(&header_->dequeued_, __ATOMIC_RELAXED);
+        while(1) {
+            slot = &queue_[pos % header_->max_depth_];
+            uint64_t seq = __atomic_load_n(&slot->seq_, __ATOMIC_ACQUIRE);
+            int64_t diff = (int64_t)seq - (int64_t)(pos + 1);
+            if(diff == 0) {
+                if(__atomic_compare_exchange_n(&header_->dequeued_, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                    break;
+                }
+            } else if(diff < 0) {
+                //The slot has not been produced yet: empty
+                return false;
+            } else {
+                pos = __atomic_load_n(&header_->dequeued_, __ATOMIC_RELAXED);
+            }
+        }
+        data = slot->data_;
+        __atomic_store_n(&slot->seq_, pos + header_->max_depth_, __ATOMIC_RELEASE);
+        return true;
+    }
+};
+
+}
+
+#endif //LABSTOR_LOCKLESS_RING_BUFFER_MPMC_H
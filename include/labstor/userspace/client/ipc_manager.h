@@ -37,12 +37,15 @@
 #include "labstor/types/data_structures/c/shmem_queue_pair.h"
 #include "labstor/userspace/types/queue_pool.h"
 #include "labstor/userspace/types/memory_manager.h"
+#include <labstor/types/allocator/slab_allocator.h>
 #include <labstor/types/thread_local.h>
 #include <sys/sysinfo.h>
 #include <sched.h>
 #include <mutex>
+#include <cstring>
 
 #define TRUSTED_SERVER_PATH "/tmp/labstor_trusted_server"
+#define LABSTOR_IPC_HARVEST_BATCH 64
 
 namespace labstor::Client {
 
@@ -51,8 +54,13 @@ private:
     int pid_, n_cpu_;
     UnixSocket serversock_;
     bool is_connected_;
+    labstor::ipc::active_queues_table *active_table_;
+    void *region_;
+    uint32_t region_size_, max_segments_, wait_policy_, wait_spin_us_;
+    labstor::ipc::slab_allocator *request_alloc_;
+    std::mutex grow_lock_;
 public:
-    IPCManager() : is_connected_(false) {
+    IPCManager() : is_connected_(false), active_table_(nullptr), region_(nullptr), region_size_(0), max_segments_(1), wait_policy_(LABSTOR_WAIT_ADAPTIVE), wait_spin_us_(LABSTOR_WAIT_DEFAULT_SPIN_US), request_alloc_(nullptr) {
         n_cpu_ = get_nprocs_conf();
     }
     void Connect();
@@ -67,16 +75,29 @@ public:
     }
     inline void GetQueuePair(labstor::queue_pair *&qp, labstor_qid_type_t type, labstor_qid_flags_t flags) {
         AUTO_TRACE("")
+        flags = GetServedFlags(type, flags);
         int off = labstor::queue_pair::GetQIDOff(type, flags, labstor::ThreadLocal::GetTid(), GetNumQueuePairsFast(type, flags), pid_);
         QueuePool::GetQueuePair(qp, type, flags, off);
     }
     inline void GetQueuePair(labstor::queue_pair *&qp, labstor_qid_flags_t flags) {
         AUTO_TRACE("")
+        flags = GetServedFlags(0, flags);
         int off = labstor::queue_pair::GetQIDOff(0, flags, labstor::ThreadLocal::GetTid(), GetNumQueuePairsFast(0, flags), pid_);
         QueuePool::GetQueuePair(qp, 0, flags, off);
     }
+    inline void GetQueuePair(labstor::queue_pair *&qp, labstor::ipc::qtok_t &qtok) {
+        QueuePool::GetQueuePair(qp, qtok);
+    }
+    inline labstor_qid_flags_t GetServedFlags(labstor_qid_type_t type, labstor_qid_flags_t flags) {
+        //Bulk submitters share the low-latency queues when none were configured for them
+        if(LABSTOR_QP_IS_HIGH_LATENCY(flags) && GetNumQueuePairsFast(type, flags) == 0) {
+            return flags & ~LABSTOR_QP_HIGH_LATENCY;
+        }
+        return flags;
+    }
     inline void GetQueuePairByName(labstor::queue_pair *&qp, labstor_qid_flags_t flags, const std::string &str, uint32_t ns_id) {
         AUTO_TRACE("")
+        flags = GetServedFlags(0, flags);
         int off = labstor::queue_pair::GetQIDOff(0, flags, str, ns_id, GetNumQueuePairsFast(0, flags), pid_);
         QueuePool::GetQueuePair(qp, 0, flags, off);
     }
@@ -105,28 +126,70 @@ public:
     template<typename T=labstor::ipc::request>
     int Wait(labstor::ipc::qtok_t *qtoks, int num_qtoks) {
         AUTO_TRACE("num_qtoks", num_qtoks)
-        for(int i = 0; i < num_qtoks; ++i) {
-            T *rq = Wait<T>(qtoks[i]);
-        }
+        Harvest<T>(qtoks, num_qtoks, false);
         return LABSTOR_REQUEST_SUCCESS;
     }
     template<typename T=labstor::ipc::request>
     int WaitFree(labstor::ipc::qtok_t *qtoks, int num_qtoks) {
         AUTO_TRACE("num_qtoks", num_qtoks)
-        for(int i = 0; i < num_qtoks; ++i) {
-            T *rq = Wait<T>(qtoks[i]);
-            //TODO: Check if request successful
-            FreeRequest(qtoks[i], rq);
-        }
+        //TODO: Check if request successful
+        Harvest<T>(qtoks, num_qtoks, true);
         return LABSTOR_REQUEST_SUCCESS;
     }
+    template<typename T=labstor::ipc::request>
+    uint32_t WaitAny(labstor::queue_pair *qp, T **rqs, uint32_t max_count) {
+        AUTO_TRACE("max_count", max_count)
+        return qp->WaitAny<T>(rqs, max_count);
+    }
 
+    bool GrowShmem(uint32_t size) override;
     void PauseQueues();
     void WaitForPause();
     void ResumeQueues();
 private:
-    void CreateQueuesSHMEM(int num_queues, int queue_size);
-    void CreatePrivateQueues(int num_queues, int queue_size);
+    /*
+     * Reap every finished request among qtoks in each pass over the completion rings,
+     * instead of blocking on the tokens one at a time.
+     * Consecutive qtoks on the same queue pair are reaped with a single call.
+     * qtoks is reordered: the tokens still pending are kept at the front.
+     * When a pass makes no progress, the first pending token is waited for using
+     * the queue pair's wait policy.
+     * */
+    template<typename T>
+    void Harvest(labstor::ipc::qtok_t *qtoks, int num_qtoks, bool free_rqs) {
+        T *rqs[LABSTOR_IPC_HARVEST_BATCH];
+        labstor::queue_pair *qp;
+        int i, j, run, num_reaped, num_pending = num_qtoks, num_pending_before;
+        while(num_pending > 0) {
+            num_pending_before = num_pending;
+            for(i = 0; i < num_pending; i += run - num_reaped) {
+                for(run = 1; i + run < num_pending && run < LABSTOR_IPC_HARVEST_BATCH; ++run) {
+                    if(!(qtoks[i + run].qid_ == qtoks[i].qid_)) { break; }
+                }
+                QueuePool::GetQueuePair(qp, qtoks[i]);
+                num_reaped = qp->ReapCompleted<T>(qtoks + i, run, rqs);
+                if(num_reaped == 0) { continue; }
+                if(free_rqs) {
+                    for(j = 0; j < num_reaped; ++j) {
+                        FreeRequest<T>(qp, rqs[j]);
+                    }
+                }
+                memmove(qtoks + i + run - num_reaped, qtoks + i + run, (num_pending - i - run)*sizeof(labstor::ipc::qtok_t));
+                num_pending -= num_reaped;
+            }
+            if(num_pending > 0 && num_pending == num_pending_before) {
+                QueuePool::GetQueuePair(qp, qtoks[0]);
+                rqs[0] = qp->Wait<T>(qtoks[0].req_id_);
+                if(free_rqs) {
+                    FreeRequest<T>(qp, rqs[0]);
+                }
+                memmove(qtoks, qtoks + 1, (num_pending - 1)*sizeof(labstor::ipc::qtok_t));
+                --num_pending;
+            }
+        }
+    }
+    void CreateQueuesSHMEM(int num_queues, int num_high_latency_queues, int queue_size);
+    void CreatePrivateQueues(int num_queues, int depth);
 };
 
 }
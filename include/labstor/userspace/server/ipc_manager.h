@@ -38,6 +38,7 @@
 #include <labstor/types/basics.h>
 #include <labstor/types/allocator/allocator.h>
 #include <labstor/types/allocator/segment_allocator.h>
+#include <labstor/userspace/util/pages.h>
 #include "labstor/types/data_structures/c/shmem_queue_pair.h"
 #include "per_process_ipc.h"
 #include <labstor/types/thread_local.h>
@@ -46,6 +47,12 @@
 #include "macros.h"
 #include "server.h"
 
+/*
+ * Flags of the server's private intermediate queues. Queues are indexed by their
+ * exact flags, so modules must look private queues up with this value.
+ * */
+#define LABSTOR_QP_SERVER_PRIVATE (LABSTOR_QP_PRIVATE | LABSTOR_QP_STREAM | LABSTOR_QP_INTERMEDIATE | LABSTOR_QP_UNORDERED | LABSTOR_QP_LOW_LATENCY)
+
 namespace labstor::Server {
 
 struct MemoryConfig {
@@ -54,10 +61,17 @@ struct MemoryConfig {
     uint32_t min_request_region;
     uint32_t queue_depth;
     uint32_t num_queues;
+    uint32_t num_high_latency_queues;
     uint32_t queue_region_size;
     uint32_t request_region_size;
     uint32_t request_queue_size;
-    uint32_t request_map_size;
+    uint32_t completion_ring_size;
+    labstor::PageSize page_size;
+    bool numa_placement;
+    uint32_t max_segments;
+    uint32_t data_pool_size;
+    uint32_t wait_policy;
+    uint32_t wait_spin_us;
 };
 
 class IPCManager {
@@ -65,14 +79,21 @@ private:
     int pid_;
     int server_fd_;
     void *private_mem_, *kern_base_region_;
+    labstor::PageSize private_page_size_;
+    bool private_numa_;
     std::mutex lock_;
     labstor::GenericAllocator *private_alloc_;
     std::unordered_map<uint32_t,PerProcessIPC*> pid_to_ipc_;
     LABSTOR_CONFIGURATION_MANAGER_T labstor_config_;
+    std::once_flag wake_once_;
+    uint32_t wake_us_;
 public:
     IPCManager() {
         pid_ = getpid();
         labstor_config_ = LABSTOR_CONFIGURATION_MANAGER;
+        private_page_size_ = labstor::PageSize::k4K;
+        private_numa_ = false;
+        wake_us_ = LABSTOR_WAIT_DEFAULT_SPIN_US;
     }
 
     inline void SetServerFd(int fd) { server_fd_ = fd; }
@@ -84,6 +105,8 @@ public:
     void CreatePrivateQueues();
     void RegisterClient(int client_fd, labstor::credentials &creds);
     void RegisterClientQP(PerProcessIPC *client_ipc, void *region);
+    void GrowClientRegion(PerProcessIPC *client_ipc);
+    void PlaceQueuePair(labstor_queue_pair *qp, int cpu_id);
     void PauseQueues();
     void WaitForPause();
     void ResumeQueues();
@@ -93,14 +116,17 @@ public:
     }
     PerProcessIPC* RegisterIPC(int pid) {
         PerProcessIPC *ipc = new PerProcessIPC(pid);
+        std::lock_guard<std::mutex> lock(lock_);
         pid_to_ipc_.emplace(pid, ipc);
         return ipc;
     }
     PerProcessIPC* RegisterIPC(int fd, labstor::credentials &creds) {
         PerProcessIPC *ipc = new PerProcessIPC(fd, creds);
+        std::lock_guard<std::mutex> lock(lock_);
         pid_to_ipc_.emplace(creds.pid_, ipc);
         return ipc;
     }
+    void UnregisterIPC(PerProcessIPC *ipc);
     inline bool RegisterQueuePair(labstor::queue_pair *qp) {
         //TODO: Thread safety? Not important now
         TRACEPOINT("pid", qp->GetQID().pid_, "pid", qp->GetQID().type_, "flags", qp->GetQID().flags_, "cnt", qp->GetQID().cnt_)
@@ -120,6 +146,28 @@ public:
         return pid_to_ipc_[LABSTOR_GET_QP_IPC_ID(qp->GetQID())]->GetRegion();
     }
 
+    /*
+     * Resolve the payload of size bytes of a request submitted by pid. A pool
+     * reference must name the submitter's own pool and lie within it, or NULL is
+     * returned. Raw buffers are only meaningful in the address space of the submitter.
+     * */
+    inline void* GetBuffer(int pid, labstor::ipc::buf_ref buf, uint64_t size) {
+        if(buf.IsRaw()) {
+            return buf.GetRaw();
+        }
+        std::lock_guard<std::mutex> lock(lock_);
+        auto iter = pid_to_ipc_.find(pid);
+        if(iter == pid_to_ipc_.end()) {
+            return nullptr;
+        }
+        PerProcessIPC *ipc = iter->second;
+        if(ipc->data_region_ == nullptr || buf.region_id_ != ipc->data_region_id_ ||
+           buf.off_ > ipc->data_region_size_ || size > ipc->data_region_size_ - buf.off_) {
+            return nullptr;
+        }
+        return LABSTOR_REGION_ADD(buf.off_, ipc->data_region_);
+    }
+
     inline void GetQueuePair(labstor::queue_pair *&qp, labstor_qid_type_t type, labstor_qid_flags_t flags, int cnt) {
         auto &ipc = pid_to_ipc_[pid_];
         labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(type, flags, labstor::ThreadLocal::GetTid(), ipc->GetNumQueuePairsFast(0, flags), pid_);
@@ -193,8 +241,11 @@ public:
         return rq;
     }
 
-    std::unordered_map<uint32_t,PerProcessIPC*>& GetAllIPC() {
-        return pid_to_ipc_;
+    void GetAllIPC(std::vector<PerProcessIPC*> &ipcs) {
+        std::lock_guard<std::mutex> lock(lock_);
+        for(auto &pid_ipc : pid_to_ipc_) {
+            ipcs.emplace_back(pid_ipc.second);
+        }
     }
     inline PerProcessIPC* GetIPC(int pid) {
         return pid_to_ipc_[pid];
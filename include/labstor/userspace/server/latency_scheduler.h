@@ -0,0 +1,139 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_SERVER_LATENCY_SCHEDULER_H
+#define LABSTOR_SERVER_LATENCY_SCHEDULER_H
+
+#include <vector>
+#include <deque>
+#include <cstdint>
+
+/*Latency classes, in the order they are served*/
+#define LABSTOR_WORKER_LOW_LATENCY_CLASS 0
+#define LABSTOR_WORKER_HIGH_LATENCY_CLASS 1
+#define LABSTOR_WORKER_NUM_CLASSES 2
+/*Requests each latency class may process per pass*/
+#define LABSTOR_WORKER_LOW_LATENCY_BUDGET 256
+#define LABSTOR_WORKER_HIGH_LATENCY_BUDGET 32
+/*Requests a queue pair may process before the next queue pair of its class gets a turn*/
+#define LABSTOR_WORKER_QUANTUM 32
+
+namespace labstor::Server {
+
+/*
+ * Orders the queue pairs of a worker, identified by their work queue slot, by latency class.
+ *
+ * Each pass serves the classes in priority order. Within a class, queue pairs
+ * are visited round-robin and each processes at most one quantum per turn.
+ * The class earns its budget every pass (deficit round-robin), so a busy
+ * low-latency class can delay the high-latency class but never starve it.
+ *
+ * The scheduler is not thread-safe.
+ * */
+class LatencyScheduler {
+private:
+    std::deque<uint32_t> run_queue_[LABSTOR_WORKER_NUM_CLASSES];
+    std::vector<bool> queued_;
+    uint32_t class_budget_[LABSTOR_WORKER_NUM_CLASSES];
+    uint32_t deficit_[LABSTOR_WORKER_NUM_CLASSES];
+public:
+    LatencyScheduler() {
+        class_budget_[LABSTOR_WORKER_LOW_LATENCY_CLASS] = LABSTOR_WORKER_LOW_LATENCY_BUDGET;
+        class_budget_[LABSTOR_WORKER_HIGH_LATENCY_CLASS] = LABSTOR_WORKER_HIGH_LATENCY_BUDGET;
+        deficit_[LABSTOR_WORKER_LOW_LATENCY_CLASS] = 0;
+        deficit_[LABSTOR_WORKER_HIGH_LATENCY_CLASS] = 0;
+    }
+
+    inline void Resize(uint32_t max_slots) {
+        queued_.resize(max_slots, false);
+    }
+
+    inline void SetClassBudget(int latency_class, uint32_t budget) {
+        //A class with no budget would starve
+        class_budget_[latency_class] = budget ? budget : 1;
+    }
+
+    inline void Enqueue(int latency_class, uint32_t slot) {
+        if(queued_[slot]) { return; }
+        run_queue_[latency_class].push_back(slot);
+        queued_[slot] = true;
+    }
+
+    inline bool IsQueued(uint32_t slot) {
+        return queued_[slot];
+    }
+
+    inline bool IsEmpty() {
+        for(auto &run_queue : run_queue_) {
+            if(run_queue.size()) { return false; }
+        }
+        return true;
+    }
+
+    /*Forget every queued slot, e.g., after slots were renumbered*/
+    inline void Clear() {
+        for(auto &run_queue : run_queue_) {
+            for(uint32_t slot : run_queue) { queued_[slot] = false; }
+            run_queue.clear();
+        }
+    }
+
+    /*
+     * Give each queue pair of a class its turn, within the class's budget.
+     * process(slot, max_count, keep) processes at most max_count requests of the
+     * queue pair in slot and returns how many it did. It sets keep if the queue
+     * pair should get another turn without being enqueued again.
+     * */
+    template<typename ProcessFn>
+    uint32_t ProcessClass(int c, ProcessFn process) {
+        std::deque<uint32_t> &run_queue = run_queue_[c];
+        uint32_t num_processed = 0, num_turns = run_queue.size();
+        if(run_queue.empty()) {
+            deficit_[c] = 0;
+            return 0;
+        }
+        deficit_[c] += class_budget_[c];
+        if(deficit_[c] > 2*class_budget_[c]) { deficit_[c] = 2*class_budget_[c]; }
+        while(num_turns-- && deficit_[c] > 0) {
+            uint32_t slot = run_queue.front(), qp_processed;
+            bool keep = false;
+            run_queue.pop_front();
+            queued_[slot] = false;
+            qp_processed = process(slot, deficit_[c] < LABSTOR_WORKER_QUANTUM ? deficit_[c] : LABSTOR_WORKER_QUANTUM, keep);
+            deficit_[c] = qp_processed < deficit_[c] ? deficit_[c] - qp_processed : 0;
+            num_processed += qp_processed;
+            if(keep) {
+                run_queue.push_back(slot);
+                queued_[slot] = true;
+            }
+        }
+        return num_processed;
+    }
+};
+
+}
+
+#endif //LABSTOR_SERVER_LATENCY_SCHEDULER_H
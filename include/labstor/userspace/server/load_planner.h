@@ -0,0 +1,418 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_SERVER_LOAD_PLANNER_H
+#define LABSTOR_SERVER_LOAD_PLANNER_H
+
+#include <vector>
+#include <cstdint>
+#include "labstor/types/data_structures/c/shmem_queue_pair.h"
+
+/*Minimum difference in utilization between the busiest and idlest CPU before queue pairs are moved*/
+#define LABSTOR_WORK_ORCHESTRATOR_IMBALANCE 0.25
+/*Minimum reduction in the peak utilization of a CPU pair for a single migration to be worthwhile*/
+#define LABSTOR_WORK_BALANCER_MIN_GAIN 0.05
+/*Number of epochs a migrated queue pair must stay on its new worker*/
+#define LABSTOR_WORK_BALANCER_COOLDOWN 8
+/*Maximum number of queue pairs migrated per epoch*/
+#define LABSTOR_WORK_BALANCER_MAX_MIGRATIONS 4
+/*Weight of the newest sample in the smoothed queue pair utilization*/
+#define LABSTOR_WORK_BALANCER_EWMA 0.5
+/*Park a worker once the total load fits on one fewer worker at this utilization*/
+#define LABSTOR_WORK_BALANCER_PARK_UTIL 0.5
+/*Unpark a worker once the total load exceeds this utilization of the unparked workers*/
+#define LABSTOR_WORK_BALANCER_UNPARK_UTIL 0.75
+/*Number of consecutive epochs either condition must hold*/
+#define LABSTOR_WORK_BALANCER_SCALE_EPOCHS 64
+
+namespace labstor::Server {
+
+/*The load of a server worker, as of the last epoch*/
+struct WorkerLoad {
+    int cpu_id_;
+    uint32_t max_qps_;
+    uint32_t num_qps_;
+    /*Queue pairs moved onto (positive) or off of this worker by the migrations of the current epoch*/
+    int32_t num_planned_;
+    uint64_t busy_ns_;
+    uint64_t num_processed_;
+    double ns_per_req_;
+    double util_;
+    double overhead_;
+    bool parked_;
+    uint64_t num_estimated_;
+    uint64_t est_cpu_ns_;
+    uint64_t est_total_ns_;
+    double cpu_ns_per_req_;
+    double cpu_fraction_;
+    WorkerLoad(int cpu_id, uint32_t max_qps) :
+        cpu_id_(cpu_id), max_qps_(max_qps), num_qps_(0), num_planned_(0), busy_ns_(0), num_processed_(0), ns_per_req_(0), util_(0), overhead_(0), parked_(false),
+        num_estimated_(0), est_cpu_ns_(0), est_total_ns_(0), cpu_ns_per_req_(0), cpu_fraction_(0) {}
+};
+
+/*The load of a queue pair, as of the last epoch*/
+struct QueuePairLoad {
+    labstor_queue_pair *qp_;
+    int worker_id_;
+    uint32_t arrivals_;
+    uint32_t occupancy_;
+    double util_;
+    uint64_t cooldown_;
+    QueuePairLoad(labstor_queue_pair *qp, int worker_id) :
+        qp_(qp), worker_id_(worker_id), arrivals_(qp->GetNumArrivals()), occupancy_(0), util_(0), cooldown_(0) {}
+};
+
+struct QueuePairMigration {
+    labstor_queue_pair *qp_;
+    int src_worker_id_;
+    int dst_worker_id_;
+    QueuePairMigration(labstor_queue_pair *qp, int src, int dst) : qp_(qp), src_worker_id_(src), dst_worker_id_(dst) {}
+};
+
+/*
+ * Decides which worker each queue pair should be polled by.
+ *
+ * Every epoch, the caller samples the busy time of each worker and the
+ * arrival count and occupancy of each queue pair. The utilization of a
+ * queue pair is estimated as the work it submitted (arrivals plus backlog)
+ * times the per-request cost measured on its worker.
+ *
+ * Plan then repeatedly moves a queue pair from the busiest CPU to the idlest
+ * CPU, picking the one which minimizes the peak of the two. Workers pinned to
+ * the same CPU share its capacity, so they are treated as one unit.
+ *
+ * Hysteresis: nothing moves unless the CPUs differ by at least
+ * LABSTOR_WORK_ORCHESTRATOR_IMBALANCE, each move must lower the peak by
+ * LABSTOR_WORK_BALANCER_MIN_GAIN, and a migrated queue pair is pinned for
+ * LABSTOR_WORK_BALANCER_COOLDOWN epochs.
+ *
+ * Workers may drop a migration, e.g., when the destination is full, so a
+ * queue pair only counts on its new worker once the caller reports that it
+ * landed there with MoveQueuePair. Until then, the cooldown keeps it from
+ * being planned again.
+ *
+ * New queue pairs go to the least loaded CPU. Among the CPUs within
+ * LABSTOR_WORK_ORCHESTRATOR_IMBALANCE of it, latency-sensitive ones prefer the
+ * worker whose requests take the least CPU time, so they don't queue behind
+ * compute-heavy requests. High-latency ones prefer the worker whose requests
+ * spend the largest fraction of their time on the CPU, which keeps bulk work
+ * together and away from the latency-sensitive queue pairs.
+ *
+ * When elastic, the planner also parks a worker after the total load has been
+ * low for a sustained period, moving its queue pairs elsewhere so it can sleep,
+ * and unparks one after the load has been high for a sustained period.
+ *
+ * The planner is not thread-safe.
+ * */
+class LoadPlanner {
+private:
+    std::vector<WorkerLoad> workers_;
+    std::vector<QueuePairLoad> qps_;
+    std::vector<double> cpu_load_;
+    uint64_t epoch_;
+    bool elastic_;
+    uint32_t park_epochs_, unpark_epochs_;
+public:
+    LoadPlanner() : epoch_(0), elastic_(false), park_epochs_(0), unpark_epochs_(0) {}
+
+    inline void SetElastic(bool elastic) {
+        elastic_ = elastic;
+    }
+
+    inline void AddWorker(int cpu_id, uint32_t max_qps) {
+        workers_.emplace_back(cpu_id, max_qps);
+        if(cpu_id >= (int)cpu_load_.size()) {
+            cpu_load_.resize(cpu_id + 1, 0);
+        }
+    }
+
+    inline void AddQueuePair(labstor_queue_pair *qp, int worker_id) {
+        qps_.emplace_back(qp, worker_id);
+        ++workers_[worker_id].num_qps_;
+    }
+
+    /*
+     * Record that a queue pair now belongs to worker_id, e.g., once a migration
+     * landed. Returns the worker it belonged to before, or -1 if it is unknown.
+     * */
+    inline int MoveQueuePair(labstor_queue_pair *qp, int worker_id) {
+        for(auto &qp_load : qps_) {
+            if(qp_load.qp_ != qp) { continue; }
+            int src_worker_id = qp_load.worker_id_;
+            --workers_[src_worker_id].num_qps_;
+            ++workers_[worker_id].num_qps_;
+            qp_load.worker_id_ = worker_id;
+            return src_worker_id;
+        }
+        return -1;
+    }
+
+    inline void RemoveQueuePair(labstor_queue_pair *qp) {
+        for(size_t i = 0; i < qps_.size(); ++i) {
+            if(qps_[i].qp_ != qp) { continue; }
+            --workers_[qps_[i].worker_id_].num_qps_;
+            qps_[i] = qps_.back();
+            qps_.pop_back();
+            return;
+        }
+    }
+
+    inline void SampleWorker(int worker_id, uint64_t busy_ns, uint64_t num_processed, double elapsed_ns) {
+        WorkerLoad &worker = workers_[worker_id];
+        uint64_t busy = busy_ns - worker.busy_ns_;
+        uint64_t processed = num_processed - worker.num_processed_;
+        worker.util_ = busy / elapsed_ns;
+        if(processed) {
+            worker.ns_per_req_ = (double)busy / processed;
+        }
+        worker.busy_ns_ = busy_ns;
+        worker.num_processed_ = num_processed;
+    }
+
+    /*
+     * The CPU and total time of the requests the worker finished, as estimated
+     * by the cost models of their modules.
+     * */
+    inline void SampleWorkerCost(int worker_id, uint64_t num_estimated, uint64_t cpu_ns, uint64_t total_ns) {
+        WorkerLoad &worker = workers_[worker_id];
+        uint64_t estimated = num_estimated - worker.num_estimated_;
+        uint64_t cpu = cpu_ns - worker.est_cpu_ns_;
+        uint64_t total = total_ns - worker.est_total_ns_;
+        if(estimated) {
+            worker.cpu_ns_per_req_ = LABSTOR_WORK_BALANCER_EWMA*cpu/estimated + (1 - LABSTOR_WORK_BALANCER_EWMA)*worker.cpu_ns_per_req_;
+        }
+        if(total) {
+            double fraction = cpu < total ? (double)cpu/total : 1;
+            worker.cpu_fraction_ = LABSTOR_WORK_BALANCER_EWMA*fraction + (1 - LABSTOR_WORK_BALANCER_EWMA)*worker.cpu_fraction_;
+        }
+        worker.num_estimated_ = num_estimated;
+        worker.est_cpu_ns_ = cpu_ns;
+        worker.est_total_ns_ = total_ns;
+    }
+
+    inline void SampleQueuePairs(double elapsed_ns) {
+        double ns_per_req = GetMeanNsPerRequest();
+        for(auto &worker : workers_) {
+            worker.overhead_ = worker.util_;
+        }
+        for(auto &qp : qps_) {
+            WorkerLoad &worker = workers_[qp.worker_id_];
+            uint32_t arrivals = qp.qp_->GetNumArrivals();
+            double cost = worker.ns_per_req_ > 0 ? worker.ns_per_req_ : ns_per_req;
+            double util = (arrivals - qp.arrivals_ + qp.qp_->GetDepth()) * cost / elapsed_ns;
+            qp.util_ = LABSTOR_WORK_BALANCER_EWMA*util + (1 - LABSTOR_WORK_BALANCER_EWMA)*qp.util_;
+            qp.arrivals_ = arrivals;
+            qp.occupancy_ = qp.qp_->GetDepth();
+            worker.overhead_ -= qp.util_;
+        }
+        //Busy time which no queue pair accounts for, e.g., polling in-flight requests
+        for(auto &worker : workers_) {
+            if(worker.overhead_ < 0) { worker.overhead_ = 0; }
+        }
+    }
+
+    /*
+     * Compute the migrations for this epoch. They take effect in the planner
+     * once reported with MoveQueuePair.
+     * */
+    inline void Plan(std::vector<QueuePairMigration> &migrations) {
+        ++epoch_;
+        ComputeCpuLoad();
+        if(elastic_) {
+            Scale(migrations);
+        }
+        for(int m = 0; m < LABSTOR_WORK_BALANCER_MAX_MIGRATIONS; ++m) {
+            int src_cpu = -1, dst_cpu = -1;
+            for(auto &worker : workers_) {
+                int cpu = worker.cpu_id_;
+                if(src_cpu < 0 || cpu_load_[cpu] > cpu_load_[src_cpu]) { src_cpu = cpu; }
+                if(worker.parked_ || IsFull(worker)) { continue; }
+                if(dst_cpu < 0 || cpu_load_[cpu] < cpu_load_[dst_cpu]) { dst_cpu = cpu; }
+            }
+            if(src_cpu < 0 || dst_cpu < 0 || src_cpu == dst_cpu) { break; }
+            if(cpu_load_[src_cpu] - cpu_load_[dst_cpu] < LABSTOR_WORK_ORCHESTRATOR_IMBALANCE) { break; }
+
+            //Pick the queue pair which minimizes the peak of the two CPUs
+            int best = -1;
+            double best_peak = cpu_load_[src_cpu] - LABSTOR_WORK_BALANCER_MIN_GAIN;
+            for(size_t i = 0; i < qps_.size(); ++i) {
+                QueuePairLoad &qp = qps_[i];
+                if(workers_[qp.worker_id_].cpu_id_ != src_cpu || qp.cooldown_ > epoch_ || qp.util_ <= 0) { continue; }
+                double src_load = cpu_load_[src_cpu] - qp.util_;
+                double dst_load = cpu_load_[dst_cpu] + qp.util_;
+                double peak = src_load > dst_load ? src_load : dst_load;
+                if(peak < best_peak) {
+                    best_peak = peak;
+                    best = i;
+                }
+            }
+            if(best < 0) { break; }
+
+            Migrate(qps_[best], GetLeastLoadedWorker(dst_cpu), migrations);
+        }
+        for(auto &worker : workers_) {
+            worker.num_planned_ = 0;
+        }
+    }
+
+    /*
+     * The worker with spare capacity on the least loaded CPU, breaking ties by
+     * the number of queue pairs already assigned.
+     * */
+    inline int GetLeastLoadedWorker() {
+        ComputeCpuLoad();
+        return GetLeastLoadedWorker(-1);
+    }
+
+    /*
+     * The worker for a new queue pair with the given flags.
+     * */
+    inline int GetWorkerForQueuePair(uint32_t qp_flags) {
+        int least = GetLeastLoadedWorker(), best = least;
+        bool is_bulk = LABSTOR_QP_IS_HIGH_LATENCY(qp_flags);
+        if(least < 0) { return least; }
+        double max_load = cpu_load_[workers_[least].cpu_id_] + LABSTOR_WORK_ORCHESTRATOR_IMBALANCE;
+        for(size_t i = 0; i < workers_.size(); ++i) {
+            WorkerLoad &worker = workers_[i];
+            if(worker.parked_ || IsFull(worker) || cpu_load_[worker.cpu_id_] > max_load) { continue; }
+            if(is_bulk ? worker.cpu_fraction_ > workers_[best].cpu_fraction_ :
+                         worker.cpu_ns_per_req_ < workers_[best].cpu_ns_per_req_) {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    inline int GetNumWorkers() { return workers_.size(); }
+    inline bool IsParked(int worker_id) { return workers_[worker_id].parked_; }
+    inline const WorkerLoad& GetWorkerLoad(int worker_id) { return workers_[worker_id]; }
+    inline const std::vector<QueuePairLoad>& GetQueuePairLoad() { return qps_; }
+    inline double GetCpuLoad(int cpu_id) { return cpu_load_[cpu_id]; }
+    inline uint64_t GetEpoch() { return epoch_; }
+
+private:
+    inline void Migrate(QueuePairLoad &qp, int dst_worker_id, std::vector<QueuePairMigration> &migrations) {
+        migrations.emplace_back(qp.qp_, qp.worker_id_, dst_worker_id);
+        cpu_load_[workers_[qp.worker_id_].cpu_id_] -= qp.util_;
+        cpu_load_[workers_[dst_worker_id].cpu_id_] += qp.util_;
+        --workers_[qp.worker_id_].num_planned_;
+        ++workers_[dst_worker_id].num_planned_;
+        qp.cooldown_ = epoch_ + LABSTOR_WORK_BALANCER_COOLDOWN;
+    }
+
+    inline bool IsFull(WorkerLoad &worker) {
+        return (int64_t)worker.num_qps_ + worker.num_planned_ >= worker.max_qps_;
+    }
+
+    /*
+     * Park or unpark a worker once the total load has been low or high
+     * for LABSTOR_WORK_BALANCER_SCALE_EPOCHS epochs in a row.
+     * */
+    inline void Scale(std::vector<QueuePairMigration> &migrations) {
+        std::vector<double> load(workers_.size(), 0);
+        double total = 0;
+        int num_active = 0, idlest = -1, parked = -1;
+        for(size_t i = 0; i < workers_.size(); ++i) {
+            load[i] = workers_[i].overhead_;
+        }
+        for(auto &qp : qps_) {
+            load[qp.worker_id_] += qp.util_;
+        }
+        for(size_t i = 0; i < workers_.size(); ++i) {
+            if(workers_[i].parked_) {
+                parked = i;
+                continue;
+            }
+            total += load[i];
+            ++num_active;
+            if(idlest < 0 || load[i] < load[idlest]) { idlest = i; }
+        }
+        park_epochs_ = (num_active > 1 && total < (num_active - 1)*LABSTOR_WORK_BALANCER_PARK_UTIL) ? park_epochs_ + 1 : 0;
+        unpark_epochs_ = (parked >= 0 && total > num_active*LABSTOR_WORK_BALANCER_UNPARK_UTIL) ? unpark_epochs_ + 1 : 0;
+
+        //Unparked workers are filled by the regular balancing below
+        if(unpark_epochs_ >= LABSTOR_WORK_BALANCER_SCALE_EPOCHS) {
+            workers_[parked].parked_ = false;
+            unpark_epochs_ = 0;
+            return;
+        }
+        if(park_epochs_ < LABSTOR_WORK_BALANCER_SCALE_EPOCHS) { return; }
+        park_epochs_ = 0;
+
+        //Move every queue pair off of the idlest worker
+        workers_[idlest].parked_ = true;
+        for(auto &qp : qps_) {
+            if(qp.worker_id_ != idlest) { continue; }
+            int dst_worker_id = GetLeastLoadedWorker(-1);
+            if(dst_worker_id < 0) { break; }
+            Migrate(qp, dst_worker_id, migrations);
+        }
+        if((int64_t)workers_[idlest].num_qps_ + workers_[idlest].num_planned_ > 0) {
+            workers_[idlest].parked_ = false;
+        }
+    }
+
+    inline void ComputeCpuLoad() {
+        for(auto &load : cpu_load_) { load = 0; }
+        for(auto &worker : workers_) {
+            cpu_load_[worker.cpu_id_] += worker.overhead_;
+        }
+        for(auto &qp : qps_) {
+            cpu_load_[workers_[qp.worker_id_].cpu_id_] += qp.util_;
+        }
+    }
+
+    inline int GetLeastLoadedWorker(int cpu_id) {
+        int best = -1;
+        for(size_t i = 0; i < workers_.size(); ++i) {
+            WorkerLoad &worker = workers_[i];
+            if(worker.parked_ || IsFull(worker)) { continue; }
+            if(cpu_id >= 0 && worker.cpu_id_ != cpu_id) { continue; }
+            if(best < 0) { best = i; continue; }
+            double load = cpu_load_[worker.cpu_id_], best_load = cpu_load_[workers_[best].cpu_id_];
+            if(load < best_load || (load == best_load && worker.num_qps_ < workers_[best].num_qps_)) {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    inline double GetMeanNsPerRequest() {
+        double ns_per_req = 0;
+        int count = 0;
+        for(auto &worker : workers_) {
+            if(worker.ns_per_req_ > 0) {
+                ns_per_req += worker.ns_per_req_;
+                ++count;
+            }
+        }
+        return count ? ns_per_req / count : 0;
+    }
+};
+
+}
+
+#endif //LABSTOR_SERVER_LOAD_PLANNER_H
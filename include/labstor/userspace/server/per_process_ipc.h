@@ -32,6 +32,7 @@
 #include <labstor/userspace/util/errors.h>
 #include <labstor/userspace/types/queue_pool.h>
 #include <vector>
+#include <atomic>
 #include "labstor/userspace/types/memory_manager.h"
 
 namespace labstor::Server {
@@ -39,12 +40,25 @@ struct PerProcessIPC : public QueuePool, public MemoryManager {
     UnixSocket clisock_;
     labstor::credentials creds_;
     int region_id_;
+    /*The address range reserved for the region and the segments it may grow by*/
+    size_t reserved_size_;
+    std::vector<int> segment_ids_;
+    int data_region_id_;
+    void *data_region_;
+    uint64_t data_region_size_;
+    /*The queue pairs of this process which are polled by server workers*/
+    std::vector<labstor_queue_pair*> worker_qps_;
+    /*Set once registration finished reading from the socket*/
+    std::atomic<bool> is_ready_;
 
-    PerProcessIPC(int pid) {
+    PerProcessIPC(int pid) : reserved_size_(0), data_region_id_(LABSTOR_BUF_RAW), data_region_(nullptr), data_region_size_(0), is_ready_(false) {
         creds_.pid_ = pid;
     }
 
-    PerProcessIPC(int fd, labstor::credentials creds) : clisock_(fd), creds_(creds) {}
+    PerProcessIPC(int fd, labstor::credentials creds) : clisock_(fd), creds_(creds), reserved_size_(0), data_region_id_(LABSTOR_BUF_RAW), data_region_(nullptr), data_region_size_(0), is_ready_(false) {}
+
+    inline bool IsReady() { return is_ready_.load(std::memory_order_acquire); }
+    inline void SetReady() { is_ready_.store(true, std::memory_order_release); }
 
     inline UnixSocket &GetSocket() { return clisock_; };
 
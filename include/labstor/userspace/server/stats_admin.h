@@ -0,0 +1,96 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_SERVER_STATS_ADMIN_H
+#define LABSTOR_SERVER_STATS_ADMIN_H
+
+#include <mutex>
+#include <labstor/types/basics.h>
+#include <labstor/types/daemon.h>
+#include <labstor/userspace/util/stats.h>
+#include "labstor/types/data_structures/shmem_qtok.h"
+
+/*How often workers publish their statistics, by default*/
+#define LABSTOR_STATS_PERIOD_US 100000
+
+namespace labstor::Server {
+
+/*
+ * Owns the statistics region (see labstor::StatsHeader) and hands out its
+ * entries. The region is named LABSTOR_STATS_SHMEM_NAME and anyone may map it
+ * read-only, e.g., labstor_stat.
+ *
+ * Worker and module entries are only ever added, so their ids are stable for
+ * the life of the server. The entries of removed queue pairs are freed and
+ * reused. When the region runs out of entries, Add* returns -1 and the
+ * caller simply isn't tracked.
+ * */
+class StatsAdmin {
+private:
+    std::mutex lock_;
+    labstor::StatsHeader *header_;
+    uint32_t period_us_;
+public:
+    StatsAdmin() : header_(nullptr), period_us_(LABSTOR_STATS_PERIOD_US) {}
+    ~StatsAdmin();
+    void Create(uint32_t period_us);
+    int AddWorker(int worker_id, int cpu_id);
+    int AddQueuePair(labstor_qid_t qid, int worker_id);
+    void RemoveQueuePair(int id);
+    int AddModule(const labstor::id &module_id);
+    void SetUpdateTime(uint64_t ns);
+
+    inline bool IsEnabled() { return header_ != nullptr; }
+    inline uint32_t GetPeriodUs() { return period_us_; }
+
+    /*Called by the worker which owns the entry*/
+    inline void PublishWorker(int worker_id, const labstor::StatsCounters &counters, uint32_t num_qps) {
+        if(!header_ || worker_id < 0 || worker_id >= LABSTOR_STATS_MAX_WORKERS) { return; }
+        header_->workers_[worker_id].num_qps_.store(num_qps, std::memory_order_relaxed);
+        header_->workers_[worker_id].stats_.Publish(counters);
+    }
+    inline void PublishQueuePair(int id, int worker_id, const labstor::StatsCounters &counters) {
+        if(!header_ || id < 0) { return; }
+        header_->qps_[id].worker_id_.store(worker_id, std::memory_order_relaxed);
+        header_->qps_[id].stats_.Publish(counters);
+    }
+    inline void PublishModule(int worker_id, int id, const labstor::StatsCounters &counters) {
+        if(!header_ || id < 0 || worker_id < 0 || worker_id >= LABSTOR_STATS_MAX_WORKERS) { return; }
+        header_->module_stats_[worker_id][id].Publish(counters);
+    }
+};
+
+/*
+ * Periodically asks every server worker to publish its statistics.
+ * */
+class StatsWorker : public labstor::DaemonWorker {
+public:
+    void DoWork() override;
+};
+
+}
+
+#endif //LABSTOR_SERVER_STATS_ADMIN_H
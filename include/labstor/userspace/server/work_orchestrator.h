@@ -29,31 +29,78 @@
 
 #include <sys/sysinfo.h>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
 #include <labstor/userspace/server/worker.h>
+#include <labstor/userspace/server/load_planner.h>
+#include <labstor/userspace/server/stats_admin.h>
+#include <labstor/userspace/util/timer.h>
 #include "labstor/types/data_structures/c/shmem_queue_pair.h"
+#include "labstor/types/data_structures/c/shmem_active_queues.h"
 
 namespace labstor::Server {
 
+enum class WorkOrchestratorPolicy {
+    kRoundRobin,
+    kDynamic
+};
+
 class WorkOrchestrator {
 private:
     int pid_;
     int n_cpu_;
     pthread_t mapper_;
     std::unordered_map<pid_t, std::vector<std::shared_ptr<labstor::Daemon>>> worker_pool_;
+    std::vector<int> worker_cpus_;
     std::shared_ptr<labstor::Daemon> work_balancer_;
+    std::shared_ptr<labstor::Daemon> stats_worker_;
+    StatsAdmin stats_admin_;
+    uint32_t active_region_id_, active_region_size_;
+    labstor::ipc::active_queues_table *active_table_;
+    WorkOrchestratorPolicy policy_;
+    size_t time_slice_us_;
+    std::mutex planner_lock_;
+    LoadPlanner planner_;
+    PlacementCounters placement_;
+    labstor::HighResMonotonicTimer load_timer_;
 public:
     WorkOrchestrator() {
         pid_ = getpid();
         n_cpu_ = get_nprocs_conf();
+        policy_ = WorkOrchestratorPolicy::kRoundRobin;
+        time_slice_us_ = 1000;
+        active_table_ = nullptr;
     }
 
     inline int GetPID() { return pid_; }
     inline int GetNumCPU() { return n_cpu_; }
+    inline size_t GetTimeSliceUs() { return time_slice_us_; }
+    inline WorkOrchestratorPolicy GetPolicy() { return policy_; }
+    inline labstor::ipc::active_queues_table* GetActiveQueuesTable() { return active_table_; }
+    inline StatsAdmin& GetStatsAdmin() { return stats_admin_; }
+    inline void GetActiveQueuesRegion(uint32_t &region_id, uint32_t &region_size) {
+        region_id = active_region_id_;
+        region_size = active_region_size_;
+    }
     void CreateWorkers();
     void AssignQueuePair(labstor::ipc::shmem_queue_pair *qp, int worker_id=-1);
+    void MigrateQueuePair(labstor_queue_pair *qp, int src_worker_id, int dst_worker_id);
+    void RemoveQueuePairs(std::vector<labstor_queue_pair*> &qps);
+    void BalanceLoad();
+
+    inline int GetWorkerCPU(int worker_id) {
+        return worker_cpus_[worker_id];
+    }
+    inline int GetNumServerWorkers() {
+        return worker_pool_[pid_].size();
+    }
+    inline std::shared_ptr<labstor::Server::Worker> GetServerWorker(int worker_id) {
+        return std::dynamic_pointer_cast<labstor::Server::Worker>(worker_pool_[pid_][worker_id]->GetWorker());
+    }
+private:
+    void ApplyLandings();
 };
 
 }
@@ -30,45 +30,289 @@
 #ifdef __cplusplus
 
 #include <thread>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <deque>
 #include <labstor/userspace/util/errors.h>
+#include <labstor/userspace/util/timer.h>
 #include <labstor/userspace/server/macros.h>
 #include <labstor/userspace/server/namespace.h>
+#include <labstor/userspace/server/stats_admin.h>
+#include <labstor/userspace/server/latency_scheduler.h>
 #include <labstor/types/daemon.h>
+#include <labstor/types/continuation.h>
 #include "labstor/types/data_structures/c/shmem_work_queue_secure.h"
+#include "labstor/types/data_structures/c/shmem_active_queues.h"
+
+#define LABSTOR_WORKER_BATCH_SIZE 32
+#define LABSTOR_WORKER_MAX_INFLIGHT 256
+/*Number of passes between visits to every queue pair, for producers which can't ring the worker*/
+#define LABSTOR_WORKER_SWEEP_PERIOD 1024
+/*How long a worker without queue pairs (e.g., a parked worker) sleeps between checks*/
+#define LABSTOR_WORKER_PARKED_SLEEP_US 1000000
+
+/*One in this many requests is timed to train the cost models of modules*/
+#define LABSTOR_WORKER_COST_SAMPLE_PERIOD 16
 
 namespace labstor::Server {
 
+/*
+ * What a worker keeps about a request across the calls it takes to finish:
+ * its module's cost estimates, the time spent on it so far, if it is sampled,
+ * and the suspended handler, if the module wrote it as a coroutine.
+ * */
+struct RequestState {
+    labstor::ipc::request *rq_;
+    labstor::ipc::request hdr_;
+    bool sampled_;
+    size_t bytes_;
+    size_t est_cpu_ns_;
+    size_t est_total_ns_;
+    double start_ns_;
+    double cpu_ns_;
+    labstor::Continuation cont_;
+    RequestState() : rq_(nullptr), sampled_(false), bytes_(0), est_cpu_ns_(0), est_total_ns_(0), start_ns_(0), cpu_ns_(0) {}
+};
+
+/*The statistics of a queue pair, which move with it between workers*/
+struct QueuePairStats {
+    int id_;
+    labstor::StatsCounters counters_;
+    QueuePairStats() : id_(-1) {}
+};
+
+/*A request dequeued from a LABSTOR_QP_UNORDERED queue pair which is still being processed*/
+struct InflightRequest {
+    labstor_queue_pair *qp_struct_;
+    labstor::queue_pair *qp_;
+    labstor::ipc::request *rq_;
+    labstor::credentials *creds_;
+    labstor::Module *module_;
+    uint32_t slot_;
+    RequestState state_;
+    InflightRequest(labstor_queue_pair *qp_struct, labstor::queue_pair *qp, labstor::ipc::request *rq, labstor::credentials *creds, labstor::Module *module, uint32_t slot, RequestState &&state) :
+        qp_struct_(qp_struct), qp_(qp), rq_(rq), creds_(creds), module_(module), slot_(slot), state_(std::move(state)) {}
+};
+
+class Worker;
+
+enum class WorkerMessageType {
+    kAssignQP,
+    kMigrateQP,
+    kMigrateHottestQP,
+    kRemoveQP
+};
+
+/*A queue pair which a worker added to its work queue*/
+struct QueuePairLanding {
+    labstor_queue_pair *qp_;
+    int worker_id_;
+    QueuePairLanding(labstor_queue_pair *qp, int worker_id) : qp_(qp), worker_id_(worker_id) {}
+};
+
+/*
+ * Queue pairs posted to workers which they haven't applied yet, counted so the
+ * work orchestrator can tell when every queue pair sits in a work queue, and
+ * when a removal has taken effect. Workers also report where queue pairs
+ * land, since a migration may be dropped on the way.
+ * */
+struct PlacementCounters {
+    std::atomic<uint32_t> num_moving_;
+    std::atomic<uint32_t> num_removing_;
+    std::mutex landed_lock_;
+    std::vector<QueuePairLanding> landed_;
+    PlacementCounters() : num_moving_(0), num_removing_(0) {}
+    void Land(labstor_queue_pair *qp, int worker_id) {
+        std::lock_guard<std::mutex> lock(landed_lock_);
+        landed_.emplace_back(qp, worker_id);
+    }
+    void TakeLandings(std::vector<QueuePairLanding> &landed) {
+        std::lock_guard<std::mutex> lock(landed_lock_);
+        landed.swap(landed_);
+        landed_.clear();
+    }
+};
+
+/*
+ * Changes to the set of queue pairs a worker owns are posted to its mailbox
+ * and applied by the worker thread itself between passes. This way, a queue
+ * pair is never visited by two workers at once.
+ *
+ * Requests which are still in flight may wait on the private queue pairs of the
+ * worker which started them, so a queue pair only moves once it is quiescent.
+ * Until then, the source worker drains it: it finishes the requests it started,
+ * but admits no new ones. A queue pair which is removed drains the same way.
+ * */
+struct WorkerMessage {
+    WorkerMessageType type_;
+    labstor_queue_pair *qp_;
+    labstor::credentials *creds_;
+    Worker *dst_;
+    QueuePairStats stats_;
+    WorkerMessage(WorkerMessageType type, labstor_queue_pair *qp, labstor::credentials *creds, Worker *dst) :
+        type_(type), qp_(qp), creds_(creds), dst_(dst) {}
+};
+
 class Worker : public DaemonWorker {
 private:
     LABSTOR_NAMESPACE_T namespace_;
     void *region_;
     uint32_t id_;
     labstor::ipc::work_queue_secure work_queue_;
+    labstor::ipc::active_queues active_;
+    std::vector<uint64_t> qp_load_;
+    std::vector<RequestState> head_state_;
+    std::vector<QueuePairStats> qp_stats_;
+    /*Where a draining queue pair goes once it is quiescent: dst, or this worker if it is removed*/
+    std::vector<Worker*> drain_to_;
+    uint32_t num_draining_;
+    LatencyScheduler scheduler_;
+    uint32_t num_passes_;
+    bool did_work_;
 
     labstor_queue_pair *qp_struct;
     labstor::queue_pair *qp;
     labstor::ipc::request *rq;
+    labstor::ipc::request *rqs[LABSTOR_WORKER_BATCH_SIZE];
     labstor::credentials *creds;
     labstor::Module *module;
-    uint32_t work_queue_depth, qp_depth;
+    uint32_t work_queue_depth, qp_depth, batch_size, num_done;
+    std::vector<InflightRequest> inflight_;
     labstor::HighResCpuTimer t;
+    labstor::HighResMonotonicTimer clock_;
+    labstor::ThreadCpuTimer cpu_clock_;
+    uint32_t num_requests_;
+    /*Estimated costs of the requests finished in this pass, published when it ends*/
+    uint64_t pass_estimated_, pass_est_cpu_ns_, pass_est_total_ns_;
+
+    /*Statistics are counted here and copied to the statistics region on request*/
+    StatsAdmin *stats_admin_;
+    PlacementCounters *placement_;
+    labstor::StatsCounters stats_;
+    labstor::StatsCounters module_stats_[LABSTOR_STATS_MAX_MODULES + 1];
+    uint64_t module_mask_;
+    std::atomic<bool> publish_stats_;
+
+    std::mutex mailbox_lock_;
+    std::vector<WorkerMessage> mailbox_;
+    std::atomic<bool> has_mail_;
+    std::atomic<uint32_t> num_qps_;
+    std::atomic<uint64_t> num_processed_;
+    std::atomic<uint64_t> busy_ns_;
+    std::atomic<uint64_t> num_estimated_;
+    std::atomic<uint64_t> est_cpu_ns_;
+    std::atomic<uint64_t> est_total_ns_;
 public:
-    Worker(uint32_t depth, uint32_t id) {
+    Worker(uint32_t depth, uint32_t id, labstor::ipc::active_queues_table *active_table, StatsAdmin *stats_admin, PlacementCounters *placement) :
+        num_draining_(0), num_passes_(0), did_work_(true), num_requests_(0), pass_estimated_(0), pass_est_cpu_ns_(0), pass_est_total_ns_(0), stats_admin_(stats_admin), placement_(placement), module_mask_(0), publish_stats_(false), has_mail_(false), num_qps_(0), num_processed_(0), busy_ns_(0),
+        num_estimated_(0), est_cpu_ns_(0), est_total_ns_(0) {
         namespace_ = LABSTOR_NAMESPACE;
         id_ = id;
         uint32_t region_size = labstor::ipc::work_queue_secure::GetSize(depth);
         region_ = malloc(region_size);
         work_queue_.Init(region_, region_size, depth);
+        labstor_active_queues_table_Get(active_table, id, &active_);
+        qp_load_.resize(work_queue_.GetMaxDepth(), 0);
+        head_state_.resize(work_queue_.GetMaxDepth());
+        qp_stats_.resize(work_queue_.GetMaxDepth());
+        scheduler_.Resize(work_queue_.GetMaxDepth());
+        drain_to_.resize(work_queue_.GetMaxDepth(), nullptr);
+        inflight_.reserve(LABSTOR_WORKER_MAX_INFLIGHT);
     }
     void AssignQP(labstor_queue_pair *qp, labstor::credentials *creds) {
-        if(!work_queue_.Enqueue(qp, creds)) {
+        if(!ReserveQP()) {
             throw FAILED_TO_ASSIGN_QUEUE.format(qp->GetQID().pid_, id_);
         }
+        WorkerMessage msg(WorkerMessageType::kAssignQP, qp, creds, nullptr);
+        msg.stats_.id_ = stats_admin_->AddQueuePair(qp->GetQID(), id_);
+        placement_->num_moving_.fetch_add(1);
+        PostMessage(std::move(msg));
+    }
+    void MigrateQP(labstor_queue_pair *qp, Worker *dst) {
+        placement_->num_moving_.fetch_add(1);
+        PostMessage(WorkerMessage(WorkerMessageType::kMigrateQP, qp, nullptr, dst));
+    }
+    void MigrateHottestQP(Worker *dst) {
+        placement_->num_moving_.fetch_add(1);
+        PostMessage(WorkerMessage(WorkerMessageType::kMigrateHottestQP, nullptr, nullptr, dst));
+    }
+    /*The caller counts the removal in num_removing_, which drops once the queue pair is gone*/
+    void RemoveQP(labstor_queue_pair *qp) {
+        PostMessage(WorkerMessage(WorkerMessageType::kRemoveQP, qp, nullptr, nullptr));
+    }
+    uint32_t GetId() {
+        return id_;
+    }
+    /*Ask the worker to publish its statistics on its next pass*/
+    void RequestStats() {
+        publish_stats_.store(true, std::memory_order_release);
+        active_.GetDoorbell()->Ring();
+    }
+    void SetClassBudget(int latency_class, uint32_t budget) {
+        scheduler_.SetClassBudget(latency_class, budget);
     }
     uint32_t GetQueueDepth() {
         return work_queue_.GetDepth();
     }
-    void DoWork();
+    uint32_t GetNumQueuePairs() {
+        return num_qps_.load(std::memory_order_relaxed);
+    }
+    uint32_t GetMaxQueuePairs() {
+        return work_queue_.GetMaxDepth();
+    }
+    uint32_t GetNumInflight() {
+        return inflight_.size();
+    }
+    uint64_t GetNumProcessed() {
+        return num_processed_.load(std::memory_order_relaxed);
+    }
+    uint64_t GetBusyNsec() {
+        return busy_ns_.load(std::memory_order_relaxed);
+    }
+    uint64_t GetNumEstimated() {
+        return num_estimated_.load(std::memory_order_relaxed);
+    }
+    uint64_t GetEstCpuNsec() {
+        return est_cpu_ns_.load(std::memory_order_relaxed);
+    }
+    uint64_t GetEstTotalNsec() {
+        return est_total_ns_.load(std::memory_order_relaxed);
+    }
+    void DoWork() override;
+    bool DidWork() override {
+        return did_work_;
+    }
+    void WaitForWork(uint32_t max_us) override;
+private:
+    bool ReserveQP() {
+        uint32_t num_qps = num_qps_.load(std::memory_order_relaxed);
+        do {
+            if(num_qps >= work_queue_.GetMaxDepth()) { return false; }
+        } while(!num_qps_.compare_exchange_weak(num_qps, num_qps + 1));
+        return true;
+    }
+    void PostMessage(WorkerMessage &&msg) {
+        std::lock_guard<std::mutex> lock(mailbox_lock_);
+        mailbox_.emplace_back(std::move(msg));
+        has_mail_.store(true, std::memory_order_release);
+        active_.GetDoorbell()->Ring();
+    }
+    void ProcessMail();
+    void MigrateSlot(uint32_t i, Worker *dst);
+    bool IsQuiescent(uint32_t i);
+    void FinishDrains();
+    void ReleaseQP(uint32_t i, Worker *dst);
+    void RemoveSlot(uint32_t i);
+    void ActivateQP(uint32_t i);
+    void PublishStats();
+    labstor::StatsCounters& GetModuleStats(labstor::Module *module);
+    void CollectActive();
+    uint32_t ProcessClass(int c);
+    bool RunRequest(labstor::Module *module, labstor::queue_pair *qp, labstor::ipc::request *rq, labstor::credentials *creds, RequestState &state, labstor::StatsCounters &qp_stats);
+    uint32_t ProcessOrdered(uint32_t i, uint32_t max_count);
+    uint32_t ProcessUnordered(uint32_t i, uint32_t max_count);
+    uint32_t PollInflight();
 };
 
 }
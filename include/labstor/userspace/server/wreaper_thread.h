@@ -37,28 +37,36 @@ namespace labstor::Server {
 class WreaperWorker : public DaemonWorker {
 private:
     LABSTOR_IPC_MANAGER_T ipc_manager_;
+    std::vector<PerProcessIPC*> ipcs_;
 public:
     WreaperWorker() {
         ipc_manager_ = LABSTOR_IPC_MANAGER;
     }
 
+    /*
+     * Check each client for a disconnect or an admin request sent after registration.
+     * Clients which are still registering are skipped, since the accept thread reads
+     * their socket. Only this thread unregisters processes, so the snapshot stays valid.
+     * */
     void DoWork() override {
-        int op;
-        auto &ipcs = ipc_manager_->GetAllIPC();
-        for(auto iter = ipcs.begin(); iter != ipcs.end();) {
+        ipcs_.clear();
+        ipc_manager_->GetAllIPC(ipcs_);
+        for(PerProcessIPC *ipc : ipcs_) {
             LABSTOR_ERROR_HANDLE_TRY {
                 labstor::ipc::admin_request header;
-                PerProcessIPC *ipc = iter->second;
-                if(ipc->GetPID() == ipc_manager_->GetPID()) { continue; }
-                if(ipc->GetPID() == 0) { continue; }
+                if(ipc->GetPID() == ipc_manager_->GetPID() || ipc->GetPID() == KERNEL_PID || !ipc->IsReady()) {
+                    continue;
+                }
                 if(!ipc->GetSocket().RecvMSGPeek(&header, sizeof(header), false)) {
                     continue;
                 }
-                ++iter;
+                if(header.op_ == labstor::ipc::LABSTOR_ADMIN_GROW_REGION) {
+                    ipc->GetSocket().RecvMSG(&header, sizeof(header));
+                    ipc_manager_->GrowClientRegion(ipc);
+                }
             } LABSTOR_ERROR_HANDLE_CATCH {
-                printf("PID %d disconnected\n", iter->first);
-                delete iter->second;
-                iter = ipcs.erase(iter);
+                printf("PID %d disconnected\n", ipc->GetPID());
+                ipc_manager_->UnregisterIPC(ipc);
             }
         }
     }
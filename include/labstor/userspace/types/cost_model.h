@@ -0,0 +1,114 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_COST_MODEL_H
+#define LABSTOR_COST_MODEL_H
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+/*Number of ops with their own estimate; larger op codes share the last one*/
+#define LABSTOR_COST_MODEL_MAX_OPS 64
+/*Weight of the newest sample in the running mean and variance*/
+#define LABSTOR_COST_MODEL_ALPHA 0.125
+
+namespace labstor {
+
+/*
+ * An exponentially-weighted running mean and variance of a time measurement.
+ *
+ * Several workers may reinforce the same estimate at once. Updates are not
+ * serialized, so a concurrent sample can occasionally be lost, which does not
+ * matter for an estimate.
+ * */
+class CostEstimate {
+private:
+    std::atomic<double> mean_;
+    std::atomic<double> var_;
+    std::atomic<uint64_t> count_;
+public:
+    CostEstimate() : mean_(0), var_(0), count_(0) {}
+
+    inline void Reinforce(double sample) {
+        uint64_t count = count_.load(std::memory_order_relaxed);
+        double mean = mean_.load(std::memory_order_relaxed);
+        double var = var_.load(std::memory_order_relaxed);
+        if(count == 0) {
+            mean = sample;
+            var = 0;
+        } else {
+            double diff = sample - mean;
+            mean += LABSTOR_COST_MODEL_ALPHA*diff;
+            var = (1 - LABSTOR_COST_MODEL_ALPHA)*(var + LABSTOR_COST_MODEL_ALPHA*diff*diff);
+        }
+        mean_.store(mean, std::memory_order_relaxed);
+        var_.store(var, std::memory_order_relaxed);
+        count_.store(count + 1, std::memory_order_relaxed);
+    }
+
+    inline double GetMean() { return mean_.load(std::memory_order_relaxed); }
+    inline double GetVariance() { return var_.load(std::memory_order_relaxed); }
+    inline double GetStdDev() { return sqrt(GetVariance()); }
+    inline uint64_t GetCount() { return count_.load(std::memory_order_relaxed); }
+};
+
+/*
+ * The CPU time and total (wall) time of each op of a module.
+ * The CPU time is what the request costs the worker; the rest of the
+ * total time is spent waiting, e.g., for a device.
+ * */
+class CostModel {
+private:
+    CostEstimate cpu_[LABSTOR_COST_MODEL_MAX_OPS];
+    CostEstimate total_[LABSTOR_COST_MODEL_MAX_OPS];
+public:
+    inline void ReinforceCpuTime(uint16_t op, size_t time_ns) {
+        GetCpuTime(op).Reinforce(time_ns);
+    }
+    inline void ReinforceTotalTime(uint16_t op, size_t time_ns) {
+        GetTotalTime(op).Reinforce(time_ns);
+    }
+    inline size_t EstCpuTime(uint16_t op, size_t default_ns) {
+        CostEstimate &est = GetCpuTime(op);
+        return est.GetCount() ? (size_t)est.GetMean() : default_ns;
+    }
+    inline size_t EstTotalTime(uint16_t op, size_t default_ns) {
+        CostEstimate &est = GetTotalTime(op);
+        return est.GetCount() ? (size_t)est.GetMean() : default_ns;
+    }
+    inline CostEstimate& GetCpuTime(uint16_t op) {
+        return cpu_[op < LABSTOR_COST_MODEL_MAX_OPS ? op : LABSTOR_COST_MODEL_MAX_OPS - 1];
+    }
+    inline CostEstimate& GetTotalTime(uint16_t op) {
+        return total_[op < LABSTOR_COST_MODEL_MAX_OPS ? op : LABSTOR_COST_MODEL_MAX_OPS - 1];
+    }
+};
+
+}
+
+#endif //LABSTOR_COST_MODEL_H
@@ -29,6 +29,8 @@
 
 #include <labstor/types/allocator/allocator.h>
 #include <labstor/types/allocator/segment_allocator.h>
+#include <labstor/types/allocator/slab_allocator.h>
+#include <labstor/types/data_structures/shmem_buffer.h>
 #include "labstor/types/data_structures/c/shmem_queue_pair.h"
 
 namespace labstor {
@@ -38,7 +40,11 @@ private:
     labstor::GenericAllocator *private_alloc_;
     labstor::GenericAllocator *shmem_alloc_;
     labstor::segment_allocator *qp_alloc_;
+    labstor::ipc::slab_allocator *data_alloc_;
+    int data_region_id_;
 public:
+    MemoryManager() : data_alloc_(nullptr), data_region_id_(LABSTOR_BUF_RAW) {}
+    virtual ~MemoryManager() = default;
     void SetPrivateAlloc(labstor::GenericAllocator *private_alloc) {
         private_alloc_ = private_alloc;
     }
@@ -48,6 +54,17 @@ public:
     void SetQueueAlloc(labstor::segment_allocator *qp_alloc) {
         qp_alloc_ = qp_alloc;
     }
+    void SetDataAlloc(labstor::ipc::slab_allocator *data_alloc, int region_id) {
+        data_alloc_ = data_alloc;
+        data_region_id_ = region_id;
+    }
+    /*
+     * Called when the SHMEM request allocator has no room for a request of this
+     * size. Returns true if more memory was added and the allocation may be retried.
+     * */
+    virtual bool GrowShmem(uint32_t size) {
+        return false;
+    }
     void *GetRegion(labstor_qid_flags_t flags) {
         if(LABSTOR_QP_IS_SHMEM(flags)) {
             return shmem_alloc_->GetRegion();
@@ -65,10 +82,19 @@ public:
         return reinterpret_cast<T*>(private_alloc_->Alloc(size));
     }
 
+    /*
+     * Size is the total size of the request, i.e., sizeof(T) plus any payload
+     * stored after it. Request regions are slab allocators, which hand out an
+     * object from the smallest size class that fits.
+     * */
     template<typename T>
     inline T* AllocRequest(labstor_qid_flags_t flags, uint32_t size) {
         if(LABSTOR_QP_IS_SHMEM(flags)) {
-            return reinterpret_cast<T*>(shmem_alloc_->Alloc(size, labstor::ThreadLocal::GetTid()));
+            T *rq = reinterpret_cast<T*>(shmem_alloc_->Alloc(size, labstor::ThreadLocal::GetTid()));
+            while(rq == nullptr && GrowShmem(size)) {
+                rq = reinterpret_cast<T*>(shmem_alloc_->Alloc(size, labstor::ThreadLocal::GetTid()));
+            }
+            return rq;
         } else {
             return reinterpret_cast<T*>(private_alloc_->Alloc(size, labstor::ThreadLocal::GetTid()));
         }
@@ -86,6 +112,34 @@ public:
         return AllocRequest<T>(qp->GetQID(), sizeof(T));
     }
 
+    /*
+     * I/O payloads allocated from the data buffer pool are shared with the
+     * server and the kernel, so requests can reference them by offset and be
+     * served in place. Returns nullptr if there is no pool or no room in it.
+     * */
+    inline void* AllocBuffer(size_t size) {
+        if(data_alloc_ == nullptr || size > data_alloc_->GetMaxSize()) {
+            return nullptr;
+        }
+        return data_alloc_->Alloc(size, labstor::ThreadLocal::GetTid());
+    }
+    inline void FreeBuffer(void *buf) {
+        data_alloc_->Free(buf);
+    }
+    inline bool IsBuffer(void *buf) {
+        return data_alloc_ != nullptr &&
+            buf >= data_alloc_->GetRegion() && buf < LABSTOR_REGION_ADD(data_alloc_->GetSize(), data_alloc_->GetRegion());
+    }
+    inline uint32_t GetMaxBufferSize() {
+        return data_alloc_ ? data_alloc_->GetMaxSize() : 0;
+    }
+    inline labstor::ipc::buf_ref GetBufferRef(void *buf) {
+        if(IsBuffer(buf)) {
+            return labstor::ipc::buf_ref::Shmem(data_region_id_, LABSTOR_REGION_SUB(buf, data_alloc_->GetRegion()));
+        }
+        return labstor::ipc::buf_ref::Raw(buf);
+    }
+
     template<typename T>
     inline void FreeRequest(labstor_qid_flags_t flags, T *rq) {
         if(LABSTOR_QP_IS_SHMEM(flags)) {
@@ -33,7 +33,8 @@
 namespace labstor::ipc {
 
 enum {
-    LABSTOR_ADMIN_REGISTER_QP
+    LABSTOR_ADMIN_REGISTER_QP,
+    LABSTOR_ADMIN_GROW_REGION
 };
 
 struct admin_request {
@@ -56,9 +57,17 @@ struct setup_reply : public admin_reply {
     uint32_t queue_region_size_;
     uint32_t queue_depth_;
     uint32_t num_queues_;
+    uint32_t num_high_latency_queues_;
     uint32_t namespace_region_id_;
     uint32_t namespace_region_size_;
     uint32_t namespace_max_entries_;
+    uint32_t active_region_id_;
+    uint32_t active_region_size_;
+    uint32_t max_segments_;
+    uint32_t wait_policy_;
+    uint32_t wait_spin_us_;
+    int32_t data_region_id_;
+    uint32_t data_region_size_;
 };
 
 struct register_qp_request : public labstor::ipc::admin_request {
@@ -72,6 +81,20 @@ struct register_qp_request : public labstor::ipc::admin_request {
 };
 typedef admin_reply register_qp_reply;
 
+/*
+ * Ask the server for another segment of the client's region. Segment i is
+ * mapped i*region_size bytes after the start of the region in both processes.
+ * */
+typedef admin_request grow_region_request;
+
+struct grow_region_reply : public admin_reply {
+    uint32_t region_id_;
+    uint32_t segment_;
+    uint32_t size_;
+    grow_region_reply() {}
+    grow_region_reply(int code) : admin_reply(code), region_id_(0), segment_(0), size_(0) {}
+};
+
 struct poll_request : public labstor::ipc::request {
     labstor::ipc::qtok_t qtok_;
     labstor::ipc::qtok_t *qtoks_;
@@ -36,6 +36,7 @@
 #include "labstor/types/data_structures/c/shmem_queue_pair.h"
 #include "registrar.h"
 #include <labstor/userspace/util/errors.h>
+#include <labstor/userspace/types/cost_model.h>
 #include <list>
 #include <yaml-cpp/yaml.h>
 
@@ -63,20 +64,32 @@ class Module {
 protected:
     labstor::id module_id_;
     uint32_t ns_id_;
+    labstor::CostModel cost_model_;
+    std::atomic<int> stats_id_;
 public:
-    Module(labstor::id module_id) : module_id_(module_id), ns_id_(0) {}
+    Module(labstor::id module_id) : module_id_(module_id), ns_id_(0), stats_id_(-1) {}
     inline labstor::id GetModuleID() { return module_id_; }
     void SetNamespaceID(uint32_t ns_id) { ns_id_ = ns_id; }
     uint32_t GetNamespaceID() { return ns_id_; }
+    /*The entry of this module in the statistics region, or -1 if it has none yet*/
+    inline int GetStatsID() { return stats_id_.load(std::memory_order_relaxed); }
+    inline void SetStatsID(int stats_id) { stats_id_.store(stats_id, std::memory_order_relaxed); }
     virtual bool Initialize(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) = 0;
 
+    /*
+     * Workers report the time of sampled requests and sum the estimates of every
+     * request for the load planner. By default, each op keeps a running mean and variance.
+     * */
     virtual void ReinforceCpuTime(
-            labstor::ipc::request *request, size_t time_measure_ns) {};
+            labstor::ipc::request *request, size_t time_measure_ns) { cost_model_.ReinforceCpuTime(request->GetOp(), time_measure_ns); };
     virtual void ReinforceTotalTime(
-            labstor::ipc::request *request, size_t time_measure_ns) {};
+            labstor::ipc::request *request, size_t time_measure_ns) { cost_model_.ReinforceTotalTime(request->GetOp(), time_measure_ns); };
     virtual size_t EstCpuTime(
-            labstor::ipc::request *request) { return 1; };
+            labstor::ipc::request *request) { return cost_model_.EstCpuTime(request->GetOp(), 1); };
     virtual size_t EstTotalTime(
+            labstor::ipc::request *request) { return cost_model_.EstTotalTime(request->GetOp(), 0); };
+    /*The bytes of data a request moves, for statistics*/
+    virtual size_t GetRequestSize(
             labstor::ipc::request *request) { return 0; };
     virtual bool ProcessRequest(
             labstor::queue_pair *qp,
@@ -35,7 +35,7 @@
 #include <labstor/types/basics.h>
 #include <labstor/userspace/types/module.h>
 #include <labstor/types/allocator/shmem_allocator.h>
-#include "labstor/types/data_structures/shmem_ring_buffer.h"
+#include "labstor/types/data_structures/shmem_lockless_ring_buffer.h"
 #include <labstor/types/data_structures/unordered_map/shmem_string_map.h>
 #include <labstor/types/data_structures/shmem_string.h>
 
@@ -50,7 +50,7 @@ protected:
     uint32_t max_entries_;
 
     std::unordered_map<labstor::id, std::queue<labstor::Module*>> module_id_to_instance_;
-    labstor::ipc::mpmc::ring_buffer<uint32_t> ns_ids_;
+    labstor::ipc::mpmc::lockless_ring_buffer<uint32_t> ns_ids_;
     labstor::ipc::mpmc::string_map key_to_ns_id_;
     std::vector<labstor::Module*> private_state_;
 public:
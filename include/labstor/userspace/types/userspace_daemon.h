@@ -30,19 +30,41 @@
 #include <labstor/types/daemon.h>
 #include <labstor/userspace/util/errors.h>
 #include <labstor/userspace/util/timer.h>
+#include <labstor/constants/macros.h>
 #include <sys/sysinfo.h>
 #include <sched.h>
 #include <thread>
 #include <future>
 #include <chrono>
 
+#define LABSTOR_DAEMON_IDLE_SPIN_US 50
+#define LABSTOR_DAEMON_IDLE_PAUSE_US 200
+#define LABSTOR_DAEMON_IDLE_SLEEP_US 1000
+#define LABSTOR_DAEMON_IDLE_POLLS_PER_CLOCK 64
+
 namespace labstor {
 
+/*
+ * How a daemon backs off once its worker runs out of work: it keeps polling for
+ * spin_us_, then yields the CPU between polls for pause_us_, and then lets the
+ * worker block for up to sleep_us_ at a time until work is signaled.
+ * */
+struct DaemonIdlePolicy {
+    uint32_t spin_us_;
+    uint32_t pause_us_;
+    uint32_t sleep_us_;
+    DaemonIdlePolicy() :
+        spin_us_(LABSTOR_DAEMON_IDLE_SPIN_US), pause_us_(LABSTOR_DAEMON_IDLE_PAUSE_US), sleep_us_(LABSTOR_DAEMON_IDLE_SLEEP_US) {}
+    DaemonIdlePolicy(uint32_t spin_us, uint32_t pause_us, uint32_t sleep_us) :
+        spin_us_(spin_us), pause_us_(pause_us), sleep_us_(sleep_us) {}
+};
+
 class UserspaceDaemon : public Daemon {
 private:
     std::thread thread_;
     bool continue_work_;
     std::atomic<bool> started_;
+    DaemonIdlePolicy idle_;
 public:
     void Start() override {
         continue_work_ = true;
@@ -82,15 +104,41 @@ public:
         affinity_ = cpu_id;
     }
 
+    void SetIdlePolicy(const DaemonIdlePolicy &idle) {
+        idle_ = idle;
+    }
+
     bool ShouldContinue() {
         return continue_work_;
     }
 
 private:
     static void daemon_thread(UserspaceDaemon *daemon, std::shared_ptr<DaemonWorker> worker) {
+        labstor::HighResMonotonicTimer t;
+        const DaemonIdlePolicy &idle = daemon->idle_;
+        double pause_ns = idle.spin_us_*1000.0, sleep_ns = (idle.spin_us_ + idle.pause_us_)*1000.0;
+        double idle_ns = 0;
+        uint32_t num_idle = 0;
         daemon->SetStarted();
         while(daemon->ShouldContinue()) {
             worker->DoWork();
+            if(worker->DidWork()) {
+                num_idle = 0;
+                continue;
+            }
+            if(num_idle++ == 0) {
+                idle_ns = 0;
+                t.Resume();
+                continue;
+            }
+            if(num_idle % LABSTOR_DAEMON_IDLE_POLLS_PER_CLOCK == 0) {
+                idle_ns = t.GetNsecFromStart();
+            }
+            if(idle_ns >= sleep_ns) {
+                worker->WaitForWork(idle.sleep_us_);
+            } else if(idle_ns >= pause_ns) {
+                LABSTOR_YIELD();
+            }
         }
     }
 
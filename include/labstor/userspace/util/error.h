@@ -54,7 +54,7 @@ namespace labstor {
         Error(int code, const std::string &fmt) : code_(code), fmt_(fmt) {}
         ~Error() {}
 
-        int get_code() { return code_; }
+        int get_code() const { return code_; }
 
         template<typename ...Args>
         std::shared_ptr<Error> format(Args ...args) const {
@@ -60,6 +60,12 @@ namespace labstor {
     const Error INVALID_REGION_SUB(303, "The pointer {} exists outside of {}");
 
     const Error SHMEM_CREATE_FAILED(400, "Failed to allocate SHMEM");
+    const Error STATS_REGION_CREATE_FAILED(401, "Failed to create the statistics region: {}");
+    const Error INVALID_PAGE_SIZE(402, "Invalid page size {}, expected 4K, 2M_THP, 2M or 1G");
+    const Error REGION_MAP_FAILED(403, "Failed to map a region of {} bytes: {}");
+    const Error INVALID_SLAB_SEGMENT(404, "Cannot add a segment of {} bytes at offset {} to the slab allocator");
+    const Error REGION_GROW_FAILED(405, "Failed to grow the shared region of pid {}: {}");
+    const Error INVALID_WAIT_POLICY(406, "Invalid wait policy {}, expected poll or adaptive");
 
     const Error INVALID_MODULE_ID(500, "Failed to find module {}");
     const Error INVALID_NAMESPACE_ENTRY(501, "Failed to find namespace entry {}");
@@ -0,0 +1,217 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_PAGES_H
+#define LABSTOR_PAGES_H
+
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <labstor/userspace/util/errors.h>
+
+/*Largest NUMA node ID the placement helpers handle*/
+#define LABSTOR_PAGES_MAX_NODES 64
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+namespace labstor {
+
+/*
+ * The pages backing a region: ordinary 4K pages, 2M transparent huge pages,
+ * or 2M / 1G pages reserved through hugetlbfs.
+ * */
+enum class PageSize {
+    k4K,
+    k2M_THP,
+    k2M,
+    k1G
+};
+
+/*
+ * Maps anonymous regions with a given page size and places memory on NUMA
+ * nodes. Only regions this process maps itself can use huge pages; regions
+ * handed out by the shmem kernel module are always backed by 4K pages.
+ * */
+class Pages {
+public:
+    static inline PageSize Parse(const std::string &str) {
+        if(str == "4K") { return PageSize::k4K; }
+        if(str == "2M_THP") { return PageSize::k2M_THP; }
+        if(str == "2M") { return PageSize::k2M; }
+        if(str == "1G") { return PageSize::k1G; }
+        throw INVALID_PAGE_SIZE.format(str);
+    }
+
+    static inline const char* ToString(PageSize page_size) {
+        switch(page_size) {
+            case PageSize::k4K: return "4K";
+            case PageSize::k2M_THP: return "2M_THP";
+            case PageSize::k2M: return "2M";
+            case PageSize::k1G: return "1G";
+        }
+        return "4K";
+    }
+
+    static inline size_t GetBytes(PageSize page_size) {
+        switch(page_size) {
+            case PageSize::k4K: return getpagesize();
+            case PageSize::k2M_THP:
+            case PageSize::k2M: return 2ul << 20;
+            case PageSize::k1G: return 1ul << 30;
+        }
+        return getpagesize();
+    }
+
+    static inline size_t RoundUp(size_t size, PageSize page_size) {
+        size_t bytes = GetBytes(page_size);
+        return (size + bytes - 1) / bytes * bytes;
+    }
+
+    /*
+     * Map a private anonymous region. If the huge pages can't be reserved, fall
+     * back to 4K pages; page_size is updated to what was actually mapped.
+     * */
+    static inline void* Map(size_t size, PageSize &page_size) {
+        void *region = MAP_FAILED;
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+        if(page_size == PageSize::k2M || page_size == PageSize::k1G) {
+            int huge = page_size == PageSize::k2M ? MAP_HUGE_2MB : MAP_HUGE_1GB;
+            region = mmap(nullptr, RoundUp(size, page_size), PROT_READ | PROT_WRITE, flags | MAP_HUGETLB | huge, -1, 0);
+            if(region == MAP_FAILED) {
+                page_size = PageSize::k4K;
+            }
+        }
+        if(region == MAP_FAILED) {
+            region = mmap(nullptr, RoundUp(size, page_size), PROT_READ | PROT_WRITE, flags, -1, 0);
+        }
+        if(region == MAP_FAILED) {
+            throw REGION_MAP_FAILED.format(size, strerror(errno));
+        }
+        if(page_size == PageSize::k2M_THP && madvise(region, RoundUp(size, page_size), MADV_HUGEPAGE) < 0) {
+            page_size = PageSize::k4K;
+        }
+        return region;
+    }
+
+    static inline void Unmap(void *region, size_t size, PageSize page_size) {
+        munmap(region, RoundUp(size, page_size));
+    }
+
+    /*
+     * Reserve address space without backing it, so regions can be mapped into it later with MAP_FIXED.
+     * */
+    static inline void* Reserve(size_t size) {
+        void *region = mmap(nullptr, RoundUp(size, PageSize::k4K), PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if(region == MAP_FAILED) {
+            throw REGION_MAP_FAILED.format(size, strerror(errno));
+        }
+        return region;
+    }
+
+    /*
+     * Move the pages which lie entirely within [addr, addr+size) to a node.
+     * Returns false if the range holds no whole page or the kernel refused.
+     * */
+    static inline bool Bind(void *addr, size_t size, int node, PageSize page_size) {
+        size_t bytes = GetBytes(page_size);
+        size_t start = ((size_t)addr + bytes - 1) / bytes * bytes;
+        size_t end = ((size_t)addr + size) / bytes * bytes;
+        unsigned long mask[(LABSTOR_PAGES_MAX_NODES + 63) / 64] = {0};
+        if(node < 0 || node >= LABSTOR_PAGES_MAX_NODES || end <= start) {
+            return false;
+        }
+        mask[node / 64] = 1ul << (node % 64);
+        return syscall(SYS_mbind, start, end - start, MPOL_BIND, mask, LABSTOR_PAGES_MAX_NODES + 1, MPOL_MF_MOVE) == 0;
+    }
+
+    static inline int GetNumNodes() {
+        int num_nodes = 0;
+        char path[64];
+        while(num_nodes < LABSTOR_PAGES_MAX_NODES) {
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", num_nodes);
+            if(access(path, F_OK) != 0) { break; }
+            ++num_nodes;
+        }
+        return num_nodes ? num_nodes : 1;
+    }
+
+    /*The NUMA node of a CPU, or 0 if the system doesn't say*/
+    static inline int GetCpuNode(int cpu) {
+        char path[64];
+        struct dirent *entry;
+        int node = 0;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+        DIR *dir = opendir(path);
+        if(dir == nullptr) { return 0; }
+        while((entry = readdir(dir)) != nullptr) {
+            if(sscanf(entry->d_name, "node%d", &node) == 1) { break; }
+        }
+        closedir(dir);
+        return node;
+    }
+
+    /*The NUMA node of the CPU a process last ran on, or -1 if unknown*/
+    static inline int GetProcessNode(pid_t pid) {
+        char path[64], buf[1024];
+        snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+        FILE *file = fopen(path, "r");
+        if(file == nullptr) { return -1; }
+        size_t len = fread(buf, 1, sizeof(buf) - 1, file);
+        fclose(file);
+        buf[len] = 0;
+        //The command name may contain spaces, so count fields after its closing paren
+        char *pos = strrchr(buf, ')');
+        int field = 2, cpu = -1;
+        for(; pos && *pos; ++pos) {
+            if(*pos != ' ') { continue; }
+            if(++field == 39) {
+                cpu = atoi(pos + 1);
+                break;
+            }
+        }
+        return cpu < 0 ? -1 : GetCpuNode(cpu);
+    }
+};
+
+}
+
+#endif //LABSTOR_PAGES_H
@@ -0,0 +1,177 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_STATS_H
+#define LABSTOR_STATS_H
+
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+
+/*Name of the shared-memory statistics region of the server*/
+#define LABSTOR_STATS_SHMEM_NAME "/labstor_stats"
+#define LABSTOR_STATS_MAGIC 0x5453534cu
+#define LABSTOR_STATS_VERSION 1
+
+#define LABSTOR_STATS_MAX_WORKERS 64
+#define LABSTOR_STATS_MAX_QPS 1024
+/*At most 64, since workers track the modules they touched in a 64-bit mask*/
+#define LABSTOR_STATS_MAX_MODULES 64
+#define LABSTOR_STATS_MODULE_NAME_SIZE 64
+/*Bucket i of a latency histogram counts latencies in [2^i, 2^(i+1)) ns; the last bucket counts the rest*/
+#define LABSTOR_STATS_LATENCY_BUCKETS 32
+/*Attempts a reader makes to copy a snapshot before giving up on it*/
+#define LABSTOR_STATS_READ_RETRIES 64
+
+namespace labstor {
+
+/*
+ * Counters of a worker, queue pair or module. Everything but occupancy_
+ * only grows, so readers compute rates from the difference of two snapshots.
+ * */
+struct StatsCounters {
+    uint64_t num_requests_;
+    uint64_t num_bytes_;
+    uint64_t busy_ns_;
+    uint64_t occupancy_;
+    uint64_t num_collisions_;
+    uint64_t latency_[LABSTOR_STATS_LATENCY_BUCKETS];
+
+    StatsCounters() { Clear(); }
+
+    inline void Clear() {
+        memset(this, 0, sizeof(StatsCounters));
+    }
+
+    inline void AddLatency(uint64_t ns) {
+        ++latency_[GetLatencyBucket(ns)];
+    }
+
+    inline void Add(const StatsCounters &other) {
+        num_requests_ += other.num_requests_;
+        num_bytes_ += other.num_bytes_;
+        busy_ns_ += other.busy_ns_;
+        occupancy_ += other.occupancy_;
+        num_collisions_ += other.num_collisions_;
+        for(int i = 0; i < LABSTOR_STATS_LATENCY_BUCKETS; ++i) {
+            latency_[i] += other.latency_[i];
+        }
+    }
+
+    static inline int GetLatencyBucket(uint64_t ns) {
+        int bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+        return bucket < LABSTOR_STATS_LATENCY_BUCKETS ? bucket : LABSTOR_STATS_LATENCY_BUCKETS - 1;
+    }
+};
+
+/*
+ * A snapshot of counters, published by one thread at a time under a sequence
+ * lock: seq_ is odd while the snapshot is being written. Writers keep their
+ * counters in their own memory and copy them here now and then, so counting
+ * never touches a shared cache line; readers retry if the snapshot changed
+ * while they copied it.
+ * */
+struct alignas(64) StatsSlot {
+    std::atomic<uint64_t> seq_;
+    StatsCounters counters_;
+
+    inline void Publish(const StatsCounters &counters) {
+        const uint64_t *src = reinterpret_cast<const uint64_t*>(&counters);
+        uint64_t *dst = reinterpret_cast<uint64_t*>(&counters_);
+        uint64_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for(size_t i = 0; i < sizeof(StatsCounters)/sizeof(uint64_t); ++i) {
+            __atomic_store_n(&dst[i], src[i], __ATOMIC_RELAXED);
+        }
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    inline bool Read(StatsCounters &counters) const {
+        const uint64_t *src = reinterpret_cast<const uint64_t*>(&counters_);
+        uint64_t *dst = reinterpret_cast<uint64_t*>(&counters);
+        for(int attempt = 0; attempt < LABSTOR_STATS_READ_RETRIES; ++attempt) {
+            uint64_t seq = seq_.load(std::memory_order_acquire);
+            if(seq & 1) { continue; }
+            for(size_t i = 0; i < sizeof(StatsCounters)/sizeof(uint64_t); ++i) {
+                dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if(seq_.load(std::memory_order_relaxed) == seq) { return true; }
+        }
+        return false;
+    }
+};
+
+struct StatsWorkerEntry {
+    std::atomic<uint32_t> in_use_;
+    int32_t cpu_id_;
+    std::atomic<uint32_t> num_qps_;
+    StatsSlot stats_;
+};
+
+struct StatsQueuePairEntry {
+    std::atomic<uint32_t> in_use_;
+    uint32_t pid_;
+    uint16_t cnt_;
+    uint8_t flags_;
+    uint8_t type_;
+    std::atomic<int32_t> worker_id_;
+    StatsSlot stats_;
+};
+
+struct StatsModuleEntry {
+    std::atomic<uint32_t> in_use_;
+    char name_[LABSTOR_STATS_MODULE_NAME_SIZE];
+};
+
+/*
+ * The statistics region. Each worker publishes its own entry, the queue pairs
+ * it owns and, per module, the requests it processed for that module, so no
+ * two workers ever write the same slot. Readers sum the module slots over workers.
+ * */
+struct StatsHeader {
+    uint32_t magic_;
+    uint32_t version_;
+    int32_t pid_;
+    uint32_t max_workers_;
+    uint32_t max_qps_;
+    uint32_t max_modules_;
+    uint32_t latency_buckets_;
+    uint32_t period_us_;
+    std::atomic<uint64_t> update_ns_;
+    std::atomic<uint32_t> num_workers_;
+    std::atomic<uint32_t> num_qps_;
+    std::atomic<uint32_t> num_modules_;
+    StatsWorkerEntry workers_[LABSTOR_STATS_MAX_WORKERS];
+    StatsQueuePairEntry qps_[LABSTOR_STATS_MAX_QPS];
+    StatsModuleEntry modules_[LABSTOR_STATS_MAX_MODULES];
+    StatsSlot module_stats_[LABSTOR_STATS_MAX_WORKERS][LABSTOR_STATS_MAX_MODULES];
+};
+
+}
+
+#endif //LABSTOR_STATS_H
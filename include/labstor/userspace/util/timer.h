@@ -30,6 +30,7 @@
 #include <chrono>
 #include <vector>
 #include <functional>
+#include <time.h>
 
 namespace labstor {
 
@@ -194,7 +195,22 @@ private:
     }
 };
 
+/*The CPU time consumed by the calling thread*/
+struct ThreadCpuClock {
+    typedef std::chrono::nanoseconds duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef std::chrono::time_point<ThreadCpuClock> time_point;
+    static constexpr bool is_steady = true;
+    static time_point now() noexcept {
+        struct timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return time_point(duration((rep)ts.tv_sec*1000000000 + ts.tv_nsec));
+    }
+};
+
 typedef Timer<std::chrono::high_resolution_clock> HighResCpuTimer;
+typedef Timer<ThreadCpuClock> ThreadCpuTimer;
 typedef Timer<std::chrono::steady_clock> HighResMonotonicTimer;
 typedef ThreadedTimer<std::chrono::high_resolution_clock> ThreadedHighResCpuTimer;
 typedef ThreadedTimer<std::chrono::steady_clock> ThreadedHighResMonotonicTimer;
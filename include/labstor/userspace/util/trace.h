@@ -0,0 +1,336 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_TRACE_H
+#define LABSTOR_TRACE_H
+
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*Trace categories. A call site's category follows from where it is defined.*/
+#define LABSTOR_TRACE_CORE (1ull << 0)
+#define LABSTOR_TRACE_IPC (1ull << 1)
+#define LABSTOR_TRACE_WORKER (1ull << 2)
+#define LABSTOR_TRACE_MODULE (1ull << 3)
+#define LABSTOR_TRACE_CLIENT (1ull << 4)
+#define LABSTOR_TRACE_ALL (~0ull)
+
+/*Environment variable holding the initial category mask, e.g. LABSTOR_TRACE=0x6 or LABSTOR_TRACE=all*/
+#define LABSTOR_TRACE_ENV "LABSTOR_TRACE"
+/*Name of the shared-memory trace region of a process*/
+#define LABSTOR_TRACE_SHMEM_NAME "/labstor_trace.%d"
+#define LABSTOR_TRACE_MAGIC 0x5254534cu
+#define LABSTOR_TRACE_VERSION 1
+
+#define LABSTOR_TRACE_MAX_ARGS 6
+#define LABSTOR_TRACE_MAX_SITES 4096
+#define LABSTOR_TRACE_MAX_THREADS 64
+/*Events per thread; the oldest are overwritten. Must be a power of two.*/
+#define LABSTOR_TRACE_RING_EVENTS 4096
+
+namespace labstor {
+
+static inline uint64_t GetTraceEnvMask() {
+    const char *mask = getenv(LABSTOR_TRACE_ENV);
+    if(mask == nullptr) { return 0; }
+    if(strcmp(mask, "all") == 0) { return LABSTOR_TRACE_ALL; }
+    return strtoull(mask, nullptr, 0);
+}
+
+enum class TracePhase : uint8_t {
+    kBegin = 'B',
+    kEnd = 'E',
+    kInstant = 'i'
+};
+
+/*A call site of AUTO_TRACE or TRACEPOINT*/
+struct TraceSite {
+    uint64_t category_;
+    uint32_t id_;
+    uint32_t line_;
+    char func_[112];
+    char file_[64];
+    char args_[64];
+};
+
+/*
+ * One event. Arguments which are integers, enums, floats (truncated) or
+ * pointers are recorded; bit i of valid_ is set if argument i was.
+ * */
+struct TraceEvent {
+    uint64_t time_ns_;
+    uint32_t tid_;
+    uint16_t site_;
+    uint8_t phase_;
+    uint8_t valid_;
+    int64_t args_[LABSTOR_TRACE_MAX_ARGS];
+};
+
+/*The events of one thread. Only that thread writes; head_ counts every event ever written.*/
+struct TraceRing {
+    uint32_t tid_;
+    uint32_t pad_;
+    std::atomic<uint64_t> head_;
+    char head_pad_[48];
+    TraceEvent events_[LABSTOR_TRACE_RING_EVENTS];
+};
+
+struct TraceHeader {
+    uint32_t magic_;
+    uint32_t version_;
+    int32_t pid_;
+    uint32_t max_sites_;
+    uint32_t max_threads_;
+    uint32_t ring_events_;
+    std::atomic<uint32_t> num_sites_;
+    std::atomic<uint32_t> num_rings_;
+    std::atomic<uint64_t> mask_;
+    std::atomic<uint64_t> dropped_;
+    char pad_[16];
+    TraceSite sites_[LABSTOR_TRACE_MAX_SITES];
+    TraceRing rings_[LABSTOR_TRACE_MAX_THREADS];
+};
+
+/*
+ * A tracer which writes fixed-size binary events to per-thread rings.
+ *
+ * Every process with tracing enabled owns a shared-memory region named
+ * LABSTOR_TRACE_SHMEM_NAME holding the call sites and one ring per thread,
+ * which labstor_trace decodes into Chrome trace JSON, even after the process
+ * exits or crashes. Recording an event is a few stores into the thread's own
+ * ring; nothing is locked or formatted.
+ *
+ * Categories are switched on and off at runtime through a mask, which starts
+ * out as LABSTOR_TRACE from the environment (off by default) and lives in the
+ * region once it exists, so labstor_trace can change it in a running process.
+ * The region is only created once some category is enabled.
+ * */
+class Tracer {
+private:
+    static inline std::atomic<uint64_t> local_mask_ = GetTraceEnvMask();
+    static inline std::atomic<std::atomic<uint64_t>*> mask_ = &local_mask_;
+    static inline std::mutex lock_;
+    static inline TraceSite sites_[LABSTOR_TRACE_MAX_SITES];
+    static inline uint32_t num_sites_ = 0;
+    static inline TraceHeader *header_ = nullptr;
+    static inline bool attach_failed_ = false;
+    static inline thread_local TraceRing *ring_ = nullptr;
+    static inline thread_local bool no_ring_ = false;
+
+public:
+    static inline bool IsEnabled(uint64_t category) {
+        return mask_.load(std::memory_order_relaxed)->load(std::memory_order_relaxed) & category;
+    }
+
+    static inline void SetMask(uint64_t mask) {
+        mask_.load(std::memory_order_relaxed)->store(mask, std::memory_order_relaxed);
+    }
+
+    static inline uint64_t GetMask() {
+        return mask_.load(std::memory_order_relaxed)->load(std::memory_order_relaxed);
+    }
+
+    /*Called once per call site*/
+    static const TraceSite& Register(const char *func, const char *file, int line, const char *args) {
+        std::lock_guard<std::mutex> lock(lock_);
+        if(num_sites_ >= LABSTOR_TRACE_MAX_SITES) {
+            return sites_[LABSTOR_TRACE_MAX_SITES - 1];
+        }
+        TraceSite &site = sites_[num_sites_];
+        site.id_ = num_sites_;
+        site.line_ = line;
+        site.category_ = GetCategory(file);
+        CopyFunctionName(site.func_, func, sizeof(site.func_));
+        CopyString(site.file_, file, sizeof(site.file_), true);
+        CopyString(site.args_, args, sizeof(site.args_), false);
+        ++num_sites_;
+        if(header_) {
+            header_->sites_[site.id_] = site;
+            header_->num_sites_.store(num_sites_, std::memory_order_release);
+        }
+        return site;
+    }
+
+    template<typename ...Args>
+    static inline void Emit(uint32_t site, TracePhase phase, const Args& ...args) {
+        TraceRing *ring = GetRing();
+        if(ring == nullptr) { return; }
+        uint64_t head = ring->head_.load(std::memory_order_relaxed);
+        TraceEvent &event = ring->events_[head & (LABSTOR_TRACE_RING_EVENTS - 1)];
+        event.time_ns_ = GetTimeNs();
+        event.tid_ = ring->tid_;
+        event.site_ = site;
+        event.phase_ = static_cast<uint8_t>(phase);
+        event.valid_ = 0;
+        if constexpr(sizeof...(Args) > 0) {
+            int i = 0;
+            (SetArg(event, i, args), ...);
+        }
+        ring->head_.store(head + 1, std::memory_order_release);
+    }
+
+    static inline uint64_t GetTimeNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static inline size_t GetRegionSize() {
+        return sizeof(TraceHeader);
+    }
+
+private:
+    static inline TraceRing* GetRing() {
+        if(ring_ || no_ring_) { return ring_; }
+        if(!Attach()) {
+            no_ring_ = true;
+            return nullptr;
+        }
+        uint32_t ring_id = header_->num_rings_.fetch_add(1);
+        if(ring_id >= LABSTOR_TRACE_MAX_THREADS) {
+            header_->dropped_.fetch_add(1);
+            no_ring_ = true;
+            return nullptr;
+        }
+        ring_ = &header_->rings_[ring_id];
+        ring_->tid_ = gettid();
+        return ring_;
+    }
+
+    /*Create this process's trace region and move the mask into it*/
+    static bool Attach() {
+        std::lock_guard<std::mutex> lock(lock_);
+        char name[64];
+        if(header_) { return true; }
+        if(attach_failed_) { return false; }
+        snprintf(name, sizeof(name), LABSTOR_TRACE_SHMEM_NAME, getpid());
+        int fd = shm_open(name, O_CREAT | O_TRUNC | O_RDWR, 0600);
+        if(fd < 0 || ftruncate(fd, GetRegionSize()) < 0) {
+            if(fd >= 0) { close(fd); }
+            attach_failed_ = true;
+            return false;
+        }
+        void *region = mmap(nullptr, GetRegionSize(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(region == MAP_FAILED) {
+            attach_failed_ = true;
+            return false;
+        }
+        TraceHeader *header = reinterpret_cast<TraceHeader*>(region);
+        header->pid_ = getpid();
+        header->max_sites_ = LABSTOR_TRACE_MAX_SITES;
+        header->max_threads_ = LABSTOR_TRACE_MAX_THREADS;
+        header->ring_events_ = LABSTOR_TRACE_RING_EVENTS;
+        memcpy(header->sites_, sites_, num_sites_*sizeof(TraceSite));
+        header->num_sites_.store(num_sites_);
+        header->num_rings_.store(0);
+        header->dropped_.store(0);
+        header->mask_.store(local_mask_.load());
+        header->version_ = LABSTOR_TRACE_VERSION;
+        header->magic_ = LABSTOR_TRACE_MAGIC;
+        header_ = header;
+        mask_.store(&header->mask_);
+        return true;
+    }
+
+    template<typename T>
+    static inline void SetArg(TraceEvent &event, int &i, const T &arg) {
+        typedef std::decay_t<T> U;
+        if(i >= LABSTOR_TRACE_MAX_ARGS) { return; }
+        if constexpr(std::is_integral_v<U> || std::is_enum_v<U> || std::is_floating_point_v<U>) {
+            event.args_[i] = static_cast<int64_t>(arg);
+            event.valid_ |= 1 << i;
+        } else if constexpr(std::is_pointer_v<U> && !std::is_same_v<std::remove_cv_t<std::remove_pointer_t<U>>, char>) {
+            event.args_[i] = static_cast<int64_t>(reinterpret_cast<uintptr_t>(arg));
+            event.valid_ |= 1 << i;
+        }
+        ++i;
+    }
+
+    static uint64_t GetCategory(const char *file) {
+        if(strstr(file, "labmods/")) { return LABSTOR_TRACE_MODULE; }
+        if(strstr(file, "ipc_manager")) { return LABSTOR_TRACE_IPC; }
+        if(strstr(file, "work")) { return LABSTOR_TRACE_WORKER; }
+        if(strstr(file, "client")) { return LABSTOR_TRACE_CLIENT; }
+        return LABSTOR_TRACE_CORE;
+    }
+
+    /*Reduce a __PRETTY_FUNCTION__ to the qualified name*/
+    static void CopyFunctionName(char *dst, const char *func, size_t size) {
+        const char *end = strchr(func, '(');
+        const char *start = func;
+        size_t len;
+        if(end == nullptr) { end = func + strlen(func); }
+        for(const char *c = func; c < end; ++c) {
+            if(*c == ' ') { start = c + 1; }
+        }
+        len = end - start;
+        if(len >= size) { len = size - 1; }
+        memcpy(dst, start, len);
+        dst[len] = 0;
+    }
+
+    static void CopyString(char *dst, const char *src, size_t size, bool keep_tail) {
+        size_t len = strlen(src);
+        if(len >= size) {
+            if(keep_tail) { src += len - (size - 1); }
+            len = size - 1;
+        }
+        memcpy(dst, src, len);
+        dst[len] = 0;
+    }
+};
+
+/*Records a begin event and, when it goes out of scope, the matching end event*/
+class AutoTrace {
+private:
+    int64_t site_;
+public:
+    AutoTrace() : site_(-1) {}
+    template<typename ...Args>
+    inline void Begin(uint32_t site, const Args& ...args) {
+        site_ = site;
+        Tracer::Emit(site, TracePhase::kBegin, args...);
+    }
+    ~AutoTrace() {
+        if(site_ >= 0) {
+            Tracer::Emit(site_, TracePhase::kEnd);
+        }
+    }
+};
+
+}
+
+#endif //LABSTOR_TRACE_H
@@ -45,12 +45,9 @@ int labstor::BlockFS::Client::Close(int fd) {
     return 0;
 }
 
-labstor::ipc::qtok_t labstor::BlockFS::Client::AIO(labstor::GenericPosix::Ops op, int fd, void *buf, size_t off, ssize_t size) {
+labstor::GenericPosix::io_request* labstor::BlockFS::Client::AllocIO(labstor::queue_pair *&qp, labstor::GenericPosix::Ops op, int fd, void *buf, size_t off, ssize_t size) {
     AUTO_TRACE("")
     labstor::GenericPosix::io_request *client_rq;
-    labstor::queue_pair *qp;
-    labstor::ipc::qtok_t qtok;
-    ssize_t ret;
 
     //Get SERVER QP
     ipc_manager_->GetQueuePair(qp,
@@ -58,7 +55,17 @@ labstor::ipc::qtok_t labstor::BlockFS::Client::AIO(labstor::GenericPosix::Ops op
 
     //Create CLIENT -> SERVER message
     client_rq = ipc_manager_->AllocRequest<labstor::GenericPosix::io_request>(qp);
-    client_rq->Start(ns_id_, op, fd, buf, off, size);
+    client_rq->Start(ns_id_, op, fd, ipc_manager_->GetBufferRef(buf), off, size);
+    return client_rq;
+}
+
+labstor::ipc::qtok_t labstor::BlockFS::Client::AIO(labstor::GenericPosix::Ops op, int fd, void *buf, size_t off, ssize_t size) {
+    AUTO_TRACE("")
+    labstor::GenericPosix::io_request *client_rq;
+    labstor::queue_pair *qp;
+    labstor::ipc::qtok_t qtok;
+
+    client_rq = AllocIO(qp, op, fd, buf, off, size);
 
     //Enqueue the message
     qp->Enqueue<labstor::GenericPosix::io_request>(client_rq, qtok);
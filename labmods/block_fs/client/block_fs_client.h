@@ -53,6 +53,7 @@ public:
     void Register(char *ns_key, char *next_module);
     int Open(int fd, const char *path, int pathlen, int oflag);
     int Close(int fd);
+    labstor::GenericPosix::io_request* AllocIO(labstor::queue_pair *&qp, labstor::GenericPosix::Ops op, int fd, void *buf, size_t off, ssize_t size) override;
     labstor::ipc::qtok_t AIO(labstor::GenericPosix::Ops op, int fd, void *buf, size_t off, ssize_t size);
     labstor::ipc::qtok_t AIO(labstor::GenericPosix::Ops op, int fd, void *buf, ssize_t size);
     ssize_t IO(labstor::GenericPosix::Ops op, int fd, void *buf, size_t off, ssize_t size);
@@ -68,20 +68,15 @@ inline bool labstor::BlockFS::Server::IO(labstor::queue_pair *qp, labstor::Gener
     labstor::GenericBlock::io_request *block_rq;
     labstor::queue_pair *priv_qp;
 
-    int i = 0;
-    char *buf = reinterpret_cast<char*>(client_rq->buf_);
-    size_t total_io = client_rq->size_;
-    int num_blocks = (total_io/SMALL_BLOCK_SIZE) + 1;
-    labstor::ipc::qtok_t *qtoks = new labstor::ipc::qtok_t[num_blocks];
-
     switch(client_rq->GetCode()) {
-        //Divide I/O into blocks
+        //Forward I/O to the block device
         case 0: {
-            ipc_manager_->GetQueuePair(priv_qp, LABSTOR_QP_PRIVATE | LABSTOR_QP_LOW_LATENCY);
+            labstor::ipc::qtok_t *qtoks = new labstor::ipc::qtok_t[1];
+            ipc_manager_->GetQueuePair(priv_qp, LABSTOR_QP_SERVER_PRIVATE);
             block_rq = ipc_manager_->AllocRequest<labstor::GenericBlock::io_request>(priv_qp);
-            block_rq->Start(next_module_, static_cast<labstor::GenericBlock::Ops>(client_rq->op_), client_rq->off_, client_rq->size_, buf);
-            priv_qp->Enqueue(block_rq, qtoks[i]);
-            client_rq->SetQtoks(i, qtoks);
+            block_rq->Start(next_module_, static_cast<labstor::GenericBlock::Ops>(client_rq->op_), client_rq->off_, client_rq->size_, client_rq->buf_);
+            priv_qp->EnqueueBatch(&block_rq, 1, qtoks);
+            client_rq->SetQtoks(1, qtoks);
             client_rq->SetCode(1);
             return false;
         }
@@ -89,12 +84,11 @@ inline bool labstor::BlockFS::Server::IO(labstor::queue_pair *qp, labstor::Gener
         //FS only performs direct I/O; commit blocks when I/O completes
         case 1: {
             ipc_manager_->GetQueuePair(priv_qp, client_rq->qtoks_[0]);
-            for(int i = client_rq->cur_qtok_; i < client_rq->num_qtoks_; ++i) {
-                if(!priv_qp->IsComplete(client_rq->qtoks_[i], block_rq)) {
-                    return  false;
-                }
-                ++client_rq->cur_qtok_;
+            client_rq->num_qtoks_ -= priv_qp->ReapCompleted(client_rq->qtoks_, client_rq->num_qtoks_, &block_rq);
+            if(client_rq->num_qtoks_ > 0) {
+                return false;
             }
+            delete [] client_rq->qtoks_;
             return true;
         }
     }
@@ -47,6 +47,9 @@ public:
     inline labstor::ipc::qtok_t ARead(void *buf, size_t size, size_t off) {
         return AIO(buf, size, off, Ops::kRead);
     }
+    inline labstor::ipc::qtok_t AFlush() {
+        return AIO(nullptr, 0, 0, Ops::kFlush);
+    }
 
     inline int IO(void *buf, size_t size, size_t off, Ops op) {
         labstor::ipc::qtok_t qtok;
@@ -62,6 +65,9 @@ public:
     inline int Read(void *buf, size_t size, size_t off) {
         return IO(buf, size, off, Ops::kRead);
     }
+    inline int Flush() {
+        return IO(nullptr, 0, 0, Ops::kFlush);
+    }
 };
 
 }
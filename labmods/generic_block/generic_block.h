@@ -28,21 +28,23 @@
 #define LABSTOR_BLOCK_H
 
 #include "labstor/types/data_structures/shmem_request.h"
+#include "labstor/types/data_structures/shmem_buffer.h"
 
 namespace labstor::GenericBlock {
 
 enum class Ops {
     kInit,
     kRead,
-    kWrite
+    kWrite,
+    kFlush
 };
 
 struct io_request : public labstor::ipc::request {
     size_t off_;
     size_t size_;
-    void *buf_;
+    labstor::ipc::buf_ref buf_;
 
-    inline void Start(int ns_id, Ops op, size_t off, size_t size, void *buf) {
+    inline void Start(int ns_id, Ops op, size_t off, size_t size, labstor::ipc::buf_ref buf) {
         op_ = static_cast<int>(op);
         ns_id_ = ns_id;
         code_ = 0;
@@ -51,7 +53,7 @@ struct io_request : public labstor::ipc::request {
         buf_ = buf;
     }
 
-    inline void Start(int ns_id, Ops op, size_t size, void *buf) {
+    inline void Start(int ns_id, Ops op, size_t size, labstor::ipc::buf_ref buf) {
             op_ = static_cast<int>(op);
             ns_id_ = ns_id;
             code_ = 0;
@@ -59,6 +61,16 @@ struct io_request : public labstor::ipc::request {
             size_ = size;
             buf_ = buf;
     }
+
+    //Makes all previously completed writes durable (e.g., flushes a volatile write cache)
+    inline void Start(int ns_id, Ops op) {
+        op_ = static_cast<int>(op);
+        ns_id_ = ns_id;
+        code_ = 0;
+        off_ = 0;
+        size_ = 0;
+        buf_ = labstor::ipc::buf_ref::Raw(nullptr);
+    }
 };
 
 }
@@ -0,0 +1,474 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LABSTOR_GENERIC_POSIX_AIO_H
+#define LABSTOR_GENERIC_POSIX_AIO_H
+
+#include "generic_posix_client.h"
+#include <labstor/userspace/util/timer.h>
+#include <linux/aio_abi.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <sched.h>
+#include <aio.h>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+
+/*
+ * libaio's context handle. libaio's iocb and io_event match the kernel ABI,
+ * so the kernel definitions are used and libaio.h is not required to build.
+ * */
+typedef struct io_context *io_context_t;
+
+namespace labstor::GenericPosix {
+
+static inline uint64_t GetTimeoutNsec(const struct timespec *timeout) {
+    return timeout->tv_sec*1000000000ull + timeout->tv_nsec;
+}
+
+/*
+ * A libaio context. I/Os on LabStor fds are submitted to the queue pairs and
+ * reaped from them in batches. All other I/Os go to a kernel context, which
+ * is driven through the aio syscalls that libaio itself wraps.
+ * */
+class AioContext {
+private:
+    Client *client_;
+    aio_context_t kernel_ctx_;
+    long kernel_pending_;
+    std::mutex lock_;
+    std::vector<AsyncIO*> pending_;
+public:
+    explicit AioContext(Client *client) : client_(client), kernel_ctx_(0), kernel_pending_(0) {}
+
+    int Setup(unsigned max_events) {
+        return syscall(SYS_io_setup, max_events, &kernel_ctx_) < 0 ? -errno : 0;
+    }
+
+    int Destroy() {
+        std::lock_guard<std::mutex> lock(lock_);
+        for(AsyncIO *aio : pending_) {
+            client_->AWait(aio);
+            delete aio;
+        }
+        pending_.clear();
+        return syscall(SYS_io_destroy, kernel_ctx_) < 0 ? -errno : 0;
+    }
+
+    inline bool IsLabStor(struct iocb *iocb) {
+        uint32_t ns_id;
+        return client_->GetNamespaceID(iocb->aio_fildes, ns_id);
+    }
+
+    /*
+     * Returns the number of iocbs submitted, or a negative errno if none were.
+     * */
+    long Submit(long nr, struct iocb **iocbs) {
+        long i = 0, run, ret;
+        while(i < nr) {
+            if(IsLabStor(iocbs[i])) {
+                //Consecutive LabStor I/Os are submitted as one batch
+                for(run = 1; i + run < nr && IsLabStor(iocbs[i + run]); ++run);
+                ret = SubmitLabStor(iocbs + i, run);
+                if(ret < 0) { return i ? i : ret; }
+                i += ret;
+                if(ret < run) { return i; }
+                continue;
+            }
+            //Consecutive kernel I/Os are submitted with one syscall
+            for(run = 1; i + run < nr && !IsLabStor(iocbs[i + run]); ++run);
+            ret = syscall(SYS_io_submit, kernel_ctx_, run, iocbs + i);
+            if(ret < 0) { return i ? i : -errno; }
+            {
+                std::lock_guard<std::mutex> lock(lock_);
+                kernel_pending_ += ret;
+            }
+            i += ret;
+            if(ret < run) { return i; }
+        }
+        return nr;
+    }
+
+    long GetEvents(long min_nr, long nr, struct io_event *events, struct timespec *timeout) {
+        labstor::HighResMonotonicTimer t;
+        struct timespec no_wait = {0, 0};
+        long count = 0;
+        bool has_labstor, has_kernel;
+        t.Resume();
+        while(true) {
+            count += ReapLabStor(events + count, nr - count, has_labstor);
+            count += ReapKernel(events + count, 0, nr - count, &no_wait, has_kernel);
+            if(count >= min_nr || count == nr || (!has_labstor && !has_kernel)) {
+                return count;
+            }
+            if(timeout && t.GetNsecFromStart() >= GetTimeoutNsec(timeout)) {
+                return count;
+            }
+            if(timeout == nullptr && has_kernel && !has_labstor) {
+                return count + ReapKernel(events + count, min_nr - count, nr - count, nullptr, has_kernel);
+            }
+            if(timeout == nullptr && has_labstor && !has_kernel) {
+                //Block on one I/O outside of the lock so other threads can submit meanwhile
+                AsyncIO *aio;
+                {
+                    std::lock_guard<std::mutex> lock(lock_);
+                    if(pending_.empty()) { continue; }
+                    aio = pending_.back();
+                    pending_.pop_back();
+                }
+                client_->AWait(aio);
+                std::lock_guard<std::mutex> lock(lock_);
+                pending_.insert(pending_.begin(), aio);
+                continue;
+            }
+            sched_yield();
+        }
+    }
+
+    int Cancel(struct iocb *iocb, struct io_event *event) {
+        if(IsLabStor(iocb)) {
+            //I/Os are not cancellable once they reach the queue pair
+            return -EAGAIN;
+        }
+        return syscall(SYS_io_cancel, kernel_ctx_, iocb, event) < 0 ? -errno : 0;
+    }
+
+private:
+    static AsyncIO* NewAsyncIO(struct iocb *iocb) {
+        AsyncIO *aio = new AsyncIO();
+        aio->fd_ = iocb->aio_fildes;
+        aio->buf_ = reinterpret_cast<char*>(iocb->aio_buf);
+        aio->off_ = iocb->aio_offset;
+        aio->size_ = iocb->aio_nbytes;
+        aio->data_ = iocb;
+        aio->stage_ = nullptr;
+        aio->ret_ = 0;
+        aio->done_ = true;
+        return aio;
+    }
+
+    /*
+     * Submit a run of LabStor iocbs. Reads and writes are handed to the client
+     * together so that they share queue pair enqueues.
+     * Returns the number submitted, or a negative errno if none were.
+     * */
+    long SubmitLabStor(struct iocb **iocbs, long count) {
+        std::vector<AsyncIO*> batch;
+        long i, ret, start;
+        for(i = 0; i < count; ++i) {
+            struct iocb *iocb = iocbs[i];
+            if(iocb->aio_lio_opcode == IOCB_CMD_PREAD || iocb->aio_lio_opcode == IOCB_CMD_PWRITE) {
+                AsyncIO *aio = NewAsyncIO(iocb);
+                aio->op_ = iocb->aio_lio_opcode == IOCB_CMD_PREAD ?
+                        labstor::GenericPosix::Ops::kRead : labstor::GenericPosix::Ops::kWrite;
+                batch.emplace_back(aio);
+                continue;
+            }
+            //Keep the I/Os in submission order
+            start = i - batch.size();
+            ret = SubmitBatch(batch);
+            if(ret < 0) { return start ? start : ret; }
+            if(start + ret < i) { return start + ret; }
+            ret = SubmitOther(iocb);
+            if(ret < 0) { return i ? i : ret; }
+        }
+        start = count - batch.size();
+        ret = SubmitBatch(batch);
+        if(ret < 0) { return start ? start : ret; }
+        return start + ret;
+    }
+
+    /*
+     * Returns the number of I/Os in batch submitted, or a negative errno if none were.
+     * The ones which weren't submitted are freed.
+     * */
+    long SubmitBatch(std::vector<AsyncIO*> &batch) {
+        long ret = 0;
+        if(!batch.empty()) {
+            ret = client_->ASubmit(batch.data(), batch.size());
+        }
+        for(long i = ret < 0 ? 0 : ret; i < (long)batch.size(); ++i) {
+            delete batch[i];
+        }
+        if(ret > 0) {
+            std::lock_guard<std::mutex> lock(lock_);
+            pending_.insert(pending_.end(), batch.begin(), batch.begin() + ret);
+        }
+        batch.clear();
+        return ret == LABSTOR_GENERIC_FS_INVALID_FD ? -EBADF : ret;
+    }
+
+    int SubmitOther(struct iocb *iocb) {
+        AsyncIO *aio = NewAsyncIO(iocb);
+        int ret = 0;
+        switch(iocb->aio_lio_opcode) {
+            //Vectored I/Os are gathered into a single request and completed here
+            case IOCB_CMD_PREADV: {
+                aio->ret_ = client_->ReadV(aio->fd_, reinterpret_cast<const struct iovec*>(aio->buf_), aio->size_, aio->off_);
+                break;
+            }
+            case IOCB_CMD_PWRITEV: {
+                aio->ret_ = client_->WriteV(aio->fd_, reinterpret_cast<const struct iovec*>(aio->buf_), aio->size_, aio->off_);
+                break;
+            }
+            //Fsyncs wait for the module's group commit and are completed here
+            case IOCB_CMD_FSYNC:
+            case IOCB_CMD_FDSYNC: {
+                aio->ret_ = client_->Fsync(aio->fd_, iocb->aio_lio_opcode == IOCB_CMD_FDSYNC);
+                break;
+            }
+            default: {
+                ret = -EINVAL;
+                break;
+            }
+        }
+        if(ret < 0) {
+            delete aio;
+            return ret;
+        }
+        std::lock_guard<std::mutex> lock(lock_);
+        pending_.emplace_back(aio);
+        return 0;
+    }
+
+    long ReapLabStor(struct io_event *events, long max_events, bool &has_pending) {
+        std::lock_guard<std::mutex> lock(lock_);
+        long count = std::min<long>(client_->AReap(pending_.data(), pending_.size()), max_events);
+        for(long i = 0; i < count; ++i) {
+            AsyncIO *aio = pending_[i];
+            struct iocb *iocb = reinterpret_cast<struct iocb*>(aio->data_);
+            events[i].data = iocb->aio_data;
+            events[i].obj = reinterpret_cast<uint64_t>(iocb);
+            events[i].res = aio->ret_ == LABSTOR_GENERIC_FS_INVALID_FD ? -EBADF : aio->ret_;
+            events[i].res2 = 0;
+            delete aio;
+        }
+        pending_.erase(pending_.begin(), pending_.begin() + count);
+        has_pending = !pending_.empty();
+        return count;
+    }
+
+    long ReapKernel(struct io_event *events, long min_nr, long max_events, struct timespec *timeout, bool &has_pending) {
+        long ret = 0;
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            has_pending = kernel_pending_ > 0;
+        }
+        if(has_pending && max_events > 0) {
+            ret = syscall(SYS_io_getevents, kernel_ctx_, min_nr, max_events, events, timeout);
+        }
+        if(ret <= 0) { return 0; }
+        std::lock_guard<std::mutex> lock(lock_);
+        kernel_pending_ -= ret;
+        has_pending = kernel_pending_ > 0;
+        return ret;
+    }
+};
+
+/*
+ * POSIX AIO control blocks on LabStor fds. Completion is not signalled
+ * through aio_sigevent; callers poll with aio_error or aio_suspend.
+ * */
+class AiocbTable {
+private:
+    Client *client_;
+    std::mutex lock_;
+    std::unordered_map<const struct aiocb*, AsyncIO*> aios_;
+public:
+    explicit AiocbTable(Client *client) : client_(client) {}
+
+    int Submit(struct aiocb *cb, labstor::GenericPosix::Ops op) {
+        AsyncIO *aio = new AsyncIO();
+        aio->op_ = op;
+        aio->fd_ = cb->aio_fildes;
+        aio->buf_ = reinterpret_cast<char*>(const_cast<void*>(cb->aio_buf));
+        aio->off_ = cb->aio_offset;
+        aio->size_ = cb->aio_nbytes;
+        aio->data_ = cb;
+        int ret = client_->ASubmit(aio);
+        if(ret < 0) {
+            delete aio;
+            return ret;
+        }
+        std::lock_guard<std::mutex> lock(lock_);
+        aios_[cb] = aio;
+        return 0;
+    }
+
+    int Fsync(struct aiocb *cb, int op) {
+        uint32_t ns_id;
+        if(!client_->GetNamespaceID(cb->aio_fildes, ns_id)) {
+            return LABSTOR_GENERIC_FS_INVALID_FD;
+        }
+        AsyncIO *aio = new AsyncIO();
+        aio->fd_ = cb->aio_fildes;
+        aio->data_ = cb;
+        aio->stage_ = nullptr;
+        aio->ret_ = client_->Fsync(cb->aio_fildes, op == O_DSYNC);
+        aio->done_ = true;
+        std::lock_guard<std::mutex> lock(lock_);
+        aios_[cb] = aio;
+        return 0;
+    }
+
+    bool Error(const struct aiocb *cb, int &err) {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto iter = aios_.find(cb);
+        if(iter == aios_.end()) { return false; }
+        AsyncIO *aio = iter->second;
+        if(client_->AReap(&aio, 1) == 0) {
+            err = EINPROGRESS;
+        } else {
+            err = aio->ret_ < 0 ? GetErrno(aio->ret_) : 0;
+        }
+        return true;
+    }
+
+    bool Return(struct aiocb *cb, ssize_t &ret) {
+        AsyncIO *aio;
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            auto iter = aios_.find(cb);
+            if(iter == aios_.end()) { return false; }
+            aio = iter->second;
+            aios_.erase(iter);
+        }
+        client_->AWait(aio);
+        ret = aio->ret_ < 0 ? -GetErrno(aio->ret_) : aio->ret_;
+        delete aio;
+        return true;
+    }
+
+    /*
+     * Returns 0 once any control block in list completes, -EAGAIN on timeout, or
+     * LABSTOR_GENERIC_FS_INVALID_FD if none of them are LabStor I/Os.
+     * Other control blocks are polled with the real aio_error.
+     * */
+    int Suspend(const struct aiocb *const list[], int nent, const struct timespec *timeout,
+                int (*real_error)(const struct aiocb*)) {
+        labstor::HighResMonotonicTimer t;
+        std::vector<AsyncIO*> aios;
+        std::vector<const struct aiocb*> others;
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            for(int i = 0; i < nent; ++i) {
+                if(list[i] == nullptr) { continue; }
+                auto iter = aios_.find(list[i]);
+                if(iter == aios_.end()) {
+                    others.emplace_back(list[i]);
+                } else {
+                    aios.emplace_back(iter->second);
+                }
+            }
+        }
+        if(aios.empty()) { return LABSTOR_GENERIC_FS_INVALID_FD; }
+        t.Resume();
+        while(true) {
+            {
+                std::lock_guard<std::mutex> lock(lock_);
+                if(client_->AReap(aios.data(), aios.size()) > 0) { return 0; }
+            }
+            for(const struct aiocb *cb : others) {
+                if(real_error(cb) != EINPROGRESS) { return 0; }
+            }
+            if(timeout && t.GetNsecFromStart() >= GetTimeoutNsec(timeout)) {
+                return -EAGAIN;
+            }
+            if(timeout == nullptr && others.empty()) {
+                std::lock_guard<std::mutex> lock(lock_);
+                client_->AWait(aios[0]);
+                return 0;
+            }
+            sched_yield();
+        }
+    }
+
+    /*
+     * Submit the LabStor control blocks of a lio_listio() call and collect the rest
+     * in others. Returns the number of LabStor control blocks that failed to submit.
+     * */
+    int Listio(struct aiocb *const list[], int nent, std::vector<struct aiocb*> &others, std::vector<AsyncIO*> &aios) {
+        uint32_t ns_id;
+        int failed = 0;
+        for(int i = 0; i < nent; ++i) {
+            struct aiocb *cb = list[i];
+            if(cb == nullptr || cb->aio_lio_opcode == LIO_NOP) { continue; }
+            if(!client_->GetNamespaceID(cb->aio_fildes, ns_id)) {
+                others.emplace_back(cb);
+                continue;
+            }
+            labstor::GenericPosix::Ops op = cb->aio_lio_opcode == LIO_READ ?
+                    labstor::GenericPosix::Ops::kRead : labstor::GenericPosix::Ops::kWrite;
+            if(Submit(cb, op) < 0) {
+                ++failed;
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(lock_);
+            aios.emplace_back(aios_[cb]);
+        }
+        return failed;
+    }
+
+    /*
+     * Wait for every I/O in aios, reaping them in batches and blocking on one
+     * pending I/O only when a pass makes no progress. Returns the number that failed.
+     * */
+    int WaitAll(std::vector<AsyncIO*> &aios) {
+        std::lock_guard<std::mutex> lock(lock_);
+        int num_done, failed = 0;
+        while((num_done = client_->AReap(aios.data(), aios.size())) < (int)aios.size()) {
+            client_->AWait(aios[num_done]);
+        }
+        for(AsyncIO *aio : aios) {
+            if(aio->ret_ < 0) { ++failed; }
+        }
+        return failed;
+    }
+
+    int Cancel(int fd, struct aiocb *cb) {
+        uint32_t ns_id;
+        if(!client_->GetNamespaceID(fd, ns_id)) { return LABSTOR_GENERIC_FS_INVALID_FD; }
+        std::lock_guard<std::mutex> lock(lock_);
+        for(auto &entry : aios_) {
+            AsyncIO *aio = entry.second;
+            if((cb == nullptr || entry.first == cb) && aio->fd_ == fd && client_->AReap(&aio, 1) == 0) {
+                //I/Os are not cancellable once they reach the queue pair
+                return AIO_NOTCANCELED;
+            }
+        }
+        return AIO_ALLDONE;
+    }
+
+private:
+    static inline int GetErrno(ssize_t ret) {
+        return ret == LABSTOR_GENERIC_FS_INVALID_FD ? EBADF : -ret;
+    }
+};
+
+}
+
+#endif //LABSTOR_GENERIC_POSIX_AIO_H
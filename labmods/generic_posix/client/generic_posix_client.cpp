@@ -29,6 +29,64 @@
 #include "generic_posix_client.h"
 #include "lib/posix_client.h"
 #include <mutex>
+#include <algorithm>
+#include <fcntl.h>
+
+/*
+ * Payloads outside of the data buffer pool are staged through a pool buffer, so
+ * the modules below always work in place on shared memory. Each byte is copied
+ * once: into the buffer before a write, or out of it after a read.
+ * */
+static ssize_t StageIO(LABSTOR_IPC_MANAGER_T ipc_manager, labstor::Posix::Client *client,
+                       labstor::GenericPosix::Ops op, int fd, char *buf, size_t off, ssize_t size, bool seek) {
+    size_t max_size = std::min<size_t>(size, ipc_manager->GetMaxBufferSize());
+    char *stage = reinterpret_cast<char*>(ipc_manager->AllocBuffer(max_size));
+    ssize_t total = 0, count, ret;
+    if(stage == nullptr) {
+        return seek ? client->IO(op, fd, buf, off, size) : client->IO(op, fd, buf, size);
+    }
+    while(total < size) {
+        count = std::min<size_t>(size - total, max_size);
+        if(op == labstor::GenericPosix::Ops::kWrite) {
+            memcpy(stage, buf + total, count);
+        }
+        ret = seek ? client->IO(op, fd, stage, off + total, count) : client->IO(op, fd, stage, count);
+        if(ret <= 0) {
+            if(total == 0) { total = ret; }
+            break;
+        }
+        if(op == labstor::GenericPosix::Ops::kRead) {
+            memcpy(buf + total, stage, ret);
+        }
+        total += ret;
+        if(ret < count) { break; }
+    }
+    ipc_manager->FreeBuffer(stage);
+    return total;
+}
+
+/*
+ * Walk up to size bytes of an iovec array from (i, iov_off), gathering them
+ * into buf or scattering buf into them. Returns the number of bytes walked.
+ * */
+static size_t WalkIov(const struct iovec *iov, int iovcnt, int &i, size_t &iov_off, char *buf, size_t size, bool scatter) {
+    size_t count = 0, len;
+    while(i < iovcnt && count < size) {
+        len = std::min(iov[i].iov_len - iov_off, size - count);
+        if(buf && scatter) {
+            memcpy((char*)iov[i].iov_base + iov_off, buf + count, len);
+        } else if(buf) {
+            memcpy(buf + count, (char*)iov[i].iov_base + iov_off, len);
+        }
+        count += len;
+        iov_off += len;
+        if(iov_off == iov[i].iov_len) {
+            ++i;
+            iov_off = 0;
+        }
+    }
+    return count;
+}
 
 void labstor::GenericPosix::Client::Register(YAML::Node config) {
     AUTO_TRACE("")
@@ -50,19 +108,21 @@ void labstor::GenericPosix::Client::Initialize(int ns_id) {
     }
 }
 
-int labstor::GenericPosix::Client::Open(const char *path, int oflag) {
+/*
+ * Find the module mounted at the longest prefix of path. len is set to the
+ * length of the mount point, so path + len is relative to the module.
+ * */
+labstor::Posix::Client* labstor::GenericPosix::Client::FindModule(const char *path, uint32_t &ns_id, int &len) {
     AUTO_TRACE(path)
-    int fd;
+    labstor::Posix::Client *module;
 
     //Determine if the path is a labstor path
     if(strncmp(path, prefix_.c_str(), prefix_.size()) != 0) {
-        return LABSTOR_GENERIC_FS_PATH_NOT_FOUND;
+        return nullptr;
     }
 
     //Determine the module belonging to the path
-    int len = strlen(path);
-    uint32_t ns_id;
-    labstor::Posix::Client *module;
+    len = strlen(path);
     while(len > 0) {
         labstor::ipc::string path_str(std::string(path, len));
         TRACEPOINT(std::string(path, len))
@@ -72,64 +132,532 @@ int labstor::GenericPosix::Client::Open(const char *path, int oflag) {
             if(module == nullptr) {
                 module = namespace_->LoadClientModule<labstor::Posix::Client>(ns_id);
             }
-            break;
+            return module;
         }
         len = PriorSlash(path, len);
     }
-    if(len == 0) {
+    return nullptr;
+}
+
+int labstor::GenericPosix::Client::Open(const char *path, int oflag) {
+    AUTO_TRACE(path)
+    int fd, ret, len;
+    uint32_t ns_id;
+    labstor::Posix::Client *module = FindModule(path, ns_id, len);
+    if(module == nullptr) {
         return LABSTOR_GENERIC_FS_PATH_NOT_FOUND;
     }
 
     //Allocate an fd & track which module the fd belongs to
     fd = AllocateFD();
-    fd_to_ns_id_.emplace(fd, ns_id);
+    SetNamespaceID(fd, ns_id);
     TRACEPOINT("FD", fd)
 
     //Call the client's implementation of open()
-    fd = module->Open(fd, path, len, oflag);
-    return fd;
+    ret = module->Open(fd, path, len, oflag);
+    if(ret < 0) {
+        SetNamespaceID(fd, LABSTOR_FD_UNUSED);
+        FreeFD(fd);
+    }
+    return ret;
 }
 
 int labstor::GenericPosix::Client::Close(int fd) {
-    if(fd < fd_min_) { return LABSTOR_INVALID_FD; }
-    int ns_id = fd_to_ns_id_[fd];
+    uint32_t ns_id;
+    if(!GetNamespaceID(fd, ns_id)) { return LABSTOR_GENERIC_FS_INVALID_FD; }
     labstor::Posix::Client *client = namespace_->GetModule<labstor::Posix::Client>(ns_id);
     client->Close(fd);
-    fd_to_ns_id_.erase(fd);
+    SetNamespaceID(fd, LABSTOR_FD_UNUSED);
     FreeFD(fd);
     return 0;
 }
 
+int labstor::GenericPosix::Client::Stat(const char *path, struct stat *st) {
+    AUTO_TRACE(path)
+    int len;
+    uint32_t ns_id;
+    labstor::Posix::Client *module = FindModule(path, ns_id, len);
+    if(module == nullptr) { return LABSTOR_GENERIC_FS_PATH_NOT_FOUND; }
+    return module->Stat(path + len, st);
+}
+
+int labstor::GenericPosix::Client::Fstat(int fd, struct stat *st) {
+    AUTO_TRACE(fd)
+    uint32_t ns_id;
+    if(!GetNamespaceID(fd, ns_id)) { return LABSTOR_GENERIC_FS_INVALID_FD; }
+    return namespace_->GetModule<labstor::Posix::Client>(ns_id)->Fstat(fd, st);
+}
+
+int64_t labstor::GenericPosix::Client::Lseek(int fd, int64_t off, int whence) {
+    AUTO_TRACE(fd)
+    uint32_t ns_id;
+    if(!GetNamespaceID(fd, ns_id)) { return LABSTOR_GENERIC_FS_INVALID_FD; }
+    return namespace_->GetModule<labstor::Posix::Client>(ns_id)->Lseek(fd, off, whence);
+}
+
+int labstor::GenericPosix::Client::Fsync(int fd, bool data_only) {
+    AUTO_TRACE(fd, data_only)
+    uint32_t ns_id;
+    if(!GetNamespaceID(fd, ns_id)) { return LABSTOR_GENERIC_FS_INVALID_FD; }
+    return namespace_->GetModule<labstor::Posix::Client>(ns_id)->Fsync(fd, data_only);
+}
+
+int labstor::GenericPosix::Client::Unlink(const char *path) {
+    AUTO_TRACE(path)
+    int len;
+    uint32_t ns_id;
+    labstor::Posix::Client *module = FindModule(path, ns_id, len);
+    if(module == nullptr) { return LABSTOR_GENERIC_FS_PATH_NOT_FOUND; }
+    return module->Unlink(path + len);
+}
+
+int labstor::GenericPosix::Client::Rename(const char *old_path, const char *new_path) {
+    AUTO_TRACE(old_path, new_path)
+    int old_len, new_len;
+    uint32_t old_ns_id, new_ns_id;
+    labstor::Posix::Client *module = FindModule(old_path, old_ns_id, old_len);
+    labstor::Posix::Client *new_module = FindModule(new_path, new_ns_id, new_len);
+    if(module == nullptr && new_module == nullptr) { return LABSTOR_GENERIC_FS_PATH_NOT_FOUND; }
+    if(module != new_module || old_ns_id != new_ns_id) { return -EXDEV; }
+    return module->Rename(old_path + old_len, new_path + new_len);
+}
+
+int labstor::GenericPosix::Client::Mkdir(const char *path, int mode) {
+    AUTO_TRACE(path)
+    int len;
+    uint32_t ns_id;
+    labstor::Posix::Client *module = FindModule(path, ns_id, len);
+    if(module == nullptr) { return LABSTOR_GENERIC_FS_PATH_NOT_FOUND; }
+    return module->Mkdir(path + len, mode);
+}
+
+int labstor::GenericPosix::Client::Rmdir(const char *path) {
+    AUTO_TRACE(path)
+    int len;
+    uint32_t ns_id;
+    labstor::Posix::Client *module = FindModule(path, ns_id, len);
+    if(module == nullptr) { return LABSTOR_GENERIC_FS_PATH_NOT_FOUND; }
+    return module->Rmdir(path + len);
+}
+
+int labstor::GenericPosix::Client::Opendir(const char *path, DIR *&dir) {
+    AUTO_TRACE(path)
+    int fd = Open(path, O_RDONLY | O_DIRECTORY);
+    if(fd < 0) { return fd; }
+    DirStream *stream = new DirStream();
+    stream->fd_ = fd;
+    stream->cookie_ = 0;
+    stream->count_ = 0;
+    stream->cur_ = 0;
+    stream->pos_ = 0;
+    dir = reinterpret_cast<DIR*>(stream);
+    std::lock_guard<std::mutex> lock(dir_lock_);
+    dirs_.emplace(dir);
+    return 0;
+}
+
+int labstor::GenericPosix::Client::Readdir(DIR *dir, struct dirent *&ent) {
+    AUTO_TRACE("")
+    uint32_t ns_id;
+    int code;
+    {
+        std::lock_guard<std::mutex> lock(dir_lock_);
+        if(dirs_.find(dir) == dirs_.end()) { return LABSTOR_GENERIC_FS_INVALID_FD; }
+    }
+    DirStream *stream = reinterpret_cast<DirStream*>(dir);
+    if(stream->cur_ == stream->count_) {
+        if(!GetNamespaceID(stream->fd_, ns_id)) { return -EBADF; }
+        code = namespace_->GetModule<labstor::Posix::Client>(ns_id)->Readdir(stream->fd_, stream->cookie_, stream->entries_, stream->count_);
+        if(code < 0) { return code; }
+        stream->cur_ = 0;
+        stream->pos_ = 0;
+        if(stream->count_ == 0) {
+            ent = nullptr;
+            return 0;
+        }
+    }
+    labstor::GenericPosix::dir_entry *entry = reinterpret_cast<labstor::GenericPosix::dir_entry*>(stream->entries_ + stream->pos_);
+    stream->dirent_.d_ino = entry->ino_;
+    stream->dirent_.d_off = stream->cookie_ - stream->count_ + stream->cur_ + 1;
+    stream->dirent_.d_reclen = sizeof(struct dirent);
+    stream->dirent_.d_type = entry->type_;
+    strncpy(stream->dirent_.d_name, entry->name_, sizeof(stream->dirent_.d_name) - 1);
+    stream->dirent_.d_name[sizeof(stream->dirent_.d_name) - 1] = 0;
+    stream->pos_ += entry->reclen_;
+    ++stream->cur_;
+    ent = &stream->dirent_;
+    return 0;
+}
+
+int labstor::GenericPosix::Client::Closedir(DIR *dir) {
+    AUTO_TRACE("")
+    {
+        std::lock_guard<std::mutex> lock(dir_lock_);
+        if(dirs_.erase(dir) == 0) { return LABSTOR_GENERIC_FS_INVALID_FD; }
+    }
+    DirStream *stream = reinterpret_cast<DirStream*>(dir);
+    Close(stream->fd_);
+    delete stream;
+    return 0;
+}
+
+/*
+ * Convert an fopen() mode to open() flags. Invalid modes are left to libc to reject.
+ * */
+static int StdioModeToFlags(const char *mode) {
+    int oflag;
+    switch(mode[0]) {
+        case 'r': oflag = O_RDONLY; break;
+        case 'w': oflag = O_WRONLY | O_CREAT | O_TRUNC; break;
+        case 'a': oflag = O_WRONLY | O_CREAT | O_APPEND; break;
+        default: return -EINVAL;
+    }
+    for(const char *c = mode + 1; *c; ++c) {
+        switch(*c) {
+            case '+': oflag = (oflag & ~O_ACCMODE) | O_RDWR; break;
+            case 'x': oflag |= O_EXCL; break;
+            case 'e': oflag |= O_CLOEXEC; break;
+        }
+    }
+    return oflag;
+}
+
+static inline int StdioErrno(int64_t ret) {
+    return ret == LABSTOR_GENERIC_FS_INVALID_FD ? EBADF : -ret;
+}
+
+static ssize_t StdioRead(void *cookie, char *buf, size_t size) {
+    labstor::GenericPosix::StdioStream *stream = reinterpret_cast<labstor::GenericPosix::StdioStream*>(cookie);
+    ssize_t ret = stream->client_->Read(stream->fd_, buf, size);
+    if(ret < 0) {
+        errno = StdioErrno(ret);
+        return -1;
+    }
+    return ret;
+}
+
+//A full stream buffer is flushed here as a single request
+static ssize_t StdioWrite(void *cookie, const char *buf, size_t size) {
+    labstor::GenericPosix::StdioStream *stream = reinterpret_cast<labstor::GenericPosix::StdioStream*>(cookie);
+    ssize_t ret = stream->client_->Write(stream->fd_, (void*)buf, size);
+    if(ret < 0) {
+        errno = StdioErrno(ret);
+        return 0;
+    }
+    return ret;
+}
+
+static int StdioSeek(void *cookie, off64_t *off, int whence) {
+    labstor::GenericPosix::StdioStream *stream = reinterpret_cast<labstor::GenericPosix::StdioStream*>(cookie);
+    int64_t ret = stream->client_->Lseek(stream->fd_, *off, whence);
+    if(ret < 0) {
+        errno = StdioErrno(ret);
+        return -1;
+    }
+    *off = ret;
+    return 0;
+}
+
+static int StdioClose(void *cookie) {
+    labstor::GenericPosix::StdioStream *stream = reinterpret_cast<labstor::GenericPosix::StdioStream*>(cookie);
+    return stream->client_->CloseStream(stream);
+}
+
+int labstor::GenericPosix::Client::Fopen(const char *path, const char *mode, ::FILE *&fp) {
+    AUTO_TRACE(path)
+    int oflag = StdioModeToFlags(mode);
+    if(oflag < 0) { return LABSTOR_GENERIC_FS_PATH_NOT_FOUND; }
+    int fd = Open(path, oflag);
+    if(fd < 0) { return fd; }
+    int ret = Fdopen(fd, mode, fp);
+    if(ret < 0) { Close(fd); }
+    return ret;
+}
+
+int labstor::GenericPosix::Client::Fdopen(int fd, const char *mode, ::FILE *&fp) {
+    AUTO_TRACE(fd)
+    uint32_t ns_id;
+    if(!GetNamespaceID(fd, ns_id)) { return LABSTOR_GENERIC_FS_INVALID_FD; }
+    StdioStream *stream = new StdioStream();
+    stream->client_ = this;
+    stream->fd_ = fd;
+    stream->buf_size_ = std::min<size_t>(LABSTOR_STDIO_BUF_SIZE, ipc_manager_->GetMaxBufferSize());
+    stream->buf_ = reinterpret_cast<char*>(ipc_manager_->AllocBuffer(stream->buf_size_));
+    stream->is_shmem_ = (stream->buf_ != nullptr);
+    if(!stream->is_shmem_) {
+        stream->buf_size_ = LABSTOR_STDIO_BUF_SIZE;
+        stream->buf_ = reinterpret_cast<char*>(malloc(stream->buf_size_));
+    }
+
+    //Stdio formats into the stream buffer and calls back into LabStor on flush
+    cookie_io_functions_t io = {StdioRead, StdioWrite, StdioSeek, StdioClose};
+    fp = fopencookie(stream, mode, io);
+    if(fp == nullptr) {
+        int code = -errno;
+        if(stream->is_shmem_) { ipc_manager_->FreeBuffer(stream->buf_); } else { free(stream->buf_); }
+        delete stream;
+        return code;
+    }
+    setvbuf(fp, stream->buf_, _IOFBF, stream->buf_size_);
+    stream->fp_ = fp;
+    std::lock_guard<std::mutex> lock(stream_lock_);
+    streams_.emplace(fp, stream);
+    return 0;
+}
+
+int labstor::GenericPosix::Client::Fileno(::FILE *fp) {
+    std::lock_guard<std::mutex> lock(stream_lock_);
+    auto iter = streams_.find(fp);
+    if(iter == streams_.end()) { return LABSTOR_GENERIC_FS_INVALID_FD; }
+    return iter->second->fd_;
+}
+
+int labstor::GenericPosix::Client::CloseStream(StdioStream *stream) {
+    AUTO_TRACE(stream->fd_)
+    {
+        std::lock_guard<std::mutex> lock(stream_lock_);
+        streams_.erase(stream->fp_);
+    }
+    Close(stream->fd_);
+    if(stream->is_shmem_) {
+        ipc_manager_->FreeBuffer(stream->buf_);
+    } else {
+        free(stream->buf_);
+    }
+    delete stream;
+    return 0;
+}
+
+int labstor::GenericPosix::Client::ASubmit(AsyncIO *aio) {
+    AUTO_TRACE(aio->fd_)
+    uint32_t ns_id;
+    char *buf;
+    bool seek = (aio->off_ != (size_t)-1);
+    if(!GetNamespaceID(aio->fd_, ns_id)) { return LABSTOR_GENERIC_FS_INVALID_FD; }
+    labstor::Posix::Client *client = namespace_->GetModule<labstor::Posix::Client>(ns_id);
+    if(!AStage(aio, buf)) { return 0; }
+    aio->qtok_ = seek ? client->AIO(aio->op_, aio->fd_, buf, aio->off_, aio->size_) : client->AIO(aio->op_, aio->fd_, buf, aio->size_);
+    return 0;
+}
+
+/*
+ * Submit count I/Os. Consecutive requests bound for the same queue pair are
+ * enqueued with a single EnqueueBatch. Submission stops at the first I/O on an
+ * invalid fd. Returns the number submitted, or the error if none were.
+ * */
+int labstor::GenericPosix::Client::ASubmit(AsyncIO **aios, int count) {
+    AUTO_TRACE(count)
+    labstor::GenericPosix::io_request *rqs[LABSTOR_AIO_SUBMIT_BATCH], *rq;
+    labstor::ipc::qtok_t qtoks[LABSTOR_AIO_SUBMIT_BATCH];
+    AsyncIO *batch[LABSTOR_AIO_SUBMIT_BATCH];
+    labstor::queue_pair *qp, *batch_qp = nullptr;
+    labstor::Posix::Client *client;
+    uint32_t ns_id;
+    int i, j, num_batched = 0;
+    char *buf;
+    auto flush = [&]() {
+        if(num_batched == 0) { return; }
+        batch_qp->EnqueueBatch<labstor::GenericPosix::io_request>(rqs, num_batched, qtoks);
+        for(j = 0; j < num_batched; ++j) {
+            batch[j]->qtok_ = qtoks[j];
+        }
+        num_batched = 0;
+    };
+    for(i = 0; i < count; ++i) {
+        AsyncIO *aio = aios[i];
+        if(!GetNamespaceID(aio->fd_, ns_id)) { break; }
+        client = namespace_->GetModule<labstor::Posix::Client>(ns_id);
+        if(!AStage(aio, buf)) { continue; }
+        rq = aio->off_ != (size_t)-1 ? client->AllocIO(qp, aio->op_, aio->fd_, buf, aio->off_, aio->size_) : nullptr;
+        if(rq == nullptr) {
+            //Keep the I/Os in submission order
+            flush();
+            aio->qtok_ = aio->off_ != (size_t)-1 ? client->AIO(aio->op_, aio->fd_, buf, aio->off_, aio->size_) : client->AIO(aio->op_, aio->fd_, buf, aio->size_);
+            continue;
+        }
+        if(qp != batch_qp || num_batched == LABSTOR_AIO_SUBMIT_BATCH) {
+            flush();
+            batch_qp = qp;
+        }
+        rqs[num_batched] = rq;
+        batch[num_batched++] = aio;
+    }
+    flush();
+    return (i == 0 && count > 0) ? LABSTOR_GENERIC_FS_INVALID_FD : i;
+}
+
+/*
+ * Stage the payload in a pool buffer so the I/O can be served in place after
+ * submission returns. buf is set to the buffer the request should reference.
+ * Returns false if the I/O was instead completed synchronously.
+ * */
+bool labstor::GenericPosix::Client::AStage(AsyncIO *aio, char *&buf) {
+    bool seek = (aio->off_ != (size_t)-1);
+    buf = aio->buf_;
+    aio->done_ = false;
+    aio->stage_ = nullptr;
+    if(aio->size_ > 0 && ipc_manager_->GetMaxBufferSize() && !ipc_manager_->IsBuffer(buf)) {
+        aio->stage_ = reinterpret_cast<char*>(ipc_manager_->AllocBuffer(aio->size_));
+        if(aio->stage_ == nullptr) {
+            //The payload does not fit in a pool buffer, so complete it synchronously
+            aio->ret_ = seek ? IO(aio->op_, aio->fd_, buf, aio->off_, aio->size_) : IO(aio->op_, aio->fd_, buf, aio->size_);
+            aio->done_ = true;
+            return false;
+        }
+        if(aio->op_ == labstor::GenericPosix::Ops::kWrite) {
+            memcpy(aio->stage_, buf, aio->size_);
+        }
+        buf = aio->stage_;
+    }
+    return true;
+}
+
+/*
+ * Reap the completed I/Os among aios without blocking. Consecutive I/Os on the
+ * same queue pair are reaped with a single pass over its completion ring.
+ * Completed I/Os are moved to the front of aios. Returns the number completed.
+ * */
+int labstor::GenericPosix::Client::AReap(AsyncIO **aios, int count) {
+    AUTO_TRACE(count)
+    labstor::GenericPosix::io_request *rqs[LABSTOR_AIO_REAP_BATCH];
+    labstor::ipc::qtok_t qtoks[LABSTOR_AIO_REAP_BATCH];
+    labstor::queue_pair *qp;
+    int i, j, k, run, num_reaped;
+    for(i = 0; i < count; i += run) {
+        run = 1;
+        if(aios[i]->done_) { continue; }
+        qtoks[0] = aios[i]->qtok_;
+        for(; i + run < count && run < LABSTOR_AIO_REAP_BATCH; ++run) {
+            if(aios[i + run]->done_ || !(aios[i + run]->qtok_.qid_ == aios[i]->qtok_.qid_)) { break; }
+            qtoks[run] = aios[i + run]->qtok_;
+        }
+        ipc_manager_->GetQueuePair(qp, aios[i]->qtok_);
+        num_reaped = qp->ReapCompleted<labstor::GenericPosix::io_request>(qtoks, run, rqs);
+        for(j = 0; j < num_reaped; ++j) {
+            for(k = i; k < i + run; ++k) {
+                if(!aios[k]->done_ && aios[k]->qtok_.req_id_ == rqs[j]->GetRequestID()) {
+                    AComplete(aios[k], rqs[j]);
+                    break;
+                }
+            }
+        }
+    }
+    return std::stable_partition(aios, aios + count, [](AsyncIO *aio) { return aio->done_; }) - aios;
+}
+
+void labstor::GenericPosix::Client::AWait(AsyncIO *aio) {
+    AUTO_TRACE(aio->fd_)
+    if(aio->done_) { return; }
+    AComplete(aio, ipc_manager_->Wait<labstor::GenericPosix::io_request>(aio->qtok_));
+}
+
+void labstor::GenericPosix::Client::AComplete(AsyncIO *aio, labstor::GenericPosix::io_request *rq) {
+    aio->ret_ = rq->GetSize();
+    ipc_manager_->FreeRequest<labstor::GenericPosix::io_request>(aio->qtok_, rq);
+    if(aio->stage_) {
+        if(aio->op_ == labstor::GenericPosix::Ops::kRead && aio->ret_ > 0) {
+            memcpy(aio->buf_, aio->stage_, aio->ret_);
+        }
+        ipc_manager_->FreeBuffer(aio->stage_);
+        aio->stage_ = nullptr;
+    }
+    aio->done_ = true;
+}
+
 labstor::ipc::qtok_t labstor::GenericPosix::Client::AIO(labstor::GenericPosix::Ops op, int fd, void *buf, size_t off, ssize_t size) {
     AUTO_TRACE("")
-    if(fd < fd_min_) { return labstor::ipc::qtok_t(); }
-    uint32_t ns_id = fd_to_ns_id_[fd];
+    uint32_t ns_id;
+    if(!GetNamespaceID(fd, ns_id)) { return labstor::ipc::qtok_t(); }
     labstor::Posix::Client *client = namespace_->GetModule<labstor::Posix::Client>(ns_id);
     return client->AIO(op, fd, buf, off, size);
 }
 
 labstor::ipc::qtok_t labstor::GenericPosix::Client::AIO(labstor::GenericPosix::Ops op, int fd, void *buf, ssize_t size) {
     AUTO_TRACE("")
-    if(fd < fd_min_) { return labstor::ipc::qtok_t(); }
-    uint32_t ns_id = fd_to_ns_id_[fd];
+    uint32_t ns_id;
+    if(!GetNamespaceID(fd, ns_id)) { return labstor::ipc::qtok_t(); }
     labstor::Posix::Client *client = namespace_->GetModule<labstor::Posix::Client>(ns_id);
     return client->AIO(op, fd, buf, size);
 }
 
 ssize_t labstor::GenericPosix::Client::IO(labstor::GenericPosix::Ops op, int fd, void *buf, size_t off, ssize_t size) {
     AUTO_TRACE("")
-    if(fd < fd_min_) { return -1; }
-    uint32_t ns_id = fd_to_ns_id_[fd];
+    uint32_t ns_id;
+    if(!GetNamespaceID(fd, ns_id)) { return LABSTOR_GENERIC_FS_INVALID_FD; }
     labstor::Posix::Client *client = namespace_->GetModule<labstor::Posix::Client>(ns_id);
+    if(size > 0 && ipc_manager_->GetMaxBufferSize() && !ipc_manager_->IsBuffer(buf)) {
+        return StageIO(ipc_manager_, client, op, fd, reinterpret_cast<char*>(buf), off, size, true);
+    }
     return client->IO(op, fd, buf, off, size);
 }
 
 ssize_t labstor::GenericPosix::Client::IO(labstor::GenericPosix::Ops op, int fd, void *buf, ssize_t size) {
     AUTO_TRACE("")
-    if(fd < fd_min_) { return -1; }
-    uint32_t ns_id = fd_to_ns_id_[fd];
+    uint32_t ns_id;
+    if(!GetNamespaceID(fd, ns_id)) { return LABSTOR_GENERIC_FS_INVALID_FD; }
     labstor::Posix::Client *client = namespace_->GetModule<labstor::Posix::Client>(ns_id);
+    if(size > 0 && ipc_manager_->GetMaxBufferSize() && !ipc_manager_->IsBuffer(buf)) {
+        return StageIO(ipc_manager_, client, op, fd, reinterpret_cast<char*>(buf), 0, size, false);
+    }
     return client->IO(op, fd, buf, size);
 }
 
+/*
+ * Vectored I/O gathers as many iovecs as fit in a pool buffer and submits them
+ * as a single request. Without a pool, each iovec is its own request.
+ * */
+ssize_t labstor::GenericPosix::Client::IOV(labstor::GenericPosix::Ops op, int fd, const struct iovec *iov, int iovcnt, size_t off, bool seek) {
+    AUTO_TRACE(iovcnt)
+    uint32_t ns_id;
+    if(!GetNamespaceID(fd, ns_id)) { return LABSTOR_GENERIC_FS_INVALID_FD; }
+    labstor::Posix::Client *client = namespace_->GetModule<labstor::Posix::Client>(ns_id);
+    size_t total_size = 0, max_size, count;
+    ssize_t total = 0, ret;
+    char *stage = nullptr;
+    int i = 0, j;
+    size_t iov_off = 0, j_off;
+
+    for(int k = 0; k < iovcnt; ++k) {
+        total_size += iov[k].iov_len;
+    }
+    max_size = std::min<size_t>(total_size, ipc_manager_->GetMaxBufferSize());
+    if(max_size) {
+        stage = reinterpret_cast<char*>(ipc_manager_->AllocBuffer(max_size));
+    }
+    if(stage == nullptr) {
+        for(; i < iovcnt; ++i) {
+            count = iov[i].iov_len;
+            ret = seek ? client->IO(op, fd, iov[i].iov_base, off + total, count) : client->IO(op, fd, iov[i].iov_base, count);
+            if(ret <= 0) {
+                if(total == 0) { total = ret; }
+                break;
+            }
+            total += ret;
+            if((size_t)ret < count) { break; }
+        }
+        return total;
+    }
+
+    while(i < iovcnt) {
+        j = i;
+        j_off = iov_off;
+        count = WalkIov(iov, iovcnt, j, j_off, op == labstor::GenericPosix::Ops::kWrite ? stage : nullptr, max_size, false);
+        if(count == 0) { break; }
+        ret = seek ? client->IO(op, fd, stage, off + total, count) : client->IO(op, fd, stage, count);
+        if(ret <= 0) {
+            if(total == 0) { total = ret; }
+            break;
+        }
+        if(op == labstor::GenericPosix::Ops::kRead) {
+            WalkIov(iov, iovcnt, i, iov_off, stage, ret, true);
+        }
+        total += ret;
+        if((size_t)ret < count) { break; }
+        i = j;
+        iov_off = j_off;
+    }
+    ipc_manager_->FreeBuffer(stage);
+    return total;
+}
+
 LABSTOR_MODULE_CONSTRUCT(labstor::GenericPosix::Client, GENERIC_POSIX_MODULE_ID);
\ No newline at end of file
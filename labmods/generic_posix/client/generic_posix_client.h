@@ -37,12 +37,26 @@
 #include <labstor/userspace/client/namespace.h>
 #include <labstor/userspace/util/error.h>
 #include <mutex>
+#include <vector>
+#include <sys/uio.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <unordered_set>
+#include <unordered_map>
 
 //TODO: Make this configurable
 #define LABSTOR_FD_MIN 50000
 #define LABSTOR_PATH_PREFIX "lab::"
 #define LABSTOR_MAX_FDS_PER_THREAD 1000
 #define LABSTOR_INVALID_FD -1
+#define LABSTOR_FD_UNUSED 0xFFFFFFFFu
+#define LABSTOR_STDIO_BUF_SIZE (1<<20)
+#define LABSTOR_AIO_REAP_BATCH 32
+#define LABSTOR_AIO_SUBMIT_BATCH 32
+
+namespace labstor::Posix {
+class Client;
+}
 
 namespace labstor::GenericPosix {
 
@@ -50,7 +64,7 @@ const Error TOO_MANY_FDS(5000, "Too many file descriptors allocated by thread");
 
 struct FDAllocator {
     int min_fd_, alloced_fds_, max_fds_;
-    labstor::ipc::mpmc::ring_buffer<int> free_fds_;
+    labstor::ipc::mpmc::lockless_ring_buffer<int> free_fds_;
     FDAllocator(int min_fd, char *region, size_t fd_alloc_size, int max_fds_per_thread) {
         free_fds_.Init(region, fd_alloc_size, max_fds_per_thread);
         min_fd_ = min_fd;
@@ -63,17 +77,58 @@ struct FDAllocator {
         if(free_fds_.Dequeue(fd)) {
             return fd;
         }
-        fd = min_fd_ + alloced_fds_;
-        if(fd >= min_fd_ + max_fds_) {
+        if(alloced_fds_ >= max_fds_) {
             throw TOO_MANY_FDS.format();
         }
-        return fd;
+        return min_fd_ + alloced_fds_++;
     }
     void Free(int fd) {
         free_fds_.Enqueue(fd);
     }
 };
 
+/*
+ * The state of a directory stream over a LabStor directory. Entries are fetched
+ * from the module in batches and converted to dirents one at a time.
+ * */
+struct DirStream {
+    int fd_;
+    uint64_t cookie_;
+    uint32_t count_, cur_, pos_;
+    struct dirent dirent_;
+    char entries_[LABSTOR_READDIR_SIZE];
+};
+
+/*
+ * The state of a stdio stream over a LabStor fd. The stream buffer comes from
+ * the data buffer pool when possible, so each flush is a single zero-copy request.
+ * */
+/*
+ * An asynchronous I/O on a LabStor fd. Payloads outside of the data buffer pool
+ * are staged through a pool buffer until the I/O is reaped. An offset of -1
+ * uses the file offset. data_ belongs to the front-end that submitted the I/O.
+ * */
+struct AsyncIO {
+    labstor::GenericPosix::Ops op_;
+    int fd_;
+    char *buf_, *stage_;
+    size_t off_;
+    ssize_t size_, ret_;
+    labstor::ipc::qtok_t qtok_;
+    bool done_;
+    void *data_;
+};
+
+class Client;
+struct StdioStream {
+    Client *client_;
+    ::FILE *fp_;
+    int fd_;
+    char *buf_;
+    size_t buf_size_;
+    bool is_shmem_;
+};
+
 class Client : public labstor::Module {
 private:
     LABSTOR_IPC_MANAGER_T ipc_manager_;
@@ -83,18 +138,25 @@ private:
     int fd_min_;
     std::string prefix_;
     std::vector<FDAllocator> fds_;
-    std::unordered_map<int, uint32_t> fd_to_ns_id_;
+    std::vector<uint32_t> fd_table_;
+    std::unordered_set<DIR*> dirs_;
+    std::mutex dir_lock_;
+    std::unordered_map<::FILE*, StdioStream*> streams_;
+    std::mutex stream_lock_;
 public:
     Client() : labstor::Module(GENERIC_POSIX_MODULE_ID) {
         ipc_manager_ = LABSTOR_IPC_MANAGER;
         namespace_ = LABSTOR_NAMESPACE;
         is_initialized_ = false;
-        size_t fd_alloc_size = labstor::ipc::mpmc::ring_buffer<int>::GetSize(LABSTOR_MAX_FDS_PER_THREAD);
+        fd_min_ = LABSTOR_FD_MIN;
+        prefix_ = LABSTOR_PATH_PREFIX;
+        fd_table_.resize(ipc_manager_->GetNumCPU() * LABSTOR_MAX_FDS_PER_THREAD, LABSTOR_FD_UNUSED);
+        size_t fd_alloc_size = labstor::ipc::mpmc::lockless_ring_buffer<int>::GetSize(LABSTOR_MAX_FDS_PER_THREAD);
         char *region = (char*)malloc( fd_alloc_size * ipc_manager_->GetNumCPU());
         fds_.reserve(ipc_manager_->GetNumCPU());
         for(int i = 0; i < ipc_manager_->GetNumCPU(); ++i) {
-            region += fd_alloc_size;
             fds_.emplace_back(LABSTOR_FD_MIN + i*LABSTOR_MAX_FDS_PER_THREAD, region, fd_alloc_size, LABSTOR_MAX_FDS_PER_THREAD);
+            region += fd_alloc_size;
         }
     }
     void Register(YAML::Node config) override;
@@ -102,6 +164,7 @@ public:
     inline bool IsInitialized() {
         return is_initialized_;
     }
+    labstor::Posix::Client* FindModule(const char *path, uint32_t &ns_id, int &len);
     int Open(const char *path, int oflag);
     int Close(int fd);
     int AllocateFD() {
@@ -111,6 +174,22 @@ public:
     void FreeFD(int fd) {
         return fds_[labstor::ThreadLocal::GetTid()].Free(fd);
     }
+
+    /*
+     * LabStor fds are dense, so the module owning an fd is found by indexing
+     * rather than hashing. Entries are only written by Open and Close.
+     * */
+    inline bool GetNamespaceID(int fd, uint32_t &ns_id) {
+        if(fd < fd_min_ || (size_t)(fd - fd_min_) >= fd_table_.size()) {
+            return false;
+        }
+        ns_id = __atomic_load_n(&fd_table_[fd - fd_min_], __ATOMIC_ACQUIRE);
+        return ns_id != LABSTOR_FD_UNUSED;
+    }
+    inline void SetNamespaceID(int fd, uint32_t ns_id) {
+        __atomic_store_n(&fd_table_[fd - fd_min_], ns_id, __ATOMIC_RELEASE);
+    }
+
     labstor::ipc::qtok_t AIO(labstor::GenericPosix::Ops op, int fd, void *buf, size_t off, ssize_t size);
     labstor::ipc::qtok_t ARead(int fd, void *buf, size_t off, ssize_t size) {
         return AIO(labstor::GenericPosix::Ops::kRead, fd, buf, off, size);
@@ -142,6 +221,46 @@ public:
     ssize_t Write(int fd, void *buf, ssize_t size) {
         return IO(labstor::GenericPosix::Ops::kWrite, fd, buf, size);
     }
+
+    int Stat(const char *path, struct stat *st);
+    int Fstat(int fd, struct stat *st);
+    int64_t Lseek(int fd, int64_t off, int whence);
+    int Fsync(int fd, bool data_only);
+    int Unlink(const char *path);
+    int Rename(const char *old_path, const char *new_path);
+    int Mkdir(const char *path, int mode);
+    int Rmdir(const char *path);
+    int Opendir(const char *path, DIR *&dir);
+    int Readdir(DIR *dir, struct dirent *&ent);
+    int Closedir(DIR *dir);
+
+    int Fopen(const char *path, const char *mode, ::FILE *&fp);
+    int Fdopen(int fd, const char *mode, ::FILE *&fp);
+    int Fileno(::FILE *fp);
+    int CloseStream(StdioStream *stream);
+
+    int ASubmit(AsyncIO *aio);
+    int ASubmit(AsyncIO **aios, int count);
+    int AReap(AsyncIO **aios, int count);
+    void AWait(AsyncIO *aio);
+private:
+    bool AStage(AsyncIO *aio, char *&buf);
+    void AComplete(AsyncIO *aio, labstor::GenericPosix::io_request *rq);
+public:
+
+    ssize_t IOV(labstor::GenericPosix::Ops op, int fd, const struct iovec *iov, int iovcnt, size_t off, bool seek);
+    ssize_t ReadV(int fd, const struct iovec *iov, int iovcnt, size_t off) {
+        return IOV(labstor::GenericPosix::Ops::kRead, fd, iov, iovcnt, off, true);
+    }
+    ssize_t WriteV(int fd, const struct iovec *iov, int iovcnt, size_t off) {
+        return IOV(labstor::GenericPosix::Ops::kWrite, fd, iov, iovcnt, off, true);
+    }
+    ssize_t ReadV(int fd, const struct iovec *iov, int iovcnt) {
+        return IOV(labstor::GenericPosix::Ops::kRead, fd, iov, iovcnt, 0, false);
+    }
+    ssize_t WriteV(int fd, const struct iovec *iov, int iovcnt) {
+        return IOV(labstor::GenericPosix::Ops::kWrite, fd, iov, iovcnt, 0, false);
+    }
 };
 }
 
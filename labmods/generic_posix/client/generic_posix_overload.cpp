@@ -58,8 +58,10 @@
 #include <errno.h>
 #include <sys/mman.h>
 #include <aio.h>
+#include <dirent.h>
 
 #include "generic_posix_client.h"
+#include "generic_posix_aio.h"
 
 /**
  * PROTOTYPES
@@ -77,20 +79,57 @@ FORWARD_DECL(int, open, const char *path, int oflag, ...)
 FORWARD_DECL(int, close, int fd)
 FORWARD_DECL(ssize_t, read, int fd, void *buf, size_t size)
 FORWARD_DECL(ssize_t, write, int fd, void *buf, size_t size)
-FORWARD_DECL(ssize_t, pread, int fd, void *buf, size_t size, labstor::off_t offset)
-FORWARD_DECL(ssize_t, pwrite, int fd, const void *buf, size_t size, labstor::off_t offset)
+FORWARD_DECL(ssize_t, pread, int fd, void *buf, size_t size, ::off_t offset)
+FORWARD_DECL(ssize_t, pwrite, int fd, const void *buf, size_t size, ::off_t offset)
 FORWARD_DECL(ssize_t, pread64, int fd, void *buf, size_t size, off64_t offset)
 FORWARD_DECL(ssize_t, pwrite64, int fd, const void *buf, size_t size, off64_t offset)
 FORWARD_DECL(ssize_t, readv, int fd, const struct iovec *iov, int iovcnt)
-FORWARD_DECL(ssize_t, preadv, int fd, const struct iovec *iov, int iovcnt, labstor::off_t offset)
+FORWARD_DECL(ssize_t, preadv, int fd, const struct iovec *iov, int iovcnt, ::off_t offset)
 FORWARD_DECL(ssize_t, preadv64, int fd, const struct iovec *iov, int iovcnt, off64_t offset)
-FORWARD_DECL(ssize_t, preadv2, int fd, const struct iovec *iov, int iovcnt, labstor::off_t offset, int flags)
+FORWARD_DECL(ssize_t, preadv2, int fd, const struct iovec *iov, int iovcnt, ::off_t offset, int flags)
 FORWARD_DECL(ssize_t, preadv64v2, int fd, const struct iovec *iov, int iovcnt, off64_t offset, int flags)
 FORWARD_DECL(ssize_t, writev, int fd, const struct iovec *iov, int iovcnt)
-FORWARD_DECL(ssize_t, pwritev, int fd, const struct iovec *iov, int iovcnt, labstor::off_t offset)
+FORWARD_DECL(ssize_t, pwritev, int fd, const struct iovec *iov, int iovcnt, ::off_t offset)
 FORWARD_DECL(ssize_t, pwritev64, int fd, const struct iovec *iov, int iovcnt, off64_t offset)
-FORWARD_DECL(ssize_t, pwritev2, int fd, const struct iovec *iov, int iovcnt, labstor::off_t offset, int flags)
+FORWARD_DECL(ssize_t, pwritev2, int fd, const struct iovec *iov, int iovcnt, ::off_t offset, int flags)
 FORWARD_DECL(ssize_t, pwritev64v2, int fd, const struct iovec *iov, int iovcnt, off64_t offset, int flags)
+FORWARD_DECL(int, stat, const char *path, struct stat *st)
+FORWARD_DECL(int, lstat, const char *path, struct stat *st)
+FORWARD_DECL(int, fstat, int fd, struct stat *st)
+FORWARD_DECL(int, __xstat, int ver, const char *path, struct stat *st)
+FORWARD_DECL(int, __lxstat, int ver, const char *path, struct stat *st)
+FORWARD_DECL(int, __fxstat, int ver, int fd, struct stat *st)
+FORWARD_DECL(off_t, lseek, int fd, off_t offset, int whence)
+FORWARD_DECL(off64_t, lseek64, int fd, off64_t offset, int whence)
+FORWARD_DECL(int, fsync, int fd)
+FORWARD_DECL(int, fdatasync, int fd)
+FORWARD_DECL(int, unlink, const char *path)
+FORWARD_DECL(int, rename, const char *old_path, const char *new_path)
+FORWARD_DECL(int, mkdir, const char *path, mode_t mode)
+FORWARD_DECL(int, rmdir, const char *path)
+FORWARD_DECL(DIR*, opendir, const char *path)
+FORWARD_DECL(struct dirent*, readdir, DIR *dir)
+FORWARD_DECL(int, closedir, DIR *dir)
+FORWARD_DECL(FILE*, fopen, const char *path, const char *mode)
+FORWARD_DECL(FILE*, fopen64, const char *path, const char *mode)
+FORWARD_DECL(FILE*, fdopen, int fd, const char *mode)
+FORWARD_DECL(int, fileno, FILE *fp)
+FORWARD_DECL(int, aio_read, struct aiocb *cb)
+FORWARD_DECL(int, aio_write, struct aiocb *cb)
+FORWARD_DECL(int, aio_fsync, int op, struct aiocb *cb)
+FORWARD_DECL(int, aio_error, const struct aiocb *cb)
+FORWARD_DECL(ssize_t, aio_return, struct aiocb *cb)
+FORWARD_DECL(int, aio_suspend, const struct aiocb *const list[], int nent, const struct timespec *timeout)
+FORWARD_DECL(int, aio_cancel, int fd, struct aiocb *cb)
+FORWARD_DECL(int, lio_listio, int mode, struct aiocb *const list[], int nent, struct sigevent *sig)
+FORWARD_DECL(int, aio_read64, struct aiocb64 *cb)
+FORWARD_DECL(int, aio_write64, struct aiocb64 *cb)
+FORWARD_DECL(int, aio_fsync64, int op, struct aiocb64 *cb)
+FORWARD_DECL(int, aio_error64, const struct aiocb64 *cb)
+FORWARD_DECL(ssize_t, aio_return64, struct aiocb64 *cb)
+FORWARD_DECL(int, aio_suspend64, const struct aiocb64 *const list[], int nent, const struct timespec *timeout)
+FORWARD_DECL(int, aio_cancel64, int fd, struct aiocb64 *cb)
+FORWARD_DECL(int, lio_listio64, int mode, struct aiocb64 *const list[], int nent, struct sigevent *sig)
 
 #define LABSTOR_GENERIC_POSIX_CLIENT_CLASS labstor::GenericPosix::Client
 #define LABSTOR_GENERIC_POSIX_CLIENT_T SINGLETON_T(LABSTOR_GENERIC_POSIX_CLIENT_CLASS)
@@ -98,6 +137,19 @@ FORWARD_DECL(ssize_t, pwritev64v2, int fd, const struct iovec *iov, int iovcnt,
 #define LABSTOR_GENERIC_POSIX_CLIENT LABSTOR_GENERIC_POSIX_CLIENT_SINGLETON::GetInstance()
 DEFINE_SINGLETON(GENERIC_POSIX_CLIENT);
 bool initialized_;
+labstor::GenericPosix::AiocbTable *aiocbs_;
+
+/*
+ * LabStor modules return a negative errno on failure.
+ * */
+template<typename T>
+static inline T LabStorReturn(int64_t ret) {
+    if(ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return ret;
+}
 
 /**
  * POSIX FUNCTIONS
@@ -109,21 +161,58 @@ static __attribute__((constructor)) void Init() {
     GETFUN(int, close, int fd);
     GETFUN(ssize_t, read, int fd, void *buf, size_t size);
     GETFUN(ssize_t, write, int fd, void *buf, size_t size);
-    GETFUN(ssize_t, pread, int fd, void *buf, size_t size, labstor::off_t offset);
-    GETFUN(ssize_t, pwrite, int fd, const void *buf, size_t size, labstor::off_t offset);
+    GETFUN(ssize_t, pread, int fd, void *buf, size_t size, ::off_t offset);
+    GETFUN(ssize_t, pwrite, int fd, const void *buf, size_t size, ::off_t offset);
     GETFUN(ssize_t, pread64, int fd, void *buf, size_t size, off64_t offset);
     GETFUN(ssize_t, pwrite64, int fd, const void *buf, size_t size, off64_t offset);
     GETFUN(ssize_t, readv, int fd, const struct iovec *iov, int iovcnt);
-    GETFUN(ssize_t, preadv, int fd, const struct iovec *iov, int iovcnt, labstor::off_t offset);
+    GETFUN(ssize_t, preadv, int fd, const struct iovec *iov, int iovcnt, ::off_t offset);
     GETFUN(ssize_t, preadv64, int fd, const struct iovec *iov, int iovcnt, off64_t offset);
-    GETFUN(ssize_t, preadv2, int fd, const struct iovec *iov, int iovcnt, labstor::off_t offset, int flags);
+    GETFUN(ssize_t, preadv2, int fd, const struct iovec *iov, int iovcnt, ::off_t offset, int flags);
     GETFUN(ssize_t, preadv64v2, int fd, const struct iovec *iov, int iovcnt, off64_t offset, int flags);
     GETFUN(ssize_t, writev, int fd, const struct iovec *iov, int iovcnt);
-    GETFUN(ssize_t, pwritev, int fd, const struct iovec *iov, int iovcnt, labstor::off_t offset);
+    GETFUN(ssize_t, pwritev, int fd, const struct iovec *iov, int iovcnt, ::off_t offset);
     GETFUN(ssize_t, pwritev64, int fd, const struct iovec *iov, int iovcnt, off64_t offset);
-    GETFUN(ssize_t, pwritev2, int fd, const struct iovec *iov, int iovcnt, labstor::off_t offset, int flags);
+    GETFUN(ssize_t, pwritev2, int fd, const struct iovec *iov, int iovcnt, ::off_t offset, int flags);
     GETFUN(ssize_t, pwritev64v2, int fd, const struct iovec *iov, int iovcnt, off64_t offset, int flags);
-    LABSTOR_GENERIC_POSIX_CLIENT;
+    GETFUN(int, stat, const char *path, struct stat *st);
+    GETFUN(int, lstat, const char *path, struct stat *st);
+    GETFUN(int, fstat, int fd, struct stat *st);
+    GETFUN(int, __xstat, int ver, const char *path, struct stat *st);
+    GETFUN(int, __lxstat, int ver, const char *path, struct stat *st);
+    GETFUN(int, __fxstat, int ver, int fd, struct stat *st);
+    GETFUN(off_t, lseek, int fd, off_t offset, int whence);
+    GETFUN(off64_t, lseek64, int fd, off64_t offset, int whence);
+    GETFUN(int, fsync, int fd);
+    GETFUN(int, fdatasync, int fd);
+    GETFUN(int, unlink, const char *path);
+    GETFUN(int, rename, const char *old_path, const char *new_path);
+    GETFUN(int, mkdir, const char *path, mode_t mode);
+    GETFUN(int, rmdir, const char *path);
+    GETFUN(DIR*, opendir, const char *path);
+    GETFUN(struct dirent*, readdir, DIR *dir);
+    GETFUN(int, closedir, DIR *dir);
+    GETFUN(FILE*, fopen, const char *path, const char *mode);
+    GETFUN(FILE*, fopen64, const char *path, const char *mode);
+    GETFUN(FILE*, fdopen, int fd, const char *mode);
+    GETFUN(int, fileno, FILE *fp);
+    GETFUN(int, aio_read, struct aiocb *cb);
+    GETFUN(int, aio_write, struct aiocb *cb);
+    GETFUN(int, aio_fsync, int op, struct aiocb *cb);
+    GETFUN(int, aio_error, const struct aiocb *cb);
+    GETFUN(ssize_t, aio_return, struct aiocb *cb);
+    GETFUN(int, aio_suspend, const struct aiocb *const list[], int nent, const struct timespec *timeout);
+    GETFUN(int, aio_cancel, int fd, struct aiocb *cb);
+    GETFUN(int, lio_listio, int mode, struct aiocb *const list[], int nent, struct sigevent *sig);
+    GETFUN(int, aio_read64, struct aiocb64 *cb);
+    GETFUN(int, aio_write64, struct aiocb64 *cb);
+    GETFUN(int, aio_fsync64, int op, struct aiocb64 *cb);
+    GETFUN(int, aio_error64, const struct aiocb64 *cb);
+    GETFUN(ssize_t, aio_return64, struct aiocb64 *cb);
+    GETFUN(int, aio_suspend64, const struct aiocb64 *const list[], int nent, const struct timespec *timeout);
+    GETFUN(int, aio_cancel64, int fd, struct aiocb64 *cb);
+    GETFUN(int, lio_listio64, int mode, struct aiocb64 *const list[], int nent, struct sigevent *sig);
+    aiocbs_ = new labstor::GenericPosix::AiocbTable(LABSTOR_GENERIC_POSIX_CLIENT);
     initialized_ = true;
 }
 
@@ -141,9 +230,9 @@ int WRAPPER_FUN(open)(const char *path, int oflag, ...) {
         fd = LABSTOR_GENERIC_POSIX_CLIENT->Open(path, oflag);
     }
     if(fd == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
-        fd = REAL_FUN(open)(path, oflag, mode);
+        return REAL_FUN(open)(path, oflag, mode);
     }
-    return fd;
+    return LabStorReturn<int>(fd);
 }
 
 int WRAPPER_FUN(close)(int fd) {
@@ -153,9 +242,9 @@ int WRAPPER_FUN(close)(int fd) {
         ret = LABSTOR_GENERIC_POSIX_CLIENT->Close(fd);
     }
     if(ret == LABSTOR_GENERIC_FS_INVALID_FD) {
-        ret = REAL_FUN(close)(fd);
+        return REAL_FUN(close)(fd);
     }
-    return ret;
+    return LabStorReturn<int>(ret);
 }
 
 ssize_t WRAPPER_FUN(read)(int fd, void *buf, size_t size) {
@@ -165,9 +254,9 @@ ssize_t WRAPPER_FUN(read)(int fd, void *buf, size_t size) {
         ret_size = LABSTOR_GENERIC_POSIX_CLIENT->Read(fd, buf, size);
     }
     if(ret_size == LABSTOR_GENERIC_FS_INVALID_FD) {
-        ret_size = REAL_FUN(read)(fd, buf, size);
+        return REAL_FUN(read)(fd, buf, size);
     }
-    return ret_size;
+    return LabStorReturn<ssize_t>(ret_size);
 }
 
 ssize_t WRAPPER_FUN(write)(int fd, void *buf, size_t size) {
@@ -177,77 +266,793 @@ ssize_t WRAPPER_FUN(write)(int fd, void *buf, size_t size) {
         ret_size = LABSTOR_GENERIC_POSIX_CLIENT->Write(fd, buf, size);
     }
     if(ret_size == LABSTOR_GENERIC_FS_INVALID_FD) {
-        ret_size = REAL_FUN(write)(fd, buf, size);
+        return REAL_FUN(write)(fd, buf, size);
     }
-    return ret_size;
+    return LabStorReturn<ssize_t>(ret_size);
 }
 
-ssize_t WRAPPER_FUN(pread)(int fd, void *buf, size_t size, labstor::off_t offset)
+ssize_t WRAPPER_FUN(pread)(int fd, void *buf, size_t size, ::off_t offset)
 {
-    return REAL_FUN(pread)(fd, buf, size, offset);
+    AUTO_TRACE("")
+    ssize_t ret_size = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret_size = LABSTOR_GENERIC_POSIX_CLIENT->Read(fd, buf, offset, size);
+    }
+    if(ret_size == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(pread)(fd, buf, size, offset);
+    }
+    return LabStorReturn<ssize_t>(ret_size);
 }
 
-ssize_t WRAPPER_FUN(pwrite)(int fd, const void *buf, size_t size, labstor::off_t offset)
+ssize_t WRAPPER_FUN(pwrite)(int fd, const void *buf, size_t size, ::off_t offset)
 {
-    return REAL_FUN(pwrite)(fd, buf, size, offset);
+    AUTO_TRACE("")
+    ssize_t ret_size = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret_size = LABSTOR_GENERIC_POSIX_CLIENT->Write(fd, (void*)buf, offset, size);
+    }
+    if(ret_size == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(pwrite)(fd, buf, size, offset);
+    }
+    return LabStorReturn<ssize_t>(ret_size);
 }
 
 ssize_t WRAPPER_FUN(pread64)(int fd, void *buf, size_t size, off64_t offset)
 {
-    return REAL_FUN(pread64)(fd, buf, size, offset);
+    AUTO_TRACE("")
+    ssize_t ret_size = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret_size = LABSTOR_GENERIC_POSIX_CLIENT->Read(fd, buf, offset, size);
+    }
+    if(ret_size == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(pread64)(fd, buf, size, offset);
+    }
+    return LabStorReturn<ssize_t>(ret_size);
 }
 
 ssize_t WRAPPER_FUN(pwrite64)(int fd, const void *buf, size_t size, off64_t offset)
 {
-    return REAL_FUN(pwrite64)(fd, buf, size, offset);
+    AUTO_TRACE("")
+    ssize_t ret_size = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret_size = LABSTOR_GENERIC_POSIX_CLIENT->Write(fd, (void*)buf, offset, size);
+    }
+    if(ret_size == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(pwrite64)(fd, buf, size, offset);
+    }
+    return LabStorReturn<ssize_t>(ret_size);
 }
 
 ssize_t WRAPPER_FUN(readv)(int fd, const struct iovec *iov, int iovcnt)
 {
-    return REAL_FUN(readv)(fd, iov, iovcnt);
+    AUTO_TRACE("")
+    ssize_t ret_size = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret_size = LABSTOR_GENERIC_POSIX_CLIENT->ReadV(fd, iov, iovcnt);
+    }
+    if(ret_size == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(readv)(fd, iov, iovcnt);
+    }
+    return LabStorReturn<ssize_t>(ret_size);
 }
 
-ssize_t WRAPPER_FUN(preadv)(int fd, const struct iovec *iov, int iovcnt, labstor::off_t offset)
+ssize_t WRAPPER_FUN(preadv)(int fd, const struct iovec *iov, int iovcnt, ::off_t offset)
 {
-    return REAL_FUN(preadv)(fd, iov, iovcnt, offset);
+    AUTO_TRACE("")
+    ssize_t ret_size = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret_size = LABSTOR_GENERIC_POSIX_CLIENT->ReadV(fd, iov, iovcnt, offset);
+    }
+    if(ret_size == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(preadv)(fd, iov, iovcnt, offset);
+    }
+    return LabStorReturn<ssize_t>(ret_size);
 }
 
 ssize_t WRAPPER_FUN(preadv64)(int fd, const struct iovec *iov, int iovcnt, off64_t offset)
 {
-    return REAL_FUN(preadv64)(fd, iov, iovcnt, offset);
+    AUTO_TRACE("")
+    ssize_t ret_size = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret_size = LABSTOR_GENERIC_POSIX_CLIENT->ReadV(fd, iov, iovcnt, offset);
+    }
+    if(ret_size == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(preadv64)(fd, iov, iovcnt, offset);
+    }
+    return LabStorReturn<ssize_t>(ret_size);
 }
 
-ssize_t WRAPPER_FUN(preadv2)(int fd, const struct iovec *iov, int iovcnt, labstor::off_t offset, int flags)
+ssize_t WRAPPER_FUN(preadv2)(int fd, const struct iovec *iov, int iovcnt, ::off_t offset, int flags)
 {
-    return REAL_FUN(preadv2)(fd, iov, iovcnt, offset, flags);
+    AUTO_TRACE("")
+    ssize_t ret_size = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        //An offset of -1 uses and updates the file offset
+        ret_size = (offset == -1) ?
+                LABSTOR_GENERIC_POSIX_CLIENT->ReadV(fd, iov, iovcnt) :
+                LABSTOR_GENERIC_POSIX_CLIENT->ReadV(fd, iov, iovcnt, offset);
+    }
+    if(ret_size == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(preadv2)(fd, iov, iovcnt, offset, flags);
+    }
+    return LabStorReturn<ssize_t>(ret_size);
 }
 
 ssize_t WRAPPER_FUN(preadv64v2)(int fd, const struct iovec *iov, int iovcnt, off64_t offset, int flags)
 {
-    return REAL_FUN(preadv64v2)(fd, iov, iovcnt, offset, flags);
+    AUTO_TRACE("")
+    ssize_t ret_size = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        //An offset of -1 uses and updates the file offset
+        ret_size = (offset == -1) ?
+                LABSTOR_GENERIC_POSIX_CLIENT->ReadV(fd, iov, iovcnt) :
+                LABSTOR_GENERIC_POSIX_CLIENT->ReadV(fd, iov, iovcnt, offset);
+    }
+    if(ret_size == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(preadv64v2)(fd, iov, iovcnt, offset, flags);
+    }
+    return LabStorReturn<ssize_t>(ret_size);
 }
 
 ssize_t WRAPPER_FUN(writev)(int fd, const struct iovec *iov, int iovcnt)
 {
-    return REAL_FUN(writev)(fd, iov, iovcnt);
+    AUTO_TRACE("")
+    ssize_t ret_size = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret_size = LABSTOR_GENERIC_POSIX_CLIENT->WriteV(fd, iov, iovcnt);
+    }
+    if(ret_size == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(writev)(fd, iov, iovcnt);
+    }
+    return LabStorReturn<ssize_t>(ret_size);
 }
 
-ssize_t WRAPPER_FUN(pwritev)(int fd, const struct iovec *iov, int iovcnt, labstor::off_t offset)
+ssize_t WRAPPER_FUN(pwritev)(int fd, const struct iovec *iov, int iovcnt, ::off_t offset)
 {
-    return REAL_FUN(pwritev)(fd, iov, iovcnt, offset);
+    AUTO_TRACE("")
+    ssize_t ret_size = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret_size = LABSTOR_GENERIC_POSIX_CLIENT->WriteV(fd, iov, iovcnt, offset);
+    }
+    if(ret_size == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(pwritev)(fd, iov, iovcnt, offset);
+    }
+    return LabStorReturn<ssize_t>(ret_size);
 }
 
 ssize_t WRAPPER_FUN(pwritev64)(int fd, const struct iovec *iov, int iovcnt, off64_t offset)
 {
-    return REAL_FUN(pwritev64)(fd, iov, iovcnt, offset);
+    AUTO_TRACE("")
+    ssize_t ret_size = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret_size = LABSTOR_GENERIC_POSIX_CLIENT->WriteV(fd, iov, iovcnt, offset);
+    }
+    if(ret_size == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(pwritev64)(fd, iov, iovcnt, offset);
+    }
+    return LabStorReturn<ssize_t>(ret_size);
 }
 
-ssize_t WRAPPER_FUN(pwritev2)(int fd, const struct iovec *iov, int iovcnt, labstor::off_t offset, int flags)
+ssize_t WRAPPER_FUN(pwritev2)(int fd, const struct iovec *iov, int iovcnt, ::off_t offset, int flags)
 {
-    return REAL_FUN(pwritev2)(fd, iov, iovcnt, offset, flags);
+    AUTO_TRACE("")
+    ssize_t ret_size = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        //An offset of -1 uses and updates the file offset
+        ret_size = (offset == -1) ?
+                LABSTOR_GENERIC_POSIX_CLIENT->WriteV(fd, iov, iovcnt) :
+                LABSTOR_GENERIC_POSIX_CLIENT->WriteV(fd, iov, iovcnt, offset);
+    }
+    if(ret_size == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(pwritev2)(fd, iov, iovcnt, offset, flags);
+    }
+    return LabStorReturn<ssize_t>(ret_size);
 }
 
 ssize_t WRAPPER_FUN(pwritev64v2)(int fd, const struct iovec *iov, int iovcnt, off64_t offset, int flags)
 {
-    return REAL_FUN(pwritev64v2)(fd, iov, iovcnt, offset, flags);
-}
\ No newline at end of file
+    AUTO_TRACE("")
+    ssize_t ret_size = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        //An offset of -1 uses and updates the file offset
+        ret_size = (offset == -1) ?
+                LABSTOR_GENERIC_POSIX_CLIENT->WriteV(fd, iov, iovcnt) :
+                LABSTOR_GENERIC_POSIX_CLIENT->WriteV(fd, iov, iovcnt, offset);
+    }
+    if(ret_size == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(pwritev64v2)(fd, iov, iovcnt, offset, flags);
+    }
+    return LabStorReturn<ssize_t>(ret_size);
+}
+
+/**
+ * METADATA FUNCTIONS
+ * */
+
+int WRAPPER_FUN(stat)(const char *path, struct stat *st) __THROW
+{
+    AUTO_TRACE("")
+    int64_t ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Stat(path, st);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD || ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(stat)(path, st);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(lstat)(const char *path, struct stat *st) __THROW
+{
+    AUTO_TRACE("")
+    int64_t ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Stat(path, st);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD || ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(lstat)(path, st);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(fstat)(int fd, struct stat *st) __THROW
+{
+    AUTO_TRACE("")
+    int64_t ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Fstat(fd, st);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD || ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(fstat)(fd, st);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(__xstat)(int ver, const char *path, struct stat *st) __THROW
+{
+    AUTO_TRACE("")
+    int64_t ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Stat(path, st);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD || ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(__xstat)(ver, path, st);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(__lxstat)(int ver, const char *path, struct stat *st) __THROW
+{
+    AUTO_TRACE("")
+    int64_t ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Stat(path, st);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD || ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(__lxstat)(ver, path, st);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(__fxstat)(int ver, int fd, struct stat *st) __THROW
+{
+    AUTO_TRACE("")
+    int64_t ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Fstat(fd, st);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD || ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(__fxstat)(ver, fd, st);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+off_t WRAPPER_FUN(lseek)(int fd, off_t offset, int whence) __THROW
+{
+    AUTO_TRACE("")
+    int64_t ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Lseek(fd, offset, whence);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD || ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(lseek)(fd, offset, whence);
+    }
+    return LabStorReturn<off_t>(ret);
+}
+
+off64_t WRAPPER_FUN(lseek64)(int fd, off64_t offset, int whence) __THROW
+{
+    AUTO_TRACE("")
+    int64_t ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Lseek(fd, offset, whence);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD || ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(lseek64)(fd, offset, whence);
+    }
+    return LabStorReturn<off64_t>(ret);
+}
+
+int WRAPPER_FUN(fsync)(int fd)
+{
+    AUTO_TRACE("")
+    int64_t ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Fsync(fd, false);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD || ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(fsync)(fd);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(fdatasync)(int fd)
+{
+    AUTO_TRACE("")
+    int64_t ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Fsync(fd, true);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD || ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(fdatasync)(fd);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(unlink)(const char *path) __THROW
+{
+    AUTO_TRACE("")
+    int64_t ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Unlink(path);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD || ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(unlink)(path);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(rename)(const char *old_path, const char *new_path) __THROW
+{
+    AUTO_TRACE("")
+    int64_t ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Rename(old_path, new_path);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD || ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(rename)(old_path, new_path);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(mkdir)(const char *path, mode_t mode) __THROW
+{
+    AUTO_TRACE("")
+    int64_t ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Mkdir(path, mode);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD || ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(mkdir)(path, mode);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(rmdir)(const char *path) __THROW
+{
+    AUTO_TRACE("")
+    int64_t ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Rmdir(path);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD || ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(rmdir)(path);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+DIR* WRAPPER_FUN(opendir)(const char *path)
+{
+    AUTO_TRACE("")
+    int ret = LABSTOR_GENERIC_FS_PATH_NOT_FOUND;
+    DIR *dir = nullptr;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Opendir(path, dir);
+    }
+    if(ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(opendir)(path);
+    }
+    if(ret < 0) {
+        errno = -ret;
+        return nullptr;
+    }
+    return dir;
+}
+
+struct dirent* WRAPPER_FUN(readdir)(DIR *dir)
+{
+    AUTO_TRACE("")
+    int ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    struct dirent *ent = nullptr;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Readdir(dir, ent);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(readdir)(dir);
+    }
+    if(ret < 0) {
+        errno = -ret;
+        return nullptr;
+    }
+    return ent;
+}
+
+int WRAPPER_FUN(closedir)(DIR *dir)
+{
+    AUTO_TRACE("")
+    int ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Closedir(dir);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(closedir)(dir);
+    }
+    return ret;
+}
+
+/*
+ * LabStor streams are regular FILE*s, so fread/fwrite/fprintf/fclose and the
+ * rest of stdio work on them unchanged. Only opening them needs interception.
+ * */
+
+FILE* WRAPPER_FUN(fopen)(const char *path, const char *mode)
+{
+    AUTO_TRACE("")
+    int ret = LABSTOR_GENERIC_FS_PATH_NOT_FOUND;
+    FILE *fp = nullptr;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Fopen(path, mode, fp);
+    }
+    if(ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(fopen)(path, mode);
+    }
+    if(ret < 0) {
+        errno = -ret;
+        return nullptr;
+    }
+    return fp;
+}
+
+FILE* WRAPPER_FUN(fopen64)(const char *path, const char *mode)
+{
+    AUTO_TRACE("")
+    int ret = LABSTOR_GENERIC_FS_PATH_NOT_FOUND;
+    FILE *fp = nullptr;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Fopen(path, mode, fp);
+    }
+    if(ret == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
+        return REAL_FUN(fopen64)(path, mode);
+    }
+    if(ret < 0) {
+        errno = -ret;
+        return nullptr;
+    }
+    return fp;
+}
+
+FILE* WRAPPER_FUN(fdopen)(int fd, const char *mode) __THROW
+{
+    AUTO_TRACE("")
+    int ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    FILE *fp = nullptr;
+    if(initialized_) {
+        ret = LABSTOR_GENERIC_POSIX_CLIENT->Fdopen(fd, mode, fp);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(fdopen)(fd, mode);
+    }
+    if(ret < 0) {
+        errno = -ret;
+        return nullptr;
+    }
+    return fp;
+}
+
+int WRAPPER_FUN(fileno)(FILE *fp) __THROW
+{
+    AUTO_TRACE("")
+    int fd = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        fd = LABSTOR_GENERIC_POSIX_CLIENT->Fileno(fp);
+    }
+    if(fd == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(fileno)(fp);
+    }
+    return fd;
+}
+
+/*
+ * libaio has no header in this build, so its entry points are declared with C
+ * linkage here. Every context is a LabStor AioContext which forwards I/Os on
+ * other fds to a kernel context. libaio functions return a negative errno.
+ * */
+extern "C" {
+
+int io_setup(int maxevents, io_context_t *ctxp)
+{
+    AUTO_TRACE("")
+    labstor::GenericPosix::AioContext *ctx = new labstor::GenericPosix::AioContext(LABSTOR_GENERIC_POSIX_CLIENT);
+    int ret = ctx->Setup(maxevents);
+    if(ret < 0) {
+        delete ctx;
+        return ret;
+    }
+    *ctxp = reinterpret_cast<io_context_t>(ctx);
+    return 0;
+}
+
+int io_queue_init(int maxevents, io_context_t *ctxp)
+{
+    return io_setup(maxevents, ctxp);
+}
+
+int io_destroy(io_context_t ctx)
+{
+    AUTO_TRACE("")
+    labstor::GenericPosix::AioContext *aio_ctx = reinterpret_cast<labstor::GenericPosix::AioContext*>(ctx);
+    int ret = aio_ctx->Destroy();
+    delete aio_ctx;
+    return ret;
+}
+
+int io_queue_release(io_context_t ctx)
+{
+    return io_destroy(ctx);
+}
+
+int io_submit(io_context_t ctx, long nr, struct iocb *iocbs[])
+{
+    AUTO_TRACE("")
+    return reinterpret_cast<labstor::GenericPosix::AioContext*>(ctx)->Submit(nr, iocbs);
+}
+
+int io_getevents(io_context_t ctx, long min_nr, long nr, struct io_event *events, struct timespec *timeout)
+{
+    AUTO_TRACE("")
+    return reinterpret_cast<labstor::GenericPosix::AioContext*>(ctx)->GetEvents(min_nr, nr, events, timeout);
+}
+
+int io_cancel(io_context_t ctx, struct iocb *iocb, struct io_event *event)
+{
+    AUTO_TRACE("")
+    return reinterpret_cast<labstor::GenericPosix::AioContext*>(ctx)->Cancel(iocb, event);
+}
+
+}
+
+/*
+ * POSIX AIO on LabStor fds is tracked by aiocbs_. Other control blocks go to libc.
+ * */
+
+int WRAPPER_FUN(aio_read)(struct aiocb *cb) __THROW
+{
+    AUTO_TRACE("")
+    int ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = aiocbs_->Submit(cb, labstor::GenericPosix::Ops::kRead);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(aio_read)(cb);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(aio_write)(struct aiocb *cb) __THROW
+{
+    AUTO_TRACE("")
+    int ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = aiocbs_->Submit(cb, labstor::GenericPosix::Ops::kWrite);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(aio_write)(cb);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(aio_fsync)(int op, struct aiocb *cb) __THROW
+{
+    AUTO_TRACE("")
+    int ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = aiocbs_->Fsync(cb, op);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(aio_fsync)(op, cb);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(aio_error)(const struct aiocb *cb) __THROW
+{
+    AUTO_TRACE("")
+    int err;
+    if(initialized_ && aiocbs_->Error(cb, err)) {
+        return err;
+    }
+    return REAL_FUN(aio_error)(cb);
+}
+
+ssize_t WRAPPER_FUN(aio_return)(struct aiocb *cb) __THROW
+{
+    AUTO_TRACE("")
+    ssize_t ret;
+    if(initialized_ && aiocbs_->Return(cb, ret)) {
+        return LabStorReturn<ssize_t>(ret);
+    }
+    return REAL_FUN(aio_return)(cb);
+}
+
+int WRAPPER_FUN(aio_suspend)(const struct aiocb *const list[], int nent, const struct timespec *timeout)
+{
+    AUTO_TRACE("")
+    int ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = aiocbs_->Suspend(list, nent, timeout, REAL_FUN(aio_error));
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(aio_suspend)(list, nent, timeout);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(aio_cancel)(int fd, struct aiocb *cb) __THROW
+{
+    AUTO_TRACE("")
+    int ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = aiocbs_->Cancel(fd, cb);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(aio_cancel)(fd, cb);
+    }
+    return ret;
+}
+
+int WRAPPER_FUN(lio_listio)(int mode, struct aiocb *const list[], int nent, struct sigevent *sig) __THROW
+{
+    AUTO_TRACE("")
+    std::vector<struct aiocb*> others;
+    std::vector<labstor::GenericPosix::AsyncIO*> aios;
+    int ret = 0, failed = 0;
+    if(!initialized_) {
+        return REAL_FUN(lio_listio)(mode, list, nent, sig);
+    }
+    failed = aiocbs_->Listio(list, nent, others, aios);
+    if(aios.empty() && failed == 0) {
+        return REAL_FUN(lio_listio)(mode, list, nent, sig);
+    }
+    if(others.size()) {
+        ret = REAL_FUN(lio_listio)(mode, others.data(), others.size(), sig);
+    }
+    if(mode == LIO_WAIT) {
+        failed += aiocbs_->WaitAll(aios);
+    }
+    if(failed) {
+        errno = (mode == LIO_WAIT) ? EIO : EAGAIN;
+        return -1;
+    }
+    return ret;
+}
+
+int WRAPPER_FUN(aio_read64)(struct aiocb64 *cb) __THROW
+{
+    AUTO_TRACE("")
+    int ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = aiocbs_->Submit(reinterpret_cast<struct aiocb*>(cb), labstor::GenericPosix::Ops::kRead);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(aio_read64)(cb);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(aio_write64)(struct aiocb64 *cb) __THROW
+{
+    AUTO_TRACE("")
+    int ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = aiocbs_->Submit(reinterpret_cast<struct aiocb*>(cb), labstor::GenericPosix::Ops::kWrite);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(aio_write64)(cb);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(aio_fsync64)(int op, struct aiocb64 *cb) __THROW
+{
+    AUTO_TRACE("")
+    int ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = aiocbs_->Fsync(reinterpret_cast<struct aiocb*>(cb), op);
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(aio_fsync64)(op, cb);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(aio_error64)(const struct aiocb64 *cb) __THROW
+{
+    AUTO_TRACE("")
+    int err;
+    if(initialized_ && aiocbs_->Error(reinterpret_cast<const struct aiocb*>(cb), err)) {
+        return err;
+    }
+    return REAL_FUN(aio_error64)(cb);
+}
+
+ssize_t WRAPPER_FUN(aio_return64)(struct aiocb64 *cb) __THROW
+{
+    AUTO_TRACE("")
+    ssize_t ret;
+    if(initialized_ && aiocbs_->Return(reinterpret_cast<struct aiocb*>(cb), ret)) {
+        return LabStorReturn<ssize_t>(ret);
+    }
+    return REAL_FUN(aio_return64)(cb);
+}
+
+int WRAPPER_FUN(aio_suspend64)(const struct aiocb64 *const list[], int nent, const struct timespec *timeout)
+{
+    AUTO_TRACE("")
+    int ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = aiocbs_->Suspend(reinterpret_cast<const struct aiocb *const*>(list), nent, timeout, reinterpret_cast<int (*)(const struct aiocb*)>(REAL_FUN(aio_error64)));
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(aio_suspend64)(list, nent, timeout);
+    }
+    return LabStorReturn<int>(ret);
+}
+
+int WRAPPER_FUN(aio_cancel64)(int fd, struct aiocb64 *cb) __THROW
+{
+    AUTO_TRACE("")
+    int ret = LABSTOR_GENERIC_FS_INVALID_FD;
+    if(initialized_) {
+        ret = aiocbs_->Cancel(fd, reinterpret_cast<struct aiocb*>(cb));
+    }
+    if(ret == LABSTOR_GENERIC_FS_INVALID_FD) {
+        return REAL_FUN(aio_cancel64)(fd, cb);
+    }
+    return ret;
+}
+
+int WRAPPER_FUN(lio_listio64)(int mode, struct aiocb64 *const list[], int nent, struct sigevent *sig) __THROW
+{
+    AUTO_TRACE("")
+    std::vector<struct aiocb*> others;
+    std::vector<labstor::GenericPosix::AsyncIO*> aios;
+    int ret = 0, failed = 0;
+    if(!initialized_) {
+        return REAL_FUN(lio_listio64)(mode, list, nent, sig);
+    }
+    failed = aiocbs_->Listio(reinterpret_cast<struct aiocb *const*>(list), nent, others, aios);
+    if(aios.empty() && failed == 0) {
+        return REAL_FUN(lio_listio64)(mode, list, nent, sig);
+    }
+    if(others.size()) {
+        ret = REAL_FUN(lio_listio64)(mode, reinterpret_cast<struct aiocb64**>(others.data()), others.size(), sig);
+    }
+    if(mode == LIO_WAIT) {
+        failed += aiocbs_->WaitAll(aios);
+    }
+    if(failed) {
+        errno = (mode == LIO_WAIT) ? EIO : EAGAIN;
+        return -1;
+    }
+    return ret;
+}
@@ -28,7 +28,9 @@
 #define LABSTOR_GENERIC_POSIX_H
 
 #include <cstring>
+#include <sys/stat.h>
 #include <labstor/types/data_structures/shmem_request.h>
+#include <labstor/types/data_structures/shmem_buffer.h>
 //#include <labstor/types/data_structures/shmem_poll.h>
 
 #define GENERIC_POSIX_MODULE_ID "GenericPosix"
@@ -48,9 +50,23 @@ enum class Ops {
     kRead,
     kWrite,
     kFsync,
-    kFdatasync
+    kFdatasync,
+    kStat,
+    kFstat,
+    kLseek,
+    kUnlink,
+    kRename,
+    kMkdir,
+    kRmdir,
+    kReaddir
 };
 
+/*
+ * Metadata requests carry paths relative to the module's mount point, so the
+ * mount point itself is the empty path. Codes are 0 or a negative errno.
+ * */
+#define LABSTOR_READDIR_SIZE 2048
+
 struct FILE {
     int off_;
     FILE() : off_(0) {}
@@ -60,6 +76,9 @@ struct open_request : public labstor::ipc::request {
     int oflags_;
     int fd_;
     char path_[];
+    static inline uint32_t GetSize(const char *path) {
+        return sizeof(open_request) + strlen(path) + 1;
+    }
     inline void ClientInit(int ns_id, const char *path, int oflags, int fd) {
         SetNamespaceID(ns_id);
         SetOp(static_cast<int>(labstor::GenericPosix::Ops::kOpen));
@@ -109,12 +128,12 @@ struct passthrough_request : public labstor::ipc::request {
 };
 
 struct io_request : passthrough_request {
-    void *buf_;
+    labstor::ipc::buf_ref buf_;
     size_t off_;
     ssize_t size_;
     int num_qtoks_, cur_qtok_;
     labstor::ipc::qtok_t *qtoks_;
-    inline void Start(int ns_id, labstor::GenericPosix::Ops op, int fd, void *buf, size_t off, ssize_t size) {
+    inline void Start(int ns_id, labstor::GenericPosix::Ops op, int fd, labstor::ipc::buf_ref buf, size_t off, ssize_t size) {
         SetNamespaceID(ns_id);
         SetOp(static_cast<int>(op));
         fd_ = fd;
@@ -122,6 +141,9 @@ struct io_request : passthrough_request {
         size_ = size;
         off_ = off;
     }
+    inline void Start(int ns_id, labstor::GenericPosix::Ops op, int fd, labstor::ipc::buf_ref buf, ssize_t size) {
+        Start(ns_id, op, fd, buf, -1, size);
+    }
     inline void SetQtoks(int num_qtoks, labstor::ipc::qtok_t *qtoks) {
         num_qtoks_ = num_qtoks;
         qtoks_ = qtoks;
@@ -136,6 +158,124 @@ struct io_request : passthrough_request {
     }
 };
 
+/*
+ * The epoch is set by the module and records which group commit makes the
+ * caller's writes durable.
+ * */
+struct fsync_request : passthrough_request {
+    uint64_t epoch_;
+    inline void ClientInit(int ns_id, int fd, bool data_only) {
+        SetNamespaceID(ns_id);
+        SetOp(static_cast<int>(data_only ? labstor::GenericPosix::Ops::kFdatasync : labstor::GenericPosix::Ops::kFsync));
+        fd_ = fd;
+        epoch_ = 0;
+    }
+};
+
+struct path_request : public labstor::ipc::request {
+    int mode_;
+    char path_[];
+    static inline uint32_t GetSize(const char *path) {
+        return sizeof(path_request) + strlen(path) + 1;
+    }
+    inline void ClientInit(int ns_id, labstor::GenericPosix::Ops op, const char *path, int mode) {
+        SetNamespaceID(ns_id);
+        SetOp(static_cast<int>(op));
+        mode_ = mode;
+        strcpy(path_, path);
+    }
+    inline void Complete(int code) {
+        SetCode(code);
+    }
+};
+
+struct rename_request : public labstor::ipc::request {
+    uint32_t new_off_;
+    char paths_[];
+    static inline uint32_t GetSize(const char *old_path, const char *new_path) {
+        return sizeof(rename_request) + strlen(old_path) + strlen(new_path) + 2;
+    }
+    inline void ClientInit(int ns_id, const char *old_path, const char *new_path) {
+        SetNamespaceID(ns_id);
+        SetOp(static_cast<int>(labstor::GenericPosix::Ops::kRename));
+        new_off_ = strlen(old_path) + 1;
+        strcpy(paths_, old_path);
+        strcpy(paths_ + new_off_, new_path);
+    }
+    inline const char* GetOldPath() {
+        return paths_;
+    }
+    inline const char* GetNewPath() {
+        return paths_ + new_off_;
+    }
+    inline void Complete(int code) {
+        SetCode(code);
+    }
+};
+
+struct stat_request : passthrough_request {
+    struct stat st_;
+    char path_[];
+    static inline uint32_t GetSize(const char *path) {
+        return sizeof(stat_request) + strlen(path) + 1;
+    }
+    inline void ClientInit(int ns_id, const char *path) {
+        SetNamespaceID(ns_id);
+        SetOp(static_cast<int>(labstor::GenericPosix::Ops::kStat));
+        fd_ = -1;
+        strcpy(path_, path);
+    }
+    inline void ClientInit(int ns_id, int fd) {
+        SetNamespaceID(ns_id);
+        SetOp(static_cast<int>(labstor::GenericPosix::Ops::kFstat));
+        fd_ = fd;
+        path_[0] = 0;
+    }
+};
+
+struct lseek_request : passthrough_request {
+    int64_t off_;
+    int whence_;
+    inline void ClientInit(int ns_id, int fd, int64_t off, int whence) {
+        SetNamespaceID(ns_id);
+        SetOp(static_cast<int>(labstor::GenericPosix::Ops::kLseek));
+        fd_ = fd;
+        off_ = off;
+        whence_ = whence;
+    }
+    inline void Complete(int64_t off, int code) {
+        off_ = off;
+        SetCode(code);
+    }
+};
+
+struct dir_entry {
+    uint64_t ino_;
+    uint16_t reclen_;
+    uint8_t type_;
+    char name_[];
+    static inline uint16_t GetSize(size_t namelen) {
+        return (sizeof(dir_entry) + namelen + 1 + 7) & ~7;
+    }
+};
+
+/*
+ * Entries are packed into the request. The cookie is the index of the next
+ * entry to list; a reply with no entries marks the end of the directory.
+ * */
+struct readdir_request : passthrough_request {
+    uint64_t cookie_;
+    uint32_t count_;
+    char entries_[LABSTOR_READDIR_SIZE];
+    inline void ClientInit(int ns_id, int fd, uint64_t cookie) {
+        SetNamespaceID(ns_id);
+        SetOp(static_cast<int>(labstor::GenericPosix::Ops::kReaddir));
+        fd_ = fd;
+        cookie_ = cookie;
+        count_ = 0;
+    }
+};
+
 int PriorSlash(const char *path, int len) {
     int i = 0;
     for(i = len - 1; i >= 0; --i) {
@@ -37,6 +37,8 @@
 #include <labstor/userspace/client/namespace.h>
 #include <labstor/userspace/util/error.h>
 #include <mutex>
+#include <cerrno>
+#include <sys/stat.h>
 
 namespace labstor::Posix {
 
@@ -49,6 +51,30 @@ public:
     virtual labstor::ipc::qtok_t AIO(labstor::GenericPosix::Ops op, int fd, void *buf, ssize_t size) = 0;
     virtual ssize_t IO(labstor::GenericPosix::Ops op, int fd, void *buf, size_t off, ssize_t size) = 0;
     virtual ssize_t IO(labstor::GenericPosix::Ops op, int fd, void *buf, ssize_t size) = 0;
+
+    /*
+     * Build the request for an I/O on the queue pair it goes to, without enqueueing it,
+     * so that callers can enqueue many I/Os at once. Modules which return nullptr
+     * are submitted through AIO instead.
+     * */
+    virtual labstor::GenericPosix::io_request* AllocIO(labstor::queue_pair *&qp, labstor::GenericPosix::Ops op, int fd, void *buf, size_t off, ssize_t size) { return nullptr; }
+
+    /*
+     * Metadata operations take paths relative to the module's mount point and
+     * return a negative errno on failure. Modules without metadata support
+     * inherit these defaults.
+     * */
+    virtual int Stat(const char *path, struct stat *st) { return -ENOTSUP; }
+    virtual int Fstat(int fd, struct stat *st) { return -ENOTSUP; }
+    virtual int64_t Lseek(int fd, int64_t off, int whence) { return -ENOTSUP; }
+    virtual int Unlink(const char *path) { return -ENOTSUP; }
+    virtual int Rename(const char *old_path, const char *new_path) { return -ENOTSUP; }
+    virtual int Mkdir(const char *path, int mode) { return -ENOTSUP; }
+    virtual int Rmdir(const char *path) { return -ENOTSUP; }
+    virtual int Readdir(int fd, uint64_t &cookie, char *entries, uint32_t &count) { return -ENOTSUP; }
+
+    //Returns once the fd's completed writes are durable; data_only skips metadata like fdatasync
+    virtual int Fsync(int fd, bool data_only) { return -ENOTSUP; }
 };
 
 }
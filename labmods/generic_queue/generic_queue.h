@@ -28,6 +28,7 @@
 #define LABSTOR_GENERIC_QUEUE_H
 
 #include <labstor/types/data_structures/shmem_request.h>
+#include <labstor/types/data_structures/shmem_buffer.h>
 #ifdef __cplusplus
 #include <labmods/generic_block/generic_block.h>
 #endif
@@ -38,11 +39,11 @@ namespace labstor::GenericQueue {
 struct io_request : public labstor::ipc::request {
     size_t off_;
     size_t size_;
-    void *buf_;
+    labstor::ipc::buf_ref buf_;
     int hctx_;
     int dev_id_;
 
-    inline void Start(int ns_id, uint16_t op, size_t off, size_t size, void *buf, int hctx) {
+    inline void Start(int ns_id, uint16_t op, size_t off, size_t size, labstor::ipc::buf_ref buf, int hctx) {
         op_ = op;
         ns_id_ = ns_id;
         code_ = 0;
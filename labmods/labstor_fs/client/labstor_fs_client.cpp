@@ -56,14 +56,14 @@ int labstor::LabFS::Client::Open(int fd, const char *path, int pathlen, int ofla
                                LABSTOR_QP_SHMEM | LABSTOR_QP_STREAM | LABSTOR_QP_PRIMARY | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY);
 
     //Create CLIENT -> SERVER message
-    client_rq = ipc_manager_->AllocRequest<labstor::GenericPosix::open_request>(qp);
-    client_rq->ClientInit(ns_id_, path, oflag, fd);
+    client_rq = ipc_manager_->AllocRequest<labstor::GenericPosix::open_request>(qp, labstor::GenericPosix::open_request::GetSize(path + pathlen));
+    client_rq->ClientInit(ns_id_, path + pathlen, oflag, fd);
 
     //Complete CLIENT -> SERVER interaction
     qp->Enqueue<labstor::GenericPosix::open_request>(client_rq, qtok);
     client_rq = ipc_manager_->Wait<labstor::GenericPosix::open_request>(qtok);
-    if(client_rq->GetCode() == LABSTOR_GENERIC_FS_PATH_NOT_FOUND) {
-        fd = LABSTOR_GENERIC_FS_PATH_NOT_FOUND;
+    if(client_rq->GetCode() < 0) {
+        fd = client_rq->GetCode();
     }
 
     //Free requests
@@ -110,7 +110,7 @@ labstor::ipc::qtok_t labstor::LabFS::Client::AIO(labstor::GenericPosix::Ops op,
 
     //Create CLIENT -> SERVER message
     client_rq = ipc_manager_->AllocRequest<labstor::GenericPosix::io_request>(qp);
-    client_rq->Start(ns_id_, op, fd, buf, size);
+    client_rq->Start(ns_id_, op, fd, ipc_manager_->GetBufferRef(buf), size);
 
     //Enqueue the message
     qp->Enqueue<labstor::GenericPosix::io_request>(client_rq, qtok);
@@ -130,4 +130,202 @@ ssize_t labstor::LabFS::Client::IO(labstor::GenericPosix::Ops op, int fd, void *
     return ret;
 }
 
+int labstor::LabFS::Client::Stat(const char *path, struct stat *st) {
+    AUTO_TRACE(path)
+    labstor::GenericPosix::stat_request *client_rq;
+    labstor::queue_pair *qp;
+    labstor::ipc::qtok_t qtok;
+    int code;
+
+    //Get SERVER QP
+    ipc_manager_->GetQueuePair(qp,
+                               LABSTOR_QP_SHMEM | LABSTOR_QP_STREAM | LABSTOR_QP_PRIMARY | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY);
+
+    //Create CLIENT -> SERVER message
+    client_rq = ipc_manager_->AllocRequest<labstor::GenericPosix::stat_request>(qp, labstor::GenericPosix::stat_request::GetSize(path));
+    client_rq->ClientInit(ns_id_, path);
+
+    //Complete CLIENT -> SERVER interaction
+    qp->Enqueue<labstor::GenericPosix::stat_request>(client_rq, qtok);
+    client_rq = ipc_manager_->Wait<labstor::GenericPosix::stat_request>(qtok);
+    code = client_rq->GetCode();
+    if(code == 0) {
+        *st = client_rq->st_;
+    }
+
+    //Free requests
+    ipc_manager_->FreeRequest<labstor::GenericPosix::stat_request>(qtok, client_rq);
+    return code;
+}
+
+int labstor::LabFS::Client::Fstat(int fd, struct stat *st) {
+    AUTO_TRACE(fd)
+    labstor::GenericPosix::stat_request *client_rq;
+    labstor::queue_pair *qp;
+    labstor::ipc::qtok_t qtok;
+    int code;
+
+    //Get SERVER QP
+    ipc_manager_->GetQueuePair(qp,
+                               LABSTOR_QP_SHMEM | LABSTOR_QP_STREAM | LABSTOR_QP_PRIMARY | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY);
+
+    //Create CLIENT -> SERVER message
+    client_rq = ipc_manager_->AllocRequest<labstor::GenericPosix::stat_request>(qp, labstor::GenericPosix::stat_request::GetSize(""));
+    client_rq->ClientInit(ns_id_, fd);
+
+    //Complete CLIENT -> SERVER interaction
+    qp->Enqueue<labstor::GenericPosix::stat_request>(client_rq, qtok);
+    client_rq = ipc_manager_->Wait<labstor::GenericPosix::stat_request>(qtok);
+    code = client_rq->GetCode();
+    if(code == 0) {
+        *st = client_rq->st_;
+    }
+
+    //Free requests
+    ipc_manager_->FreeRequest<labstor::GenericPosix::stat_request>(qtok, client_rq);
+    return code;
+}
+
+int64_t labstor::LabFS::Client::Lseek(int fd, int64_t off, int whence) {
+    AUTO_TRACE(fd, off, whence)
+    labstor::GenericPosix::lseek_request *client_rq;
+    labstor::queue_pair *qp;
+    labstor::ipc::qtok_t qtok;
+    int64_t ret;
+
+    //Get SERVER QP
+    ipc_manager_->GetQueuePair(qp,
+                               LABSTOR_QP_SHMEM | LABSTOR_QP_STREAM | LABSTOR_QP_PRIMARY | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY);
+
+    //Create CLIENT -> SERVER message
+    client_rq = ipc_manager_->AllocRequest<labstor::GenericPosix::lseek_request>(qp);
+    client_rq->ClientInit(ns_id_, fd, off, whence);
+
+    //Complete CLIENT -> SERVER interaction
+    qp->Enqueue<labstor::GenericPosix::lseek_request>(client_rq, qtok);
+    client_rq = ipc_manager_->Wait<labstor::GenericPosix::lseek_request>(qtok);
+    ret = client_rq->GetCode() < 0 ? client_rq->GetCode() : client_rq->off_;
+
+    //Free requests
+    ipc_manager_->FreeRequest<labstor::GenericPosix::lseek_request>(qtok, client_rq);
+    return ret;
+}
+
+int labstor::LabFS::Client::PathOp(labstor::GenericPosix::Ops op, const char *path, int mode) {
+    AUTO_TRACE(path)
+    labstor::GenericPosix::path_request *client_rq;
+    labstor::queue_pair *qp;
+    labstor::ipc::qtok_t qtok;
+    int code;
+
+    //Get SERVER QP
+    ipc_manager_->GetQueuePair(qp,
+                               LABSTOR_QP_SHMEM | LABSTOR_QP_STREAM | LABSTOR_QP_PRIMARY | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY);
+
+    //Create CLIENT -> SERVER message
+    client_rq = ipc_manager_->AllocRequest<labstor::GenericPosix::path_request>(qp, labstor::GenericPosix::path_request::GetSize(path));
+    client_rq->ClientInit(ns_id_, op, path, mode);
+
+    //Complete CLIENT -> SERVER interaction
+    qp->Enqueue<labstor::GenericPosix::path_request>(client_rq, qtok);
+    client_rq = ipc_manager_->Wait<labstor::GenericPosix::path_request>(qtok);
+    code = client_rq->GetCode();
+
+    //Free requests
+    ipc_manager_->FreeRequest<labstor::GenericPosix::path_request>(qtok, client_rq);
+    return code;
+}
+
+int labstor::LabFS::Client::Unlink(const char *path) {
+    return PathOp(labstor::GenericPosix::Ops::kUnlink, path, 0);
+}
+
+int labstor::LabFS::Client::Mkdir(const char *path, int mode) {
+    return PathOp(labstor::GenericPosix::Ops::kMkdir, path, mode);
+}
+
+int labstor::LabFS::Client::Rmdir(const char *path) {
+    return PathOp(labstor::GenericPosix::Ops::kRmdir, path, 0);
+}
+
+int labstor::LabFS::Client::Rename(const char *old_path, const char *new_path) {
+    AUTO_TRACE(old_path, new_path)
+    labstor::GenericPosix::rename_request *client_rq;
+    labstor::queue_pair *qp;
+    labstor::ipc::qtok_t qtok;
+    int code;
+
+    //Get SERVER QP
+    ipc_manager_->GetQueuePair(qp,
+                               LABSTOR_QP_SHMEM | LABSTOR_QP_STREAM | LABSTOR_QP_PRIMARY | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY);
+
+    //Create CLIENT -> SERVER message
+    client_rq = ipc_manager_->AllocRequest<labstor::GenericPosix::rename_request>(qp, labstor::GenericPosix::rename_request::GetSize(old_path, new_path));
+    client_rq->ClientInit(ns_id_, old_path, new_path);
+
+    //Complete CLIENT -> SERVER interaction
+    qp->Enqueue<labstor::GenericPosix::rename_request>(client_rq, qtok);
+    client_rq = ipc_manager_->Wait<labstor::GenericPosix::rename_request>(qtok);
+    code = client_rq->GetCode();
+
+    //Free requests
+    ipc_manager_->FreeRequest<labstor::GenericPosix::rename_request>(qtok, client_rq);
+    return code;
+}
+
+int labstor::LabFS::Client::Readdir(int fd, uint64_t &cookie, char *entries, uint32_t &count) {
+    AUTO_TRACE(fd, cookie)
+    labstor::GenericPosix::readdir_request *client_rq;
+    labstor::queue_pair *qp;
+    labstor::ipc::qtok_t qtok;
+    int code;
+
+    //Get SERVER QP
+    ipc_manager_->GetQueuePair(qp,
+                               LABSTOR_QP_SHMEM | LABSTOR_QP_STREAM | LABSTOR_QP_PRIMARY | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY);
+
+    //Create CLIENT -> SERVER message
+    client_rq = ipc_manager_->AllocRequest<labstor::GenericPosix::readdir_request>(qp);
+    client_rq->ClientInit(ns_id_, fd, cookie);
+
+    //Complete CLIENT -> SERVER interaction
+    qp->Enqueue<labstor::GenericPosix::readdir_request>(client_rq, qtok);
+    client_rq = ipc_manager_->Wait<labstor::GenericPosix::readdir_request>(qtok);
+    code = client_rq->GetCode();
+    if(code == 0) {
+        cookie = client_rq->cookie_;
+        count = client_rq->count_;
+        memcpy(entries, client_rq->entries_, LABSTOR_READDIR_SIZE);
+    }
+
+    //Free requests
+    ipc_manager_->FreeRequest<labstor::GenericPosix::readdir_request>(qtok, client_rq);
+    return code;
+}
+
+int labstor::LabFS::Client::Fsync(int fd, bool data_only) {
+    AUTO_TRACE(fd, data_only)
+    labstor::GenericPosix::fsync_request *client_rq;
+    labstor::queue_pair *qp;
+    labstor::ipc::qtok_t qtok;
+    int code;
+
+    //Get SERVER QP
+    ipc_manager_->GetQueuePair(qp,
+                               LABSTOR_QP_SHMEM | LABSTOR_QP_STREAM | LABSTOR_QP_PRIMARY | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY);
+
+    //Create CLIENT -> SERVER message
+    client_rq = ipc_manager_->AllocRequest<labstor::GenericPosix::fsync_request>(qp);
+    client_rq->ClientInit(ns_id_, fd, data_only);
+
+    //Complete CLIENT -> SERVER interaction
+    qp->Enqueue<labstor::GenericPosix::fsync_request>(client_rq, qtok);
+    client_rq = ipc_manager_->Wait<labstor::GenericPosix::fsync_request>(qtok);
+    code = client_rq->GetCode();
+
+    //Free requests
+    ipc_manager_->FreeRequest<labstor::GenericPosix::fsync_request>(qtok, client_rq);
+    return code;
+}
+
 LABSTOR_MODULE_CONSTRUCT(labstor::LabFS::Client, LABFS_MODULE_ID)
\ No newline at end of file
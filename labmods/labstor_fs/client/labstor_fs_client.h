@@ -53,6 +53,17 @@ public:
     int Close(int fd);
     labstor::ipc::qtok_t AIO(labstor::GenericPosix::Ops op, int fd, void *buf, size_t size);
     ssize_t IO(labstor::GenericPosix::Ops op, int fd, void *buf, size_t size);
+    int Stat(const char *path, struct stat *st) override;
+    int Fstat(int fd, struct stat *st) override;
+    int64_t Lseek(int fd, int64_t off, int whence) override;
+    int Unlink(const char *path) override;
+    int Rename(const char *old_path, const char *new_path) override;
+    int Mkdir(const char *path, int mode) override;
+    int Rmdir(const char *path) override;
+    int Readdir(int fd, uint64_t &cookie, char *entries, uint32_t &count) override;
+    int Fsync(int fd, bool data_only) override;
+private:
+    int PathOp(labstor::GenericPosix::Ops op, const char *path, int mode);
 };
 
 };
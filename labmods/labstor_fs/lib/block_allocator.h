@@ -29,7 +29,7 @@
 
 #include <vector>
 #include <cstdint>
-#include "labstor/types/data_structures/shmem_ring_buffer.h"
+#include "labstor/types/data_structures/shmem_lockless_ring_buffer.h"
 
 #define SMALL_BLOCK_SIZE (4*(1<<10))
 #define LARGE_BLOCK_SIZE (128*(1<<10))
@@ -45,16 +45,16 @@ struct Block {
 
 class BlockAllocator {
 private:
-    labstor::ipc::mpmc::ring_buffer<Block> small_blocks_;
-    labstor::ipc::mpmc::ring_buffer<Block> large_blocks_;
+    labstor::ipc::mpmc::lockless_ring_buffer<Block> small_blocks_;
+    labstor::ipc::mpmc::lockless_ring_buffer<Block> large_blocks_;
 public:
     static size_t GetNumLargeBlocks(size_t disk_size, size_t num_small_blocks) {
         return (disk_size - num_small_blocks*SMALL_BLOCK_SIZE)/LARGE_BLOCK_SIZE;;
     }
 
     static size_t GetSize(size_t disk_size, size_t num_small_blocks) {
-        size_t small_block_size = labstor::ipc::mpmc::ring_buffer<Block>::GetSize(num_small_blocks);
-        size_t large_block_size = labstor::ipc::mpmc::ring_buffer<Block>::GetSize(GetNumLargeBlocks(disk_size, num_small_blocks));
+        size_t small_block_size = labstor::ipc::mpmc::lockless_ring_buffer<Block>::GetSize(num_small_blocks);
+        size_t large_block_size = labstor::ipc::mpmc::lockless_ring_buffer<Block>::GetSize(GetNumLargeBlocks(disk_size, num_small_blocks));
         return small_block_size + large_block_size;
     }
 
@@ -38,6 +38,17 @@
 
 #include <vector>
 #include <list>
+#include <map>
+#include <string>
+#include <mutex>
+#include <unordered_map>
+#include <cerrno>
+#include <ctime>
+#include <algorithm>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <labmods/generic_posix/generic_posix.h>
 #include <labmods/secure_shmem/netlink_client/secure_shmem_client_netlink.h>
 #include <labstor/types/allocator/allocator.h>
 #include <labstor/types/allocator/shmem_allocator.h>
@@ -47,9 +58,50 @@
 
 namespace labstor::LabFS {
 
+struct MetadataLogEntry;
+
 struct Inode {
     uint64_t uuid_;
+    mode_t mode_;
+    uid_t uid_;
+    gid_t gid_;
+    size_t size_;
+    time_t mtime_;
+    int nopen_;
+    bool unlinked_;
     std::list<Block> blocks_;
+    std::map<std::string, Inode*> children_;
+    MetadataLogEntry *resize_entry_;
+    uint64_t resize_epoch_;
+
+    Inode(uint64_t uuid, mode_t mode, uid_t uid, gid_t gid) :
+        uuid_(uuid), mode_(mode), uid_(uid), gid_(gid), size_(0), mtime_(time(nullptr)), nopen_(0), unlinked_(false),
+        resize_entry_(nullptr), resize_epoch_(0) {}
+
+    inline bool IsDir() {
+        return S_ISDIR(mode_);
+    }
+
+    void Stat(struct stat *st) {
+        memset(st, 0, sizeof(struct stat));
+        st->st_ino = uuid_;
+        st->st_mode = mode_;
+        st->st_nlink = IsDir() ? 2 : 1;
+        st->st_uid = uid_;
+        st->st_gid = gid_;
+        st->st_size = size_;
+        st->st_blksize = SMALL_BLOCK_SIZE;
+        st->st_blocks = (size_ + 511) / 512;
+        st->st_atime = mtime_;
+        st->st_mtime = mtime_;
+        st->st_ctime = mtime_;
+    }
+};
+
+struct OpenFile {
+    Inode *inode_;
+    size_t off_;
+    int oflags_;
 };
 
 struct LogEntry {
@@ -57,6 +109,41 @@ struct LogEntry {
     int size_;
 };
 
+enum class LogOp : uint16_t {
+    kCreate,
+    kRemove,
+    kRename,
+    kResize
+};
+
+/*
+ * A change to the namespace or to an inode's attributes. The inode's path
+ * follows the record, and the new path follows it for renames.
+ * */
+struct MetadataLogEntry : public LogEntry {
+    LogOp op_;
+    uint16_t path_len_, new_path_len_;
+    mode_t mode_;
+    uid_t uid_;
+    gid_t gid_;
+    uint64_t uuid_;
+    size_t inode_size_;
+    time_t mtime_;
+
+    static int GetSize(size_t path_len, size_t new_path_len) {
+        size_t size = sizeof(MetadataLogEntry) + path_len + new_path_len;
+        return (size + alignof(MetadataLogEntry) - 1) & ~(alignof(MetadataLogEntry) - 1);
+    }
+
+    std::string GetPath() {
+        return std::string(reinterpret_cast<char*>(this + 1), path_len_);
+    }
+
+    std::string GetNewPath() {
+        return std::string(reinterpret_cast<char*>(this + 1) + path_len_, new_path_len_);
+    }
+};
+
 struct LogCommit {
     uint64_t checksum_;
     size_t total_size_;
@@ -82,7 +169,7 @@ struct CoreLog {
     CoreLog(size_t uuid_min, size_t log_size, size_t disk_off, size_t disk_size, size_t num_small_blocks, void *region, size_t region_size) {
         //Log entries
         head_ = reinterpret_cast<LogEntry*>(region);
-        tail_ = reinterpret_cast<LogEntry*>(LABSTOR_REGION_ADD(region_size, region));
+        tail_ = reinterpret_cast<LogEntry*>(LABSTOR_REGION_ADD(log_size, region));
         reserve_off_ = head_;
         commit_off_ = head_;
         uuid_min_ = uuid_min;
@@ -91,18 +178,22 @@ struct CoreLog {
         alloc_.Initialize(disk_off, disk_size, num_small_blocks, tail_, region_size - log_size);
     }
 
+    //Returns nullptr if the log has no room for the entry
     template<typename T>
-    T* ReserveLogEntry() {
-        T* entry = reinterpret_cast<T*>(reserve_off_ + 1);
-        entry->size_ = sizeof(T);
+    T* ReserveLogEntry(int size = sizeof(T)) {
+        if((size_t)tail_ - (size_t)reserve_off_ < (size_t)size) {
+            return nullptr;
+        }
+        T* entry = reinterpret_cast<T*>(reserve_off_);
+        entry->size_ = size;
         entry->finalized_ = false;
-        reserve_off_ = reinterpret_cast<LogEntry*>(entry + 1);
+        reserve_off_ = reinterpret_cast<LogEntry*>(LABSTOR_REGION_ADD(size, entry));
         return entry;
     }
 
     template<typename T>
     void FinalizeLogEntry(T *entry) {
-        entry->finalize_ = true;
+        entry->finalized_ = true;
     }
 
     void GetBlock(int size, Block &block) {
@@ -124,11 +215,18 @@ struct CoreLog {
     LogEntry* GetUncommittedOff() {
         return commit_off_;
     }
+
+    void Commit() {
+        commit_off_ = reserve_off_;
+    }
 };
 
 /*
- * When searching for an Inode, check path
- * Directories store a list of file UUIDs they contain in-memory
+ * Metadata is kept in-memory. Paths are relative to the mount: "" is the
+ * root directory and "/a/b" is the file b in directory a. Directories
+ * store the inodes they contain, and open files are keyed by (pid, fd).
+ * Creates, removals, renames and size changes are appended to the log
+ * before they are applied, so the next commit makes them durable.
  * */
 
 class Log {
@@ -136,11 +234,16 @@ class Log {
     void *region_;
     std::vector<CoreLog> per_core_log_;
     labstor::GenericAllocator *shmem_alloc_;
-    labstor::ipc::mpmc::inode_map path_to_inode_;
-    std::unordered_map<std::pair<int,int>, uint32_t> fd_to_inode_;
+    std::mutex lock_;
+    std::unordered_map<std::string, Inode*> path_to_inode_;
+    std::unordered_map<uint64_t, OpenFile> fd_to_inode_;
+    uint64_t next_uuid_, commit_epoch_;
     Block next_log_block_;
 public:
-    Log() = default;
+    Log() : next_uuid_(1), commit_epoch_(1) {
+        //Root UUID is 0
+        path_to_inode_[""] = new Inode(0, S_IFDIR | 0777, 0, 0);
+    }
 
     void Initialize(size_t log_size, size_t disk_size, size_t num_small_blocks, int concurrency) {
         size_t disk_off = SMALL_BLOCK_SIZE;
@@ -166,6 +269,7 @@ public:
         per_core_log_.reserve(concurrency);
         for(int i = 0; i < concurrency; ++i) {
             per_core_log_.emplace_back(cur_uuid, per_core_log_size, disk_off, per_core_disk_size, per_core_num_blocks, region, per_core_region_size);
+            region = LABSTOR_REGION_ADD(per_core_region_size, region);
             disk_off += per_core_disk_size;
             cur_uuid += uuid_diff;
         }
@@ -180,23 +284,458 @@ public:
         next_log_block_ = block;
     }
 
-    Inode* FindInode(uint64_t dir_uid, labstor::ipc::string filename)  {
-        uint32_t inode_off_;
-        if(path_to_inode_.Find(std::pair(dir_uid, filename), inode_off_)) {
+    static std::string GetParent(const std::string &path) {
+        size_t slash = path.rfind('/');
+        return slash == std::string::npos ? "" : path.substr(0, slash);
+    }
+
+    static std::string GetName(const std::string &path) {
+        size_t slash = path.rfind('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    static std::string Normalize(const char *path) {
+        std::string norm = path;
+        while(norm.size() && norm.back() == '/') {
+            norm.pop_back();
+        }
+        if(norm.size() && norm[0] != '/') {
+            norm.insert(norm.begin(), '/');
+        }
+        return norm;
+    }
+
+    static inline uint64_t GetFdKey(int pid, int fd) {
+        return ((uint64_t)pid << 32) | (uint32_t)fd;
+    }
+
+    int Open(int pid, int fd, const char *path, int oflags, labstor::credentials *creds) {
+        std::lock_guard<std::mutex> lock(lock_);
+        std::string norm = Normalize(path);
+        Inode *inode = FindInode(norm);
+        if(inode == nullptr) {
+            if(!(oflags & O_CREAT)) {
+                return -ENOENT;
+            }
+            int ret = CreateInode(norm, S_IFREG | 0666, creds, inode);
+            if(ret < 0) {
+                return ret;
+            }
+        } else if((oflags & O_CREAT) && (oflags & O_EXCL)) {
+            return -EEXIST;
+        } else if((oflags & O_DIRECTORY) && !inode->IsDir()) {
+            return -ENOTDIR;
+        } else if((oflags & O_TRUNC) && !inode->IsDir()) {
+            int ret = LogResize(inode, 0);
+            if(ret < 0) {
+                return ret;
+            }
+        }
+        ++inode->nopen_;
+        fd_to_inode_[GetFdKey(pid, fd)] = OpenFile{inode, 0, oflags};
+        return 0;
+    }
+
+    int Close(int pid, int fd) {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto iter = fd_to_inode_.find(GetFdKey(pid, fd));
+        if(iter == fd_to_inode_.end()) {
+            return -EBADF;
+        }
+        Inode *inode = iter->second.inode_;
+        fd_to_inode_.erase(iter);
+        if(--inode->nopen_ == 0 && inode->unlinked_) {
+            ReleaseInode(inode);
+        }
+        return 0;
+    }
+
+    int Stat(const char *path, struct stat *st) {
+        std::lock_guard<std::mutex> lock(lock_);
+        Inode *inode = FindInode(Normalize(path));
+        if(inode == nullptr) {
+            return -ENOENT;
+        }
+        inode->Stat(st);
+        return 0;
+    }
+
+    int Fstat(int pid, int fd, struct stat *st) {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto iter = fd_to_inode_.find(GetFdKey(pid, fd));
+        if(iter == fd_to_inode_.end()) {
+            return -EBADF;
+        }
+        iter->second.inode_->Stat(st);
+        return 0;
+    }
+
+    bool IsOpen(int pid, int fd) {
+        std::lock_guard<std::mutex> lock(lock_);
+        return fd_to_inode_.find(GetFdKey(pid, fd)) != fd_to_inode_.end();
+    }
+
+    int64_t Lseek(int pid, int fd, int64_t off, int whence) {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto iter = fd_to_inode_.find(GetFdKey(pid, fd));
+        if(iter == fd_to_inode_.end()) {
+            return -EBADF;
+        }
+        OpenFile &file = iter->second;
+        switch(whence) {
+            case SEEK_SET: break;
+            case SEEK_CUR: off += file.off_; break;
+            case SEEK_END: off += file.inode_->size_; break;
+            default: return -EINVAL;
+        }
+        if(off < 0) {
+            return -EINVAL;
+        }
+        file.off_ = off;
+        return off;
+    }
+
+    /*
+     * Resolves the offset of an I/O and updates the file size and offset.
+     * An offset of -1 means the I/O uses and advances the file offset.
+     * Reads are clamped to the end of the file.
+     * */
+    int64_t ReserveIO(int pid, int fd, bool is_write, size_t off, ssize_t &size) {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto iter = fd_to_inode_.find(GetFdKey(pid, fd));
+        if(iter == fd_to_inode_.end()) {
+            return -EBADF;
+        }
+        OpenFile &file = iter->second;
+        Inode *inode = file.inode_;
+        bool use_file_off = (off == (size_t)-1);
+        if(use_file_off) {
+            off = (is_write && (file.oflags_ & O_APPEND)) ? inode->size_ : file.off_;
+        }
+        if(is_write) {
+            if(off + size > inode->size_) {
+                int ret = LogResize(inode, off + size);
+                if(ret < 0) {
+                    return ret;
+                }
+            } else {
+                inode->mtime_ = time(nullptr);
+            }
+        } else {
+            size = off < inode->size_ ? std::min<size_t>(size, inode->size_ - off) : 0;
+        }
+        if(use_file_off) {
+            file.off_ = off + size;
+        }
+        return off;
+    }
+
+    int Mkdir(const char *path, int mode, labstor::credentials *creds) {
+        std::lock_guard<std::mutex> lock(lock_);
+        Inode *inode;
+        return CreateInode(Normalize(path), S_IFDIR | (mode & 07777), creds, inode);
+    }
+
+    int Unlink(const char *path) {
+        std::lock_guard<std::mutex> lock(lock_);
+        std::string norm = Normalize(path);
+        Inode *inode = FindInode(norm);
+        if(inode == nullptr) {
+            return -ENOENT;
+        }
+        if(inode->IsDir()) {
+            return -EISDIR;
+        }
+        MetadataLogEntry *entry = ReserveMetadata(norm);
+        if(entry == nullptr) {
+            return -ENOSPC;
+        }
+        LogMetadata(entry, LogOp::kRemove, inode, norm);
+        RemoveInode(norm, inode);
+        return 0;
+    }
+
+    int Rmdir(const char *path) {
+        std::lock_guard<std::mutex> lock(lock_);
+        std::string norm = Normalize(path);
+        Inode *inode = FindInode(norm);
+        if(inode == nullptr) {
+            return -ENOENT;
+        }
+        if(!inode->IsDir()) {
+            return -ENOTDIR;
+        }
+        if(norm.empty()) {
+            return -EBUSY;
+        }
+        if(inode->children_.size()) {
+            return -ENOTEMPTY;
+        }
+        MetadataLogEntry *entry = ReserveMetadata(norm);
+        if(entry == nullptr) {
+            return -ENOSPC;
+        }
+        LogMetadata(entry, LogOp::kRemove, inode, norm);
+        RemoveInode(norm, inode);
+        return 0;
+    }
+
+    int Rename(const char *old_path, const char *new_path) {
+        std::lock_guard<std::mutex> lock(lock_);
+        std::string old_norm = Normalize(old_path), new_norm = Normalize(new_path);
+        Inode *inode = FindInode(old_norm);
+        if(inode == nullptr) {
+            return -ENOENT;
+        }
+        if(old_norm == new_norm) {
+            return 0;
+        }
+        if(old_norm.empty() || new_norm.compare(0, old_norm.size() + 1, old_norm + "/") == 0) {
+            return -EINVAL;
+        }
+        Inode *parent = FindInode(GetParent(new_norm));
+        if(parent == nullptr) {
+            return -ENOENT;
+        }
+        if(!parent->IsDir()) {
+            return -ENOTDIR;
+        }
+
+        //The destination is replaced if it exists
+        Inode *target = FindInode(new_norm);
+        if(target) {
+            if(target->IsDir() && !inode->IsDir()) {
+                return -EISDIR;
+            }
+            if(!target->IsDir() && inode->IsDir()) {
+                return -ENOTDIR;
+            }
+            if(target->children_.size()) {
+                return -ENOTEMPTY;
+            }
+        }
+        MetadataLogEntry *entry = ReserveMetadata(old_norm, new_norm);
+        if(entry == nullptr) {
+            return -ENOSPC;
+        }
+        LogMetadata(entry, LogOp::kRename, inode, old_norm, new_norm);
+        MoveInode(old_norm, new_norm, inode, parent);
+        return 0;
+    }
+
+    /*
+     * Packs the entries of an open directory starting at the cookie-th entry.
+     * The cookie is advanced past the entries that were packed.
+     * */
+    int Readdir(int pid, int fd, uint64_t &cookie, char *entries, uint32_t &count) {
+        std::lock_guard<std::mutex> lock(lock_);
+        auto iter = fd_to_inode_.find(GetFdKey(pid, fd));
+        if(iter == fd_to_inode_.end()) {
+            return -EBADF;
+        }
+        Inode *dir = iter->second.inode_;
+        if(!dir->IsDir()) {
+            return -ENOTDIR;
+        }
+        uint32_t off = 0;
+        uint64_t idx = 0;
+        count = 0;
+        for(auto &child : dir->children_) {
+            if(idx++ < cookie) {
+                continue;
+            }
+            uint16_t reclen = labstor::GenericPosix::dir_entry::GetSize(child.first.size());
+            if(off + reclen > LABSTOR_READDIR_SIZE) {
+                break;
+            }
+            auto entry = reinterpret_cast<labstor::GenericPosix::dir_entry*>(entries + off);
+            entry->ino_ = child.second->uuid_;
+            entry->reclen_ = reclen;
+            entry->type_ = child.second->IsDir() ? DT_DIR : DT_REG;
+            strcpy(entry->name_, child.first.c_str());
+            off += reclen;
+            ++count;
+        }
+        cookie += count;
+        return 0;
+    }
+
+    //The methods below require the lock to be held
+
+    Inode* FindInode(const std::string &path)  {
+        auto iter = path_to_inode_.find(path);
+        if(iter == path_to_inode_.end()) {
             return nullptr;
         }
+        return iter->second;
+    }
+
+    int CreateInode(const std::string &path, mode_t mode, labstor::credentials *creds, Inode *&inode) {
+        Inode *parent = FindInode(GetParent(path));
+        if(parent == nullptr) {
+            return -ENOENT;
+        }
+        if(!parent->IsDir()) {
+            return -ENOTDIR;
+        }
+        if(FindInode(path)) {
+            return -EEXIST;
+        }
+        MetadataLogEntry *entry = ReserveMetadata(path);
+        if(entry == nullptr) {
+            return -ENOSPC;
+        }
+        inode = new Inode(next_uuid_++, mode, creds->uid_, creds->gid_);
+        path_to_inode_[path] = inode;
+        parent->children_[GetName(path)] = inode;
+        parent->mtime_ = time(nullptr);
+        LogMetadata(entry, LogOp::kCreate, inode, path);
+        return 0;
+    }
+
+    Inode* FindInodeByUUID(uint64_t uuid) {
+        for(auto &entry : path_to_inode_) {
+            if(entry.second->uuid_ == uuid) {
+                return entry.second;
+            }
+        }
+        return nullptr;
+    }
+
+    //Moves an inode to a new path, replacing the inode there, and re-keys its descendants
+    void MoveInode(const std::string &old_norm, const std::string &new_norm, Inode *inode, Inode *parent) {
+        Inode *target = FindInode(new_norm);
+        if(target) {
+            RemoveInode(new_norm, target);
+        }
+        FindInode(GetParent(old_norm))->children_.erase(GetName(old_norm));
+        parent->children_[GetName(new_norm)] = inode;
+        path_to_inode_.erase(old_norm);
+        path_to_inode_[new_norm] = inode;
+        if(inode->IsDir()) {
+            std::string prefix = old_norm + "/";
+            std::vector<std::pair<std::string, Inode*>> moved;
+            for(auto iter = path_to_inode_.begin(); iter != path_to_inode_.end();) {
+                if(iter->first.compare(0, prefix.size(), prefix) == 0) {
+                    moved.emplace_back(new_norm + iter->first.substr(old_norm.size()), iter->second);
+                    iter = path_to_inode_.erase(iter);
+                } else {
+                    ++iter;
+                }
+            }
+            path_to_inode_.insert(moved.begin(), moved.end());
+        }
+        parent->mtime_ = time(nullptr);
+    }
+
+    void RemoveInode(const std::string &path, Inode *inode) {
+        Inode *parent = FindInode(GetParent(path));
+        parent->children_.erase(GetName(path));
+        parent->mtime_ = time(nullptr);
+        path_to_inode_.erase(path);
+        //Deleting an open file is deferred until its last close
+        inode->unlinked_ = true;
+        if(inode->nopen_ == 0) {
+            ReleaseInode(inode);
+        }
+    }
+
+    void ReleaseInode(Inode *inode) {
+        for(auto &block : inode->blocks_) {
+            GetCoreLog().FreeBlock(block);
+        }
+        delete inode;
     }
 
-    Inode FindInode(int pid, int fd)  {
-        return fd_to_inode_[std::pair(pid,fd)];
+    //Returns nullptr if the calling core's log is full
+    MetadataLogEntry* ReserveMetadata(const std::string &path, const std::string &new_path = "") {
+        return GetCoreLog().ReserveLogEntry<MetadataLogEntry>(MetadataLogEntry::GetSize(path.size(), new_path.size()));
     }
 
-    void RemoveInode(int pid, int fd) {
-        Inode *inode = FindInode(pid,fd);
-        fd_to_inode_.erase(std::pair(pid,fd));
+    void LogMetadata(MetadataLogEntry *entry, LogOp op, Inode *inode, const std::string &path, const std::string &new_path = "") {
+        entry->op_ = op;
+        entry->path_len_ = path.size();
+        entry->new_path_len_ = new_path.size();
+        entry->mode_ = inode->mode_;
+        entry->uid_ = inode->uid_;
+        entry->gid_ = inode->gid_;
+        entry->uuid_ = inode->uuid_;
+        entry->inode_size_ = inode->size_;
+        entry->mtime_ = inode->mtime_;
+        memcpy(reinterpret_cast<char*>(entry + 1), path.data(), path.size());
+        memcpy(reinterpret_cast<char*>(entry + 1) + path.size(), new_path.data(), new_path.size());
+        GetCoreLog().FinalizeLogEntry(entry);
     }
 
-    void CreateInode(uint64_t dir_uid, labstor::ipc::string path) {
+    /*
+     * Size changes are recorded by uuid. All of an inode's size changes within
+     * one commit update the same record, so appending writes don't fill the log.
+     * */
+    int LogResize(Inode *inode, size_t size) {
+        if(inode->resize_entry_ == nullptr || inode->resize_epoch_ != commit_epoch_) {
+            MetadataLogEntry *entry = ReserveMetadata("");
+            if(entry == nullptr) {
+                return -ENOSPC;
+            }
+            inode->resize_entry_ = entry;
+            inode->resize_epoch_ = commit_epoch_;
+        }
+        inode->size_ = size;
+        inode->mtime_ = time(nullptr);
+        LogMetadata(inode->resize_entry_, LogOp::kResize, inode, "");
+        return 0;
+    }
+
+    //Re-applies the metadata changes of a commit read back from storage
+    void Replay(LogCommit *commit) {
+        std::lock_guard<std::mutex> lock(lock_);
+        char *log_off = commit->GetLogOff();
+        for(size_t off = 0; off < commit->log_size_;) {
+            auto entry = reinterpret_cast<MetadataLogEntry*>(log_off + off);
+            off += entry->size_;
+            if(!entry->finalized_) {
+                continue;
+            }
+            std::string path = entry->GetPath();
+            switch(entry->op_) {
+                case LogOp::kCreate: {
+                    Inode *parent = FindInode(GetParent(path));
+                    if(parent == nullptr || FindInode(path)) {
+                        break;
+                    }
+                    Inode *inode = new Inode(entry->uuid_, entry->mode_, entry->uid_, entry->gid_);
+                    inode->size_ = entry->inode_size_;
+                    inode->mtime_ = entry->mtime_;
+                    path_to_inode_[path] = inode;
+                    parent->children_[GetName(path)] = inode;
+                    next_uuid_ = std::max(next_uuid_, entry->uuid_ + 1);
+                    break;
+                }
+                case LogOp::kRemove: {
+                    Inode *inode = FindInode(path);
+                    if(inode) {
+                        RemoveInode(path, inode);
+                    }
+                    break;
+                }
+                case LogOp::kRename: {
+                    std::string new_path = entry->GetNewPath();
+                    Inode *inode = FindInode(path), *parent = FindInode(GetParent(new_path));
+                    if(inode && parent) {
+                        MoveInode(path, new_path, inode, parent);
+                    }
+                    break;
+                }
+                case LogOp::kResize: {
+                    Inode *inode = FindInodeByUUID(entry->uuid_);
+                    if(inode) {
+                        inode->size_ = entry->inode_size_;
+                        inode->mtime_ = entry->mtime_;
+                    }
+                    break;
+                }
+            }
+        }
     }
 
     Block& GetLogBlock() {
@@ -207,7 +746,15 @@ public:
         return per_core_log_[labstor::ThreadLocal::GetTid()];
     }
 
-    void GetLogUpdates(LogCommit *&update, size_t size, const Block &first_block) {
+    /*
+     * Packs every uncommitted log entry into a single LogCommit. The commit
+     * starts at the block the previous commit pointed to and spans as many
+     * blocks as it needs; the buffer is sized to cover all of them. The
+     * entries are marked committed, so the caller must write every block.
+     * */
+    void GetLogUpdates(LogCommit *&update) {
+        std::lock_guard<std::mutex> lock(lock_);
+
         //Get all uncommitted changes to the log
         size_t log_size = 0;
         for(auto &core_log : per_core_log_) {
@@ -215,22 +762,20 @@ public:
         }
 
         //Get the first block
-        int disk_size = log_size;
         std::list<Block> blocks;
         blocks.emplace_back(next_log_block_);
-        disk_size -= next_log_block_.size_;
+        size_t disk_size = next_log_block_.size_;
 
         //Allocate blocks for storing the current log
         auto &core_log = GetCoreLog();
-        while(disk_size > 0) {
+        while(disk_size < LogCommit::GetSize(blocks.size(), log_size)) {
             Block block;
-            if (disk_size > LARGE_BLOCK_SIZE) {
+            if (LogCommit::GetSize(blocks.size() + 1, log_size) - disk_size > LARGE_BLOCK_SIZE) {
                 core_log.GetBlock(LARGE_BLOCK_SIZE, block);
-                disk_size -= LARGE_BLOCK_SIZE;
             } else {
                 core_log.GetBlock(SMALL_BLOCK_SIZE, block);
-                disk_size -= SMALL_BLOCK_SIZE;
             }
+            disk_size += block.size_;
             blocks.emplace_back(block);
         }
 
@@ -238,19 +783,22 @@ public:
         core_log.GetBlock(SMALL_BLOCK_SIZE, next_log_block_);
 
         //Create the LogCommit message
-        update = reinterpret_cast<LogCommit*>(malloc(LogCommit::GetSize(blocks.size(), log_size)));
+        update = reinterpret_cast<LogCommit*>(malloc(disk_size));
+        update->total_size_ = disk_size;
         update->num_blocks_ = 0;
         update->log_size_ = 0;
         update->next_ = next_log_block_;
         for(auto &block : blocks) {
-            update->blocks_[update->num_blocks_++];
+            update->blocks_[update->num_blocks_++] = block;
         }
         char *log_off = update->GetLogOff();
         for(auto &core_log : per_core_log_) {
             size_t uncommitted_size = core_log.GetUncommittedSize();
-            memcpy(log_off, core_log.GetUncommittedOff(), uncommitted_size);
+            memcpy(log_off + update->log_size_, core_log.GetUncommittedOff(), uncommitted_size);
             update->log_size_ += uncommitted_size;
+            core_log.Commit();
         }
+        ++commit_epoch_;
     }
 };
 
@@ -29,6 +29,9 @@
 #include <labmods/labstor_fs/server/labstor_fs_server.h>
 #include <labmods/generic_block/generic_block.h>
 #include <list>
+#include <cstring>
+
+#define LABFS_REAP_BATCH_SIZE 32
 
 bool labstor::LabFS::Server::ProcessRequest(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) {
     switch(static_cast<labstor::GenericPosix::Ops>(request->GetOp())) {
@@ -45,6 +48,28 @@ bool labstor::LabFS::Server::ProcessRequest(labstor::queue_pair *qp, labstor::ip
         case labstor::GenericPosix::Ops::kRead: {
             return IO(qp, reinterpret_cast<labstor::GenericPosix::io_request*>(request), creds);
         }
+        case labstor::GenericPosix::Ops::kStat:
+        case labstor::GenericPosix::Ops::kFstat: {
+            return Stat(qp, reinterpret_cast<labstor::GenericPosix::stat_request*>(request), creds);
+        }
+        case labstor::GenericPosix::Ops::kLseek: {
+            return Lseek(qp, reinterpret_cast<labstor::GenericPosix::lseek_request*>(request), creds);
+        }
+        case labstor::GenericPosix::Ops::kUnlink:
+        case labstor::GenericPosix::Ops::kMkdir:
+        case labstor::GenericPosix::Ops::kRmdir: {
+            return PathOp(qp, reinterpret_cast<labstor::GenericPosix::path_request*>(request), creds);
+        }
+        case labstor::GenericPosix::Ops::kRename: {
+            return Rename(qp, reinterpret_cast<labstor::GenericPosix::rename_request*>(request), creds);
+        }
+        case labstor::GenericPosix::Ops::kReaddir: {
+            return Readdir(qp, reinterpret_cast<labstor::GenericPosix::readdir_request*>(request), creds);
+        }
+        case labstor::GenericPosix::Ops::kFsync:
+        case labstor::GenericPosix::Ops::kFdatasync: {
+            return Fsync(qp, reinterpret_cast<labstor::GenericPosix::fsync_request*>(request), creds);
+        }
     }
     return true;
 }
@@ -60,16 +85,17 @@ inline bool labstor::LabFS::Server::Initialize(labstor::queue_pair *qp, labstor:
     LogCommit *commit;
     std::list<LogCommit*> log;
     Block block = log_.GetLogBlock();
-    ipc_manager_->GetQueuePair(priv_qp, LABSTOR_QP_PRIVATE | LABSTOR_QP_INTERMEDIATE | LABSTOR_QP_LOW_LATENCY);
+    ipc_manager_->GetQueuePair(priv_qp, LABSTOR_QP_SERVER_PRIVATE);
     do {
         //Load log block from storage
         commit = reinterpret_cast<LogCommit*>(malloc(block.size_));
         block_rq = ipc_manager_->AllocRequest<labstor::GenericBlock::io_request>(priv_qp);
-        block_rq->Start(next_module_, labstor::GenericBlock::Ops::kRead, block.off_, block.size_, commit);
+        block_rq->Start(next_module_, labstor::GenericBlock::Ops::kRead, block.off_, block.size_, labstor::ipc::buf_ref::Raw(commit));
         priv_qp->Enqueue<labstor::GenericBlock::io_request>(block_rq, qtok);
         block_rq = ipc_manager_->Wait<labstor::GenericBlock::io_request>(qtok);
 
         //Replay log transactions
+        log_.Replay(commit);
 
         //Get next block to load
         block = commit->next_;
@@ -80,48 +106,195 @@ inline bool labstor::LabFS::Server::Initialize(labstor::queue_pair *qp, labstor:
     } while(block.size_);
 }
 inline bool labstor::LabFS::Server::Open(labstor::queue_pair *qp, labstor::GenericPosix::open_request *client_rq, labstor::credentials *creds) {
-    int prior_off = 0;
-    uint64_t cur_uuid = 0;
-    if(client_rq->oflags_ & O_CREAT) {
-        //Allocate file UUID
-        log_.GetCoreLog().GetUUID();
-        //Get UUID of parent directory (traverse private inode map)
-        while(0) {
-            int len = GetNextSlash(client_rq->path_, prior_off);
-            if(len == 0) { break; }
-            Inode *inode = log_->FindInode(cur_uuid, client_rq->path_, prior_off, len);
-            prior_off = len+1; //index of thing after the slash
-        }
-        //Create new Inode
-        log_->CreateInode();
-        //Append to log
-        log_.GetCoreLog().LogModify(client_rq);
-    }
+    client_rq->Complete(log_.Open(creds->pid_, client_rq->fd_, client_rq->path_, client_rq->oflags_, creds));
     return true;
 }
 inline bool labstor::LabFS::Server::Close(labstor::queue_pair *qp, labstor::GenericPosix::close_request *client_rq, labstor::credentials *creds) {
     //sync all data & metadata back to storage
+    client_rq->Complete(log_.Close(creds->pid_, client_rq->fd_));
     return true;
 }
-inline bool labstor::LabFS::Server::IO(labstor::queue_pair *qp, labstor::GenericPosix::io_request *client_rq, labstor::credentials *creds) {
+inline bool labstor::LabFS::Server::Stat(labstor::queue_pair *qp, labstor::GenericPosix::stat_request *client_rq, labstor::credentials *creds) {
+    if(client_rq->fd_ < 0) {
+        client_rq->Complete(log_.Stat(client_rq->path_, &client_rq->st_));
+    } else {
+        client_rq->Complete(log_.Fstat(creds->pid_, client_rq->fd_, &client_rq->st_));
+    }
+    return true;
+}
+inline bool labstor::LabFS::Server::Lseek(labstor::queue_pair *qp, labstor::GenericPosix::lseek_request *client_rq, labstor::credentials *creds) {
+    int64_t off = log_.Lseek(creds->pid_, client_rq->fd_, client_rq->off_, client_rq->whence_);
+    client_rq->Complete(off, off < 0 ? off : 0);
+    return true;
+}
+inline bool labstor::LabFS::Server::PathOp(labstor::queue_pair *qp, labstor::GenericPosix::path_request *client_rq, labstor::credentials *creds) {
+    switch(static_cast<labstor::GenericPosix::Ops>(client_rq->GetOp())) {
+        case labstor::GenericPosix::Ops::kUnlink: {
+            client_rq->Complete(log_.Unlink(client_rq->path_));
+            break;
+        }
+        case labstor::GenericPosix::Ops::kMkdir: {
+            client_rq->Complete(log_.Mkdir(client_rq->path_, client_rq->mode_, creds));
+            break;
+        }
+        case labstor::GenericPosix::Ops::kRmdir: {
+            client_rq->Complete(log_.Rmdir(client_rq->path_));
+            break;
+        }
+    }
+    return true;
+}
+inline bool labstor::LabFS::Server::Rename(labstor::queue_pair *qp, labstor::GenericPosix::rename_request *client_rq, labstor::credentials *creds) {
+    client_rq->Complete(log_.Rename(client_rq->GetOldPath(), client_rq->GetNewPath()));
+    return true;
+}
+inline bool labstor::LabFS::Server::Readdir(labstor::queue_pair *qp, labstor::GenericPosix::readdir_request *client_rq, labstor::credentials *creds) {
+    client_rq->Complete(log_.Readdir(creds->pid_, client_rq->fd_, client_rq->cookie_, client_rq->entries_, client_rq->count_));
+    return true;
+}
+/*
+ * Fsyncs are group committed. An fsync joins the epoch of the next commit to
+ * start, and the first waiter to find no commit in flight starts it and drives
+ * it to completion: the uncommitted log is written in one batch, then the
+ * device is flushed once. Every fsync of that epoch completes together.
+ * Data is written directly to its blocks, so fdatasync shares the same commit.
+ * */
+inline bool labstor::LabFS::Server::Fsync(labstor::queue_pair *qp, labstor::GenericPosix::fsync_request *client_rq, labstor::credentials *creds) {
+    std::lock_guard<std::mutex> lock(commit_lock_);
+    if(client_rq->epoch_ == 0) {
+        if(!log_.IsOpen(creds->pid_, client_rq->fd_)) {
+            client_rq->Complete(-EBADF);
+            return true;
+        }
+        client_rq->epoch_ = next_epoch_;
+    }
+    if(committer_ == nullptr && client_rq->epoch_ > durable_epoch_) {
+        committer_ = client_rq;
+        StartCommit();
+    }
+    if(committer_ == client_rq) {
+        PollCommit();
+    }
+    if(client_rq->epoch_ > durable_epoch_) {
+        return false;
+    }
+    client_rq->Complete(client_rq->epoch_ == failed_epoch_ ? failed_code_ : 0);
+    return true;
+}
+
+inline void labstor::LabFS::Server::StartCommit() {
+    labstor::queue_pair *priv_qp;
+    log_.GetLogUpdates(commit_);
+    ++next_epoch_;
+    commit_code_ = 0;
+    commit_phase_ = CommitPhase::kWriteLog;
+
+    //Write the commit across its log blocks in a single batch
+    int num_blocks = commit_->num_blocks_;
+    char *buf = reinterpret_cast<char*>(commit_);
+    labstor::GenericBlock::io_request **block_rqs = new labstor::GenericBlock::io_request*[num_blocks];
+    commit_qtoks_.resize(num_blocks);
+    ipc_manager_->GetQueuePair(priv_qp, LABSTOR_QP_SERVER_PRIVATE);
+    for(int i = 0; i < num_blocks; ++i) {
+        Block &block = commit_->blocks_[i];
+        block_rqs[i] = ipc_manager_->AllocRequest<labstor::GenericBlock::io_request>(priv_qp);
+        block_rqs[i]->Start(next_module_, labstor::GenericBlock::Ops::kWrite, block.off_, block.size_, labstor::ipc::buf_ref::Raw(buf));
+        buf += block.size_;
+    }
+    priv_qp->EnqueueBatch(block_rqs, num_blocks, commit_qtoks_.data());
+    delete [] block_rqs;
+}
+
+/*
+ * Advances the in-flight commit.
+ * */
+inline void labstor::LabFS::Server::PollCommit() {
+    labstor::queue_pair *priv_qp;
     labstor::GenericBlock::io_request *block_rq;
+    labstor::ipc::qtok_t qtok;
+
+    if(!ReapCommit()) {
+        return;
+    }
+    switch(commit_phase_) {
+        //The log is on storage; flush the device so it and all completed data writes are durable
+        case CommitPhase::kWriteLog: {
+            ipc_manager_->GetQueuePair(priv_qp, LABSTOR_QP_SERVER_PRIVATE);
+            block_rq = ipc_manager_->AllocRequest<labstor::GenericBlock::io_request>(priv_qp);
+            block_rq->Start(next_module_, labstor::GenericBlock::Ops::kFlush);
+            priv_qp->Enqueue<labstor::GenericBlock::io_request>(block_rq, qtok);
+            commit_qtoks_.assign(1, qtok);
+            commit_phase_ = CommitPhase::kFlush;
+            break;
+        }
+
+        //Complete the epoch
+        case CommitPhase::kFlush: {
+            free(commit_);
+            commit_ = nullptr;
+            committer_ = nullptr;
+            durable_epoch_ = next_epoch_ - 1;
+            if(commit_code_) {
+                failed_epoch_ = durable_epoch_;
+                failed_code_ = commit_code_;
+            }
+            break;
+        }
+    }
+}
+
+/*
+ * Reaps the commit's outstanding block requests. Returns true once all of them are complete.
+ * */
+inline bool labstor::LabFS::Server::ReapCommit() {
     labstor::queue_pair *priv_qp;
-    Block block;
+    labstor::GenericBlock::io_request *block_rqs[LABFS_REAP_BATCH_SIZE];
+    uint32_t count, num_reaped;
+
+    if(commit_qtoks_.empty()) {
+        return true;
+    }
+    ipc_manager_->GetQueuePair(priv_qp, commit_qtoks_[0]);
+    do {
+        count = commit_qtoks_.size() < LABFS_REAP_BATCH_SIZE ? commit_qtoks_.size() : LABFS_REAP_BATCH_SIZE;
+        //Reaped qtoks are compacted out of the front of the window, so the pending ones stay first
+        num_reaped = priv_qp->ReapCompleted(commit_qtoks_.data(), count, block_rqs);
+        for(uint32_t j = 0; j < num_reaped; ++j) {
+            if(block_rqs[j]->GetCode() != 0) {
+                commit_code_ = -EIO;
+            }
+            ipc_manager_->FreeRequest<labstor::GenericBlock::io_request>(priv_qp, block_rqs[j]);
+        }
+        commit_qtoks_.erase(commit_qtoks_.begin() + (count - num_reaped), commit_qtoks_.begin() + count);
+    } while(num_reaped == count && commit_qtoks_.size() > 0);
+    return commit_qtoks_.empty();
+}
 
-    int i = 0;
-    char *buf = reinterpret_cast<char*>(client_rq->buf_);
-    size_t total_io = client_rq->size_;
-    int num_blocks = (total_io/SMALL_BLOCK_SIZE) + 1;
-    labstor::ipc::qtok_t *qtoks = new labstor::ipc::qtok_t[num_blocks];
+inline bool labstor::LabFS::Server::IO(labstor::queue_pair *qp, labstor::GenericPosix::io_request *client_rq, labstor::credentials *creds) {
+    labstor::queue_pair *priv_qp;
+    Block block;
 
     //For a read, we must identify the set of blocks
     //For a write, we must allocate new blocks
 
     switch(client_rq->GetCode()) {
-        //Divide I/O into blocks
+        //Divide I/O into blocks and submit them to the next module in a single batch
         case 0: {
-            ipc_manager_->GetQueuePair(priv_qp, LABSTOR_QP_PRIVATE | LABSTOR_QP_LOW_LATENCY);
-            for (size_t cur_io = 0; cur_io < total_io; ++i) {
+            int i = 0;
+            bool is_write = static_cast<labstor::GenericPosix::Ops>(client_rq->op_) == labstor::GenericPosix::Ops::kWrite;
+            int64_t off = log_.ReserveIO(creds->pid_, client_rq->fd_, is_write, client_rq->off_, client_rq->size_);
+            if(off < 0) {
+                client_rq->Complete(off, off);
+                return true;
+            }
+            labstor::ipc::buf_ref buf = client_rq->buf_;
+            size_t total_io = client_rq->size_;
+            int num_blocks = (total_io/SMALL_BLOCK_SIZE) + 1;
+            labstor::ipc::qtok_t *qtoks = new labstor::ipc::qtok_t[num_blocks];
+            labstor::GenericBlock::io_request **block_rqs = new labstor::GenericBlock::io_request*[num_blocks];
+
+            ipc_manager_->GetQueuePair(priv_qp, LABSTOR_QP_SERVER_PRIVATE);
+            for (size_t cur_io = 0; cur_io < total_io && i < num_blocks; ++i) {
                 size_t io_size = (total_io - cur_io < LARGE_BLOCK_SIZE) ? SMALL_BLOCK_SIZE : LARGE_BLOCK_SIZE;
                 switch(static_cast<labstor::GenericPosix::Ops>(client_rq->op_)) {
                     case labstor::GenericPosix::Ops::kWrite: {
@@ -132,11 +305,13 @@ inline bool labstor::LabFS::Server::IO(labstor::queue_pair *qp, labstor::Generic
                         break;
                     }
                 }
-                block_rq = ipc_manager_->AllocRequest<labstor::GenericBlock::io_request>(priv_qp);
-                block_rq->Start(next_module_, static_cast<labstor::GenericBlock::Ops>(client_rq->op_), block.off_, block.size_, buf);
-                priv_qp->Enqueue(block_rq, qtoks[i]);
-                buf += io_size;
+                block_rqs[i] = ipc_manager_->AllocRequest<labstor::GenericBlock::io_request>(priv_qp);
+                block_rqs[i]->Start(next_module_, static_cast<labstor::GenericBlock::Ops>(client_rq->op_), block.off_, block.size_, buf);
+                buf = buf.Add(io_size);
+                cur_io += io_size;
             }
+            priv_qp->EnqueueBatch(block_rqs, i, qtoks);
+            delete [] block_rqs;
             client_rq->SetQtoks(i, qtoks);
             client_rq->SetCode(1);
             return false;
@@ -144,14 +319,30 @@ inline bool labstor::LabFS::Server::IO(labstor::queue_pair *qp, labstor::Generic
 
         //FS only performs direct I/O; commit blocks when I/O completes
         case 1: {
+            labstor::GenericBlock::io_request *block_rqs[LABFS_REAP_BATCH_SIZE];
+            uint32_t count, num_reaped;
+            if(client_rq->num_qtoks_ == 0) {
+                delete [] client_rq->qtoks_;
+                return true;
+            }
             ipc_manager_->GetQueuePair(priv_qp, client_rq->qtoks_[0]);
-            for(int i = client_rq->cur_qtok_; i < client_rq->num_qtoks_; ++i) {
-                if(!priv_qp->IsComplete(client_rq->qtoks_[i], block_rq)) {
-                    return  false;
+            do {
+                count = client_rq->num_qtoks_ < LABFS_REAP_BATCH_SIZE ? client_rq->num_qtoks_ : LABFS_REAP_BATCH_SIZE;
+                //Reaped qtoks are compacted out of the front of the window, so the pending ones stay first
+                num_reaped = priv_qp->ReapCompleted(client_rq->qtoks_, count, block_rqs);
+                for(uint32_t j = 0; j < num_reaped; ++j) {
+                    log_.GetCoreLog().LogModify(block_rqs[j]);
+                }
+                if(num_reaped) {
+                    memmove(client_rq->qtoks_ + (count - num_reaped), client_rq->qtoks_ + count,
+                            (client_rq->num_qtoks_ - count) * sizeof(labstor::ipc::qtok_t));
                 }
-                log_.GetCoreLog().LogModify(block_rq);
-                ++client_rq->cur_qtok_;
+                client_rq->num_qtoks_ -= num_reaped;
+            } while(num_reaped == count && client_rq->num_qtoks_ > 0);
+            if(client_rq->num_qtoks_ > 0) {
+                return false;
             }
+            delete [] client_rq->qtoks_;
             return true;
         }
     }
@@ -39,16 +39,34 @@
 #include <labstor/userspace/server/ipc_manager.h>
 #include <labstor/userspace/server/namespace.h>
 #include <labstor/types/data_structures/unordered_map/shmem_int_map.h>
+#include <mutex>
+#include <vector>
 
 namespace labstor::LabFS {
+
+enum class CommitPhase {
+    kWriteLog,
+    kFlush
+};
+
 class Server : public labstor::Module {
 private:
     LABSTOR_IPC_MANAGER_T ipc_manager_;
     LABSTOR_NAMESPACE_T namespace_;
     uint32_t next_module_;
     Log log_;
+
+    //Group commit: fsyncs of the same epoch share one log write and one device flush
+    std::mutex commit_lock_;
+    uint64_t next_epoch_, durable_epoch_, failed_epoch_;
+    int failed_code_, commit_code_;
+    CommitPhase commit_phase_;
+    labstor::GenericPosix::fsync_request *committer_;
+    LogCommit *commit_;
+    std::vector<labstor::ipc::qtok_t> commit_qtoks_;
 public:
-    Server() : labstor::Module(LABFS_MODULE_ID) {
+    Server() : labstor::Module(LABFS_MODULE_ID), next_epoch_(1), durable_epoch_(0), failed_epoch_(0), failed_code_(0),
+        commit_code_(0), commit_phase_(CommitPhase::kWriteLog), committer_(nullptr), commit_(nullptr) {
         ipc_manager_ = LABSTOR_IPC_MANAGER;
         namespace_ = LABSTOR_NAMESPACE;
     }
@@ -57,6 +75,16 @@ public:
     inline bool Open(labstor::queue_pair *qp, labstor::GenericPosix::open_request *client_rq, labstor::credentials *creds);
     inline bool Close(labstor::queue_pair *qp, labstor::GenericPosix::close_request *client_rq, labstor::credentials *creds);
     inline bool IO(labstor::queue_pair *qp, labstor::GenericPosix::io_request *client_rq, labstor::credentials *creds);
+    inline bool Stat(labstor::queue_pair *qp, labstor::GenericPosix::stat_request *client_rq, labstor::credentials *creds);
+    inline bool Lseek(labstor::queue_pair *qp, labstor::GenericPosix::lseek_request *client_rq, labstor::credentials *creds);
+    inline bool PathOp(labstor::queue_pair *qp, labstor::GenericPosix::path_request *client_rq, labstor::credentials *creds);
+    inline bool Rename(labstor::queue_pair *qp, labstor::GenericPosix::rename_request *client_rq, labstor::credentials *creds);
+    inline bool Readdir(labstor::queue_pair *qp, labstor::GenericPosix::readdir_request *client_rq, labstor::credentials *creds);
+    inline bool Fsync(labstor::queue_pair *qp, labstor::GenericPosix::fsync_request *client_rq, labstor::credentials *creds);
+private:
+    inline void StartCommit();
+    inline void PollCommit();
+    inline bool ReapCommit();
 };
 }
 
@@ -105,7 +105,7 @@ labstor::ipc::qtok_t labstor::LRU::Client::AIO(labstor::GenericPosix::Ops op, in
 
     //Create CLIENT -> SERVER message
     client_rq = ipc_manager_->AllocRequest<labstor::GenericPosix::io_request>(qp);
-    client_rq->Start(ns_id_, op, fd, buf, size);
+    client_rq->Start(ns_id_, op, fd, ipc_manager_->GetBufferRef(buf), size);
 
     //Enqueue the message
     qp->Enqueue<labstor::GenericPosix::io_request>(client_rq, qtok);
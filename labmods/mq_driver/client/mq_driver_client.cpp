@@ -57,7 +57,7 @@ labstor::ipc::qtok_t labstor::MQDriver::Client::AIO(Ops op, void *user_buf, size
     //Create CLIENT -> SERVER message
     TRACEPOINT("Submit")
     client_rq = ipc_manager_->AllocRequest<io_request>(qp);
-    client_rq->IOClientStart(ns_id_, ipc_manager_->GetPID(), op, user_buf, buf_size, sector, hctx);
+    client_rq->IOClientStart(ns_id_, ipc_manager_->GetPID(), op, ipc_manager_->GetBufferRef(user_buf), buf_size, sector, hctx);
 
     //Enqueue the request
     qp->Enqueue<io_request>(client_rq, qtok);
@@ -76,7 +76,7 @@ void labstor::MQDriver::Client::IO(Ops op, void *user_buf, size_t buf_size, size
     //Create CLIENT -> SERVER message
     TRACEPOINT("Submit", "dev_id", dev_id_)
     client_rq = ipc_manager_->AllocRequest<io_request>(qp);
-    client_rq->IOClientStart(ns_id_, ipc_manager_->GetPID(), op, user_buf, buf_size, sector, hctx);
+    client_rq->IOClientStart(ns_id_, ipc_manager_->GetPID(), op, ipc_manager_->GetBufferRef(user_buf), buf_size, sector, hctx);
 
     //Complete CLIENT -> SERVER interaction
     qp->Enqueue<io_request>(client_rq, qtok);
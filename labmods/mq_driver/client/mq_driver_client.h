@@ -55,6 +55,9 @@ public:
     inline void Write(void *user_buf, size_t buf_size, size_t sector, int hctx) {
         IO(Ops::kWrite, user_buf, buf_size, sector, hctx);
     }
+    inline void Flush(int hctx) {
+        IO(Ops::kFlush, nullptr, 0, 0, hctx);
+    }
 
     labstor::ipc::qtok_t AIO(Ops op, void *user_buf, size_t buf_size, size_t sector, int hctx);
     inline labstor::ipc::qtok_t ARead(void *user_buf, size_t buf_size, size_t sector, int hctx) {
@@ -63,6 +66,9 @@ public:
     inline labstor::ipc::qtok_t AWrite(void *user_buf, size_t buf_size, size_t sector, int hctx) {
         return AIO(Ops::kWrite, user_buf, buf_size, sector, hctx);
     }
+    inline labstor::ipc::qtok_t AFlush(int hctx) {
+        return AIO(Ops::kFlush, nullptr, 0, 0, hctx);
+    }
 
     int GetNumHWQueues();
 };
@@ -57,6 +57,7 @@
 #include <labmods/generic_queue/generic_queue.h>
 #include <labmods/mq_driver/kernel/mq_driver_kernel.h>
 #include <labmods/blkdev_table/kernel/blkdev_table_kernel.h>
+#include <labmods/secure_shmem/kernel/secure_shmem_kernel.h>
 
 MODULE_AUTHOR("Luke Logan <llogan@hawk.iit.edu>");
 MODULE_DESCRIPTION("A kernel module that performs I/O with underlying storage devices");
@@ -510,6 +511,44 @@ static inline struct page **convert_user_buf(int pid, void *user_buf, size_t len
     return pages;
 }
 
+/*
+ * Buffers from a data buffer pool are backed by a secure_shmem region, so
+ * their pages are found directly instead of pinning the submitter's memory.
+ * The submitter must have been granted the region.
+ * */
+static inline struct page **convert_shmem_buf(int pid, struct labstor_buf_ref *buf, size_t length, int *num_pagesp) {
+    struct shmem_region_info *region;
+    struct page **pages;
+    int num_pages, i;
+
+    *num_pagesp = 0;
+    region = labstor_find_pid_shmem_region_info(pid, buf->region_id_);
+    num_pages = (length % PAGE_SIZE) ? length/PAGE_SIZE + 1 : length/PAGE_SIZE;
+    if(region == NULL || buf->off_ % PAGE_SIZE || num_pages > MAX_PAGES_PER_GET ||
+       buf->off_ > region->size || (size_t)num_pages*PAGE_SIZE > region->size - buf->off_) {
+        pr_err("Invalid data buffer: pid=%d region=%d off=%llu length=%lu\n", pid, buf->region_id_, buf->off_, length);
+        return NULL;
+    }
+    pages = (struct page **)kmem_cache_alloc(page_cache, GFP_KERNEL);
+    if(pages == NULL) {
+        pr_err("Could not allocate space for the buffer's pages");
+        return NULL;
+    }
+    for(i = 0; i < num_pages; ++i) {
+        pages[i] = vmalloc_to_page((char*)region->vmalloc_ptr + buf->off_ + (size_t)i*PAGE_SIZE);
+    }
+
+    *num_pagesp = num_pages;
+    return pages;
+}
+
+static inline struct page **convert_buf(int pid, struct labstor_buf_ref *buf, size_t length, int *num_pagesp) {
+    if(labstor_buf_ref_IsRaw(buf)) {
+        return convert_user_buf(pid, (void*)(uintptr_t)buf->off_, length, num_pagesp);
+    }
+    return convert_shmem_buf(pid, buf, length, num_pagesp);
+}
+
 static inline struct bio *create_bio(struct labstor_mq_driver_request *rq, struct block_device *bdev, struct page **pages, int num_pages, size_t sector, int op) {
     struct bio *bio;
     int i;
@@ -590,8 +629,8 @@ inline void submit_mq_driver_io(struct labstor_queue_pair *qp, struct labstor_mq
     pr_debug("Starting I/O submission");
 
     //Convert user's buffer to pages
-    pr_debug("Converting user pages: %p %lu\n", rq->user_buf_, rq->buf_size_);
-    pages = convert_user_buf(rq->pid_, rq->user_buf_, rq->buf_size_, &num_pages);
+    pr_debug("Converting buffer pages: %d %llu %lu\n", rq->buf_.region_id_, rq->buf_.off_, rq->buf_size_);
+    pages = convert_buf(rq->pid_, &rq->buf_, rq->buf_size_, &num_pages);
     if(pages == NULL) {
         pr_err("Not enough space to allocate user pages\n");
         success = LABSTOR_MQ_CANT_ALLOCATE_PAGES;
@@ -655,6 +694,46 @@ inline void submit_mq_driver_io(struct labstor_queue_pair *qp, struct labstor_mq
     pr_err("I/O has been submitted: %d", rq->cookie_); //TODO: pr_info
 }
 
+/*
+ * Flushes the device's volatile write cache. An empty PREFLUSH bio goes through the BIO layer,
+ * whose flush machinery completes it immediately on devices without a write cache.
+ * */
+inline void submit_mq_driver_flush(struct labstor_queue_pair *qp, struct labstor_mq_driver_request *rq) {
+    struct block_device *bdev;
+    struct bio *bio;
+    int success = LABSTOR_MQ_OK;
+
+    pr_debug("Received REQ_PREFLUSH request [%p], %d\n", rq, rq->dev_id_);
+
+    //Get block device associated with semantic label
+    bdev = labstor_get_bdev(rq->dev_id_);
+    if(bdev == NULL) {
+        pr_err("Invalid block device id: %d\n", rq->dev_id_);
+        success = LABSTOR_MQ_INVALID_DEVICE_ID;
+        goto err_complete;
+    }
+    //Create an empty bio
+    bio = bio_alloc(GFP_KERNEL, 0);
+    if(bio == NULL) {
+        pr_err("Cannot allocate more BIOs\n");
+        success = LABSTOR_MQ_CANNOT_ALLOCATE_BIO;
+        goto err_complete;
+    }
+    bio_set_dev(bio, bdev);
+    bio->bi_opf = REQ_OP_WRITE | REQ_PREFLUSH | REQ_SYNC;
+    bio->bi_private = rq;
+    bio->bi_end_io = &io_complete;
+    rq->cookie_ = submit_bio(bio);
+
+    //A flush that was never submitted will not reach io_complete
+    err_complete:
+    if(success != LABSTOR_MQ_OK) {
+        rq->flags_ |= LABSTOR_MQ_IO_IS_COMPLETE;
+    }
+    rq->header_.code_ = success;
+    labstor_queue_pair_CompleteInf(qp, (struct labstor_request*)rq);
+}
+
 inline void poll_io_completion(struct labstor_queue_pair *qp, struct labstor_mq_driver_request *rq) {
     struct blk_mq_hw_ctx *hctx;
     struct block_device *bdev;
@@ -701,6 +780,10 @@ void mq_process_request_fn(struct labstor_queue_pair *qp, struct labstor_request
             submit_mq_driver_io(qp, (struct labstor_mq_driver_request*)rq);
             break;
         }
+        case LABSTOR_MQ_DRIVER_FLUSH: {
+            submit_mq_driver_flush(qp, (struct labstor_mq_driver_request*)rq);
+            break;
+        }
         case LABSTOR_MQ_NUM_HW_QUEUES: {
             get_num_hw_queues(qp, (struct labstor_queue_stats_request*)rq);
             break;
@@ -29,6 +29,7 @@
 
 #include <labstor/types/basics.h>
 #include <labstor/types/data_structures/shmem_request.h>
+#include <labstor/types/data_structures/shmem_buffer.h>
 #include "labstor/types/data_structures/c/shmem_queue_pair.h"
 #include <labmods/generic_queue/generic_queue.h>
 
@@ -61,7 +62,8 @@ enum {
     LABSTOR_MQ_NUM_HW_QUEUES,
     LABSTOR_MQ_POLL_COMPLETION,
     LABSTOR_MQ_DRIVER_WRITE,
-    LABSTOR_MQ_DRIVER_READ
+    LABSTOR_MQ_DRIVER_READ,
+    LABSTOR_MQ_DRIVER_FLUSH
 };
 
 #ifdef __cplusplus
@@ -73,6 +75,7 @@ enum class Ops {
     kPollCompletion,
     kWrite,
     kRead,
+    kFlush,
 };
 
 struct register_request : labstor::Registrar::register_request {
@@ -86,7 +89,7 @@ struct register_request : labstor::Registrar::register_request {
 
 struct io_request : public labstor::ipc::request {
     int dev_id_;
-    void *user_buf_;
+    labstor::ipc::buf_ref buf_;
     size_t sector_;
     size_t buf_size_;
     int hctx_;
@@ -97,18 +100,18 @@ struct io_request : public labstor::ipc::request {
     struct labstor_qtok_t kern_qtok_;
     void *kern_rq_;
 
-    inline void IOClientStart(int ns_id, int pid, labstor::MQDriver::Ops op, void *user_buf, size_t buf_size, size_t sector, int hctx) {
-        IOStart(ns_id, pid, static_cast<int>(op), 0, user_buf, buf_size, sector, hctx);
+    inline void IOClientStart(int ns_id, int pid, labstor::MQDriver::Ops op, labstor::ipc::buf_ref buf, size_t buf_size, size_t sector, int hctx) {
+        IOStart(ns_id, pid, static_cast<int>(op), 0, buf, buf_size, sector, hctx);
     }
     inline void IOKernelStart(int ns_id, io_request *rq) {
-        IOStart(ns_id, rq->pid_, rq->op_, rq->dev_id_, rq->user_buf_, rq->buf_size_, rq->sector_, rq->hctx_);
+        IOStart(ns_id, rq->pid_, rq->op_, rq->dev_id_, rq->buf_, rq->buf_size_, rq->sector_, rq->hctx_);
     }
-    inline void IOStart(int ns_id, int pid, int op, int dev_id, void *user_buf, size_t buf_size, size_t sector, int hctx) {
+    inline void IOStart(int ns_id, int pid, int op, int dev_id, labstor::ipc::buf_ref buf, size_t buf_size, size_t sector, int hctx) {
         ns_id_ = ns_id;
         op_ = op;
         pid_ = pid;
         dev_id_ = dev_id;
-        user_buf_ = user_buf;
+        buf_ = buf;
         buf_size_ = buf_size;
         sector_ = sector;
         hctx_ = hctx;
@@ -138,7 +141,7 @@ struct io_request : public labstor::ipc::request {
 struct labstor_mq_driver_request {
     struct labstor_request header_;
     int dev_id_;
-    void *user_buf_;
+    struct labstor_buf_ref buf_;
     size_t sector_;
     size_t buf_size_;
     int hctx_;
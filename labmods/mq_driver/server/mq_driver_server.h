@@ -31,6 +31,7 @@
 #include <labstor/userspace/server/macros.h>
 #include <labstor/userspace/server/ipc_manager.h>
 #include <labstor/userspace/types/module.h>
+#include <labstor/types/continuation.h>
 #include <labmods/generic_queue/server/generic_queue_server.h>
 #include "mq_driver.h"
 
@@ -45,8 +46,9 @@ public:
         ipc_manager_ = LABSTOR_IPC_MANAGER;
     }
     bool ProcessRequest(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds);
+    size_t GetRequestSize(labstor::ipc::request *request) override;
     bool Initialize(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override;
-    bool IO(labstor::queue_pair *qp, io_request *rq_submit, labstor::credentials *creds);
+    labstor::Continuation IO(labstor::queue_pair *qp, io_request *rq_submit, labstor::credentials *creds);
     bool GetStatistics(labstor::queue_pair *qp, labstor::GenericQueue::stats_request *rq_submit, labstor::credentials *creds);
 };
 
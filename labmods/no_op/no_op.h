@@ -24,8 +24,8 @@
  * <http://www.gnu.org/licenses/>.
  */
 
-#ifndef LABSTOR_MQ_DRIVER_H
-#define LABSTOR_MQ_DRIVER_H
+#ifndef LABSTOR_NO_OP_H
+#define LABSTOR_NO_OP_H
 
 #include "labstor/types/basics.h"
 #include "labstor/types/data_structures/shmem_request.h"
@@ -48,4 +48,4 @@ struct register_request : public labstor::Registrar::register_request {
 
 }
 
-#endif //LABSTOR_MQ_DRIVER_H
\ No newline at end of file
+#endif //LABSTOR_NO_OP_H
\ No newline at end of file
@@ -38,8 +38,24 @@ bool labstor::iosched::NoOp::Server::ProcessRequest(labstor::queue_pair *qp, lab
             return Initialize(qp, request, creds);
         }
         case labstor::GenericBlock::Ops::kWrite:
+        case labstor::GenericBlock::Ops::kRead:
+        case labstor::GenericBlock::Ops::kFlush: {
+            return labstor::RunContinuation(IO(qp, reinterpret_cast<labstor::GenericBlock::io_request*>(request), creds));
+        }
+    }
+    return true;
+}
+
+labstor::MQDriver::Ops labstor::iosched::NoOp::Server::GetDriverOp(labstor::GenericBlock::Ops op) {
+    switch(op) {
         case labstor::GenericBlock::Ops::kRead: {
-            return IO(qp, reinterpret_cast<labstor::GenericBlock::io_request*>(request), creds);
+            return labstor::MQDriver::Ops::kRead;
+        }
+        case labstor::GenericBlock::Ops::kWrite: {
+            return labstor::MQDriver::Ops::kWrite;
+        }
+        default: {
+            return labstor::MQDriver::Ops::kFlush;
         }
     }
 }
@@ -54,7 +70,7 @@ bool labstor::iosched::NoOp::Server::Initialize(labstor::queue_pair *qp, labstor
     labstor::ipc::qtok_t qtok;
     labstor::queue_pair *priv_qp;
     labstor::GenericQueue::stats_request *stats_rq;
-    ipc_manager_->GetNextQueuePair(priv_qp, LABSTOR_QP_PRIVATE | LABSTOR_QP_INTERMEDIATE | LABSTOR_QP_LOW_LATENCY);
+    ipc_manager_->GetNextQueuePair(priv_qp, LABSTOR_QP_SERVER_PRIVATE);
     stats_rq = ipc_manager_->AllocRequest<labstor::GenericQueue::stats_request>(priv_qp);
     stats_rq->ClientStart(next_module_);
     priv_qp->Enqueue<labstor::GenericQueue::stats_request>(stats_rq, qtok);
@@ -63,16 +79,26 @@ bool labstor::iosched::NoOp::Server::Initialize(labstor::queue_pair *qp, labstor
     queue_depth_ = stats_rq->queue_depth_;
     ipc_manager_->FreeRequest<labstor::GenericQueue::stats_request>(priv_qp, stats_rq);
     TRACEPOINT("num_hw_queues",num_hw_queues_,queue_depth_)
+    return true;
 }
 
-bool labstor::iosched::NoOp::Server::IO(labstor::queue_pair *qp, labstor::GenericBlock::io_request *client_rq, labstor::credentials *creds) {
+labstor::Continuation labstor::iosched::NoOp::Server::IO(labstor::queue_pair *qp, labstor::GenericBlock::io_request *client_rq, labstor::credentials *creds) {
+    AUTO_TRACE(client_rq->op_, client_rq->req_id_)
     labstor::queue_pair *priv_qp;
-    labstor::GenericQueue::io_request *rq;
+    labstor::MQDriver::io_request *rq;
     int hctx = labstor::ThreadLocal::GetTid() % num_hw_queues_;
 
-    ipc_manager_->GetNextQueuePair(priv_qp, LABSTOR_QP_PRIVATE | LABSTOR_QP_LOW_LATENCY);
-    rq = ipc_manager_->AllocRequest<labstor::GenericQueue::io_request>(priv_qp);
-    rq->Start(next_module_, client_rq->op_, client_rq->off_, client_rq->size_, client_rq->buf_, hctx);
+    //Forward the block request to the driver, which numbers its ops differently
+    ipc_manager_->GetNextQueuePair(priv_qp, LABSTOR_QP_SERVER_PRIVATE);
+    rq = ipc_manager_->AllocRequest<labstor::MQDriver::io_request>(priv_qp);
+    rq->IOClientStart(next_module_, creds->pid_, GetDriverOp(static_cast<labstor::GenericBlock::Ops>(client_rq->op_)),
+                      client_rq->buf_, client_rq->size_, client_rq->off_ / LABSTOR_NO_OP_SECTOR_SIZE, hctx);
+    rq = co_await priv_qp->Submit(rq);
+
+    //Complete the client request with the driver's result
+    client_rq->SetCode(rq->GetCode());
+    qp->Complete<labstor::GenericBlock::io_request>(client_rq);
+    ipc_manager_->FreeRequest<labstor::MQDriver::io_request>(priv_qp, rq);
 }
 
 LABSTOR_MODULE_CONSTRUCT(labstor::iosched::NoOp::Server, NO_OP_IOSCHED_MODULE_ID);
\ No newline at end of file
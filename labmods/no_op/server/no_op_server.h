@@ -34,6 +34,11 @@
 #include "labstor/userspace/server/macros.h"
 #include "labstor/userspace/server/ipc_manager.h"
 #include "labstor/userspace/server/namespace.h"
+#include "labstor/types/continuation.h"
+#include <labmods/mq_driver/mq_driver.h>
+
+//The driver addresses the device in 512-byte sectors
+#define LABSTOR_NO_OP_SECTOR_SIZE 512
 
 
 namespace labstor::iosched::NoOp {
@@ -50,7 +55,9 @@ public:
     }
     bool ProcessRequest(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds);
     bool Initialize(labstor::queue_pair *qp, labstor::ipc::request *request, labstor::credentials *creds) override;
-    bool IO(labstor::queue_pair *qp, labstor::GenericBlock::io_request *client_rq, labstor::credentials *creds);
+    labstor::Continuation IO(labstor::queue_pair *qp, labstor::GenericBlock::io_request *client_rq, labstor::credentials *creds);
+private:
+    static labstor::MQDriver::Ops GetDriverOp(labstor::GenericBlock::Ops op);
 };
 
 }
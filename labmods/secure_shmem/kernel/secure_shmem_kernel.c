@@ -97,7 +97,7 @@ struct shmem_pid_region *find_pid_region_nolock(int pid, int region_id) {
     return NULL;
 }
 
-void* reserve_shmem_nolock(size_t size, bool user_owned, int *new_region_id) {
+void* reserve_shmem_nolock(size_t size, bool user_owned, int numa_node, int *new_region_id) {
     struct shmem_region_info *region_info;
 
     if(size % PAGE_SIZE != 0) {
@@ -112,7 +112,7 @@ void* reserve_shmem_nolock(size_t size, bool user_owned, int *new_region_id) {
     }
     region_info->region_id = atomic_inc_return(&cur_region_id);
     region_info->size = size;
-    region_info->vmalloc_ptr = vmalloc(size);
+    region_info->vmalloc_ptr = vmalloc_node(size, numa_node < 0 ? NUMA_NO_NODE : numa_node);
     if(region_info->vmalloc_ptr == NULL) {
         pr_err("Could not allocate another secure shared memory region of size %lu", size);
         vfree(region_info);
@@ -239,10 +239,18 @@ struct shmem_pid_region *find_pid_region(int pid, int region_id) {
     return pid_region;
 }
 
-void* reserve_shmem(size_t size, bool user_owned, int *new_region_id) {
+/*A region, only if pid was granted it*/
+struct shmem_region_info *labstor_find_pid_shmem_region_info(int pid, int region_id) {
+    struct shmem_pid_region *pid_region = find_pid_region(pid, region_id);
+    if(pid_region) { return pid_region->region; }
+    return NULL;
+}
+EXPORT_SYMBOL(labstor_find_pid_shmem_region_info);
+
+void* reserve_shmem(size_t size, bool user_owned, int numa_node, int *new_region_id) {
     void *region;
     LABSTOR_MMAP_LOCK
-    region = reserve_shmem_nolock(size, user_owned, new_region_id);
+    region = reserve_shmem_nolock(size, user_owned, numa_node, new_region_id);
     LABSTOR_MMAP_UNLOCK
     return region;
 }
@@ -291,8 +299,8 @@ void shmem_process_request_fn_netlink(int pid, struct secure_shmem_request *rq)
     int code = 0;
     switch(rq->header.op_) {
         case RESERVE_SHMEM: {
-            pr_debug("Reserving shared memory of size %lu\n", rq->reserve.size);
-            if(reserve_shmem(rq->reserve.size, rq->reserve.user_owned, &code)) {}
+            pr_debug("Reserving shared memory of size %lu on node %d\n", rq->reserve.size, rq->reserve.numa_node);
+            if(reserve_shmem(rq->reserve.size, rq->reserve.user_owned, rq->reserve.numa_node, &code)) {}
             else { code = -1; }
             labstor_msg_trusted_server(&code, sizeof(code), pid);
             break;
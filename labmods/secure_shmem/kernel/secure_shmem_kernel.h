@@ -40,6 +40,7 @@ struct shmem_region_info {
 };
 
 struct shmem_region_info *labstor_find_shmem_region_info(int region_id);
+struct shmem_region_info *labstor_find_pid_shmem_region_info(int pid, int region_id);
 void *labstor_find_shmem_region(int region_id);
 
 #endif //LABSTOR_SECURE_SHMEM_KERNEL_H
\ No newline at end of file
@@ -38,13 +38,14 @@
 #include <labmods/secure_shmem/secure_shmem.h>
 #include "secure_shmem_client_netlink.h"
 
-int labstor::kernel::netlink::ShmemClient::CreateShmem(size_t region_size, bool user_owned) {
+int labstor::kernel::netlink::ShmemClient::CreateShmem(size_t region_size, bool user_owned, int numa_node) {
     struct secure_shmem_request rq;
     int region_id;
     rq.header.ns_id_ = SHMEM_MODULE_RUNTIME_ID;
     rq.header.op_ = RESERVE_SHMEM;
     rq.reserve.size = region_size;
     rq.reserve.user_owned = user_owned;
+    rq.reserve.numa_node = numa_node;
     kernel_client_->SendMSG(&rq, sizeof(rq));
     kernel_client_->RecvMSG(&region_id, sizeof(region_id));
     return region_id;
@@ -87,6 +88,23 @@ void* labstor::kernel::netlink::ShmemClient::MapShmem(int region_id, size_t regi
     return data;
 }
 
+/*
+ * Map a region over a fixed address, e.g., within a span reserved with labstor::Pages::Reserve.
+ * */
+void* labstor::kernel::netlink::ShmemClient::MapShmem(int region_id, size_t region_size, void *addr) {
+    int fd = open(SHMEM_CHRDEV, O_RDWR);
+    if(fd < 0) {
+        return nullptr;
+    }
+    lseek(fd, region_id, SEEK_SET);
+    void *data = mmap(addr, region_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        return nullptr;
+    }
+    return data;
+}
+
 void labstor::kernel::netlink::ShmemClient::UnmapShmem(void *region, size_t region_size) {
     munmap(region, region_size);
 }
\ No newline at end of file
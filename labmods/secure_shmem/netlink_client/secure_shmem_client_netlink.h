@@ -43,10 +43,11 @@ public:
         kernel_client_ = LABSTOR_KERNEL_CLIENT;
         page_size_ = getpagesize();
     }
-    int CreateShmem(size_t region_size, bool user_owned);
+    int CreateShmem(size_t region_size, bool user_owned, int numa_node = -1);
     int GrantPidShmem(int pid, int region_id);
     int FreeShmem(int region_id);
     static void *MapShmem(int region_id, size_t region_size);
+    static void *MapShmem(int region_id, size_t region_size, void *addr);
     static void UnmapShmem(void *region, size_t region_size);
 };
 
@@ -41,6 +41,7 @@ enum {
 struct shmem_reserve_request {
     size_t size;
     bool user_owned;
+    int numa_node; /*-1 for any node*/
 };
 
 struct shmem_grant_pid_shmem_request {
@@ -51,10 +51,11 @@ void labstor::SPDK::Client::Register(YAML::Node config) {
                 i,
                 context_.GetNumQueuePairs(),
                 ipc_manager_->GetPID());
-        int queue_size = labstor::ipc::request_queue::GetSize(context_.GetMaxQueueDepth());
-        void *sq_region = ipc_manager_->AllocPrivateQueue(queue_size);
-        void *cq_region = ipc_manager_->AllocPrivateQueue(queue_size);
-        priv_qp->Init(qid, ipc_manager_->GetRegion(LABSTOR_QP_PRIVATE), sq_region, queue_size, cq_region, queue_size);
+        int sq_size = labstor::ipc::request_queue::GetSize(context_.GetMaxQueueDepth());
+        int cq_size = labstor::ipc::completion_ring::GetSize(context_.GetMaxQueueDepth());
+        void *sq_region = ipc_manager_->AllocPrivateQueue(sq_size);
+        void *cq_region = ipc_manager_->AllocPrivateQueue(cq_size);
+        priv_qp->Init(qid, ipc_manager_->GetRegion(LABSTOR_QP_PRIVATE), sq_region, sq_size, cq_region, cq_size);
         ipc_manager_->RegisterQueuePair(priv_qp);
         TRACEPOINT("Registered Private Queue")
 
@@ -58,7 +58,7 @@ namespace labstor::SPDK {
 struct queue_pair;
 
 enum class Ops {
-    kWrite, kRead
+    kWrite, kRead, kFlush
 };
 
 struct Device {
@@ -178,6 +178,13 @@ struct queue_pair : labstor::async_queue_pair {
                         _IOComplete, spdk_rq, 0);
                 break;
             }
+            case labstor::SPDK::Ops::kFlush: {
+                ret = spdk_nvme_ns_cmd_flush(
+                        dev_->nvme_ns_,
+                        qp_,
+                        _IOComplete, spdk_rq);
+                break;
+            }
         }
         return ret==0;
     }
@@ -33,9 +33,11 @@
 #include <labstor/types/basics.h>
 #include <labstor/userspace/types/socket.h>
 #include <labstor/types/allocator/shmem_allocator.h>
+#include <labstor/types/allocator/slab_allocator.h>
 #include <labstor/types/allocator/segment_allocator.h>
 #include <labstor/userspace/client/ipc_manager.h>
 #include <labstor/userspace/client/namespace.h>
+#include <labstor/userspace/util/pages.h>
 #include <labmods/secure_shmem/netlink_client/secure_shmem_client_netlink.h>
 #include <sys/sysinfo.h>
 
@@ -87,17 +89,43 @@ void labstor::Client::IPCManager::Connect() {
     labstor::ipc::setup_reply reply;
     serversock_.RecvMSG(&reply, sizeof(reply));
     TRACEPOINT("Receive reply", "region_id", reply.region_id_, "region_size", reply.region_size_, "queue_size", reply.queue_region_size_, "queue_depth", reply.queue_depth_)
-    region = labstor::kernel::netlink::ShmemClient::MapShmem(reply.region_id_, reply.region_size_);
+    region_size_ = reply.region_size_;
+    max_segments_ = reply.max_segments_ ? reply.max_segments_ : 1;
+    wait_policy_ = reply.wait_policy_;
+    wait_spin_us_ = reply.wait_spin_us_;
+    region = labstor::kernel::netlink::ShmemClient::MapShmem(reply.region_id_, reply.region_size_,
+            labstor::Pages::Reserve((size_t)reply.region_size_*max_segments_));
+    if(!region) {
+        throw MMAP_FAILED.format(strerror(errno));
+    }
+    region_ = region;
 
     //Receive and initialize namespace
     LABSTOR_NAMESPACE->Attach(reply.namespace_region_id_, reply.namespace_region_size_);
 
+    //Attach the active queue sets of the server workers
+    active_table_ = (labstor::ipc::active_queues_table*)labstor::kernel::netlink::ShmemClient::MapShmem(reply.active_region_id_, reply.active_region_size_);
+
+    //Initialize the data buffer pool
+    if(reply.data_region_size_) {
+        TRACEPOINT("Initialize data buffer pool", reply.data_region_id_, reply.data_region_size_)
+        void *data_region = labstor::kernel::netlink::ShmemClient::MapShmem(reply.data_region_id_, reply.data_region_size_);
+        if(!data_region) {
+            throw MMAP_FAILED.format(strerror(errno));
+        }
+        labstor::ipc::slab_allocator *data_alloc = new labstor::ipc::slab_allocator();
+        data_alloc->InitSlabs(data_region, data_region, reply.data_region_size_,
+                LABSTOR_DATA_POOL_UNIT, LABSTOR_DATA_POOL_SLAB_SIZE, n_cpu_);
+        SetDataAlloc(data_alloc, reply.data_region_id_);
+    }
+
     //Initialize SHMEM request allocator
     TRACEPOINT("Attach SHMEM allocator")
-    labstor::ipc::shmem_allocator *shmem_alloc;
-    shmem_alloc = new labstor::ipc::shmem_allocator();
-    shmem_alloc->Init(region, region, reply.request_region_size_, reply.request_unit_, n_cpu_);
+    labstor::ipc::slab_allocator *shmem_alloc;
+    shmem_alloc = new labstor::ipc::slab_allocator();
+    shmem_alloc->Init(region, region, reply.request_region_size_, LABSTOR_SLAB_MIN_UNIT, n_cpu_, reply.region_size_);
     SetShmemAlloc(shmem_alloc);
+    request_alloc_ = shmem_alloc;
     TRACEPOINT("SHMEM allocator", (size_t)shmem_alloc->GetRegion())
 
     //Initialize SHMEM queue allocator
@@ -116,35 +144,48 @@ void labstor::Client::IPCManager::Connect() {
 
     //Create the SHMEM queues
     TRACEPOINT("Create SHMEM queues")
-    CreateQueuesSHMEM(reply.num_queues_, reply.queue_depth_);
+    CreateQueuesSHMEM(reply.num_queues_, reply.num_high_latency_queues_, reply.queue_depth_);
     CreatePrivateQueues(n_cpu_, reply.queue_depth_);
 
     //Mark as connected
     is_connected_ = true;
 }
 
-void labstor::Client::IPCManager::CreateQueuesSHMEM(int num_queues, int depth) {
+void labstor::Client::IPCManager::CreateQueuesSHMEM(int num_queues, int num_high_latency_queues, int depth) {
     AUTO_TRACE("")
-    labstor::ipc::register_qp_request request(num_queues);
+    labstor::ipc::register_qp_request request(num_queues + num_high_latency_queues);
     labstor::ipc::register_qp_reply reply;
     labstor::ipc::queue_pair_ptr *qps = (labstor::ipc::queue_pair_ptr *)malloc(request.GetQueueArrayLength());
     uint32_t request_queue_size = labstor::ipc::request_queue::GetSize(depth);
-    uint32_t request_map_size = labstor::ipc::request_map::GetSize(depth);
+    uint32_t completion_ring_size = labstor::ipc::completion_ring::GetSize(depth);
 
-    //Allocate SHMEM queues for the client
+    //Allocate SHMEM queues for the client. Bulk queues are tagged high-latency.
     ReserveQueues(0, LABSTOR_QP_SHMEM, num_queues);
-    for(int i = 0; i < num_queues; ++i) {
+    ReserveQueues(0, LABSTOR_QP_SHMEM | LABSTOR_QP_HIGH_LATENCY, num_high_latency_queues);
+    for(int i = 0; i < num_queues + num_high_latency_queues; ++i) {
         labstor::ipc::shmem_queue_pair *qp = new labstor::ipc::shmem_queue_pair();
-        labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(
-                0,
-                LABSTOR_QP_SHMEM | LABSTOR_QP_STREAM | LABSTOR_QP_PRIMARY | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY,
-                i,
-                num_queues,
-                pid_);
+        labstor::ipc::qid_t qid;
+        if(i < num_queues) {
+            qid = labstor::queue_pair::GetQID(
+                    0,
+                    LABSTOR_QP_SHMEM | LABSTOR_QP_STREAM | LABSTOR_QP_PRIMARY | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY,
+                    i,
+                    num_queues,
+                    pid_);
+        } else {
+            qid = labstor::queue_pair::GetQID(
+                    0,
+                    LABSTOR_QP_SHMEM | LABSTOR_QP_STREAM | LABSTOR_QP_PRIMARY | LABSTOR_QP_ORDERED | LABSTOR_QP_HIGH_LATENCY,
+                    i - num_queues,
+                    num_high_latency_queues,
+                    pid_);
+        }
         void *sq_region = AllocShmemQueue(request_queue_size);
-        void *cq_region = AllocShmemQueue(request_map_size);
+        void *cq_region = AllocShmemQueue(completion_ring_size);
         TRACEPOINT("Creating queue", i, qid.Hash());
-        qp->Init(qid, GetRegion(LABSTOR_QP_SHMEM), sq_region, request_queue_size, cq_region, request_map_size);
+        qp->Init(qid, GetRegion(LABSTOR_QP_SHMEM), sq_region, request_queue_size, cq_region, completion_ring_size);
+        qp->SetWaitPolicy(i < num_queues ? wait_policy_ : LABSTOR_WAIT_ADAPTIVE, wait_spin_us_);
+        qp->sq_.SetActiveTable(active_table_);
         RegisterQueuePair(qp);
         qp->GetPointer(qps[i], GetRegion(LABSTOR_QP_SHMEM));
         TRACEPOINT("Created queue", i, qid.Hash());
@@ -159,8 +200,10 @@ void labstor::Client::IPCManager::CreateQueuesSHMEM(int num_queues, int depth) {
     free(qps);
 }
 
-void labstor::Client::IPCManager::CreatePrivateQueues(int num_queues, int queue_size) {
+void labstor::Client::IPCManager::CreatePrivateQueues(int num_queues, int depth) {
     AUTO_TRACE("")
+    uint32_t request_queue_size = labstor::ipc::request_queue::GetSize(depth);
+    uint32_t completion_ring_size = labstor::ipc::completion_ring::GetSize(depth);
     for(int i = 0; i < num_queues; ++i) {
         labstor::ipc::shmem_queue_pair *qp = new labstor::ipc::shmem_queue_pair();
         labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(
@@ -169,13 +212,49 @@ void labstor::Client::IPCManager::CreatePrivateQueues(int num_queues, int queue_
                 i,
                 num_queues,
                 pid_);
-        void *sq_region = AllocPrivateQueue(queue_size);
-        void *cq_region = AllocPrivateQueue(queue_size);
-        qp->Init(qid, GetRegion(LABSTOR_QP_PRIVATE), sq_region, queue_size, cq_region, queue_size);
+        void *sq_region = AllocPrivateQueue(request_queue_size);
+        void *cq_region = AllocPrivateQueue(completion_ring_size);
+        qp->Init(qid, GetRegion(LABSTOR_QP_PRIVATE), sq_region, request_queue_size, cq_region, completion_ring_size);
+        qp->SetWaitPolicy(wait_policy_, wait_spin_us_);
         RegisterQueuePair(qp);
     }
 }
 
+/*
+ * Ask the server for another segment of the SHMEM region and give its slabs to
+ * the request allocator. Threads which fail to allocate concurrently share one grow.
+ * */
+bool labstor::Client::IPCManager::GrowShmem(uint32_t size) {
+    AUTO_TRACE(size)
+    if(!is_connected_ || size > request_alloc_->GetMaxSize()) {
+        return false;
+    }
+    uint32_t num_segments = request_alloc_->GetNumSegments();
+    std::lock_guard<std::mutex> lock(grow_lock_);
+    if(request_alloc_->GetNumSegments() != num_segments) {
+        return true;
+    }
+    if(num_segments >= max_segments_) {
+        return false;
+    }
+
+    labstor::ipc::grow_region_request request(labstor::ipc::LABSTOR_ADMIN_GROW_REGION);
+    labstor::ipc::grow_region_reply reply;
+    serversock_.SendMSG((void*)&request, sizeof(request));
+    serversock_.RecvMSG((void*)&reply, sizeof(reply));
+    if(reply.code_ != 0) {
+        TRACEPOINT("Server refused to grow the region", reply.code_)
+        return false;
+    }
+    void *segment = LABSTOR_REGION_ADD((size_t)reply.segment_*region_size_, region_);
+    if(!labstor::kernel::netlink::ShmemClient::MapShmem(reply.region_id_, reply.size_, segment)) {
+        throw MMAP_FAILED.format(strerror(errno));
+    }
+    request_alloc_->AddSegment(segment, reply.size_);
+    TRACEPOINT("Grew region", reply.segment_, reply.size_)
+    return true;
+}
+
 void labstor::Client::IPCManager::PauseQueues() {
 }
 
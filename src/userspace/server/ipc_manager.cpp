@@ -25,6 +25,10 @@
  */
 
 #include <memory>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
 
 #include <labstor/userspace/server/server.h>
 #include <labstor/userspace/util/errors.h>
@@ -36,19 +40,115 @@
 #include <labstor/userspace/server/work_orchestrator.h>
 #include <labstor/kernel/client/kernel_client.h>
 #include <labstor/userspace/types/messages.h>
+#include <labstor/types/allocator/shmem_allocator.h>
+#include <labstor/types/allocator/slab_allocator.h>
 #include <labmods/ipc_manager/netlink_client/ipc_manager_client_netlink.h>
 #include <labmods/work_orchestrator/netlink_client/work_orchestrator_client_netlink.h>
 
 LABSTOR_WORK_ORCHESTRATOR_T work_orchestrator_ = LABSTOR_WORK_ORCHESTRATOR;
 
+/*Number of wakeups timed to pick how long waiters spin*/
+#define LABSTOR_WAIT_CALIBRATION_SAMPLES 16
+
+/*
+ * Median time from ringing a doorbell until its sleeper runs again. A waiter which
+ * spins about as long as a wakeup costs waits at most twice as long as it had to.
+ * */
+static uint32_t MeasureDoorbellWakeUs() {
+    labstor::ipc::doorbell db;
+    std::atomic<int> num_asleep(0), num_awake(0);
+    std::atomic<int64_t> rang_ns(0);
+    std::vector<int64_t> samples(LABSTOR_WAIT_CALIBRATION_SAMPLES);
+    auto now_ns = []() {
+        return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    };
+    db.Init(LABSTOR_WAIT_ADAPTIVE);
+    std::thread sleeper([&]() {
+        for(int i = 0; i < LABSTOR_WAIT_CALIBRATION_SAMPLES; ++i) {
+            uint32_t seq = labstor_doorbell_PrepareSleep(&db);
+            num_asleep.store(i + 1);
+            labstor_doorbell_SleepUs(&db, seq, 100000);
+            samples[i] = now_ns() - rang_ns.load();
+            num_awake.store(i + 1);
+        }
+    });
+    for(int i = 0; i < LABSTOR_WAIT_CALIBRATION_SAMPLES; ++i) {
+        while(num_asleep.load() <= i) { std::this_thread::yield(); }
+        //Give the sleeper time to enter the kernel
+        usleep(200);
+        rang_ns.store(now_ns());
+        db.Ring();
+        while(num_awake.load() <= i) { std::this_thread::yield(); }
+    }
+    sleeper.join();
+    std::sort(samples.begin(), samples.end());
+    int64_t wake_us = (samples[LABSTOR_WAIT_CALIBRATION_SAMPLES / 2] + 999) / 1000;
+    return (uint32_t)std::clamp<int64_t>(wake_us, 1, LABSTOR_WAIT_DEFAULT_YIELD_US);
+}
+
+static uint32_t ParseWaitPolicy(const std::string &str) {
+    if(str == "poll") { return LABSTOR_WAIT_POLL; }
+    if(str == "adaptive") { return LABSTOR_WAIT_ADAPTIVE; }
+    throw labstor::INVALID_WAIT_POLICY.format(str);
+}
+
 void labstor::Server::IPCManager::LoadMemoryConfig(std::string pid_type, MemoryConfig &memconf) {
     memconf.region_size = labstor_config_->config_["ipc_manager"][pid_type]["max_region_size_kb"].as<uint32_t>() * SizeType::KB;
     memconf.request_unit = labstor_config_->config_["ipc_manager"][pid_type]["request_unit_bytes"].as<uint32_t>() * SizeType::BYTES;
     memconf.min_request_region = labstor_config_->config_["ipc_manager"][pid_type]["min_request_region_kb"].as<uint32_t>() * SizeType::KB;
     memconf.queue_depth = labstor_config_->config_["ipc_manager"][pid_type]["queue_depth"].as<uint32_t>();
     memconf.num_queues = labstor_config_->config_["ipc_manager"][pid_type]["num_queues"].as<uint32_t>();
-    memconf.queue_region_size = memconf.num_queues * labstor::ipc::shmem_queue_pair::GetSize(memconf.queue_depth);
-    memconf.request_region_size = memconf.region_size - memconf.queue_region_size;
+    //Bulk tenants submit on high-latency queues, which workers serve after the low-latency ones
+    memconf.num_high_latency_queues = 0;
+    if(labstor_config_->config_["ipc_manager"][pid_type]["num_high_latency_queues"]) {
+        memconf.num_high_latency_queues = labstor_config_->config_["ipc_manager"][pid_type]["num_high_latency_queues"].as<uint32_t>();
+    }
+    memconf.page_size = labstor::PageSize::k4K;
+    if(labstor_config_->config_["ipc_manager"][pid_type]["page_size"]) {
+        memconf.page_size = labstor::Pages::Parse(labstor_config_->config_["ipc_manager"][pid_type]["page_size"].as<std::string>());
+    }
+    memconf.numa_placement = false;
+    if(labstor_config_->config_["ipc_manager"][pid_type]["numa_placement"]) {
+        memconf.numa_placement = labstor_config_->config_["ipc_manager"][pid_type]["numa_placement"].as<bool>();
+    }
+    memconf.max_segments = 1;
+    if(labstor_config_->config_["ipc_manager"][pid_type]["max_segments"]) {
+        memconf.max_segments = labstor_config_->config_["ipc_manager"][pid_type]["max_segments"].as<uint32_t>();
+    }
+    if(memconf.max_segments == 0 || memconf.max_segments > LABSTOR_SLAB_MAX_SEGMENTS) {
+        memconf.max_segments = memconf.max_segments ? LABSTOR_SLAB_MAX_SEGMENTS : 1;
+    }
+    //Low-latency queues may busy-poll for completions instead of sleeping; high-latency queues always adapt
+    memconf.wait_policy = LABSTOR_WAIT_ADAPTIVE;
+    if(labstor_config_->config_["ipc_manager"][pid_type]["wait_policy"]) {
+        memconf.wait_policy = ParseWaitPolicy(labstor_config_->config_["ipc_manager"][pid_type]["wait_policy"].as<std::string>());
+    }
+    //Waiters spin for about one futex wakeup before they yield, unless configured
+    if(labstor_config_->config_["ipc_manager"][pid_type]["wait_spin_us"]) {
+        memconf.wait_spin_us = labstor_config_->config_["ipc_manager"][pid_type]["wait_spin_us"].as<uint32_t>();
+    } else {
+        std::call_once(wake_once_, [this]() { wake_us_ = MeasureDoorbellWakeUs(); });
+        memconf.wait_spin_us = wake_us_;
+    }
+    memconf.data_pool_size = 0;
+    if(labstor_config_->config_["ipc_manager"][pid_type]["data_pool_mb"]) {
+        //Buffers are referenced by 32-bit offsets within the pool
+        memconf.data_pool_size = std::min(labstor_config_->config_["ipc_manager"][pid_type]["data_pool_mb"].as<uint32_t>(), 1024u) * SizeType::MB;
+    }
+    memconf.request_queue_size = labstor::ipc::request_queue::GetSize(memconf.queue_depth);
+    memconf.completion_ring_size = labstor::ipc::completion_ring::GetSize(memconf.queue_depth);
+    if(memconf.numa_placement) {
+        //Queues which may be moved to another node must not share pages
+        memconf.request_queue_size = labstor::Pages::RoundUp(memconf.request_queue_size, labstor::PageSize::k4K);
+        memconf.completion_ring_size = labstor::Pages::RoundUp(memconf.completion_ring_size, labstor::PageSize::k4K);
+        memconf.queue_region_size = (memconf.num_queues + memconf.num_high_latency_queues) *
+                (sizeof(labstor_queue_pair) + memconf.request_queue_size + memconf.completion_ring_size);
+        memconf.request_region_size = (memconf.region_size - memconf.queue_region_size) / getpagesize() * getpagesize();
+    } else {
+        memconf.queue_region_size = (memconf.num_queues + memconf.num_high_latency_queues) * labstor::ipc::shmem_queue_pair::GetSize(memconf.queue_depth);
+        memconf.request_region_size = memconf.region_size - memconf.queue_region_size;
+    }
     if(memconf.queue_region_size >= memconf.region_size) {
         throw NOT_ENOUGH_REQUEST_MEMORY.format(pid_type,
                                                SizeType(memconf.queue_region_size, SizeType::KB).ToString(),
@@ -59,8 +159,6 @@ void labstor::Server::IPCManager::LoadMemoryConfig(std::string pid_type, MemoryC
                SizeType(memconf.request_region_size, SizeType::KB).ToString(),
                SizeType(memconf.min_request_region, SizeType::KB).ToString());
     }
-    memconf.request_queue_size = labstor::ipc::request_queue::GetSize(memconf.queue_depth);
-    memconf.request_map_size = labstor::ipc::request_map::GetSize(memconf.queue_depth);
 }
 
 void labstor::Server::IPCManager::InitializeKernelIPCManager() {
@@ -128,8 +226,8 @@ void labstor::Server::IPCManager::CreateKernelQueues() {
                 memconf.num_queues,
                 KERNEL_PID);
         void *sq_region = client_ipc->AllocShmemQueue(memconf.request_queue_size);
-        void *cq_region = client_ipc->AllocShmemQueue(memconf.request_map_size);
-        remote_qp->Init(qid, client_ipc->GetRegion(), sq_region, memconf.request_queue_size, cq_region, memconf.request_map_size);
+        void *cq_region = client_ipc->AllocShmemQueue(memconf.completion_ring_size);
+        remote_qp->Init(qid, client_ipc->GetRegion(), sq_region, memconf.request_queue_size, cq_region, memconf.completion_ring_size);
         TRACEPOINT("qid", remote_qp->GetQID().Hash(), "depth", remote_qp->GetDepth(),
                    "offset2", LABSTOR_REGION_SUB(remote_qp->cq_.GetRegion(), client_ipc->GetRegion()));
         remote_qp->GetPointer(ptr, client_ipc->GetRegion());
@@ -159,11 +257,14 @@ void labstor::Server::IPCManager::CreatePrivateQueues() {
     PerProcessIPC *client_ipc = RegisterIPC(pid_);
 
     //Allocator internal memory
-    private_mem_ = malloc(memconf.region_size);
+    private_page_size_ = memconf.page_size;
+    private_numa_ = memconf.numa_placement;
+    private_mem_ = labstor::Pages::Map(memconf.region_size, private_page_size_);
+    TRACEPOINT("Private region", memconf.region_size, labstor::Pages::ToString(private_page_size_))
 
     //Initialize request allocator
-    labstor::ipc::shmem_allocator *private_alloc;
-    private_alloc = new labstor::ipc::shmem_allocator();
+    labstor::ipc::slab_allocator *private_alloc;
+    private_alloc = new labstor::ipc::slab_allocator();
     private_alloc->Init(private_mem_, private_mem_, memconf.request_region_size, memconf.request_unit);
     client_ipc->SetShmemAlloc(private_alloc);
     client_ipc->SetPrivateAlloc(private_alloc);
@@ -177,7 +278,8 @@ void labstor::Server::IPCManager::CreatePrivateQueues() {
     client_ipc->SetQueueAlloc(qp_alloc);
 
     //Allocate & register PRIVATE intermediate streaming queues for modules to communicate internally
-    labstor_qid_flags_t flags = LABSTOR_QP_PRIVATE | LABSTOR_QP_STREAM | LABSTOR_QP_INTERMEDIATE | LABSTOR_QP_ORDERED | LABSTOR_QP_LOW_LATENCY;
+    //Modules wait on each request they submit individually, so these queues don't need ordering
+    labstor_qid_flags_t flags = LABSTOR_QP_SERVER_PRIVATE;
     client_ipc->ReserveQueues(0, flags, memconf.num_queues);
     for(int i = 0; i < memconf.num_queues; ++i) {
         //Initialize QP
@@ -189,8 +291,10 @@ void labstor::Server::IPCManager::CreatePrivateQueues() {
                 memconf.num_queues,
                 pid_);
         void *sq_region = client_ipc->AllocShmemQueue(memconf.request_queue_size);
-        void *cq_region = client_ipc->AllocShmemQueue(memconf.request_map_size);
-        qp->Init(qid, private_alloc_->GetRegion(), sq_region, memconf.request_queue_size, cq_region, memconf.request_map_size);
+        void *cq_region = client_ipc->AllocShmemQueue(memconf.completion_ring_size);
+        qp->Init(qid, private_alloc_->GetRegion(), sq_region, memconf.request_queue_size, cq_region, memconf.completion_ring_size);
+        qp->SetWaitPolicy(memconf.wait_policy, memconf.wait_spin_us);
+        qp->sq_.SetActiveTable(work_orchestrator_->GetActiveQueuesTable());
         TRACEPOINT("pid", qid.pid_, "pid", qid.type_, "flags", qid.flags_, "cnt", qid.cnt_)
         TRACEPOINT("pid", qp->GetQID().pid_, "pid", qp->GetQID().type_, "flags", qp->GetQID().flags_, "cnt", qp->GetQID().cnt_)
 
@@ -216,17 +320,36 @@ void labstor::Server::IPCManager::RegisterClient(int client_fd, labstor::credent
 
     //Create shared memory
     LABSTOR_KERNEL_SHMEM_ALLOC_T shmem = LABSTOR_KERNEL_SHMEM_ALLOC; 
-    client_ipc->region_id_ = shmem->CreateShmem(memconf.region_size, true);
+    int numa_node = memconf.numa_placement ? labstor::Pages::GetProcessNode(creds.pid_) : -1;
+    client_ipc->region_id_ = shmem->CreateShmem(memconf.region_size, true, numa_node);
     if(client_ipc->region_id_ < 0) {
         throw SHMEM_CREATE_FAILED.format();
     }
     shmem->GrantPidShmem(getpid(), client_ipc->region_id_);
     shmem->GrantPidShmem(creds.pid_, client_ipc->region_id_);
-    region = shmem->MapShmem(client_ipc->region_id_, memconf.region_size);
+    //Segments added later are mapped after the region, so offsets stay relative to its start
+    client_ipc->reserved_size_ = (size_t)memconf.region_size*memconf.max_segments;
+    region = shmem->MapShmem(client_ipc->region_id_, memconf.region_size,
+            labstor::Pages::Reserve(client_ipc->reserved_size_));
     if(!region) {
         throw MMAP_FAILED.format(strerror(errno));
     }
 
+    //Create the data buffer pool, which the client formats
+    if(memconf.data_pool_size) {
+        client_ipc->data_region_id_ = shmem->CreateShmem(memconf.data_pool_size, true, numa_node);
+        if(client_ipc->data_region_id_ < 0) {
+            throw SHMEM_CREATE_FAILED.format();
+        }
+        shmem->GrantPidShmem(getpid(), client_ipc->data_region_id_);
+        shmem->GrantPidShmem(creds.pid_, client_ipc->data_region_id_);
+        client_ipc->data_region_ = shmem->MapShmem(client_ipc->data_region_id_, memconf.data_pool_size);
+        if(!client_ipc->data_region_) {
+            throw MMAP_FAILED.format(strerror(errno));
+        }
+        client_ipc->data_region_size_ = memconf.data_pool_size;
+    }
+
     //Send shared memory to client
     labstor::ipc::setup_reply reply;
     reply.region_id_ = client_ipc->region_id_;
@@ -236,10 +359,18 @@ void labstor::Server::IPCManager::RegisterClient(int client_fd, labstor::credent
     reply.queue_region_size_ = memconf.queue_region_size;
     reply.queue_depth_ = memconf.queue_depth;
     reply.num_queues_ = memconf.num_queues;
+    reply.num_high_latency_queues_ = memconf.num_high_latency_queues;
+    reply.max_segments_ = memconf.max_segments;
+    reply.wait_policy_ = memconf.wait_policy;
+    reply.wait_spin_us_ = memconf.wait_spin_us;
+    reply.data_region_id_ = client_ipc->data_region_id_;
+    reply.data_region_size_ = client_ipc->data_region_id_ < 0 ? 0 : memconf.data_pool_size;
     LABSTOR_NAMESPACE->GetSharedRegion(reply.namespace_region_id_, reply.namespace_region_size_, reply.namespace_max_entries_);
+    work_orchestrator_->GetActiveQueuesRegion(reply.active_region_id_, reply.active_region_size_);
     TRACEPOINT("Registering", reply.region_id_, reply.region_size_, reply.request_unit_)
     client_ipc->GetSocket().SendMSG(&reply, sizeof(reply));
     labstor::kernel::netlink::ShmemClient().GrantPidShmem(creds.pid_, reply.namespace_region_id_);
+    labstor::kernel::netlink::ShmemClient().GrantPidShmem(creds.pid_, reply.active_region_id_);
 
     //Receive and register client QPs
     RegisterClientQP(client_ipc, region);
@@ -256,7 +387,7 @@ void labstor::Server::IPCManager::RegisterClientQP(PerProcessIPC *client_ipc, vo
     TRACEPOINT("count", request.count_);
 
     //Attach request allocator
-    labstor::ipc::shmem_allocator *alloc = new labstor::ipc::shmem_allocator();
+    labstor::ipc::slab_allocator *alloc = new labstor::ipc::slab_allocator();
     alloc->Attach(region, region);
     client_ipc->SetShmemAlloc(alloc);
 
@@ -274,12 +405,105 @@ void labstor::Server::IPCManager::RegisterClientQP(PerProcessIPC *client_ipc, vo
             throw IPC_MANAGER_CANT_REGISTER_QP.format();
         }
         work_orchestrator_->AssignQueuePair(qp, i);
+        client_ipc->worker_qps_.emplace_back(qp);
     }
     free(ptrs);
 
-    //Reply success
+    //Reply success. The wreaper may read the socket from now on.
     labstor::ipc::register_qp_reply reply(0);
     client_ipc->GetSocket().SendMSG((void*)&reply, sizeof(labstor::ipc::register_qp_reply));
+    client_ipc->SetReady();
+}
+
+/*
+ * Forget a process which disconnected. Workers reference its queue pairs and
+ * credentials, so the queue pairs are taken off of them first. Once nothing
+ * can look the process up, its region, the segments it grew by and its data
+ * pool are unmapped and freed.
+ * */
+void labstor::Server::IPCManager::UnregisterIPC(PerProcessIPC *ipc) {
+    AUTO_TRACE(ipc->GetPID())
+    LABSTOR_KERNEL_SHMEM_ALLOC_T shmem = LABSTOR_KERNEL_SHMEM_ALLOC;
+    work_orchestrator_->RemoveQueuePairs(ipc->worker_qps_);
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        pid_to_ipc_.erase(ipc->GetPID());
+    }
+    if(ipc->reserved_size_) {
+        //The segments are mapped within the reserved range
+        labstor::kernel::netlink::ShmemClient::UnmapShmem(ipc->GetRegion(), ipc->reserved_size_);
+        shmem->FreeShmem(ipc->region_id_);
+    }
+    for(int segment_id : ipc->segment_ids_) {
+        shmem->FreeShmem(segment_id);
+    }
+    if(ipc->data_region_) {
+        labstor::kernel::netlink::ShmemClient::UnmapShmem(ipc->data_region_, ipc->data_region_size_);
+        shmem->FreeShmem(ipc->data_region_id_);
+    }
+    delete ipc;
+}
+
+/*
+ * Create another segment of a client's region and map it at the same offset the
+ * client will. The client formats the segment into its request allocator, which
+ * the server attached to, so the server must map it before replying.
+ * */
+void labstor::Server::IPCManager::GrowClientRegion(PerProcessIPC *client_ipc) {
+    AUTO_TRACE(client_ipc->GetPID())
+    MemoryConfig memconf;
+    LoadMemoryConfig("client", memconf);
+    labstor::ipc::grow_region_reply reply(0);
+    uint32_t segment = client_ipc->segment_ids_.size() + 1;
+
+    if(segment >= memconf.max_segments) {
+        reply.code_ = REGION_GROW_FAILED.get_code();
+        client_ipc->GetSocket().SendMSG((void*)&reply, sizeof(reply));
+        return;
+    }
+
+    LABSTOR_KERNEL_SHMEM_ALLOC_T shmem = LABSTOR_KERNEL_SHMEM_ALLOC;
+    int numa_node = memconf.numa_placement ? labstor::Pages::GetProcessNode(client_ipc->GetPID()) : -1;
+    int region_id = shmem->CreateShmem(memconf.region_size, true, numa_node);
+    if(region_id < 0) {
+        reply.code_ = SHMEM_CREATE_FAILED.get_code();
+        client_ipc->GetSocket().SendMSG((void*)&reply, sizeof(reply));
+        return;
+    }
+    shmem->GrantPidShmem(getpid(), region_id);
+    shmem->GrantPidShmem(client_ipc->GetPID(), region_id);
+    void *addr = LABSTOR_REGION_ADD((size_t)segment*memconf.region_size, client_ipc->GetRegion());
+    if(!shmem->MapShmem(region_id, memconf.region_size, addr)) {
+        shmem->FreeShmem(region_id);
+        reply.code_ = MMAP_FAILED.get_code();
+        client_ipc->GetSocket().SendMSG((void*)&reply, sizeof(reply));
+        return;
+    }
+    client_ipc->segment_ids_.emplace_back(region_id);
+
+    reply.region_id_ = region_id;
+    reply.segment_ = segment;
+    reply.size_ = memconf.region_size;
+    TRACEPOINT("Grew region", client_ipc->GetPID(), segment, region_id)
+    client_ipc->GetSocket().SendMSG((void*)&reply, sizeof(reply));
+}
+
+/*
+ * Move the rings of a private queue pair to the NUMA node of the CPU which polls it.
+ * Client and kernel rings live in regions the shmem module allocates, so they stay put.
+ * */
+void labstor::Server::IPCManager::PlaceQueuePair(labstor_queue_pair *qp, int cpu_id) {
+    if(!private_numa_ || !LABSTOR_QP_IS_PRIVATE(qp->GetQID().flags_)) {
+        return;
+    }
+    //Rings are smaller than a huge page: hugetlbfs pages can't be split, THP ones are split to 4K
+    if(private_page_size_ == labstor::PageSize::k2M || private_page_size_ == labstor::PageSize::k1G) {
+        return;
+    }
+    int node = labstor::Pages::GetCpuNode(cpu_id);
+    labstor::Pages::Bind(qp->sq_.GetRegion(), qp->sq_.GetSize(), node, labstor::PageSize::k4K);
+    labstor::Pages::Bind(qp->cq_.GetRegion(), qp->cq_.GetSize(), node, labstor::PageSize::k4K);
+    TRACEPOINT("qid", qp->GetQID().Hash(), "cpu", cpu_id, "node", node)
 }
 
 void labstor::Server::IPCManager::PauseQueues() {
@@ -57,7 +57,7 @@ labstor::Server::Namespace::Namespace() {
     TRACEPOINT("NamespaceTables")
     uint32_t remainder = shmem_size;
     void *section = region_;
-    ns_ids_.Init(section, labstor::ipc::mpmc::ring_buffer<uint32_t>::GetSize(max_entries));
+    ns_ids_.Init(section, labstor::ipc::mpmc::lockless_ring_buffer<uint32_t>::GetSize(max_entries));
     remainder -= ns_ids_.GetSize();
     section = ns_ids_.GetNextSection();
     key_to_ns_id_.Init(region_, section, labstor::ipc::mpmc::string_map::GetSize(max_entries), 0, 16);
@@ -24,28 +24,145 @@
  * <http://www.gnu.org/licenses/>.
  */
 
-#include <labstor/userspace/util/timer.h>
-#include <labstor/userspace/types/userspace_daemon.h>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <labstor/userspace/server/server.h>
+#include <labstor/userspace/server/macros.h>
+#include <labstor/userspace/server/stats_admin.h>
+#include <labstor/userspace/server/work_orchestrator.h>
 
-struct shmem_stats {
-    size_t ns_since_start_;
-};
+labstor::Server::StatsAdmin::~StatsAdmin() {
+    if(header_) {
+        munmap(header_, sizeof(labstor::StatsHeader));
+        shm_unlink(LABSTOR_STATS_SHMEM_NAME);
+    }
+}
+
+/*
+ * Create the statistics region, replacing the one of any previous server.
+ * Only the server may write it; everyone may read it.
+ * */
+void labstor::Server::StatsAdmin::Create(uint32_t period_us) {
+    AUTO_TRACE(period_us)
+    std::lock_guard<std::mutex> lock(lock_);
+    period_us_ = period_us ? period_us : LABSTOR_STATS_PERIOD_US;
+    shm_unlink(LABSTOR_STATS_SHMEM_NAME);
+    int fd = shm_open(LABSTOR_STATS_SHMEM_NAME, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(fd < 0) {
+        throw STATS_REGION_CREATE_FAILED.format(strerror(errno));
+    }
+    fchmod(fd, 0644);
+    if(ftruncate(fd, sizeof(labstor::StatsHeader)) < 0) {
+        close(fd);
+        throw STATS_REGION_CREATE_FAILED.format(strerror(errno));
+    }
+    void *region = mmap(nullptr, sizeof(labstor::StatsHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(region == MAP_FAILED) {
+        throw MMAP_FAILED.format(strerror(errno));
+    }
+    labstor::StatsHeader *header = reinterpret_cast<labstor::StatsHeader*>(region);
+    header->pid_ = getpid();
+    header->max_workers_ = LABSTOR_STATS_MAX_WORKERS;
+    header->max_qps_ = LABSTOR_STATS_MAX_QPS;
+    header->max_modules_ = LABSTOR_STATS_MAX_MODULES;
+    header->latency_buckets_ = LABSTOR_STATS_LATENCY_BUCKETS;
+    header->period_us_ = period_us_;
+    header->update_ns_.store(0);
+    header->num_workers_.store(0);
+    header->num_qps_.store(0);
+    header->num_modules_.store(0);
+    header->version_ = LABSTOR_STATS_VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic_ = LABSTOR_STATS_MAGIC;
+    header_ = header;
+}
+
+int labstor::Server::StatsAdmin::AddWorker(int worker_id, int cpu_id) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if(!header_ || worker_id < 0 || worker_id >= LABSTOR_STATS_MAX_WORKERS) { return -1; }
+    labstor::StatsWorkerEntry &entry = header_->workers_[worker_id];
+    entry.cpu_id_ = cpu_id;
+    entry.in_use_.store(1, std::memory_order_release);
+    if((uint32_t)worker_id >= header_->num_workers_.load()) {
+        header_->num_workers_.store(worker_id + 1, std::memory_order_release);
+    }
+    return worker_id;
+}
 
-class StatsWorker : public labstor::DaemonWorker {
-private:
-    labstor::HighResMonotonicTimer t_;
-    int region_id_;
-    shmem_stats *stats_;
-public:
-    StatsWorker() {
-        t_.Resume();
-        //Create SHMEM region
+/*
+ * The entry of a new queue pair. Entries of removed queue pairs are reused first.
+ * */
+int labstor::Server::StatsAdmin::AddQueuePair(labstor_qid_t qid, int worker_id) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if(!header_) { return -1; }
+    uint32_t num_qps = header_->num_qps_.load(), id;
+    for(id = 0; id < num_qps; ++id) {
+        if(!header_->qps_[id].in_use_.load(std::memory_order_relaxed)) { break; }
+    }
+    if(id >= LABSTOR_STATS_MAX_QPS) { return -1; }
+    labstor::StatsQueuePairEntry &entry = header_->qps_[id];
+    entry.stats_.Publish(labstor::StatsCounters());
+    entry.pid_ = qid.pid_;
+    entry.cnt_ = qid.cnt_;
+    entry.flags_ = qid.flags_;
+    entry.type_ = qid.type_;
+    entry.worker_id_.store(worker_id, std::memory_order_relaxed);
+    entry.in_use_.store(1, std::memory_order_release);
+    if(id == num_qps) {
+        header_->num_qps_.store(id + 1, std::memory_order_release);
+    }
+    return id;
+}
+
+/*
+ * Free the entry of a queue pair which was removed. Called by the worker which
+ * owned the queue pair last, so nobody publishes to the entry anymore.
+ * */
+void labstor::Server::StatsAdmin::RemoveQueuePair(int id) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if(!header_ || id < 0 || id >= LABSTOR_STATS_MAX_QPS) { return; }
+    header_->qps_[id].in_use_.store(0, std::memory_order_release);
+}
+
+/*
+ * The entry of a module, by name, so a module keeps its entry across upgrades.
+ * */
+int labstor::Server::StatsAdmin::AddModule(const labstor::id &module_id) {
+    std::lock_guard<std::mutex> lock(lock_);
+    if(!header_) { return -1; }
+    uint32_t num_modules = header_->num_modules_.load();
+    for(uint32_t i = 0; i < num_modules; ++i) {
+        if(strncmp(header_->modules_[i].name_, module_id.key_, MODULE_KEY_SIZE) == 0) {
+            return i;
+        }
     }
+    if(num_modules >= LABSTOR_STATS_MAX_MODULES) { return -1; }
+    labstor::StatsModuleEntry &entry = header_->modules_[num_modules];
+    strncpy(entry.name_, module_id.key_, MODULE_KEY_SIZE);
+    entry.name_[MODULE_KEY_SIZE] = 0;
+    entry.in_use_.store(1, std::memory_order_release);
+    header_->num_modules_.store(num_modules + 1, std::memory_order_release);
+    return num_modules;
+}
 
-    int GetRegionID() {
+void labstor::Server::StatsAdmin::SetUpdateTime(uint64_t ns) {
+    if(header_) {
+        header_->update_ns_.store(ns, std::memory_order_release);
     }
+}
 
-    void DoWork() {
-        stats_->ns_since_start_ = (size_t)t_.GetNsecFromStart();
+void labstor::Server::StatsWorker::DoWork() {
+    LABSTOR_WORK_ORCHESTRATOR_T work_orchestrator_ = LABSTOR_WORK_ORCHESTRATOR;
+    StatsAdmin &stats = work_orchestrator_->GetStatsAdmin();
+    usleep(stats.GetPeriodUs());
+    stats.SetUpdateTime(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    for(int i = 0; i < work_orchestrator_->GetNumServerWorkers(); ++i) {
+        work_orchestrator_->GetServerWorker(i)->RequestStats();
     }
-};
\ No newline at end of file
+}
@@ -25,7 +25,18 @@
  */
 
 #include <labstor/userspace/server/server.h>
+#include <labstor/userspace/server/macros.h>
+#include <labstor/userspace/server/work_balancer.h>
+#include <labstor/userspace/server/work_orchestrator.h>
+#include <unistd.h>
 
 void labstor::Server::WorkBalancer::DoWork() {
-    sleep(5);
-}
\ No newline at end of file
+    LABSTOR_WORK_ORCHESTRATOR_T work_orchestrator_ = LABSTOR_WORK_ORCHESTRATOR;
+    usleep(work_orchestrator_->GetTimeSliceUs());
+    Rebalance();
+}
+
+void labstor::Server::WorkBalancer::Rebalance() {
+    LABSTOR_WORK_ORCHESTRATOR_T work_orchestrator_ = LABSTOR_WORK_ORCHESTRATOR;
+    work_orchestrator_->BalanceLoad();
+}
@@ -31,6 +31,7 @@
 #include <labstor/userspace/server/macros.h>
 #include <labstor/userspace/server/work_orchestrator.h>
 #include <labstor/userspace/server/worker.h>
+#include <labstor/userspace/server/work_balancer.h>
 #include <labstor/userspace/server/ipc_manager.h>
 #include <labstor/userspace/server/server.h>
 #include <labstor/userspace/util/partitioner.h>
@@ -47,26 +48,109 @@ void labstor::Server::WorkOrchestrator::CreateWorkers() {
     uint32_t queue_depth = config["work_queue_depth"].as<uint32_t>();
     int nworkers;
 
+    //Queue pair placement policy
+    if(config["time_slice_us"]) {
+        time_slice_us_ = config["time_slice_us"].as<size_t>();
+    }
+    if(config["policy"] && config["policy"].as<std::string>() == "dynamic") {
+        policy_ = WorkOrchestratorPolicy::kDynamic;
+    }
+    if(config["elastic"]) {
+        planner_.SetElastic(config["elastic"].as<bool>());
+    }
+
+    //How idle workers back off
+    labstor::DaemonIdlePolicy idle;
+    if(config["idle_spin_us"]) {
+        idle.spin_us_ = config["idle_spin_us"].as<uint32_t>();
+    }
+    if(config["idle_pause_us"]) {
+        idle.pause_us_ = config["idle_pause_us"].as<uint32_t>();
+    }
+    if(config["idle_sleep_us"]) {
+        idle.sleep_us_ = config["idle_sleep_us"].as<uint32_t>();
+    }
+
+    //Requests each latency class may process per worker pass
+    uint32_t class_budget[LABSTOR_WORKER_NUM_CLASSES] = {LABSTOR_WORKER_LOW_LATENCY_BUDGET, LABSTOR_WORKER_HIGH_LATENCY_BUDGET};
+    if(config["low_latency_budget"]) {
+        class_budget[LABSTOR_WORKER_LOW_LATENCY_CLASS] = config["low_latency_budget"].as<uint32_t>();
+    }
+    if(config["high_latency_budget"]) {
+        class_budget[LABSTOR_WORKER_HIGH_LATENCY_CLASS] = config["high_latency_budget"].as<uint32_t>();
+    }
+
+    //Statistics region, published every stats_period_us
+    uint32_t stats_period_us = LABSTOR_STATS_PERIOD_US;
+    if(config["stats_period_us"]) {
+        stats_period_us = config["stats_period_us"].as<uint32_t>();
+    }
+    stats_admin_.Create(stats_period_us);
+
     //Server worker threads
     nworkers = config["server_workers"].size();
     if(nworkers == 0) {
         throw WORK_ORCHESTRATOR_HAS_NO_WORKERS.format("server");
     }
+
+    //Active queue sets, shared with clients so they can mark queue pairs as active
+    LABSTOR_KERNEL_SHMEM_ALLOC_T shmem_alloc = LABSTOR_KERNEL_SHMEM_ALLOC;
+    active_region_size_ = labstor_active_queues_table_GetSize_global(nworkers, queue_depth);
+    int active_region_id = shmem_alloc->CreateShmem(active_region_size_, true);
+    if(active_region_id < 0) {
+        throw SHMEM_CREATE_FAILED.format();
+    }
+    active_region_id_ = active_region_id;
+    shmem_alloc->GrantPidShmem(getpid(), active_region_id_);
+    active_table_ = (labstor::ipc::active_queues_table*)shmem_alloc->MapShmem(active_region_id_, active_region_size_);
+    if(!active_table_) {
+        throw MMAP_FAILED.format(strerror(errno));
+    }
+    labstor_active_queues_table_Init(active_table_, active_region_size_, nworkers, queue_depth);
+
     worker_pool_.emplace(pid_, std::move(std::vector<std::shared_ptr<labstor::Daemon>>(nworkers)));
     auto &server_workers = worker_pool_[pid_];
     server_workers.resize(nworkers);
+    worker_cpus_.assign(nworkers, 0);
     for (const auto &worker_conf : config["server_workers"]) {
         int worker_id = worker_conf["worker_id"].as<int>();
         int cpu_id = worker_conf["cpu_id"].as<int>();
         TRACEPOINT("id", worker_id, "cpu", cpu_id)
         std::shared_ptr<labstor::UserspaceDaemon> worker_daemon = std::shared_ptr<labstor::UserspaceDaemon>(new labstor::UserspaceDaemon());
-        std::shared_ptr<labstor::Server::Worker> worker = std::shared_ptr<labstor::Server::Worker>(new labstor::Server::Worker(queue_depth, worker_id));
+        std::shared_ptr<labstor::Server::Worker> worker = std::shared_ptr<labstor::Server::Worker>(new labstor::Server::Worker(queue_depth, worker_id, active_table_, &stats_admin_, &placement_));
+        for(int c = 0; c < LABSTOR_WORKER_NUM_CLASSES; ++c) {
+            worker->SetClassBudget(c, class_budget[c]);
+        }
         server_workers[worker_id] = worker_daemon;
         worker_daemon->SetWorker(worker);
+        worker_daemon->SetIdlePolicy(idle);
         worker_daemon->Start();
         worker_daemon->SetAffinity(cpu_id);
+        worker_cpus_[worker_id] = cpu_id;
+        stats_admin_.AddWorker(worker_id, cpu_id);
+    }
+    for(int i = 0; i < nworkers; ++i) {
+        planner_.AddWorker(worker_cpus_[i], GetServerWorker(i)->GetMaxQueuePairs());
+    }
+    load_timer_.Resume();
+
+    //Dynamic orchestration periodically moves queue pairs off of overloaded workers
+    if(policy_ == WorkOrchestratorPolicy::kDynamic) {
+        std::shared_ptr<labstor::UserspaceDaemon> balancer_daemon = std::shared_ptr<labstor::UserspaceDaemon>(new labstor::UserspaceDaemon());
+        std::shared_ptr<labstor::Server::WorkBalancer> balancer = std::shared_ptr<labstor::Server::WorkBalancer>(new labstor::Server::WorkBalancer());
+        balancer_daemon->SetWorker(balancer);
+        balancer_daemon->Start();
+        balancer_daemon->SetAffinity(labstor_config_->config_["admin_thread"].as<int>());
+        work_balancer_ = balancer_daemon;
     }
 
+    //Periodically ask the workers to publish their statistics
+    std::shared_ptr<labstor::UserspaceDaemon> stats_daemon = std::shared_ptr<labstor::UserspaceDaemon>(new labstor::UserspaceDaemon());
+    stats_daemon->SetWorker(std::shared_ptr<labstor::Server::StatsWorker>(new labstor::Server::StatsWorker()));
+    stats_daemon->Start();
+    stats_daemon->SetAffinity(labstor_config_->config_["admin_thread"].as<int>());
+    stats_worker_ = stats_daemon;
+
     //Create kernel work queue region
     labstor::kernel::netlink::ShmemClient shmem;
     nworkers = config["kernel_workers"].size();
@@ -108,13 +192,93 @@ void labstor::Server::WorkOrchestrator::AssignQueuePair(labstor::ipc::shmem_queu
     LABSTOR_IPC_MANAGER_T ipc_manager_ = LABSTOR_IPC_MANAGER;
     labstor::credentials *creds;
     ipc_manager_->GetRegion(qp, creds);
-    auto &server_workers = worker_pool_[pid_];
-    if(worker_id < 0) {
-        throw NOT_YET_IMPLEMENTED.format("Dynamic work orchestration");
+    std::lock_guard<std::mutex> lock(planner_lock_);
+    if(worker_id < 0 || policy_ == WorkOrchestratorPolicy::kDynamic) {
+        worker_id = planner_.GetWorkerForQueuePair(qp->GetQID().flags_);
+        if(worker_id < 0) {
+            throw FAILED_TO_ASSIGN_QUEUE.format(qp->GetQID().pid_, -1);
+        }
     }
-    worker_id = worker_id % server_workers.size();
+    worker_id = worker_id % GetNumServerWorkers();
     TRACEPOINT(worker_id)
-    std::shared_ptr<labstor::Server::Worker> worker = std::dynamic_pointer_cast<labstor::Server::Worker>(server_workers[worker_id]->GetWorker());
+    std::shared_ptr<labstor::Server::Worker> worker = GetServerWorker(worker_id);
+    ipc_manager_->PlaceQueuePair(qp, GetWorkerCPU(worker_id));
     worker->AssignQP(qp, creds);
+    planner_.AddQueuePair(qp, worker_id);
     TRACEPOINT("Depth", worker->GetQueueDepth());
-}
\ No newline at end of file
+}
+
+void labstor::Server::WorkOrchestrator::MigrateQueuePair(labstor_queue_pair *qp, int src_worker_id, int dst_worker_id) {
+    AUTO_TRACE(src_worker_id, dst_worker_id)
+    std::shared_ptr<labstor::Server::Worker> src = GetServerWorker(src_worker_id);
+    std::shared_ptr<labstor::Server::Worker> dst = GetServerWorker(dst_worker_id);
+    src->MigrateQP(qp, dst.get());
+}
+
+/*
+ * Tell the planner where queue pairs landed since the last call and move the
+ * rings of migrated ones to the node of their new CPU. Migrations which were
+ * dropped never land, so the planner keeps them on their source worker.
+ * The planner lock must be held.
+ * */
+void labstor::Server::WorkOrchestrator::ApplyLandings() {
+    LABSTOR_IPC_MANAGER_T ipc_manager_ = LABSTOR_IPC_MANAGER;
+    std::vector<QueuePairLanding> landed;
+    placement_.TakeLandings(landed);
+    for(auto &landing : landed) {
+        int src_worker_id = planner_.MoveQueuePair(landing.qp_, landing.worker_id_);
+        if(src_worker_id < 0 || GetWorkerCPU(src_worker_id) == GetWorkerCPU(landing.worker_id_)) { continue; }
+        ipc_manager_->PlaceQueuePair(landing.qp_, GetWorkerCPU(landing.worker_id_));
+    }
+}
+
+/*
+ * Take queue pairs off of the planner and the workers, e.g., those of a process
+ * which disconnected. Returns once no worker references them anymore.
+ * */
+void labstor::Server::WorkOrchestrator::RemoveQueuePairs(std::vector<labstor_queue_pair*> &qps) {
+    AUTO_TRACE(qps.size())
+    {
+        std::lock_guard<std::mutex> lock(planner_lock_);
+        //Nothing is assigned or migrated while the planner is locked, so each queue pair ends up in one work queue
+        while(placement_.num_moving_.load()) {
+            std::this_thread::yield();
+        }
+        //Landings still name these queue pairs, whose memory may be reused
+        ApplyLandings();
+        for(auto qp : qps) {
+            planner_.RemoveQueuePair(qp);
+            placement_.num_removing_.fetch_add(GetNumServerWorkers());
+            for(int i = 0; i < GetNumServerWorkers(); ++i) {
+                GetServerWorker(i)->RemoveQP(qp);
+            }
+        }
+    }
+    while(placement_.num_removing_.load()) {
+        std::this_thread::yield();
+    }
+}
+
+/*
+ * Sample the load of each server worker and queue pair since the last call
+ * and move queue pairs off of the busiest CPUs. See LoadPlanner.
+ * */
+void labstor::Server::WorkOrchestrator::BalanceLoad() {
+    std::vector<QueuePairMigration> migrations;
+    std::lock_guard<std::mutex> lock(planner_lock_);
+    double elapsed_ns = load_timer_.GetNsecFromStart();
+    load_timer_.Resume();
+    ApplyLandings();
+    if(elapsed_ns <= 0) { return; }
+    for(int i = 0; i < GetNumServerWorkers(); ++i) {
+        std::shared_ptr<labstor::Server::Worker> worker = GetServerWorker(i);
+        planner_.SampleWorker(i, worker->GetBusyNsec(), worker->GetNumProcessed(), elapsed_ns);
+        planner_.SampleWorkerCost(i, worker->GetNumEstimated(), worker->GetEstCpuNsec(), worker->GetEstTotalNsec());
+    }
+    planner_.SampleQueuePairs(elapsed_ns);
+    planner_.Plan(migrations);
+    for(auto &migration : migrations) {
+        TRACEPOINT("Migrating queue pair", migration.src_worker_id_, migration.dst_worker_id_)
+        MigrateQueuePair(migration.qp_, migration.src_worker_id_, migration.dst_worker_id_);
+    }
+}
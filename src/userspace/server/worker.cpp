@@ -32,33 +32,485 @@
 #include <labstor/userspace/server/ipc_manager.h>
 
 void labstor::Server::Worker::DoWork() {
-    LABSTOR_IPC_MANAGER_T ipc_manager_ = LABSTOR_IPC_MANAGER;
+    uint32_t num_processed = 0;
+    if(has_mail_.load(std::memory_order_acquire)) {
+        ProcessMail();
+    }
+    if(publish_stats_.load(std::memory_order_relaxed)) {
+        PublishStats();
+    }
     work_queue_depth = work_queue_.GetDepth();
+    if(++num_passes_ % LABSTOR_WORKER_SWEEP_PERIOD == 0) {
+        active_.SetAll(work_queue_depth);
+    }
+    t.Resume();
     LABSTOR_ERROR_HANDLE_TRY {
-        for (uint32_t i = 0; i < work_queue_depth; ++i) {
-            if (!work_queue_.Peek(qp_struct, creds, i)) { break; }
-            ipc_manager_->GetQueuePair(qp, qp_struct->GetQID());
-            qp_depth = qp->GetDepth();
-            for (uint32_t j = 0; j < qp_depth; ++j) {
-                if (!qp->Peek(rq, 0)) { break; }
-                module = namespace_->GetModule(rq->GetNamespaceID());
-                if (!module) {
-                    rq->SetCode(-1);
-                    qp->Complete(rq);
-                    TRACEPOINT("Could not find module in namespace", rq->GetNamespaceID())
-                    continue;
-                }
-                bool is_complete = module->ProcessRequest(qp, rq, creds);
-                if(is_complete) {
-                    qp->Dequeue(rq);
-                } else {
-                    break;
-                }
-            }
+        num_processed += PollInflight();
+        if(num_draining_) {
+            FinishDrains();
+        }
+        CollectActive();
+        //Latency classes are served in priority order, each within its budget
+        for(int c = 0; c < LABSTOR_WORKER_NUM_CLASSES; ++c) {
+            num_processed += ProcessClass(c);
         }
     }
     LABSTOR_ERROR_HANDLE_CATCH {
         printf("In worker\n");
         LABSTOR_ERROR_PTR->print();
     };
-}
\ No newline at end of file
+    if(num_processed) {
+        num_processed_.fetch_add(num_processed, std::memory_order_relaxed);
+        busy_ns_.fetch_add((uint64_t)t.GetNsecFromStart(), std::memory_order_relaxed);
+    }
+    if(pass_estimated_) {
+        num_estimated_.fetch_add(pass_estimated_, std::memory_order_relaxed);
+        est_cpu_ns_.fetch_add(pass_est_cpu_ns_, std::memory_order_relaxed);
+        est_total_ns_.fetch_add(pass_est_total_ns_, std::memory_order_relaxed);
+        pass_estimated_ = pass_est_cpu_ns_ = pass_est_total_ns_ = 0;
+    }
+    did_work_ = num_processed || inflight_.size() || !active_.IsEmpty() || !scheduler_.IsEmpty();
+}
+
+/*
+ * Move the queue pairs which producers marked as active to the run queue
+ * of their latency class.
+ * */
+void labstor::Server::Worker::CollectActive() {
+    uint64_t summary, word;
+    summary = active_.TakeSummary();
+    while(summary) {
+        uint32_t w = __builtin_ctzll(summary);
+        summary &= summary - 1;
+        word = active_.TakeWord(w);
+        while(word) {
+            uint32_t i = w*LABSTOR_ACTIVE_QUEUES_BITS + __builtin_ctzll(word);
+            word &= word - 1;
+            if(i >= work_queue_depth || scheduler_.IsQueued(i) || !work_queue_.Peek(qp_struct, creds, i)) { continue; }
+            int c = LABSTOR_QP_IS_HIGH_LATENCY(qp_struct->GetQID().flags_) ?
+                    LABSTOR_WORKER_HIGH_LATENCY_CLASS : LABSTOR_WORKER_LOW_LATENCY_CLASS;
+            scheduler_.Enqueue(c, i);
+        }
+    }
+}
+
+/*
+ * Give the queue pairs of a latency class their turns. See LatencyScheduler.
+ * */
+uint32_t labstor::Server::Worker::ProcessClass(int c) {
+    LABSTOR_IPC_MANAGER_T ipc_manager_ = LABSTOR_IPC_MANAGER;
+    return scheduler_.ProcessClass(c, [&](uint32_t i, uint32_t max_count, bool &keep) -> uint32_t {
+        uint32_t qp_processed;
+        if(i >= work_queue_depth || !work_queue_.Peek(qp_struct, creds, i)) { return 0; }
+        if(drain_to_[i]) {
+            //A draining queue pair only finishes the head request it started
+            if(LABSTOR_QP_IS_UNORDERED(qp_struct->GetQID().flags_) || !head_state_[i].rq_) { return 0; }
+            max_count = 1;
+        }
+        ipc_manager_->GetQueuePair(qp, qp_struct->GetQID());
+        if(LABSTOR_QP_IS_UNORDERED(qp->GetQID().flags_)) {
+            qp_processed = ProcessUnordered(i, max_count);
+        } else {
+            qp_processed = ProcessOrdered(i, max_count);
+        }
+        qp_load_[i] += qp_processed;
+        //Go idle on the queue pair until a producer rings, unless work is left
+        keep = qp_struct->GetDepth() || !qp_struct->sq_.ArmDoorbell(LABSTOR_QP_DOORBELL(id_, i));
+        return qp_processed;
+    });
+}
+
+/*
+ * Sleep on the active queue doorbell. Producers ring it when they mark a
+ * queue pair active and the orchestrator rings it when it posts mail.
+ * */
+void labstor::Server::Worker::WaitForWork(uint32_t max_us) {
+    labstor::ipc::doorbell *doorbell = active_.GetDoorbell();
+    if(work_queue_.GetDepth() == 0) {
+        max_us = LABSTOR_WORKER_PARKED_SLEEP_US;
+    }
+    uint32_t seq = labstor_doorbell_PrepareSleep(doorbell);
+    if(!active_.IsEmpty() || has_mail_.load(std::memory_order_acquire) || publish_stats_.load(std::memory_order_relaxed)) {
+        labstor_doorbell_CancelSleep(doorbell);
+        return;
+    }
+    labstor_doorbell_SleepUs(doorbell, seq, max_us);
+}
+
+/*
+ * Apply the queue pair assignments and migrations posted to this worker.
+ * */
+void labstor::Server::Worker::ProcessMail() {
+    std::vector<WorkerMessage> mailbox;
+    {
+        std::lock_guard<std::mutex> lock(mailbox_lock_);
+        mailbox.swap(mailbox_);
+        has_mail_.store(false, std::memory_order_relaxed);
+    }
+    for(auto &msg : mailbox) {
+        switch(msg.type_) {
+            case WorkerMessageType::kAssignQP: {
+                uint32_t slot = work_queue_.GetDepth();
+                qp_load_[slot] = 0;
+                head_state_[slot] = RequestState();
+                qp_stats_[slot] = msg.stats_;
+                work_queue_.Enqueue(msg.qp_, msg.creds_);
+                ActivateQP(slot);
+                placement_->Land(msg.qp_, id_);
+                placement_->num_moving_.fetch_sub(1);
+                break;
+            }
+            case WorkerMessageType::kMigrateQP: {
+                uint32_t i;
+                for(i = 0; i < work_queue_.GetDepth(); ++i) {
+                    if(!work_queue_.Peek(qp_struct, creds, i)) { break; }
+                    if(qp_struct == msg.qp_) {
+                        MigrateSlot(i, msg.dst_);
+                        break;
+                    }
+                }
+                if(i == work_queue_.GetDepth()) {
+                    placement_->num_moving_.fetch_sub(1);
+                }
+                break;
+            }
+            case WorkerMessageType::kMigrateHottestQP: {
+                uint32_t hottest = 0;
+                if(work_queue_.GetDepth() - num_draining_ < 2) {
+                    placement_->num_moving_.fetch_sub(1);
+                    break;
+                }
+                while(drain_to_[hottest]) { ++hottest; }
+                for(uint32_t i = hottest + 1; i < work_queue_.GetDepth(); ++i) {
+                    if(!drain_to_[i] && qp_load_[i] > qp_load_[hottest]) { hottest = i; }
+                }
+                MigrateSlot(hottest, msg.dst_);
+                for(uint32_t i = 0; i < work_queue_.GetDepth(); ++i) {
+                    qp_load_[i] = 0;
+                }
+                break;
+            }
+            case WorkerMessageType::kRemoveQP: {
+                uint32_t i;
+                for(i = 0; i < work_queue_.GetDepth(); ++i) {
+                    if(!work_queue_.Peek(qp_struct, creds, i)) { break; }
+                    if(qp_struct != msg.qp_) { continue; }
+                    //A migration which hasn't happened yet is abandoned
+                    if(drain_to_[i]) {
+                        placement_->num_moving_.fetch_sub(1);
+                    } else {
+                        ++num_draining_;
+                    }
+                    drain_to_[i] = this;
+                    break;
+                }
+                if(i == work_queue_.GetDepth()) {
+                    placement_->num_removing_.fetch_sub(1);
+                }
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * Move work queue entry i to dst now if it is quiescent, or drain it first.
+ * */
+void labstor::Server::Worker::MigrateSlot(uint32_t i, Worker *dst) {
+    if(dst == this || drain_to_[i]) {
+        placement_->num_moving_.fetch_sub(1);
+        return;
+    }
+    if(IsQuiescent(i)) {
+        ReleaseQP(i, dst);
+        return;
+    }
+    drain_to_[i] = dst;
+    ++num_draining_;
+}
+
+/*
+ * Whether no request of work queue entry i is being processed.
+ * */
+bool labstor::Server::Worker::IsQuiescent(uint32_t i) {
+    if(head_state_[i].rq_) { return false; }
+    for(auto &inflight : inflight_) {
+        if(inflight.slot_ == i) { return false; }
+    }
+    return true;
+}
+
+/*
+ * Hand off or drop the draining queue pairs whose requests have all finished.
+ * */
+void labstor::Server::Worker::FinishDrains() {
+    for(uint32_t i = 0; i < work_queue_.GetDepth();) {
+        //The last entry moves into slot i, so look at slot i again
+        if(drain_to_[i] && IsQuiescent(i)) {
+            if(drain_to_[i] == this) {
+                drain_to_[i] = nullptr;
+                --num_draining_;
+                stats_admin_->RemoveQueuePair(qp_stats_[i].id_);
+                RemoveSlot(i);
+                placement_->num_removing_.fetch_sub(1);
+            } else {
+                ReleaseQP(i, drain_to_[i]);
+            }
+            continue;
+        }
+        ++i;
+    }
+}
+
+/*
+ * Hand off work queue entry i to dst. The entry must be quiescent.
+ * The queue pair is removed from this worker before dst can see it.
+ * */
+void labstor::Server::Worker::ReleaseQP(uint32_t i, Worker *dst) {
+    if(drain_to_[i]) {
+        drain_to_[i] = nullptr;
+        --num_draining_;
+    }
+    if(!dst->ReserveQP()) {
+        placement_->num_moving_.fetch_sub(1);
+        ActivateQP(i);
+        return;
+    }
+    work_queue_.Peek(qp_struct, creds, i);
+    WorkerMessage msg(WorkerMessageType::kAssignQP, qp_struct, creds, nullptr);
+    msg.stats_ = qp_stats_[i];
+    RemoveSlot(i);
+    dst->PostMessage(std::move(msg));
+}
+
+/*
+ * Remove work queue entry i from this worker. The last entry moves into slot i.
+ * */
+void labstor::Server::Worker::RemoveSlot(uint32_t i) {
+    uint32_t last = work_queue_.GetDepth() - 1;
+    for(auto &inflight : inflight_) {
+        if(inflight.slot_ == last) { inflight.slot_ = i; }
+    }
+    qp_load_[i] = qp_load_[last];
+    head_state_[i] = std::move(head_state_[last]);
+    drain_to_[i] = drain_to_[last];
+    drain_to_[last] = nullptr;
+    qp_stats_[i] = qp_stats_[last];
+    work_queue_.Remove(i);
+    if(i < work_queue_.GetDepth()) {
+        ActivateQP(i);
+    }
+    //The last entry moved into slot i, so rebuild the run queues
+    scheduler_.Clear();
+    active_.SetAll(work_queue_.GetDepth());
+    num_qps_.fetch_sub(1);
+}
+
+/*
+ * Point the doorbell of the queue pair in work queue entry i at its slot
+ * and visit it on the next pass.
+ * */
+void labstor::Server::Worker::ActivateQP(uint32_t i) {
+    labstor_queue_pair *qp;
+    labstor::credentials *qp_creds;
+    work_queue_.Peek(qp, qp_creds, i);
+    qp->sq_.SetDoorbell(LABSTOR_QP_DOORBELL(id_, i));
+    active_.Set(i);
+}
+
+/*
+ * Copy this worker's statistics, those of the queue pairs it owns and those
+ * of the modules it ran requests for into the statistics region.
+ * */
+void labstor::Server::Worker::PublishStats() {
+    uint32_t depth = work_queue_.GetDepth();
+    publish_stats_.store(false, std::memory_order_relaxed);
+    stats_.busy_ns_ = busy_ns_.load(std::memory_order_relaxed);
+    stats_.occupancy_ = inflight_.size();
+    for(uint32_t i = 0; i < depth; ++i) {
+        if(!work_queue_.Peek(qp_struct, creds, i)) { break; }
+        QueuePairStats &qp_stats = qp_stats_[i];
+        qp_stats.counters_.occupancy_ = qp_struct->GetDepth();
+        qp_stats.counters_.num_collisions_ = qp_struct->cq_.GetNumCollisions();
+        stats_.occupancy_ += qp_stats.counters_.occupancy_;
+        stats_admin_->PublishQueuePair(qp_stats.id_, id_, qp_stats.counters_);
+    }
+    stats_admin_->PublishWorker(id_, stats_, depth);
+    for(uint64_t mask = module_mask_; mask; mask &= mask - 1) {
+        int m = __builtin_ctzll(mask);
+        stats_admin_->PublishModule(id_, m, module_stats_[m]);
+    }
+}
+
+/*
+ * The counters of a module on this worker. Modules which didn't get an entry
+ * in the statistics region share the last one, which is never published.
+ * */
+labstor::StatsCounters& labstor::Server::Worker::GetModuleStats(labstor::Module *module) {
+    int stats_id = module->GetStatsID();
+    if(stats_id < 0) {
+        stats_id = stats_admin_->AddModule(module->GetModuleID());
+        if(stats_id < 0) { stats_id = LABSTOR_STATS_MAX_MODULES; }
+        module->SetStatsID(stats_id);
+    }
+    if(stats_id < LABSTOR_STATS_MAX_MODULES) {
+        module_mask_ |= 1ull << stats_id;
+    }
+    return module_stats_[stats_id];
+}
+
+/*
+ * Process a request. Every LABSTOR_WORKER_COST_SAMPLE_PERIOD-th request is
+ * timed: its CPU time accumulates over the calls it takes to finish, and the
+ * module's cost model is reinforced with its CPU and total time once it does.
+ *
+ * If the module's handler suspends on a coroutine, the worker keeps it and
+ * resumes it once the operation it awaits completes, instead of calling
+ * ProcessRequest again.
+ *
+ * Finished requests are counted for the worker, the module and the queue pair.
+ * Latency histograms and the busy time of modules and queue pairs come from
+ * the sampled requests, scaled by the sample period. The worker also sums the
+ * module's estimated CPU and total time of every finished request, which the
+ * load planner uses to tell compute-heavy workers apart.
+ * */
+bool labstor::Server::Worker::RunRequest(labstor::Module *module, labstor::queue_pair *qp, labstor::ipc::request *rq, labstor::credentials *creds, RequestState &state, labstor::StatsCounters &qp_stats) {
+    double cpu_start_ns = 0;
+    bool done;
+    if(state.rq_ != rq) {
+        state.rq_ = rq;
+        state.bytes_ = module->GetRequestSize(rq);
+        state.est_cpu_ns_ = module->EstCpuTime(rq);
+        state.est_total_ns_ = module->EstTotalTime(rq);
+        state.sampled_ = (++num_requests_ % LABSTOR_WORKER_COST_SAMPLE_PERIOD) == 0;
+        if(state.sampled_) {
+            //The request may be reused as soon as it completes, so keep its header
+            state.hdr_ = *rq;
+            state.start_ns_ = clock_.GetNsecFromStart();
+            state.cpu_ns_ = 0;
+        }
+    }
+    if(state.cont_ && !state.cont_.IsReady()) {
+        return false;
+    }
+    if(state.sampled_) {
+        cpu_start_ns = cpu_clock_.GetNsecFromStart();
+    }
+    if(state.cont_) {
+        done = state.cont_.Resume();
+    } else {
+        done = module->ProcessRequest(qp, rq, creds);
+        if(!done) {
+            state.cont_ = labstor::Continuation::TakeParked();
+        }
+    }
+    if(state.sampled_) {
+        state.cpu_ns_ += cpu_clock_.GetNsecFromStart() - cpu_start_ns;
+    }
+    if(!done) { return false; }
+    state.rq_ = nullptr;
+    labstor::StatsCounters &module_stats = GetModuleStats(module);
+    ++stats_.num_requests_;
+    ++module_stats.num_requests_;
+    ++qp_stats.num_requests_;
+    stats_.num_bytes_ += state.bytes_;
+    module_stats.num_bytes_ += state.bytes_;
+    qp_stats.num_bytes_ += state.bytes_;
+    ++pass_estimated_;
+    pass_est_cpu_ns_ += state.est_cpu_ns_;
+    pass_est_total_ns_ += state.est_total_ns_;
+    if(!state.sampled_) { return true; }
+    double wall_ns = clock_.GetNsecFromStart() - state.start_ns_;
+    uint64_t busy_ns = (uint64_t)state.cpu_ns_*LABSTOR_WORKER_COST_SAMPLE_PERIOD;
+    module_stats.busy_ns_ += busy_ns;
+    qp_stats.busy_ns_ += busy_ns;
+    stats_.AddLatency((uint64_t)wall_ns);
+    module_stats.AddLatency((uint64_t)wall_ns);
+    qp_stats.AddLatency((uint64_t)wall_ns);
+    module->ReinforceCpuTime(&state.hdr_, state.cpu_ns_);
+    module->ReinforceTotalTime(&state.hdr_, wall_ns);
+    return true;
+}
+
+/*
+ * Requests are processed in the order they were submitted.
+ * The head request blocks the rest of the queue until it completes.
+ * */
+uint32_t labstor::Server::Worker::ProcessOrdered(uint32_t i, uint32_t max_count) {
+    RequestState &head_state = head_state_[i];
+    labstor::StatsCounters &qp_stats = qp_stats_[i].counters_;
+    uint32_t num_processed = 0;
+    qp_depth = qp->GetDepth();
+    if(qp_depth > max_count) { qp_depth = max_count; }
+    while(qp_depth) {
+        //Snapshot a batch of requests and retire all finished ones with a single index update
+        batch_size = qp->PeekBatch(rqs, qp_depth < LABSTOR_WORKER_BATCH_SIZE ? qp_depth : LABSTOR_WORKER_BATCH_SIZE);
+        for (num_done = 0; num_done < batch_size; ++num_done) {
+            rq = rqs[num_done];
+            module = namespace_->GetModule(rq->GetNamespaceID());
+            if (!module) {
+                rq->SetCode(-1);
+                qp->Complete(rq);
+                TRACEPOINT("Could not find module in namespace", rq->GetNamespaceID())
+                continue;
+            }
+            if(!RunRequest(module, qp, rq, creds, head_state, qp_stats)) { break; }
+        }
+        if(num_done) { qp->Consume(num_done); }
+        num_processed += num_done;
+        if(num_done < LABSTOR_WORKER_BATCH_SIZE || num_done == qp_depth) { break; }
+        qp_depth -= num_done;
+    }
+    return num_processed;
+}
+
+/*
+ * Requests are dequeued as soon as they are admitted.
+ * Requests which don't finish in one pass are parked in the in-flight set
+ * and polled by PollInflight, so they don't block the requests behind them.
+ * */
+uint32_t labstor::Server::Worker::ProcessUnordered(uint32_t i, uint32_t max_count) {
+    labstor::StatsCounters &qp_stats = qp_stats_[i].counters_;
+    uint32_t max_admit, num_processed = 0;
+    qp_depth = qp->GetDepth();
+    if(qp_depth > max_count) { qp_depth = max_count; }
+    while(qp_depth && inflight_.size() < LABSTOR_WORKER_MAX_INFLIGHT) {
+        max_admit = LABSTOR_WORKER_MAX_INFLIGHT - inflight_.size();
+        if(max_admit > LABSTOR_WORKER_BATCH_SIZE) { max_admit = LABSTOR_WORKER_BATCH_SIZE; }
+        if(max_admit > qp_depth) { max_admit = qp_depth; }
+        batch_size = qp->DequeueBatch(rqs, max_admit);
+        for (uint32_t j = 0; j < batch_size; ++j) {
+            rq = rqs[j];
+            module = namespace_->GetModule(rq->GetNamespaceID());
+            if (!module) {
+                rq->SetCode(-1);
+                qp->Complete(rq);
+                TRACEPOINT("Could not find module in namespace", rq->GetNamespaceID())
+                continue;
+            }
+            RequestState state;
+            if(!RunRequest(module, qp, rq, creds, state, qp_stats)) {
+                inflight_.emplace_back(qp_struct, qp, rq, creds, module, i, std::move(state));
+            }
+        }
+        num_processed += batch_size;
+        if(batch_size < max_admit) { break; }
+        qp_depth -= batch_size;
+    }
+    return num_processed;
+}
+
+uint32_t labstor::Server::Worker::PollInflight() {
+    uint32_t num_processed = 0;
+    for(size_t i = 0; i < inflight_.size();) {
+        InflightRequest &inflight = inflight_[i];
+        if(!RunRequest(inflight.module_, inflight.qp_, inflight.rq_, inflight.creds_, inflight.state_, qp_stats_[inflight.slot_].counters_)) {
+            ++i;
+            continue;
+        }
+        inflight = std::move(inflight_.back());
+        inflight_.pop_back();
+        ++num_processed;
+    }
+    return num_processed;
+}
@@ -0,0 +1,218 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <labstor/userspace/util/stats.h>
+
+/*
+ * Print live rates from the statistics region of the server (see labstor::StatsHeader).
+ *   workers: requests, bandwidth, utilization and backlog of each worker
+ *   qps: the same per queue pair, plus completion collisions
+ *   modules: the same per module, summed over workers
+ *   latency: the latency histogram of each module
+ * */
+
+struct Snapshot {
+    uint64_t update_ns_;
+    std::vector<labstor::StatsCounters> workers_;
+    std::vector<labstor::StatsCounters> qps_;
+    std::vector<labstor::StatsCounters> modules_;
+};
+
+static labstor::StatsHeader* OpenRegion() {
+    int fd = shm_open(LABSTOR_STATS_SHMEM_NAME, O_RDONLY, 0);
+    if(fd < 0) {
+        printf("No statistics region. Is the LabStor server running?\n");
+        exit(1);
+    }
+    void *region = mmap(nullptr, sizeof(labstor::StatsHeader), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(region == MAP_FAILED) {
+        printf("Could not map the statistics region\n");
+        exit(1);
+    }
+    labstor::StatsHeader *header = reinterpret_cast<labstor::StatsHeader*>(region);
+    if(header->magic_ != LABSTOR_STATS_MAGIC || header->version_ != LABSTOR_STATS_VERSION ||
+       header->max_workers_ != LABSTOR_STATS_MAX_WORKERS || header->max_qps_ != LABSTOR_STATS_MAX_QPS ||
+       header->max_modules_ != LABSTOR_STATS_MAX_MODULES || header->latency_buckets_ != LABSTOR_STATS_LATENCY_BUCKETS) {
+        printf("The statistics region has an unknown layout\n");
+        exit(1);
+    }
+    return header;
+}
+
+static void TakeSnapshot(labstor::StatsHeader *header, Snapshot &snap) {
+    uint32_t num_workers = std::min(header->num_workers_.load(std::memory_order_acquire), (uint32_t)LABSTOR_STATS_MAX_WORKERS);
+    uint32_t num_qps = std::min(header->num_qps_.load(std::memory_order_acquire), (uint32_t)LABSTOR_STATS_MAX_QPS);
+    uint32_t num_modules = std::min(header->num_modules_.load(std::memory_order_acquire), (uint32_t)LABSTOR_STATS_MAX_MODULES);
+    labstor::StatsCounters counters;
+    snap.update_ns_ = header->update_ns_.load(std::memory_order_acquire);
+    snap.workers_.assign(num_workers, labstor::StatsCounters());
+    snap.qps_.assign(num_qps, labstor::StatsCounters());
+    snap.modules_.assign(num_modules, labstor::StatsCounters());
+    for(uint32_t i = 0; i < num_workers; ++i) {
+        header->workers_[i].stats_.Read(snap.workers_[i]);
+    }
+    for(uint32_t i = 0; i < num_qps; ++i) {
+        header->qps_[i].stats_.Read(snap.qps_[i]);
+    }
+    for(uint32_t w = 0; w < num_workers; ++w) {
+        for(uint32_t m = 0; m < num_modules; ++m) {
+            if(header->module_stats_[w][m].Read(counters)) {
+                snap.modules_[m].Add(counters);
+            }
+        }
+    }
+}
+
+static labstor::StatsCounters Diff(const std::vector<labstor::StatsCounters> &prior, const std::vector<labstor::StatsCounters> &cur, size_t i) {
+    labstor::StatsCounters diff = cur[i];
+    //Counters only go down when the entry was reused by another queue pair
+    if(i >= prior.size() || cur[i].num_requests_ < prior[i].num_requests_) { return diff; }
+    diff.num_requests_ -= prior[i].num_requests_;
+    diff.num_bytes_ -= prior[i].num_bytes_;
+    diff.busy_ns_ -= prior[i].busy_ns_;
+    diff.num_collisions_ -= prior[i].num_collisions_;
+    for(int b = 0; b < LABSTOR_STATS_LATENCY_BUCKETS; ++b) {
+        diff.latency_[b] -= prior[i].latency_[b];
+    }
+    return diff;
+}
+
+/*The upper bound of the bucket holding the given percentile, in microseconds*/
+static double GetPercentileUs(const labstor::StatsCounters &counters, double percentile) {
+    uint64_t total = 0, count = 0;
+    for(int b = 0; b < LABSTOR_STATS_LATENCY_BUCKETS; ++b) { total += counters.latency_[b]; }
+    if(total == 0) { return 0; }
+    for(int b = 0; b < LABSTOR_STATS_LATENCY_BUCKETS; ++b) {
+        count += counters.latency_[b];
+        if(count >= percentile*total) { return (double)(2ull << b) / 1000; }
+    }
+    return (double)(1ull << LABSTOR_STATS_LATENCY_BUCKETS) / 1000;
+}
+
+static void PrintRow(const char *name, const labstor::StatsCounters &diff, const labstor::StatsCounters &cur, double elapsed_s, bool collisions) {
+    printf("%-24s %10.2lf %10.2lf %7.1lf%% %8lu %8.1lf %8.1lf",
+           name,
+           diff.num_requests_ / elapsed_s / 1000,
+           diff.num_bytes_ / elapsed_s / (1 << 20),
+           100 * diff.busy_ns_ / (elapsed_s * 1e9),
+           cur.occupancy_,
+           GetPercentileUs(diff, .5),
+           GetPercentileUs(diff, .99));
+    if(collisions) {
+        printf(" %10.1lf", diff.num_collisions_ / elapsed_s);
+    }
+    printf("\n");
+}
+
+static void PrintHeader(const char *name, bool collisions) {
+    printf("%-24s %10s %10s %8s %8s %8s %8s", name, "Kops/s", "MB/s", "Busy", "Queued", "p50(us)", "p99(us)");
+    if(collisions) { printf(" %10s", "Coll/s"); }
+    printf("\n");
+}
+
+static void PrintLatency(const char *name, const labstor::StatsCounters &diff) {
+    uint64_t total = 0;
+    for(int b = 0; b < LABSTOR_STATS_LATENCY_BUCKETS; ++b) { total += diff.latency_[b]; }
+    printf("%s (%lu sampled requests)\n", name, total);
+    if(total == 0) { return; }
+    for(int b = 0; b < LABSTOR_STATS_LATENCY_BUCKETS; ++b) {
+        if(diff.latency_[b] == 0) { continue; }
+        int width = (int)(50 * diff.latency_[b] / total);
+        printf("  < %12.3lf us %10lu |%.*s\n", (double)(2ull << b) / 1000, diff.latency_[b], width,
+               "##################################################");
+    }
+}
+
+static void Print(labstor::StatsHeader *header, const std::string &view, const Snapshot &prior, const Snapshot &cur, double elapsed_s) {
+    char name[64];
+    if(view == "workers") {
+        PrintHeader("Worker", false);
+        for(size_t i = 0; i < cur.workers_.size(); ++i) {
+            if(!header->workers_[i].in_use_.load(std::memory_order_acquire)) { continue; }
+            snprintf(name, sizeof(name), "%lu (cpu %d, %u qps)", i, header->workers_[i].cpu_id_, header->workers_[i].num_qps_.load());
+            PrintRow(name, Diff(prior.workers_, cur.workers_, i), cur.workers_[i], elapsed_s, false);
+        }
+    } else if(view == "qps") {
+        PrintHeader("QP pid.cnt/flags@worker", true);
+        for(size_t i = 0; i < cur.qps_.size(); ++i) {
+            labstor::StatsQueuePairEntry &qp = header->qps_[i];
+            if(!qp.in_use_.load(std::memory_order_acquire)) { continue; }
+            snprintf(name, sizeof(name), "%u.%u/0x%x@%d", qp.pid_, qp.cnt_, qp.flags_, qp.worker_id_.load());
+            PrintRow(name, Diff(prior.qps_, cur.qps_, i), cur.qps_[i], elapsed_s, true);
+        }
+    } else if(view == "modules") {
+        PrintHeader("Module", false);
+        for(size_t i = 0; i < cur.modules_.size(); ++i) {
+            if(!header->modules_[i].in_use_.load(std::memory_order_acquire)) { continue; }
+            PrintRow(header->modules_[i].name_, Diff(prior.modules_, cur.modules_, i), cur.modules_[i], elapsed_s, false);
+        }
+    } else {
+        for(size_t i = 0; i < cur.modules_.size(); ++i) {
+            if(!header->modules_[i].in_use_.load(std::memory_order_acquire)) { continue; }
+            PrintLatency(header->modules_[i].name_, Diff(prior.modules_, cur.modules_, i));
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    if(argc < 2) {
+        printf("USAGE: ./labstor_stat [workers|qps|modules|latency] [interval_ms (1000)] [count (forever)]\n");
+        exit(1);
+    }
+    std::string view = argv[1];
+    if(view != "workers" && view != "qps" && view != "modules" && view != "latency") {
+        printf("Unknown view %s\n", view.c_str());
+        exit(1);
+    }
+    int interval_ms = argc > 2 ? atoi(argv[2]) : 1000;
+    int count = argc > 3 ? atoi(argv[3]) : -1;
+    if(interval_ms <= 0) { interval_ms = 1000; }
+
+    labstor::StatsHeader *header = OpenRegion();
+    Snapshot prior, cur;
+    TakeSnapshot(header, prior);
+    for(int i = 0; count < 0 || i < count; ++i) {
+        usleep(interval_ms * 1000);
+        TakeSnapshot(header, cur);
+        //Rates are over the time between the publications the snapshots saw
+        double elapsed_s = (cur.update_ns_ > prior.update_ns_) ? (cur.update_ns_ - prior.update_ns_) / 1e9 : interval_ms / 1e3;
+        Print(header, view, prior, cur, elapsed_s);
+        prior = cur;
+    }
+    return 0;
+}
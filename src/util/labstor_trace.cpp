@@ -0,0 +1,223 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <labstor/userspace/util/trace.h>
+
+/*
+ * Inspect the trace region of a process (see labstor::Tracer).
+ *   decode: write its events as Chrome trace JSON (chrome://tracing, Perfetto)
+ *   enable/disable: change which categories it records
+ *   unlink: remove the region once it's no longer needed
+ * */
+
+struct DecodedEvent {
+    labstor::TraceEvent event_;
+    uint32_t ring_;
+};
+
+static labstor::TraceHeader* OpenRegion(int pid, bool writable) {
+    char name[64];
+    snprintf(name, sizeof(name), LABSTOR_TRACE_SHMEM_NAME, pid);
+    int fd = shm_open(name, writable ? O_RDWR : O_RDONLY, 0);
+    if(fd < 0) {
+        printf("No trace region for pid %d. Was tracing enabled with %s?\n", pid, LABSTOR_TRACE_ENV);
+        exit(1);
+    }
+    void *region = mmap(nullptr, labstor::Tracer::GetRegionSize(), writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(region == MAP_FAILED) {
+        printf("Could not map the trace region of pid %d\n", pid);
+        exit(1);
+    }
+    labstor::TraceHeader *header = reinterpret_cast<labstor::TraceHeader*>(region);
+    if(header->magic_ != LABSTOR_TRACE_MAGIC || header->version_ != LABSTOR_TRACE_VERSION ||
+       header->ring_events_ != LABSTOR_TRACE_RING_EVENTS || header->max_threads_ != LABSTOR_TRACE_MAX_THREADS) {
+        printf("The trace region of pid %d has an unknown layout\n", pid);
+        exit(1);
+    }
+    return header;
+}
+
+static const char* GetCategoryName(uint64_t category) {
+    switch(category) {
+        case LABSTOR_TRACE_CORE: return "core";
+        case LABSTOR_TRACE_IPC: return "ipc";
+        case LABSTOR_TRACE_WORKER: return "worker";
+        case LABSTOR_TRACE_MODULE: return "module";
+        case LABSTOR_TRACE_CLIENT: return "client";
+    }
+    return "other";
+}
+
+static std::string Escape(const std::string &str) {
+    std::string escaped;
+    for(char c : str) {
+        if(c == '"' || c == '\\') { escaped += '\\'; }
+        if((unsigned char)c < 0x20) { continue; }
+        escaped += c;
+    }
+    return escaped;
+}
+
+/*Split the argument text of a call site at its top-level commas*/
+static std::vector<std::string> SplitArgs(const char *text) {
+    std::vector<std::string> args;
+    std::string cur;
+    int depth = 0;
+    bool quoted = false;
+    for(const char *c = text; *c; ++c) {
+        if(*c == '"' && (c == text || c[-1] != '\\')) { quoted = !quoted; }
+        if(!quoted && (*c == '(' || *c == '[' || *c == '{')) { ++depth; }
+        if(!quoted && (*c == ')' || *c == ']' || *c == '}')) { --depth; }
+        if(!quoted && depth == 0 && *c == ',') {
+            args.emplace_back(cur);
+            cur.clear();
+            continue;
+        }
+        if(cur.empty() && *c == ' ') { continue; }
+        cur += *c;
+    }
+    if(!cur.empty()) { args.emplace_back(cur); }
+    return args;
+}
+
+/*
+ * Name each recorded argument: a string literal labels the argument after it,
+ * otherwise the argument is named by its own expression.
+ * */
+static std::string FormatArgs(const labstor::TraceSite &site, const labstor::TraceEvent &event) {
+    std::vector<std::string> args = SplitArgs(site.args_);
+    std::string json, label;
+    for(size_t i = 0; i < args.size() && i < LABSTOR_TRACE_MAX_ARGS; ++i) {
+        if(!(event.valid_ & (1 << i))) {
+            label = (args[i].size() && args[i][0] == '"') ? args[i].substr(1, args[i].size() - 2) : "";
+            continue;
+        }
+        std::string name = label.size() ? label : args[i];
+        label.clear();
+        if(json.size()) { json += ","; }
+        json += "\"" + Escape(name) + "\":" + std::to_string(event.args_[i]);
+    }
+    return "{" + json + "}";
+}
+
+static void Decode(int pid, const char *path) {
+    labstor::TraceHeader *header = OpenRegion(pid, false);
+    std::vector<DecodedEvent> events;
+    uint32_t num_rings = std::min(header->num_rings_.load(), (uint32_t)LABSTOR_TRACE_MAX_THREADS);
+    uint32_t num_sites = std::min(header->num_sites_.load(std::memory_order_acquire), (uint32_t)LABSTOR_TRACE_MAX_SITES);
+
+    //Copy each ring, then discard whatever the process overwrote while it was copied
+    for(uint32_t r = 0; r < num_rings; ++r) {
+        labstor::TraceRing &ring = header->rings_[r];
+        uint64_t head = ring.head_.load(std::memory_order_acquire);
+        uint64_t tail = head > LABSTOR_TRACE_RING_EVENTS ? head - LABSTOR_TRACE_RING_EVENTS : 0;
+        size_t first = events.size();
+        for(uint64_t i = tail; i < head; ++i) {
+            events.push_back({ring.events_[i & (LABSTOR_TRACE_RING_EVENTS - 1)], r});
+        }
+        uint64_t new_head = ring.head_.load(std::memory_order_acquire);
+        uint64_t overwritten = new_head > LABSTOR_TRACE_RING_EVENTS ? new_head - LABSTOR_TRACE_RING_EVENTS : 0;
+        if(overwritten > tail) {
+            size_t num_lost = std::min<uint64_t>(overwritten - tail, head - tail);
+            events.erase(events.begin() + first, events.begin() + first + num_lost);
+        }
+    }
+    std::stable_sort(events.begin(), events.end(), [](const DecodedEvent &a, const DecodedEvent &b) {
+        return a.event_.time_ns_ < b.event_.time_ns_;
+    });
+
+    FILE *out = path ? fopen(path, "w") : stdout;
+    if(out == nullptr) {
+        printf("Could not open %s\n", path);
+        exit(1);
+    }
+    uint64_t start_ns = events.size() ? events[0].event_.time_ns_ : 0;
+    std::vector<uint32_t> depth(num_rings, 0);
+    bool first = true;
+    fprintf(out, "{\"traceEvents\":[\n");
+    for(auto &decoded : events) {
+        labstor::TraceEvent &event = decoded.event_;
+        if(event.site_ >= num_sites) { continue; }
+        const labstor::TraceSite &site = header->sites_[event.site_];
+        //Drop ends whose begin was overwritten
+        if(event.phase_ == static_cast<uint8_t>(labstor::TracePhase::kBegin)) {
+            ++depth[decoded.ring_];
+        } else if(event.phase_ == static_cast<uint8_t>(labstor::TracePhase::kEnd)) {
+            if(depth[decoded.ring_] == 0) { continue; }
+            --depth[decoded.ring_];
+        }
+        fprintf(out, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3lf,\"pid\":%d,\"tid\":%u",
+                first ? "" : ",\n", Escape(site.func_).c_str(), GetCategoryName(site.category_), event.phase_,
+                (event.time_ns_ - start_ns)/1000.0, header->pid_, event.tid_);
+        if(event.phase_ == static_cast<uint8_t>(labstor::TracePhase::kInstant)) {
+            fprintf(out, ",\"s\":\"t\"");
+        }
+        if(event.phase_ != static_cast<uint8_t>(labstor::TracePhase::kEnd)) {
+            fprintf(out, ",\"args\":%s", FormatArgs(site, event).c_str());
+        }
+        fprintf(out, "}");
+        first = false;
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_threads\":%lu}}\n", header->dropped_.load());
+    if(path) { fclose(out); }
+}
+
+int main(int argc, char **argv) {
+    if(argc < 3) {
+        printf("USAGE: ./labstor_trace decode [pid] [output.json]\n");
+        printf("       ./labstor_trace enable [pid] [category mask]\n");
+        printf("       ./labstor_trace disable [pid]\n");
+        printf("       ./labstor_trace unlink [pid]\n");
+        printf("Categories: core=0x%llx ipc=0x%llx worker=0x%llx module=0x%llx client=0x%llx\n",
+               LABSTOR_TRACE_CORE, LABSTOR_TRACE_IPC, LABSTOR_TRACE_WORKER, LABSTOR_TRACE_MODULE, LABSTOR_TRACE_CLIENT);
+        exit(1);
+    }
+    std::string cmd = argv[1];
+    int pid = atoi(argv[2]);
+    if(cmd == "decode") {
+        Decode(pid, argc > 3 ? argv[3] : nullptr);
+    } else if(cmd == "enable" && argc > 3) {
+        uint64_t mask = strcmp(argv[3], "all") == 0 ? LABSTOR_TRACE_ALL : strtoull(argv[3], nullptr, 0);
+        OpenRegion(pid, true)->mask_.store(mask);
+    } else if(cmd == "disable") {
+        OpenRegion(pid, true)->mask_.store(0);
+    } else if(cmd == "unlink") {
+        char name[64];
+        snprintf(name, sizeof(name), LABSTOR_TRACE_SHMEM_NAME, pid);
+        shm_unlink(name);
+    } else {
+        printf("Unknown command %s\n", cmd.c_str());
+        exit(1);
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <vector>
+#include <algorithm>
+#include <labstor/userspace/util/timer.h>
+
+/*
+ * Each thread writes blocks to its own LabFS file and makes each one durable
+ * with fsync or fdatasync, so concurrent callers share group commits. The
+ * files are then re-opened and verified. Run it with the GenericPosix client
+ * preloaded and a LabFS directory backed by a real block device.
+ * */
+
+#define BLOCK_SIZE 4096
+
+int main(int argc, char **argv) {
+    if(argc < 2) {
+        printf("USAGE: ./test_labfs_fsync_exec [dir] [fsyncs_per_thread] [nthreads]\n");
+        exit(1);
+    }
+    const char *dir = argv[1];
+    int fsyncs_per_thread = 256;
+    int nthreads = 8;
+    if(argc >= 3) { fsyncs_per_thread = atoi(argv[2]); }
+    if(argc >= 4) { nthreads = atoi(argv[3]); }
+    int total = fsyncs_per_thread*nthreads;
+    std::vector<double> latencies(total);
+    int errors = 0;
+
+    //Write and sync
+    omp_set_dynamic(0);
+#pragma omp parallel num_threads(nthreads) reduction(+:errors)
+    {
+        int rank = omp_get_thread_num();
+        char path[4096], buf[BLOCK_SIZE];
+        snprintf(path, sizeof(path), "%s/fsync.%d", dir, rank);
+        int fd = open(path, O_CREAT | O_TRUNC | O_RDWR, 0666);
+        if(fd < 0) {
+            printf("Could not open %s\n", path);
+            ++errors;
+        }
+#pragma omp barrier
+        for(int i = 0; fd >= 0 && i < fsyncs_per_thread; ++i) {
+            memset(buf, (rank + i) % 256, BLOCK_SIZE);
+            if(pwrite(fd, buf, BLOCK_SIZE, (off_t)i*BLOCK_SIZE) != BLOCK_SIZE) {
+                printf("Failed to write block %d of %s\n", i, path);
+                ++errors;
+                continue;
+            }
+            labstor::HighResMonotonicTimer t;
+            t.Resume();
+            int ret = (i % 2) ? fdatasync(fd) : fsync(fd);
+            latencies[rank*fsyncs_per_thread + i] = t.GetUsecFromStart();
+            if(ret < 0) {
+                perror("Failed to sync");
+                ++errors;
+            }
+        }
+        if(fd >= 0) { close(fd); }
+    }
+
+    //Verify the synced data
+#pragma omp parallel num_threads(nthreads) reduction(+:errors)
+    {
+        int rank = omp_get_thread_num();
+        char path[4096], buf[BLOCK_SIZE];
+        snprintf(path, sizeof(path), "%s/fsync.%d", dir, rank);
+        int fd = open(path, O_RDONLY);
+        for(int i = 0; fd >= 0 && i < fsyncs_per_thread; ++i) {
+            if(pread(fd, buf, BLOCK_SIZE, (off_t)i*BLOCK_SIZE) != BLOCK_SIZE) {
+                ++errors;
+                continue;
+            }
+            for(int j = 0; j < BLOCK_SIZE; ++j) {
+                if(buf[j] != (char)((rank + i) % 256)) {
+                    printf("%s[%d] = %d, but should be %d\n", path, i*BLOCK_SIZE + j, buf[j], (rank + i) % 256);
+                    ++errors;
+                    break;
+                }
+            }
+        }
+        if(fd < 0) { ++errors; } else { close(fd); unlink(path); }
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    printf("fsync: threads=%d syncs=%d p50=%lfus p99=%lfus max=%lfus errors=%d\n",
+           nthreads, total, latencies[total/2], latencies[(size_t)(total*.99)], latencies[total - 1], errors);
+    return errors ? 1 : 0;
+}
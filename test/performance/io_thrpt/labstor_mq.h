@@ -41,7 +41,11 @@ struct LabStorMQThread {
     int hctx_;
     LabStorMQThread(int ops_per_batch, size_t block_size) {
         int nonce = 12;
-        buf_ = aligned_alloc(4096, block_size);
+        //Buffers in the data pool are served without pinning pages
+        buf_ = LABSTOR_IPC_MANAGER->AllocBuffer(block_size);
+        if(buf_ == nullptr) {
+            buf_ = aligned_alloc(4096, block_size);
+        }
         memset(buf_, nonce, block_size);
         qtoks_ = new labstor::ipc::qtok_t[ops_per_batch];
         hctx_ = -1;
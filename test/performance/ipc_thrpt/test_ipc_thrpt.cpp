@@ -30,6 +30,32 @@
 #include "labmods/ipc_test/client/ipc_test_client.h"
 
 #include <unistd.h>
+#include <cstring>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+//Count a hardware cache event for this process and its threads, e.g., dTLB
+//misses or loads served by a remote NUMA node. Returns -1 if unsupported.
+int open_cache_counter(int cache, int result) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+long long read_counter(int fd) {
+    long long count = 0;
+    if(fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count)) {
+        return -1;
+    }
+    return count;
+}
 
 int main(int argc, char **argv) {
     if(argc != 7) {
@@ -63,6 +89,12 @@ int main(int argc, char **argv) {
 
     printf("IPC Manager Connected?\n");
 
+    //Count TLB misses and remote-node loads while the clients run
+    int tlb_fd = open_cache_counter(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_MISS);
+    int remote_fd = open_cache_counter(PERF_COUNT_HW_CACHE_NODE, PERF_COUNT_HW_CACHE_RESULT_MISS);
+    ioctl(tlb_fd, PERF_EVENT_IOC_ENABLE, 0);
+    ioctl(remote_fd, PERF_EVENT_IOC_ENABLE, 0);
+
     //Spam the trusted server
     omp_set_dynamic(0);
     #pragma omp parallel shared(n_server_cores, n_kernel_cores, dedicated, n_clients, n_msgs, batch_size, client, t) num_threads(n_clients)
@@ -85,7 +117,10 @@ int main(int argc, char **argv) {
         LABSTOR_ERROR_HANDLE_END()
     }
 
-    printf("%s,%s,%s,%d,%d,%d,%lf,%lf\n",
+    ioctl(tlb_fd, PERF_EVENT_IOC_DISABLE, 0);
+    ioctl(remote_fd, PERF_EVENT_IOC_DISABLE, 0);
+
+    printf("%s,%s,%s,%d,%d,%d,%lf,%lf,%lld,%lld\n",
            n_server_cores,
            n_kernel_cores,
            dedicated,
@@ -93,5 +128,7 @@ int main(int argc, char **argv) {
            n_msgs,
            batch_size,
            t.GetUsec(),
-           n_msgs/t.GetUsec());
+           n_msgs/t.GetUsec(),
+           read_counter(tlb_fd),
+           read_counter(remote_fd));
 }
\ No newline at end of file
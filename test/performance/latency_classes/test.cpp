@@ -0,0 +1,192 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+//One latency-sensitive client shares a worker with bulk clients which keep their
+//queues full. The worker is simulated in virtual time with the real LatencyScheduler,
+//so the tail latency of the latency client only depends on the scheduling policy.
+//Each run is repeated with the bulk queue pairs tagged low-latency and high-latency.
+
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <random>
+#include <labstor/userspace/server/latency_scheduler.h>
+#include "labstor/types/data_structures/c/shmem_queue_pair.h"
+
+#define QUEUE_DEPTH 64
+#define REQ_COST_NS 2000
+#define THINK_NS 50000
+
+struct SimClient {
+    labstor::ipc::shmem_queue_pair qp_;
+    labstor::ipc::request *rqs_;
+    std::deque<labstor::ipc::qtok_t> qtoks_;
+    uint32_t next_rq_;
+    SimClient() : rqs_(nullptr), next_rq_(0) {}
+    bool Submit() {
+        labstor::ipc::qtok_t qtok;
+        if(qtoks_.size() == QUEUE_DEPTH || !qp_.Enqueue(rqs_ + next_rq_, qtok)) { return false; }
+        next_rq_ = (next_rq_ + 1) % QUEUE_DEPTH;
+        qtoks_.emplace_back(qtok);
+        return true;
+    }
+    void Reap() {
+        labstor::ipc::request *rq;
+        while(qtoks_.size() && qp_.IsComplete(qtoks_.front(), rq)) {
+            qtoks_.pop_front();
+        }
+    }
+};
+
+struct SimResult {
+    double p50_us_, p99_us_, max_us_;
+    double bulk_kops_;
+};
+
+SimResult simulate(int num_bulk, bool tag_bulk, uint32_t high_budget, int num_latency_rqs) {
+    std::vector<SimClient> clients(num_bulk + 1);
+    uint32_t sq_size = labstor::ipc::request_queue::GetSize(QUEUE_DEPTH);
+    uint32_t cq_size = labstor::ipc::completion_ring::GetSize(QUEUE_DEPTH);
+    uint32_t rq_size = QUEUE_DEPTH*sizeof(labstor::ipc::request);
+    void *base_region = malloc(clients.size()*(sq_size + cq_size + rq_size));
+    void *cur_region = base_region;
+
+    //The latency client takes the last slot, so it is visited after the bulk ones of its class
+    for(int i = 0; i < (int)clients.size(); ++i) {
+        bool bulk = i < num_bulk;
+        labstor_qid_flags_t flags = LABSTOR_QP_SHMEM | LABSTOR_QP_ORDERED |
+                (bulk && tag_bulk ? LABSTOR_QP_HIGH_LATENCY : LABSTOR_QP_LOW_LATENCY);
+        labstor::ipc::qid_t qid = labstor::queue_pair::GetQID(0, flags, i, clients.size(), 0);
+        void *sq_region = cur_region;
+        void *cq_region = LABSTOR_REGION_ADD(sq_size, cur_region);
+        clients[i].rqs_ = (labstor::ipc::request*)LABSTOR_REGION_ADD(sq_size + cq_size, cur_region);
+        clients[i].qp_.Init(qid, base_region, QUEUE_DEPTH, sq_region, sq_size, cq_region, cq_size);
+        cur_region = LABSTOR_REGION_ADD(sq_size + cq_size + rq_size, cur_region);
+    }
+    SimClient &latency_client = clients[num_bulk];
+
+    labstor::Server::LatencyScheduler scheduler;
+    scheduler.Resize(clients.size());
+    scheduler.SetClassBudget(LABSTOR_WORKER_HIGH_LATENCY_CLASS, high_budget);
+
+    //The latency client submits one request at a time, THINK_NS after its last one completed on average
+    std::mt19937 rng(0);
+    std::uniform_int_distribution<uint64_t> think_ns(0, 2*THINK_NS);
+    uint64_t now_ns = 0, next_submit_ns = 0, submit_ns = 0, num_bulk_processed = 0;
+    bool outstanding = false;
+    std::vector<uint64_t> latencies;
+    auto tick = [&]() {
+        if(!outstanding && now_ns >= next_submit_ns && latency_client.Submit()) {
+            submit_ns = now_ns;
+            outstanding = true;
+        }
+    };
+    auto process = [&](uint32_t slot, uint32_t max_count, bool &keep) -> uint32_t {
+        labstor::ipc::shmem_queue_pair &qp = clients[slot].qp_;
+        labstor::ipc::request *rq;
+        uint32_t num_processed = 0;
+        while(num_processed < max_count && qp.Dequeue(rq)) {
+            now_ns += REQ_COST_NS;
+            qp.Complete(rq);
+            ++num_processed;
+            if(slot == (uint32_t)num_bulk) {
+                latencies.emplace_back(now_ns - submit_ns);
+                latency_client.Reap();
+                outstanding = false;
+                next_submit_ns = now_ns + think_ns(rng);
+            } else {
+                ++num_bulk_processed;
+            }
+            tick();
+        }
+        keep = qp.GetDepth() > 0;
+        return num_processed;
+    };
+
+    while((int)latencies.size() < num_latency_rqs) {
+        //Bulk clients reap what completed and fill their queues back up
+        for(int i = 0; i < num_bulk; ++i) {
+            clients[i].Reap();
+            while(clients[i].Submit());
+        }
+        tick();
+
+        //One worker pass: collect the active queue pairs, then serve each class
+        for(uint32_t i = 0; i < clients.size(); ++i) {
+            if(scheduler.IsQueued(i) || clients[i].qp_.GetDepth() == 0) { continue; }
+            int c = LABSTOR_QP_IS_HIGH_LATENCY(clients[i].qp_.GetQID().flags_) ?
+                    LABSTOR_WORKER_HIGH_LATENCY_CLASS : LABSTOR_WORKER_LOW_LATENCY_CLASS;
+            scheduler.Enqueue(c, i);
+        }
+        uint32_t num_processed = 0;
+        for(int c = 0; c < LABSTOR_WORKER_NUM_CLASSES; ++c) {
+            num_processed += scheduler.ProcessClass(c, process);
+        }
+        if(num_processed == 0) {
+            now_ns = std::max(now_ns + 1, next_submit_ns);
+        }
+    }
+    free(base_region);
+
+    SimResult result;
+    std::sort(latencies.begin(), latencies.end());
+    result.p50_us_ = latencies[latencies.size()/2] / 1000.0;
+    result.p99_us_ = latencies[latencies.size()*99/100] / 1000.0;
+    result.max_us_ = latencies.back() / 1000.0;
+    result.bulk_kops_ = num_bulk_processed / (now_ns / 1000000.0);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    if(argc != 3) {
+        printf("USAGE: ./test_latency_classes [nbulk] [nreqs]\n");
+        exit(1);
+    }
+    int num_bulk = atoi(argv[1]);
+    int num_latency_rqs = atoi(argv[2]);
+
+    SimResult untagged = simulate(num_bulk, false, LABSTOR_WORKER_HIGH_LATENCY_BUDGET, num_latency_rqs);
+    printf("Bulk untagged: p50: %lf us p99: %lf us max: %lf us bulk thrpt: %lf Kops\n",
+           untagged.p50_us_, untagged.p99_us_, untagged.max_us_, untagged.bulk_kops_);
+    double worst_p99 = 0;
+    for(uint32_t high_budget : {8, 32, 128}) {
+        SimResult tagged = simulate(num_bulk, true, high_budget, num_latency_rqs);
+        printf("Bulk high-latency (budget %u): p50: %lf us p99: %lf us max: %lf us bulk thrpt: %lf Kops\n",
+               high_budget, tagged.p50_us_, tagged.p99_us_, tagged.max_us_, tagged.bulk_kops_);
+        if(high_budget == LABSTOR_WORKER_HIGH_LATENCY_BUDGET) { worst_p99 = tagged.p99_us_; }
+    }
+
+    //A tagged latency request waits for at most one high-latency budget of bulk requests
+    double bound_us = (2*LABSTOR_WORKER_HIGH_LATENCY_BUDGET + 1) * REQ_COST_NS / 1000.0;
+    if(worst_p99 > bound_us || worst_p99 >= untagged.p99_us_) {
+        printf("FAIL: high-latency bulk queue pairs did not protect the p99 (%lf us, bound %lf us)\n", worst_p99, bound_us);
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
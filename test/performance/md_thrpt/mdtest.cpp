@@ -0,0 +1,99 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <labstor/userspace/util/timer.h>
+
+/*
+ * An mdtest-style metadata benchmark. Each thread creates, stats, and unlinks
+ * its own files in a shared directory. Run it with the GenericPosix client
+ * preloaded and a "lab::" directory to measure LabFS metadata throughput.
+ * */
+
+typedef int (*md_op_fn)(const char *path);
+
+static int create_file(const char *path) {
+    int fd = open(path, O_CREAT | O_WRONLY | O_EXCL, 0666);
+    if(fd < 0) { return fd; }
+    return close(fd);
+}
+
+static int stat_file(const char *path) {
+    struct stat st;
+    return stat(path, &st);
+}
+
+static int unlink_file(const char *path) {
+    return unlink(path);
+}
+
+void run_phase(const char *name, md_op_fn op, const char *dir, int files_per_thread, int nthreads) {
+    labstor::HighResMonotonicTimer t;
+    int errors = 0;
+
+    omp_set_dynamic(0);
+#pragma omp parallel shared(t) num_threads(nthreads) reduction(+:errors)
+    {
+        int rank = omp_get_thread_num();
+        char path[4096];
+#pragma omp barrier
+#pragma omp master
+        t.Resume();
+        for(int i = 0; i < files_per_thread; ++i) {
+            snprintf(path, sizeof(path), "%s/file.%d.%d", dir, rank, i);
+            if(op(path) < 0) { ++errors; }
+        }
+#pragma omp barrier
+#pragma omp master
+        t.Pause();
+    }
+
+    int total_ops = files_per_thread*nthreads;
+    printf("%s: threads=%d files=%d thrpt=%lf ops/sec errors=%d\n",
+           name, nthreads, total_ops, total_ops/t.GetSec(), errors);
+}
+
+int main(int argc, char **argv) {
+    if(argc < 2) {
+        printf("USAGE: ./test_mdtest [dir] [files_per_thread] [nthreads]\n");
+        exit(1);
+    }
+    const char *dir = argv[1];
+    int files_per_thread = 1024;
+    int nthreads = 1;
+    if(argc >= 3) { files_per_thread = atoi(argv[2]); }
+    if(argc >= 4) { nthreads = atoi(argv[3]); }
+    mkdir(dir, 0777);
+    run_phase("create", create_file, dir, files_per_thread, nthreads);
+    run_phase("stat", stat_file, dir, files_per_thread, nthreads);
+    run_phase("unlink", unlink_file, dir, files_per_thread, nthreads);
+    return 0;
+}
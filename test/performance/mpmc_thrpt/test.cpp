@@ -0,0 +1,116 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <labstor/userspace/util/timer.h>
+#include "labstor/types/data_structures/shmem_ring_buffer.h"
+#include "labstor/types/data_structures/shmem_lockless_ring_buffer.h"
+
+/*
+ * Compares the trylock MPMC ring against the lockless MPMC ring.
+ * Every failed Enqueue/Dequeue forces the caller to retry. For the lockless ring
+ * a retry only happens when the ring is truly full or empty.
+ * */
+
+template<typename RingT>
+void produce_and_consume(const char *name, int total_reqs, int num_producers, int num_consumers, int queue_depth) {
+    labstor::HighResMonotonicTimer t;
+    RingT q;
+    size_t region_size;
+    void *region;
+    int reqs_per_producer, nthreads = num_producers + num_consumers;
+    uint64_t enqueue_retries = 0, dequeue_retries = 0, checksum = 0;
+
+    //Get total number of requests and reqs per thread
+    total_reqs = num_producers * (total_reqs/num_producers);
+    reqs_per_producer = total_reqs/num_producers;
+
+    //Allocate region & initialize queue
+    LABSTOR_ERROR_HANDLE_START()
+    region_size = RingT::GetSize(queue_depth);
+    region = malloc(region_size);
+    q.Init(region, region_size, queue_depth);
+    LABSTOR_ERROR_HANDLE_END()
+
+    int reqs_per_consumer = total_reqs / num_consumers;
+    int extra_reqs = total_reqs % num_consumers;
+
+    omp_set_dynamic(0);
+#pragma omp parallel shared(q, t) num_threads(nthreads) reduction(+:enqueue_retries,dequeue_retries,checksum)
+    {
+        int rank = omp_get_thread_num();
+#pragma omp barrier
+#pragma omp master
+        t.Resume();
+        if(rank < num_producers) {
+            for(int i = 0; i < reqs_per_producer; ++i) {
+                uint32_t data = rank*reqs_per_producer + i;
+                while(!q.Enqueue(data)) { ++enqueue_retries; }
+            }
+        } else {
+            int consumer_rank = rank - num_producers;
+            int my_reqs = reqs_per_consumer + (consumer_rank < extra_reqs ? 1 : 0);
+            for(int i = 0; i < my_reqs; ++i) {
+                uint32_t data;
+                while(!q.Dequeue(data)) { ++dequeue_retries; }
+                checksum += data;
+            }
+        }
+#pragma omp barrier
+#pragma omp master
+        t.Pause();
+    }
+
+    uint64_t expected = ((uint64_t)total_reqs*(total_reqs - 1))/2;
+    if(checksum != expected) {
+        printf("%s: requests were lost or duplicated (%lu vs %lu)\n", name, checksum, expected);
+        exit(1);
+    }
+    printf("%s: producers=%d consumers=%d depth=%d thrpt=%lf Kops enqueue_retries=%lu dequeue_retries=%lu\n",
+           name, num_producers, num_consumers, queue_depth,
+           total_reqs/t.GetMsec(), enqueue_retries, dequeue_retries);
+    free(region);
+}
+
+int main(int argc, char **argv) {
+    int total_reqs = 1<<22;
+    int queue_depth = 1024;
+    int max_threads = omp_get_num_procs();
+    if(argc >= 2) { total_reqs = atoi(argv[1]); }
+    if(argc >= 3) { queue_depth = atoi(argv[2]); }
+    if(argc >= 4) { max_threads = atoi(argv[3]); }
+    //Always measure one producer against one consumer, even if they share a core
+    if(max_threads < 2) { max_threads = 2; }
+    for(int nthreads = 2; nthreads <= max_threads; nthreads *= 2) {
+        produce_and_consume<labstor::ipc::mpmc::ring_buffer<uint32_t>>(
+                "trylock", total_reqs, nthreads/2, nthreads/2, queue_depth);
+        produce_and_consume<labstor::ipc::mpmc::lockless_ring_buffer<uint32_t>>(
+                "lockless", total_reqs, nthreads/2, nthreads/2, queue_depth);
+    }
+    return 0;
+}
@@ -46,7 +46,7 @@ void test_throughput(int total_reqs) {
     //Allocate region & initialize queue
     LABSTOR_ERROR_HANDLE_START()
     sq_size = labstor::ipc::request_queue::GetSize(queue_depth);
-    cq_size = labstor::ipc::request_map::GetSize(queue_depth);
+    cq_size = labstor::ipc::completion_ring::GetSize(queue_depth);
     region = malloc(sq_size + cq_size + total_reqs*sizeof(labstor::ipc::request));
     sq_region = region;
     cq_region = LABSTOR_REGION_ADD(sq_size, region);
@@ -0,0 +1,122 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <labstor/userspace/util/timer.h>
+#include "labstor/types/data_structures/c/shmem_request_ring_buffer.h"
+#include "labstor/types/data_structures/c/shmem_spsc_request_ring.h"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/sysinfo.h>
+#include <sched.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+
+/*
+ * Cross-process ping-pong latency between two SPSC rings in shared memory.
+ * The parent enqueues a token on the ping ring, the child dequeues it and
+ * enqueues it on the pong ring, and the parent measures the round trip.
+ * A token that comes back out of order means the ring published a slot
+ * before its contents were visible.
+ * */
+
+static void Affine(int cpu) {
+    int num_cpu = get_nprocs_conf();
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu % num_cpu, &cpus);
+    sched_setaffinity(0, sizeof(cpus), &cpus);
+}
+
+template<typename RingT>
+void ping_pong(const char *name, int num_round_trips, int queue_depth, int parent_cpu, int child_cpu) {
+    uint32_t ring_size = RingT::GetSize(queue_depth);
+    void *region = mmap(NULL, 2*ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(region == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    RingT ping, pong;
+    LABSTOR_ERROR_HANDLE_START()
+    ping.Init(region, ring_size, queue_depth);
+    pong.Init(LABSTOR_REGION_ADD(ring_size, region), ring_size, queue_depth);
+    LABSTOR_ERROR_HANDLE_END()
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid == 0) {
+        Affine(child_cpu);
+        RingT child_ping, child_pong;
+        child_ping.Attach(region);
+        child_pong.Attach(LABSTOR_REGION_ADD(ring_size, region));
+        labstor_off_t token;
+        for(int i = 0; i < num_round_trips; ++i) {
+            while(!child_ping.Dequeue(token)) {}
+            while(!child_pong.Enqueue(token)) {}
+        }
+        exit(0);
+    }
+
+    Affine(parent_cpu);
+    std::vector<double> latencies(num_round_trips);
+    labstor::HighResMonotonicTimer total;
+    labstor_off_t token;
+    int ordering_errors = 0;
+    total.Resume();
+    for(int i = 0; i < num_round_trips; ++i) {
+        labstor::HighResMonotonicTimer t;
+        t.Resume();
+        while(!ping.Enqueue(i)) {}
+        while(!pong.Dequeue(token)) {}
+        latencies[i] = t.GetNsecFromStart();
+        if(token != i) {
+            ++ordering_errors;
+        }
+    }
+    total.Pause();
+    waitpid(pid, NULL, 0);
+
+    std::sort(latencies.begin(), latencies.end());
+    printf("%s: round_trips=%d avg=%lfns p50=%lfns p99=%lfns p999=%lfns ordering_errors=%d\n",
+           name, num_round_trips,
+           total.GetNsec()/num_round_trips,
+           latencies[num_round_trips/2],
+           latencies[(size_t)(num_round_trips*.99)],
+           latencies[(size_t)(num_round_trips*.999)],
+           ordering_errors);
+    munmap(region, 2*ring_size);
+}
+
+int main(int argc, char **argv) {
+    int num_round_trips = 1<<20;
+    int parent_cpu = 0, child_cpu = 1;
+    if(argc >= 2) { num_round_trips = atoi(argv[1]); }
+    if(argc >= 4) { parent_cpu = atoi(argv[2]); child_cpu = atoi(argv[3]); }
+    ping_pong<labstor::ipc::ring_buffer_labstor_off_t>("request_ring_buffer", num_round_trips, 256, parent_cpu, child_cpu);
+    ping_pong<labstor::ipc::spsc_request_ring>("spsc_request_ring", num_round_trips, 256, parent_cpu, child_cpu);
+    return 0;
+}
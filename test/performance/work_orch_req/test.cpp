@@ -24,3 +24,195 @@
  * <http://www.gnu.org/licenses/>.
  */
 
+//Skewed multi-client load. Every "hot" client starts on worker 0 and the rest of the
+//clients trickle requests to the other workers. The first half of the run keeps
+//this static placement, the second half lets the LoadPlanner migrate queue pairs.
+
+#include <cstdlib>
+#include <cstdio>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include <omp.h>
+#include <labstor/userspace/util/timer.h>
+#include <labstor/userspace/server/load_planner.h>
+#include "labstor/types/data_structures/c/shmem_queue_pair.h"
+
+#define QUEUE_DEPTH 64
+#define HOT_WINDOW 8
+#define COLD_THINK_US 500
+#define REQ_COST_NS 10000
+#define EPOCH_US 10000
+
+struct SimWorker {
+    std::mutex lock_;
+    std::vector<labstor::ipc::shmem_queue_pair*> qps_;
+    std::atomic<uint64_t> busy_ns_;
+    std::atomic<uint64_t> num_processed_;
+    SimWorker() : busy_ns_(0), num_processed_(0) {}
+};
+
+void spin(double ns) {
+    labstor::HighResMonotonicTimer t;
+    t.Resume();
+    while(t.GetNsecFromStart() < ns);
+}
+
+void worker_loop(SimWorker &worker, std::atomic<int> &clients_running) {
+    labstor::HighResMonotonicTimer t;
+    labstor::ipc::request *rq;
+    while(clients_running.load()) {
+        uint32_t num_processed = 0;
+        t.Resume();
+        {
+            std::lock_guard<std::mutex> lock(worker.lock_);
+            for(auto qp : worker.qps_) {
+                while(qp->Dequeue(rq)) {
+                    spin(REQ_COST_NS);
+                    qp->Complete(rq);
+                    ++num_processed;
+                }
+            }
+        }
+        if(num_processed) {
+            worker.busy_ns_ += (uint64_t)t.GetNsecFromStart();
+            worker.num_processed_ += num_processed;
+        }
+    }
+}
+
+void client_loop(labstor::ipc::shmem_queue_pair &qp, labstor::ipc::request *rqs, bool hot, std::atomic<bool> &done) {
+    labstor::ipc::qtok_t qtoks[HOT_WINDOW];
+    int window = hot ? HOT_WINDOW : 1;
+    for(int i = 0; i < window; ++i) {
+        qp.Enqueue(rqs + i, qtoks[i]);
+    }
+    for(int i = 0; !done.load(); i = (i + 1) % window) {
+        qp.Wait<labstor::ipc::request>(qtoks[i]);
+        if(!hot) { usleep(COLD_THINK_US); }
+        qp.Enqueue(rqs + i, qtoks[i]);
+    }
+    for(int i = 0; i < window; ++i) {
+        qp.Wait<labstor::ipc::request>(qtoks[i]);
+    }
+}
+
+void migrate(std::vector<SimWorker> &workers, labstor::Server::QueuePairMigration &migration) {
+    auto qp = (labstor::ipc::shmem_queue_pair*)migration.qp_;
+    {
+        auto &qps = workers[migration.src_worker_id_].qps_;
+        std::lock_guard<std::mutex> lock(workers[migration.src_worker_id_].lock_);
+        qps.erase(std::find(qps.begin(), qps.end(), qp));
+    }
+    std::lock_guard<std::mutex> lock(workers[migration.dst_worker_id_].lock_);
+    workers[migration.dst_worker_id_].qps_.emplace_back(qp);
+}
+
+int main(int argc, char **argv) {
+    if(argc != 4) {
+        printf("USAGE: ./work_orch_req [nworkers] [nclients] [nepochs]\n");
+        exit(1);
+    }
+    int num_workers = atoi(argv[1]);
+    int num_clients = atoi(argv[2]);
+    int num_epochs = atoi(argv[3]);
+    int nthreads = num_workers + num_clients + 1;
+
+    //Allocate queue pairs and requests
+    std::vector<labstor::ipc::shmem_queue_pair> qps(num_clients);
+    std::vector<SimWorker> workers(num_workers);
+    uint32_t sq_size = labstor::ipc::request_queue::GetSize(QUEUE_DEPTH);
+    uint32_t cq_size = labstor::ipc::completion_ring::GetSize(QUEUE_DEPTH);
+    uint32_t rq_size = HOT_WINDOW*sizeof(labstor::ipc::request);
+    void *base_region = malloc(num_clients*(sq_size + cq_size + rq_size));
+    void *cur_region = base_region;
+    std::vector<labstor::ipc::request*> rqs(num_clients);
+    for(int i = 0; i < num_clients; ++i) {
+        void *sq_region = cur_region;
+        void *cq_region = LABSTOR_REGION_ADD(sq_size, cur_region);
+        rqs[i] = (labstor::ipc::request*)LABSTOR_REGION_ADD(sq_size + cq_size, cur_region);
+        qps[i].Init(0, base_region, QUEUE_DEPTH, sq_region, sq_size, cq_region, cq_size);
+        cur_region = LABSTOR_REGION_ADD(sq_size + cq_size + rq_size, cur_region);
+    }
+
+    //Clients are striped evenly among workers; the hot ones all land on worker 0
+    labstor::Server::LoadPlanner planner;
+    for(int i = 0; i < num_workers; ++i) {
+        planner.AddWorker(i, num_clients);
+    }
+    for(int i = 0; i < num_clients; ++i) {
+        workers[i % num_workers].qps_.emplace_back(&qps[i]);
+        planner.AddQueuePair(&qps[i], i % num_workers);
+    }
+
+    std::atomic<bool> done(false);
+    std::atomic<int> clients_running(num_clients);
+    double static_thrpt = 0, dynamic_thrpt = 0;
+    double static_spread = 0, dynamic_spread = 0;
+    omp_set_dynamic(0);
+#pragma omp parallel shared(qps, workers, planner, done, clients_running) num_threads(nthreads)
+    {
+        int rank = omp_get_thread_num();
+        if(rank < num_workers) {
+            worker_loop(workers[rank], clients_running);
+        } else if(rank < num_workers + num_clients) {
+            int client = rank - num_workers;
+            client_loop(qps[client], rqs[client], client % num_workers == 0, done);
+            --clients_running;
+        } else {
+            labstor::HighResMonotonicTimer t;
+            std::vector<labstor::Server::QueuePairMigration> migrations;
+            uint64_t last_processed = 0;
+            t.Resume();
+            for(int epoch = 0; epoch < num_epochs; ++epoch) {
+                bool dynamic = epoch >= num_epochs / 2;
+                usleep(EPOCH_US);
+                double elapsed_ns = t.GetNsecFromStart();
+                t.Resume();
+
+                //Sample load
+                uint64_t processed = 0;
+                double max_util = 0, min_util = 1;
+                for(int i = 0; i < num_workers; ++i) {
+                    planner.SampleWorker(i, workers[i].busy_ns_.load(), workers[i].num_processed_.load(), elapsed_ns);
+                    double util = planner.GetWorkerLoad(i).util_;
+                    max_util = std::max(max_util, util);
+                    min_util = std::min(min_util, util);
+                    processed += workers[i].num_processed_.load();
+                }
+                planner.SampleQueuePairs(elapsed_ns);
+                double thrpt = (processed - last_processed) / (elapsed_ns / 1000000);
+                last_processed = processed;
+
+                //Rebalance
+                migrations.clear();
+                if(dynamic) {
+                    planner.Plan(migrations);
+                    for(auto &migration : migrations) {
+                        migrate(workers, migration);
+                        planner.MoveQueuePair(migration.qp_, migration.dst_worker_id_);
+                    }
+                }
+
+                printf("Epoch[%d] %s Thrpt: %lf Kops MaxUtil: %lf MinUtil: %lf Migrations: %lu\n",
+                       epoch, dynamic ? "dynamic" : "static", thrpt, max_util, min_util, migrations.size());
+                if(dynamic) {
+                    dynamic_thrpt += thrpt;
+                    dynamic_spread += max_util - min_util;
+                } else {
+                    static_thrpt += thrpt;
+                    static_spread += max_util - min_util;
+                }
+            }
+            done = true;
+        }
+    }
+
+    int num_static = num_epochs / 2, num_dynamic = num_epochs - num_static;
+    printf("Static: %lf Kops, utilization spread %lf\n", static_thrpt / num_static, static_spread / num_static);
+    printf("Dynamic: %lf Kops, utilization spread %lf\n", dynamic_thrpt / num_dynamic, dynamic_spread / num_dynamic);
+    free(base_region);
+    return 0;
+}
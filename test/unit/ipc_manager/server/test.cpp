@@ -49,7 +49,7 @@ int main() {
         void *sq_region = region;
         void *cq_region = (char*)region + queue_size;
         qp->Init(qid, region, sq_region, queue_size, cq_region, queue_size);
-        printf("%d\n", qp->cq_.GetNumBuckets());
+        printf("%d\n", qp->cq_.GetMaxDepth());
 
         //Store QP internally
         qps_by_id_.Set(qid, qp);
@@ -62,5 +62,5 @@ int main() {
             num_queues,
             KERNEL_PID);
     kern_qp = qps_by_id_[qid];
-    printf("%d\n", kern_qp->cq_.GetNumBuckets());*/
+    printf("%d\n", kern_qp->cq_.GetMaxDepth());*/
 }
\ No newline at end of file
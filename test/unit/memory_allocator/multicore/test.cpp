@@ -24,145 +24,146 @@
  * <http://www.gnu.org/licenses/>.
  */
 
-#include <mpi.h>
+//Allocations per second of the per-core shmem allocator versus the number of threads.
+//RINGS calls the per-core rings directly, MAGAZINE goes through the per-thread magazines.
+//In the LOCAL pattern a thread frees what it allocated. In the REMOTE pattern threads
+//are paired and each frees the pages its partner allocated, like a client and a server
+//worker exchanging requests.
+
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <omp.h>
+#include <labstor/userspace/util/timer.h>
 #include <labstor/types/allocator/shmem_allocator.h>
-#include <labstor/types/allocator/private_shmem_allocator.h>
-#include <labmods/secure_shmem/netlink_client/secure_shmem_client_netlink.h>
 
-uint32_t ncores = 8;
 uint32_t page_size = 128;
-uint32_t num_pages = 64;
-size_t region_size = ncores * page_size * num_pages;
-void *region;
-
-labstor::GenericAllocator* private_allocator_init(int rank) {
-    labstor::ipc::private_shmem_allocator *allocator = new labstor::ipc::private_shmem_allocator();
-    if(rank == 0) {
-        allocator->Init(region, region, region_size, page_size);
-    }
-    MPI_Barrier(MPI_COMM_WORLD);
-    if(rank != 0) {
-        allocator->Attach(region, region);
+uint32_t pages_per_thread = 1024;
+uint32_t batch = 16;
+
+struct Handoff {
+    std::atomic<uint32_t> count_;
+    std::atomic<bool> finished_;
+    void *pages_[64];
+    Handoff() : count_(0), finished_(false) {}
+};
+
+inline void* alloc_page(labstor::ipc::shmem_allocator *allocator, bool magazine, int rank) {
+    if(magazine) {
+        return allocator->Alloc(page_size, rank);
     }
-    return allocator;
+    return labstor_shmem_allocator_Alloc(allocator, page_size, rank);
 }
 
-labstor::GenericAllocator* multicore_allocator_init(int rank) {
-    labstor::ipc::shmem_allocator *allocator = new labstor::ipc::shmem_allocator();
-    if(rank == 0) {
-        allocator->Init(region, region, region_size, page_size, 4);
+inline void free_page(labstor::ipc::shmem_allocator *allocator, bool magazine, void *page) {
+    if(magazine) {
+        allocator->Free(page);
+    } else {
+        labstor_shmem_allocator_Free(allocator, page);
     }
-    MPI_Barrier(MPI_COMM_WORLD);
-    if(rank != 0) {
-        allocator->Attach(region, region);
-    }
-    return allocator;
 }
 
-std::vector<void*> create_requests(int rank, labstor::GenericAllocator *allocator, int max) {
-    void *page;
-    int *intpg;
-    std::vector<void*> pages;
-    for(int i = 0; i < max; ++i) {
-        page = allocator->Alloc(page_size, rank % ncores);
-        if(page == nullptr) { break; }
-        intpg = (int*)page;
-        *intpg = rank*10000 + i;
-        pages.emplace_back(page);
+void local_test(labstor::ipc::shmem_allocator *allocator, bool magazine, int rank, size_t ops) {
+    void *pages[64];
+    for(size_t i = 0; i < ops; i += batch) {
+        for(uint32_t j = 0; j < batch; ++j) {
+            pages[j] = alloc_page(allocator, magazine, rank);
+            if(pages[j] == nullptr) {
+                printf("Allocator ran out of pages\n");
+                exit(1);
+            }
+            *(int*)pages[j] = rank;
+        }
+        for(uint32_t j = 0; j < batch; ++j) {
+            free_page(allocator, magazine, pages[j]);
+        }
     }
-    return std::move(pages);
 }
 
-void view_request_values(int rank, int nprocs, std::vector<void*> &pages) {
-    MPI_Barrier(MPI_COMM_WORLD);
-    for(int p = 0; p < nprocs; ++p) {
-        if(rank == p) {
-            for (int i = 0; i < pages.size(); ++i) {
-                int *page = (int *)pages[i];
-                printf("PAGE[%d,%d]: %d\n", rank, i, *page);
+void remote_test(labstor::ipc::shmem_allocator *allocator, bool magazine, int rank, size_t ops, std::vector<Handoff> &handoffs) {
+    Handoff &mine = handoffs[rank], &partner = handoffs[rank ^ 1];
+    size_t done = 0;
+    while(true) {
+        //Hand a batch of new pages to the partner
+        if(done < ops && partner.count_.load(std::memory_order_acquire) == 0) {
+            for(uint32_t j = 0; j < batch; ++j) {
+                partner.pages_[j] = alloc_page(allocator, magazine, rank);
+                if(partner.pages_[j] == nullptr) {
+                    printf("Allocator ran out of pages\n");
+                    exit(1);
+                }
+            }
+            partner.count_.store(batch, std::memory_order_release);
+            done += batch;
+            if(done >= ops) { mine.finished_ = true; }
+        }
+        //Free the batch the partner handed over
+        uint32_t count = mine.count_.load(std::memory_order_acquire);
+        if(count) {
+            for(uint32_t j = 0; j < count; ++j) {
+                free_page(allocator, magazine, mine.pages_[j]);
             }
-            printf("\n");
+            mine.count_.store(0, std::memory_order_release);
+        } else if(done >= ops && partner.finished_.load() && partner.count_.load(std::memory_order_acquire) == 0) {
+            break;
+        } else {
+            LABSTOR_YIELD();
         }
-        MPI_Barrier(MPI_COMM_WORLD);
     }
 }
 
-void multicore_test(labstor::GenericAllocator *allocator) {
-    void *page;
-    int *intpg, i = 0;
-    std::vector<void*> pages;
-    int nprocs, rank;
-
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
-
-    //Allocate requests
-    pages = create_requests(rank, allocator, ncores*num_pages);
-
-    //View request values
-    view_request_values(rank, nprocs, pages);
-
-    //Free requests
-    for(uint32_t i = 0; i < pages.size(); ++i) {
-        allocator->Free(pages[i]);
+double run(std::string allocator_type, std::string pattern, int nthreads, size_t ops) {
+    bool magazine = allocator_type == "MAGAZINE";
+    size_t region_size = nthreads * page_size * pages_per_thread;
+    void *region = malloc(region_size);
+    auto allocator = new labstor::ipc::shmem_allocator();
+    allocator->Init(region, region, region_size, page_size, nthreads);
+    std::vector<Handoff> handoffs(nthreads + 1);
+    std::atomic<int> ready(0);
+    labstor::HighResMonotonicTimer t;
+
+    omp_set_dynamic(0);
+#pragma omp parallel shared(allocator, handoffs, ready, t) num_threads(nthreads)
+    {
+        int rank = omp_get_thread_num();
+        ++ready;
+        while(ready.load() < nthreads);
+#pragma omp single
+        t.Resume();
+        if(pattern == "REMOTE" && nthreads > 1) {
+            remote_test(allocator, magazine, rank, ops, handoffs);
+        } else {
+            local_test(allocator, magazine, rank, ops);
+        }
+#pragma omp barrier
+#pragma omp single
+        t.Pause();
+        if(magazine) {
+            labstor::ipc::shmem_magazine_cache::Flush(allocator);
+        }
     }
 
-    //Allocate requests
-    pages = create_requests(rank, allocator, pages.size());
-
-    //View request values
-    view_request_values(rank, nprocs, pages);
+    free(region);
+    return nthreads * ops / t.GetMsec() / 1000;
 }
 
 int main(int argc, char **argv) {
-    int rank, region_id;
-    MPI_Init(&argc, &argv);
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-    labstor::GenericAllocator *alloc;
-    auto netlink_client_ = LABSTOR_KERNEL_CLIENT;
-    labstor::kernel::netlink::ShmemClient shmem_netlink;
-    std::string allocator_type;
-
-    //Allocator
-    if(argc != 2) {
-        printf("USAGE: ./test [allocator_type]\n");
+    if(argc != 5) {
+        printf("USAGE: ./test [allocator_type] [pattern] [max_threads] [ops_per_thread]\n");
+        printf("allocator_type: RINGS or MAGAZINE\n");
+        printf("pattern: LOCAL or REMOTE\n");
         exit(1);
     }
-    allocator_type = argv[1];
-
-    //Create SHMEM region
-    netlink_client_->Connect();
-    if(rank == 0) {
-        region_id = shmem_netlink.CreateShmem(region_size, true);
-        if(region_id < 0) {
-            printf("Failed to allocate SHMEM!\n");
-            exit(1);
-        }
-        printf("Sending ID: %d\n", region_id);
-    }
-    MPI_Bcast(&region_id, 1, MPI_INT, 0, MPI_COMM_WORLD);
-    printf("REGION ID: %d\n", region_id);
-
-    //Grant MPI rank access to region
-    shmem_netlink.GrantPidShmem(getpid(), region_id);
-    region = shmem_netlink.MapShmem(region_id, region_size);
-    if(region == NULL) {
-        printf("Failed to map shmem\n");
-        exit(1);
+    std::string allocator_type = argv[1];
+    std::string pattern = argv[2];
+    int max_threads = atoi(argv[3]);
+    size_t ops = atol(argv[4]);
+    ops = (ops + batch - 1) / batch * batch;
+
+    for(int nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+        double thrpt = run(allocator_type, pattern, nthreads, ops);
+        printf("%s %s threads=%d thrpt=%lf Mops\n", allocator_type.c_str(), pattern.c_str(), nthreads, thrpt);
     }
-    printf("Mapped Region ID (rank=%d): %d %p\n", rank, region_id, region);
-
-    //Perform the tests
-    if(allocator_type == "PRIVATE") {
-        multicore_test(private_allocator_init(rank));
-    }
-    if(allocator_type == "MULTICORE") {
-        multicore_test(multicore_allocator_init(rank));
-    }
-    MPI_Barrier(MPI_COMM_WORLD);
-
-    //Delete SHMEM region
-    shmem_netlink.FreeShmem(region_id);
-
-    MPI_Finalize();
-}
\ No newline at end of file
+}
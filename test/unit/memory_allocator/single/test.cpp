@@ -27,6 +27,8 @@
 #include <vector>
 #include <labstor/types/allocator/shmem_allocator.h>
 #include <labstor/types/allocator/private_shmem_allocator.h>
+#include <labstor/types/allocator/slab_allocator.h>
+#include <labstor/types/data_structures/shmem_buffer.h>
 
 uint32_t page_size = 128;
 uint32_t num_pages = 64;
@@ -45,6 +47,105 @@ labstor::GenericAllocator* multicore_allocator_test() {
     return allocator;
 }
 
+labstor::GenericAllocator* slab_allocator_test() {
+    labstor::ipc::slab_allocator *allocator = new labstor::ipc::slab_allocator();
+    allocator->Init(region, region, region_size, LABSTOR_SLAB_MIN_UNIT, 4);
+    return allocator;
+}
+
+void size_class_test(labstor::ipc::slab_allocator *allocator) {
+    std::vector<void*> pages;
+    void *page;
+
+    //Fill the region with the smallest class
+    while(page = allocator->Alloc(1, 0)) {
+        pages.emplace_back(page);
+    }
+    printf("SMALL OBJECTS: %lu\n", pages.size());
+    if(allocator->Alloc(allocator->GetMaxSize() + 1, 0) != nullptr) {
+        printf("Allocated an object larger than the largest class\n");
+        exit(1);
+    }
+
+    //Once freed, the slabs must be reusable by the largest class
+    for(auto small : pages) {
+        allocator->Free(small);
+    }
+    pages.clear();
+    while(page = allocator->Alloc(allocator->GetMaxSize(), 1)) {
+        pages.emplace_back(page);
+    }
+    printf("LARGE OBJECTS: %lu\n", pages.size());
+    if(pages.empty()) {
+        printf("Couldn't reuse free slabs for another size class\n");
+        exit(1);
+    }
+}
+
+void segment_test() {
+    std::vector<void*> pages;
+    void *page;
+    size_t num_first;
+    char *segments = (char*)malloc(2*region_size);
+    labstor::ipc::slab_allocator *allocator = new labstor::ipc::slab_allocator();
+    allocator->Init(segments, segments, region_size, LABSTOR_SLAB_MIN_UNIT, 1, region_size);
+
+    //Exhaust the first segment, then grow the region
+    while(page = allocator->Alloc(page_size, 0)) {
+        pages.emplace_back(page);
+    }
+    num_first = pages.size();
+    allocator->AddSegment(segments + region_size, region_size);
+    while(page = allocator->Alloc(page_size, 0)) {
+        if(page < segments + region_size) {
+            printf("Allocated from the exhausted segment\n");
+            exit(1);
+        }
+        pages.emplace_back(page);
+    }
+    printf("SEGMENTS: %u OBJECTS: %lu -> %lu\n", allocator->GetNumSegments(), num_first, pages.size());
+    if(allocator->GetNumSegments() != 2 || pages.size() <= num_first) {
+        printf("The second segment wasn't used\n");
+        exit(1);
+    }
+
+    //Objects of both segments must find their slab when freed
+    for(auto obj : pages) {
+        allocator->Free(obj);
+    }
+    for(size_t i = 0; i < pages.size(); ++i) {
+        if(allocator->Alloc(page_size, 0) == nullptr) {
+            printf("Couldn't reallocate all objects across segments\n");
+            exit(1);
+        }
+    }
+    free(segments);
+}
+
+void data_pool_test() {
+    std::vector<void*> bufs;
+    void *buf;
+    uint32_t pool_size = 8*LABSTOR_DATA_POOL_SLAB_SIZE;
+    char *pool = (char*)aligned_alloc(LABSTOR_DATA_POOL_UNIT, pool_size);
+    labstor::ipc::slab_allocator *allocator = new labstor::ipc::slab_allocator();
+    allocator->InitSlabs(pool, pool, pool_size, LABSTOR_DATA_POOL_UNIT, LABSTOR_DATA_POOL_SLAB_SIZE, 1);
+
+    //Buffers of every class must be page-aligned
+    for(int cls = 0; cls < allocator->GetClass(allocator->GetMaxSize()) + 1; ++cls) {
+        buf = allocator->Alloc(allocator->GetClassSize(cls), 0);
+        if(buf == nullptr || (size_t)buf % LABSTOR_DATA_POOL_UNIT) {
+            printf("Data buffer of %u bytes isn't page-aligned\n", allocator->GetClassSize(cls));
+            exit(1);
+        }
+        bufs.emplace_back(buf);
+    }
+    printf("DATA POOL: MAX BUFFER %u\n", allocator->GetMaxSize());
+    for(auto obj : bufs) {
+        allocator->Free(obj);
+    }
+    free(pool);
+}
+
 void single_allocate_test(labstor::GenericAllocator *allocator) {
     void *page;
     int *intpg, i = 0;
@@ -98,4 +199,10 @@ int main(int argc, char **argv) {
     if(allocator_type == "MULTICORE") {
         single_allocate_test(multicore_allocator_test());
     }
+    if(allocator_type == "SLAB") {
+        single_allocate_test(slab_allocator_test());
+        size_class_test((labstor::ipc::slab_allocator*)slab_allocator_test());
+        segment_test();
+        data_pool_test();
+    }
 }
\ No newline at end of file
@@ -67,7 +67,7 @@ void produce_and_consume(bool consume, int total_reqs, int num_producers, int nu
     //Allocate region & initialize queue
     LABSTOR_ERROR_HANDLE_START()
     sq_size = labstor::ipc::request_queue::GetSize(queue_depth);
-    cq_size = labstor::ipc::request_map::GetSize(queue_depth);
+    cq_size = labstor::ipc::completion_ring::GetSize(queue_depth);
     region = malloc(sq_size + cq_size + total_reqs*sizeof(labstor::ipc::request));
     sq_region = region;
     cq_region = LABSTOR_REGION_ADD(sq_size, region);
@@ -0,0 +1,120 @@
+
+/*
+ * Copyright (C) 2022  SCS Lab <scslab@iit.edu>,
+ * Luke Logan <llogan@hawk.iit.edu>,
+ * Jaime Cernuda Garcia <jcernudagarcia@hawk.iit.edu>
+ * Jay Lofstead <gflofst@sandia.gov>,
+ * Anthony Kougkas <akougkas@iit.edu>,
+ * Xian-He Sun <sun@iit.edu>
+ *
+ * This file is part of LabStor
+ *
+ * LabStor is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <omp.h>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <vector>
+#include <sched.h>
+#include <labstor/userspace/util/timer.h>
+#include "labstor/types/data_structures/c/shmem_completion_ring.h"
+
+/*
+ * Complete requests from several threads while several threads reap the same ring,
+ * some in order (RemoveAll) and some out of order (FindAndRemove).
+ * Every request must be reaped exactly once, and the ring must never stall full.
+ * */
+
+int main(int argc, char **argv) {
+    int total_reqs = argc > 1 ? atoi(argv[1]) : (1<<16);
+    int num_completers = argc > 2 ? atoi(argv[2]) : 2;
+    int num_reapers = argc > 3 ? atoi(argv[3]) : 4;
+    int queue_depth = argc > 4 ? atoi(argv[4]) : 64;
+    int nthreads = num_completers + num_reapers;
+    labstor::ipc::completion_ring ring;
+    labstor::ipc::request *req_region;
+    std::vector<std::atomic<int>> was_reaped(total_reqs);
+    std::atomic<int> num_reaped = 0, num_errors = 0;
+    uint32_t cq_size;
+    void *base_region;
+
+    cq_size = labstor::ipc::completion_ring::GetSize(queue_depth);
+    base_region = malloc(cq_size + total_reqs*sizeof(labstor::ipc::request));
+    ring.Init(base_region, base_region, cq_size, queue_depth);
+    req_region = (labstor::ipc::request*)LABSTOR_REGION_ADD(cq_size, base_region);
+    for(int i = 0; i < total_reqs; ++i) {
+        req_region[i].req_id_ = i;
+        req_region[i].code_ = 0;
+        was_reaped[i] = 0;
+    }
+
+    omp_set_dynamic(0);
+#pragma omp parallel num_threads(nthreads)
+    {
+        int rank = omp_get_thread_num();
+        labstor::HighResMonotonicTimer t;
+        labstor::ipc::request *rqs[16];
+        t.Resume();
+#pragma omp barrier
+        if(rank < num_completers) {
+            for(int i = rank; i < total_reqs && t.GetMsecFromStart() < 10000;) {
+                labstor::ipc::request *rq = req_region + i;
+                if(ring.SetBatch(&rq, 1)) {
+                    i += num_completers;
+                } else {
+                    sched_yield();
+                }
+            }
+        } else {
+            int reaper = rank - num_completers;
+            int next = reaper;
+            while(num_reaped < total_reqs && t.GetMsecFromStart() < 10000) {
+                uint32_t count = 0;
+                if(reaper % 2) {
+                    count = ring.RemoveAll(rqs, 16);
+                } else {
+                    while(next < total_reqs && was_reaped[next]) {
+                        next += num_reapers;
+                    }
+                    if(next < total_reqs && ring.FindAndRemove(next, rqs[0])) {
+                        count = 1;
+                    } else if(next >= total_reqs) {
+                        count = ring.RemoveAll(rqs, 16);
+                    }
+                }
+                for(uint32_t i = 0; i < count; ++i) {
+                    if(was_reaped[rqs[i]->req_id_]++) {
+                        ++num_errors;
+                    }
+                }
+                if(count == 0) {
+                    sched_yield();
+                }
+                num_reaped += count;
+            }
+        }
+    }
+
+    if(num_errors || num_reaped != total_reqs || ring.GetDepth()) {
+        printf("FAILED: reaped=%d/%d duplicates=%d depth=%u\n",
+               (int)num_reaped, total_reqs, (int)num_errors, ring.GetDepth());
+        return 1;
+    }
+    printf("Reaped %d requests with %d reapers (collisions=%u)\n", total_reqs, num_reapers, ring.GetNumCollisions());
+    free(base_region);
+    return 0;
+}
@@ -63,7 +63,7 @@ void produce_and_consume(int total_reqs, int num_producers, int num_consumers, i
     //Allocate region & initialize queue
     LABSTOR_ERROR_HANDLE_START()
     sq_size = labstor::ipc::request_queue::GetSize(queue_depth);
-    cq_size = labstor::ipc::request_map::GetSize(queue_depth);
+    cq_size = labstor::ipc::completion_ring::GetSize(queue_depth);
     sq_region_size = sq_size*num_producers;
     cq_region_size = cq_size*num_producers;
     req_region_size = total_reqs*sizeof(labstor::ipc::request);
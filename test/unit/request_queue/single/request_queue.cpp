@@ -39,8 +39,10 @@ int main(int argc, char **argv) {
 
     printf("REQUEST QUEUE START!\n");
     q.Init(region, region, queue_size, 10);
-    printf("Max Depth: %d vs %d\n", q.GetMaxDepth(), num_requests);
-    if(q.GetMaxDepth() != num_requests) {
+    //The SQ ring rounds its depth up to a power of two
+    uint32_t expected_depth = labstor_spsc_request_ring_RoundDepthUp(num_requests);
+    printf("Max Depth: %d vs %d\n", q.GetMaxDepth(), expected_depth);
+    if(q.GetMaxDepth() != expected_depth) {
         printf("Max depth calculation is off\n");
         exit(1);
     }